@@ -38,6 +38,8 @@ public class BleManager {
     private final Context context;
     private final android.os.Handler mainHandler = new android.os.Handler(android.os.Looper.getMainLooper());
     private final android.os.Handler locationCheckHandler = new android.os.Handler(android.os.Looper.getMainLooper());
+    // Delivers received messages in order; not cleared on disconnect so nothing already received is lost
+    private final android.os.Handler deliveryHandler = new android.os.Handler(android.os.Looper.getMainLooper());
     // LiveData for state changes
     private final MutableLiveData<String> connectionStatus = new MutableLiveData<>();
     private final MutableLiveData<Protocol.Message> messageReceived = new MutableLiveData<>();
@@ -377,8 +379,16 @@ public class BleManager {
                     Log.d(TAG, "Received notification: " + data.length + " bytes");
                     try {
                         Protocol.Message msg = Protocol.Message.deserialize(data);
-                        Log.d(TAG, "Deserialized message: " + msg);
-                        messageReceived.postValue(msg);
+                        if (msg instanceof Protocol.AggregateMessage) {
+                            // The bridge batches several frames into one notification (length-prefixed)
+                            java.util.List<Protocol.Message> messages = ((Protocol.AggregateMessage) msg).messages;
+                            Log.d(TAG, "Notification carries " + messages.size() + " messages");
+                            for (Protocol.Message inner : messages) {
+                                deliverMessage(inner);
+                            }
+                        } else {
+                            deliverMessage(msg);
+                        }
                     } catch (Exception e) {
                         Log.e(TAG, "Failed to deserialize message: " + e.getMessage());
                     }
@@ -406,6 +416,16 @@ public class BleManager {
         });
     }
 
+    /**
+     * Posts a received message to observers.
+     * postValue() keeps only the latest value until the main thread runs, which would lose all
+     * but the last message of a batch, so every message is set on the main thread on its own.
+     */
+    private void deliverMessage(Protocol.Message msg) {
+        Log.d(TAG, "Deserialized message: " + msg);
+        deliveryHandler.post(() -> messageReceived.setValue(msg));
+    }
+
     @SuppressLint("MissingPermission")
     public boolean sendMessage(Protocol.Message message) {
         if (message == null) {
@@ -241,17 +241,20 @@ public class MainActivity extends AppCompatActivity {
         if (text == null)
             text = "";
         int charCount = text.length();
-        int packedBytes = Protocol.calculatePackedSize(text);
+        int packedBytes = Protocol.calculateEncodedSize(text);
         int totalMessageSize = 12 + packedBytes; // 12 byte header + packed text
 
-        String countText = charCount + "/" + Protocol.MAX_TEXT_LENGTH + " chars (" + totalMessageSize + " bytes)";
+        String countText = charCount + "/" + Protocol.LONG_TEXT_MAX_LENGTH + " chars (" + totalMessageSize + " bytes)";
+        if (charCount > Protocol.MAX_TEXT_LENGTH) {
+            countText += " - sent in parts";
+        }
         binding.charCountTextView.setText(countText);
 
         // Change color if approaching limit
-        if (charCount >= Protocol.MAX_TEXT_LENGTH) {
+        if (charCount >= Protocol.LONG_TEXT_MAX_LENGTH) {
             binding.charCountTextView.setTextColor(
                     androidx.core.content.ContextCompat.getColor(this, R.color.char_count_exceeded));
-        } else if (charCount >= Protocol.MAX_TEXT_LENGTH * CHAR_COUNT_WARNING_THRESHOLD) {
+        } else if (charCount >= Protocol.LONG_TEXT_MAX_LENGTH * CHAR_COUNT_WARNING_THRESHOLD) {
             binding.charCountTextView.setTextColor(
                     androidx.core.content.ContextCompat.getColor(this, R.color.char_count_warning));
         } else {
@@ -8,7 +8,10 @@ import androidx.lifecycle.MutableLiveData;
 import androidx.lifecycle.Observer;
 import androidx.lifecycle.ViewModel;
 
+import java.util.HashSet;
+import java.util.List;
 import java.util.Locale;
+import java.util.Set;
 
 import lora.Protocol;
 
@@ -36,6 +39,10 @@ public class MessageViewModel extends ViewModel {
     private byte seqCounter = 0;
     private boolean observersRegistered = false;
     private byte pendingAckSeq = -1;
+    // Fragment seqs of the last long text still awaiting their ACK, and the seq it is shown with
+    private final Set<Byte> pendingFragmentSeqs = new HashSet<>();
+    private byte longTextSeq = -1;
+    private final Protocol.FragmentAssembler fragmentAssembler = new Protocol.FragmentAssembler();
     // Observers for BLE manager
     private final Observer<Protocol.Message> messageReceivedObserver = this::handleReceivedMessage;
 
@@ -94,9 +101,9 @@ public class MessageViewModel extends ViewModel {
     public void sendMessage(String text) {
         Log.d(TAG, "Send message - text: " + text);
 
-        // Enforce maximum text length
-        if (text.length() > Protocol.MAX_TEXT_LENGTH) {
-            text = text.substring(0, Protocol.MAX_TEXT_LENGTH);
+        // Enforce maximum text length (texts over MAX_TEXT_LENGTH go as fragments)
+        if (text.length() > Protocol.LONG_TEXT_MAX_LENGTH) {
+            text = text.substring(0, Protocol.LONG_TEXT_MAX_LENGTH);
         }
 
         // Validate characters
@@ -140,18 +147,35 @@ public class MessageViewModel extends ViewModel {
 
         try {
             // Send unified text message with optional GPS
-            final byte textSeq = seqCounter++;
+            final byte textSeq = seqCounter;
             pendingAckSeq = textSeq;
-            Protocol.TextMessage textMsg;
-
+            Protocol.Message textMsg;
+
+            if (text.length() > Protocol.MAX_TEXT_LENGTH) {
+                // Long text: one aggregate of fragments on consecutive seqs, delivered once all are ACKed
+                Protocol.LongText longText = location != null
+                        ? new Protocol.LongText(text, (int) (location.getLatitude() * 1_000_000),
+                                (int) (location.getLongitude() * 1_000_000))
+                        : new Protocol.LongText(text);
+                List<Protocol.Message> fragments = longText.toFragments(textSeq);
+                longTextSeq = textSeq;
+                pendingFragmentSeqs.clear();
+                for (Protocol.Message fragment : fragments) {
+                    pendingFragmentSeqs.add(((Protocol.FragmentMessage) fragment).seq);
+                }
+                seqCounter += (byte) fragments.size();
+                textMsg = new Protocol.AggregateMessage(fragments);
+            } else {
+                seqCounter++;
+                textMsg = location != null
+                        ? new Protocol.TextMessage(textSeq, text, (int) (location.getLatitude() * 1_000_000),
+                                (int) (location.getLongitude() * 1_000_000))
+                        : new Protocol.TextMessage(textSeq, text);
+            }
             if (location != null) {
-                final int lat = (int) (location.getLatitude() * 1_000_000);
-                final int lon = (int) (location.getLongitude() * 1_000_000);
-                textMsg = new Protocol.TextMessage(textSeq, text, lat, lon);
                 messageAdapter.addMessage(text, true, textSeq, true,
                         location.getLatitude(), location.getLongitude());
             } else {
-                textMsg = new Protocol.TextMessage(textSeq, text);
                 messageAdapter.addMessage(text, true, textSeq);
             }
 
@@ -163,7 +187,7 @@ public class MessageViewModel extends ViewModel {
                 Log.e(TAG, "Failed to send message - will retry");
                 showToast.postValue("Send failed - retrying...");
                 // Retry after brief delay using Handler
-                final Protocol.TextMessage retryMsg = textMsg;
+                final Protocol.Message retryMsg = textMsg;
                 handler.postDelayed(() -> {
                     if (bleManager.isConnected()) {
                         bleManager.sendMessage(retryMsg);
@@ -206,7 +230,12 @@ public class MessageViewModel extends ViewModel {
     }
 
     private void handleReceivedMessage(Protocol.Message message) {
-        if (message instanceof Protocol.TextMessage textMsg) {
+        if (message instanceof Protocol.AggregateMessage aggregate) {
+            // The bridge normally splits aggregates, but handle them if one is forwarded as-is
+            for (Protocol.Message inner : aggregate.messages) {
+                handleReceivedMessage(inner);
+            }
+        } else if (message instanceof Protocol.TextMessage textMsg) {
             Log.d(TAG, "Text message received: " + textMsg.text);
             // Display text without GPS coordinates, but store GPS data for Maps click
             if (textMsg.hasGps) {
@@ -216,13 +245,40 @@ public class MessageViewModel extends ViewModel {
             } else {
                 messageAdapter.addMessage(textMsg.text, false, textMsg.seq);
             }
+        } else if (message instanceof Protocol.FragmentMessage fragment) {
+            // The bridge forwards a long text only once all of its fragments arrived
+            byte[] payload = fragmentAssembler.add(fragment);
+            if (payload == null) {
+                return;
+            }
+            Protocol.LongText longText;
+            try {
+                longText = Protocol.LongText.decode(payload);
+            } catch (IllegalArgumentException e) {
+                Log.e(TAG, "Invalid long text: " + e.getMessage());
+                return;
+            }
+            Log.d(TAG, "Long text received: " + longText.text);
+            if (longText.hasGps) {
+                messageAdapter.addMessage(longText.text, false, fragment.firstSeq(), true,
+                        longText.lat / 1_000_000.0, longText.lon / 1_000_000.0);
+            } else {
+                messageAdapter.addMessage(longText.text, false, fragment.firstSeq());
+            }
         } else if (message instanceof Protocol.AckMessage ackMsg) {
             Log.d(TAG, "ACK received for seq: " + ackMsg.seq);
-            messageAdapter.updateAckStatus(ackMsg.seq, MessageAdapter.AckStatus.DELIVERED);
-            showToast.postValue("✓ Message delivered (seq " + ackMsg.seq + ")");
+            byte deliveredSeq = ackMsg.seq;
+            if (pendingFragmentSeqs.remove(ackMsg.seq)) {
+                if (!pendingFragmentSeqs.isEmpty()) {
+                    return; // Other fragments of the long text are still on their way
+                }
+                deliveredSeq = longTextSeq;
+            }
+            messageAdapter.updateAckStatus(deliveredSeq, MessageAdapter.AckStatus.DELIVERED);
+            showToast.postValue("✓ Message delivered (seq " + deliveredSeq + ")");
 
             // Re-enable send button if this ACK is for the pending message
-            if (pendingAckSeq == ackMsg.seq) {
+            if (pendingAckSeq == deliveredSeq) {
                 canSendNewMessage.postValue(true);
                 pendingAckSeq = -1;
             }
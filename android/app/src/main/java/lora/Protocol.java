@@ -4,28 +4,120 @@ import androidx.annotation.NonNull;
 
 import java.nio.ByteBuffer;
 import java.nio.ByteOrder;
+import java.util.ArrayList;
+import java.util.Arrays;
+import java.util.Collections;
+import java.util.LinkedHashMap;
+import java.util.List;
+import java.util.Map;
 
 /**
  * LoRa Message Protocol for Android
  * Binary format for efficient BLE and LoRa communication
- * Uses 6-bit character packing for bandwidth optimization
+ * Uses 6-bit character packing or a static Huffman code, whichever is smaller
  */
 public class Protocol {
 
     /**
      * Maximum text length in characters for optimal long-range LoRa transmission.
      * With 6-bit packing: 50 chars = 38 bytes (was 50 bytes)
-     * With SF10, BW125, 433MHz: 50 bytes (12 header + 38 text) = ~600ms Time on Air
-     * This allows ~60 messages per hour within 1% duty cycle limits.
+     * With SF11, BW 31.25 kHz, 433MHz: 50 bytes (text + GPS) = 4932 ms Time on Air
+     * This allows 7 such messages per hour within 1% duty cycle limits.
      */
     public static final int MAX_TEXT_LENGTH = 50;
 
+    /**
+     * Maximum serialized size of a single Text/Ack message (50-char text with GPS).
+     */
+    public static final int MAX_FRAME_SIZE = 50;
+
+    /**
+     * Maximum size of an aggregate frame (LoRa payload limit).
+     */
+    public static final int MAX_AGGREGATE_SIZE = 255;
+
+    /**
+     * FRAGMENT frames carry a long text in parts: [0x07][seq][index << 4 | last][data].
+     * Every fragment but the last holds FRAGMENT_DATA_SIZE bytes, the fragments of one
+     * text take consecutive seqs and every one of them is acknowledged on its own.
+     */
+    public static final int FRAGMENT_HEADER_SIZE = 3;
+    public static final int FRAGMENT_DATA_SIZE = MAX_FRAME_SIZE - FRAGMENT_HEADER_SIZE;
+    public static final int FRAGMENT_MAX_COUNT = 8;
+
+    /**
+     * Longest text sent as fragments. With GPS it still fits 4 fragments, which the
+     * app writes as one aggregate and the bridge sends as one LoRa packet.
+     */
+    public static final int LONG_TEXT_MAX_LENGTH = 200;
+
+    /**
+     * Long text payload: [char count][flags][coded text][lat lon, 4 bytes LE each if LONG_TEXT_GPS_FLAG]
+     */
+    public static final int LONG_TEXT_COMPRESSED_FLAG = 0x80;
+    public static final int LONG_TEXT_GPS_FLAG = 0x40;
+
     /**
      * Character set for 6-bit encoding (64 characters)
      * UPPERCASE ONLY: Space + A-Z + 0-9 + punctuation
      */
     private static final String CHARSET = " ABCDEFGHIJKLMNOPQRSTUVWXYZ0123456789.,!?-:;'\"@#$%&*()[]{}=+/<>_";
 
+    /**
+     * Set in the character count byte of a TEXT frame when the text is Huffman coded
+     * instead of 6-bit packed
+     */
+    public static final int TEXT_COMPRESSED_FLAG = 0x80;
+
+    /**
+     * Byte 3 of a TEXT frame: GPS encoding in bits 7-6, packed text length in bits 5-0.
+     * The app sends and receives GPS_ABSOLUTE only; keyframe and delta coded
+     * positions travel between the bridges and are expanded before they reach BLE.
+     */
+    public static final int TEXT_GPS_SHIFT = 6;
+    public static final int TEXT_PACKED_LEN_MASK = 0x3F;
+    public static final int GPS_NONE = 0;
+    public static final int GPS_ABSOLUTE = 1;
+    public static final int GPS_KEYFRAME = 2;
+    public static final int GPS_DELTA = 3;
+
+    /**
+     * Static Huffman code: length in bits of the code for each CHARSET index.
+     * Must stay identical to HUFFMAN_CODE_LENGTHS in shared/Protocol/Protocol.cpp.
+     */
+    private static final int[] HUFFMAN_CODE_LENGTHS = {
+            3, 4, 7, 6, 5, 3, 6, 6, 5, 4, 10, 8, 5, 6, 4, 4,        // ' ' A-O
+            6, 11, 5, 4, 4, 6, 7, 6, 10, 6, 12,                     // P-Z
+            7, 7, 7, 7, 7, 7, 7, 7, 7, 7,                           // 0-9
+            7, 8, 10, 9, 9, 10, 12, 11, 12, 12, 12, 12, 12, 12, 12, // . , ! ? - : ; ' " @ # $ % & *
+            12, 12, 12, 12, 12, 12, 12, 12, 9, 12, 12, 12};         // ( ) [ ] { } = + / < > _
+
+    private static final int HUFFMAN_MAX_BITS = 12;
+
+    // Canonical code tables: codes are assigned in order of (length, CHARSET index)
+    private static final int[] HUFFMAN_CODES = new int[64];
+    private static final int[] HUFFMAN_FIRST_CODE = new int[HUFFMAN_MAX_BITS + 1];
+    private static final int[] HUFFMAN_COUNT = new int[HUFFMAN_MAX_BITS + 1];
+    private static final int[] HUFFMAN_OFFSET = new int[HUFFMAN_MAX_BITS + 1];
+    private static final int[] HUFFMAN_SYMBOLS = new int[64];
+
+    static {
+        int code = 0;
+        int index = 0;
+        for (int len = 1; len <= HUFFMAN_MAX_BITS; len++) {
+            HUFFMAN_FIRST_CODE[len] = code;
+            HUFFMAN_OFFSET[len] = index;
+            for (int value = 0; value < 64; value++) {
+                if (HUFFMAN_CODE_LENGTHS[value] == len) {
+                    HUFFMAN_CODES[value] = code++;
+                    HUFFMAN_SYMBOLS[index++] = value;
+                    HUFFMAN_COUNT[len]++;
+                }
+            }
+            code <<= 1;
+        }
+    }
+
     /**
      * Convert a character to its 6-bit encoded value
      * Automatically converts lowercase to uppercase
@@ -132,12 +224,75 @@ public class Protocol {
     }
 
     /**
-     * Calculate the packed size for a given text
+     * Pack text with the static Huffman code (3-12 bits per character, MSB first)
+     * Lowercase letters are automatically converted to uppercase
+     */
+    private static byte[] packTextCompressed(String text) throws IllegalArgumentException {
+        byte[] result = new byte[calculateCompressedSize(text)];
+        int bitOffset = 0;
+        for (int i = 0; i < text.length(); i++) {
+            byte value = charTo6Bit(text.charAt(i));
+            int code = HUFFMAN_CODES[value];
+            for (int bit = HUFFMAN_CODE_LENGTHS[value] - 1; bit >= 0; bit--, bitOffset++) {
+                if (((code >>> bit) & 1) != 0) {
+                    result[bitOffset / 8] |= (byte) (0x80 >>> (bitOffset % 8));
+                }
+            }
+        }
+        return result;
+    }
+
+    /**
+     * Unpack Huffman coded bytes back to text, one bit at a time in canonical order (uppercase)
+     */
+    private static String unpackTextCompressed(byte[] packed, int charCount) throws IllegalArgumentException {
+        StringBuilder result = new StringBuilder(charCount);
+        int bitOffset = 0;
+        for (int i = 0; i < charCount; i++) {
+            int code = 0;
+            int value = -1;
+            for (int len = 1; len <= HUFFMAN_MAX_BITS && value < 0; len++, bitOffset++) {
+                if (bitOffset / 8 >= packed.length) {
+                    throw new IllegalArgumentException("Insufficient packed data");
+                }
+                code = (code << 1) | (((packed[bitOffset / 8] & 0xFF) >>> (7 - bitOffset % 8)) & 1);
+                int index = code - HUFFMAN_FIRST_CODE[len];
+                if (index >= 0 && index < HUFFMAN_COUNT[len]) {
+                    value = HUFFMAN_SYMBOLS[HUFFMAN_OFFSET[len] + index];
+                }
+            }
+            result.append(CHARSET.charAt(value));
+        }
+        return result.toString();
+    }
+
+    /**
+     * Calculate the 6-bit packed size for a given text
      */
     public static int calculatePackedSize(String text) {
         return (text.length() * 6 + 7) / 8;
     }
 
+    /**
+     * Calculate the Huffman coded size for a given text
+     * Throws for unsupported characters
+     */
+    public static int calculateCompressedSize(String text) throws IllegalArgumentException {
+        int bits = 0;
+        for (int i = 0; i < text.length(); i++) {
+            bits += HUFFMAN_CODE_LENGTHS[charTo6Bit(text.charAt(i))];
+        }
+        return (bits + 7) / 8;
+    }
+
+    /**
+     * Size of the text as sent: the smaller of 6-bit packing and Huffman coding
+     */
+    public static int calculateEncodedSize(String text) {
+        int packed = calculatePackedSize(text);
+        return isTextSupported(text) ? Math.min(packed, calculateCompressedSize(text)) : packed;
+    }
+
     /**
      * Validate if a character is supported
      */
@@ -160,7 +315,11 @@ public class Protocol {
 
     public enum MessageType {
         TEXT((byte) 0x01),
-        ACK((byte) 0x02);
+        ACK((byte) 0x02),
+        AGGREGATE((byte) 0x03),
+        SELECTIVE_ACK((byte) 0x04),
+        DATA_RATE((byte) 0x05),
+        FRAGMENT((byte) 0x07);
 
         private final byte value;
 
@@ -215,20 +374,21 @@ public class Protocol {
 
         @Override
         public byte[] serialize() {
-            byte[] packedText = packText(text);
-            int totalSize = 1 + 1 + 1 + 1 + 1 + packedText.length; // type + seq + charCount + packedLen + hasGps + packed
+            // Huffman coding when it is shorter, else 6-bit packing (digits and punctuation heavy text)
+            boolean compressed = calculateCompressedSize(text) < calculatePackedSize(text);
+            byte[] packedText = compressed ? packTextCompressed(text) : packText(text);
+            int totalSize = 1 + 1 + 1 + 1 + packedText.length; // type + seq + charCount + gps|packedLen + packed
             if (hasGps) {
                 totalSize += 8; // lat + lon
             }
             byte[] data = new byte[totalSize];
             data[0] = MessageType.TEXT.getValue();
             data[1] = seq;
-            data[2] = (byte) text.length(); // Original character count
-            data[3] = (byte) packedText.length; // Packed byte count
+            data[2] = (byte) (text.length() | (compressed ? TEXT_COMPRESSED_FLAG : 0)); // Character count + encoding
+            data[3] = (byte) (((hasGps ? GPS_ABSOLUTE : GPS_NONE) << TEXT_GPS_SHIFT) | packedText.length);
             System.arraycopy(packedText, 0, data, 4, packedText.length);
-            data[4 + packedText.length] = (byte) (hasGps ? 1 : 0);
             if (hasGps) {
-                ByteBuffer buf = ByteBuffer.wrap(data, 5 + packedText.length, 8).order(ByteOrder.LITTLE_ENDIAN);
+                ByteBuffer buf = ByteBuffer.wrap(data, 4 + packedText.length, 8).order(ByteOrder.LITTLE_ENDIAN);
                 buf.putInt(lat);
                 buf.putInt(lon);
             }
@@ -299,6 +459,395 @@ public class Protocol {
         }
     }
 
+    /**
+     * Cumulative + bitmap acknowledgment used by the bridges' link ARQ
+     * Format: [0x04][cumulative][bitmap]. Acknowledges every seq up to cumulative
+     * and cumulative + 1 + i for each set bit i. Bridges convert it to plain ACKs
+     * before forwarding, so the app normally never receives one.
+     */
+    public static class SelectiveAckMessage extends Message {
+        public final byte cumulative;
+        public final byte bitmap;
+
+        public SelectiveAckMessage(byte cumulative, byte bitmap) {
+            super(MessageType.SELECTIVE_ACK);
+            this.cumulative = cumulative;
+            this.bitmap = bitmap;
+        }
+
+        @Override
+        public byte[] serialize() {
+            return new byte[] { MessageType.SELECTIVE_ACK.getValue(), cumulative, bitmap };
+        }
+
+        @Override
+        public boolean equals(Object obj) {
+            if (this == obj)
+                return true;
+            if (obj == null || getClass() != obj.getClass())
+                return false;
+            SelectiveAckMessage that = (SelectiveAckMessage) obj;
+            return cumulative == that.cumulative && bitmap == that.bitmap;
+        }
+
+        @Override
+        public int hashCode() {
+            return 31 * Byte.hashCode(cumulative) + Byte.hashCode(bitmap);
+        }
+
+        @NonNull
+        @Override
+        public String toString() {
+            return "SelectiveAckMessage{cumulative=" + (cumulative & 0xFF) + ", bitmap=0x"
+                    + Integer.toHexString(bitmap & 0xFF) + "}";
+        }
+    }
+
+    /**
+     * Data rate negotiation between the bridges (adaptive data rate)
+     * Format: [0x05][op][rate]. op 0 = request, 1 = accept; rate indexes the
+     * bridges' ADR_RATES table. Link control only, the bridges never forward it.
+     */
+    public static class DataRateMessage extends Message {
+        public static final byte OP_REQUEST = 0x00;
+        public static final byte OP_ACCEPT = 0x01;
+
+        public final byte op;
+        public final byte rate;
+
+        public DataRateMessage(byte op, byte rate) {
+            super(MessageType.DATA_RATE);
+            if (op != OP_REQUEST && op != OP_ACCEPT) {
+                throw new IllegalArgumentException("Unknown data rate operation: " + op);
+            }
+            this.op = op;
+            this.rate = rate;
+        }
+
+        @Override
+        public byte[] serialize() {
+            return new byte[] { MessageType.DATA_RATE.getValue(), op, rate };
+        }
+
+        @Override
+        public boolean equals(Object obj) {
+            if (this == obj)
+                return true;
+            if (obj == null || getClass() != obj.getClass())
+                return false;
+            DataRateMessage that = (DataRateMessage) obj;
+            return op == that.op && rate == that.rate;
+        }
+
+        @Override
+        public int hashCode() {
+            return 31 * Byte.hashCode(op) + Byte.hashCode(rate);
+        }
+
+        @NonNull
+        @Override
+        public String toString() {
+            return "DataRateMessage{op=" + (op == OP_REQUEST ? "request" : "accept") + ", rate=" + (rate & 0xFF) + "}";
+        }
+    }
+
+    /**
+     * One part of a long text, see LongText
+     * Format: [0x07][seq][index << 4 | last][data]; the fragments of a text have consecutive
+     * seqs, so seq - index (the first fragment's seq) identifies the text.
+     */
+    public static class FragmentMessage extends Message {
+        public final byte seq;
+        public final int index;
+        public final int last; // Index of the text's last fragment
+        public final byte[] data;
+
+        public FragmentMessage(byte seq, int index, int last, byte[] data) {
+            super(MessageType.FRAGMENT);
+            if (last < 0 || last >= FRAGMENT_MAX_COUNT || index < 0 || index > last) {
+                throw new IllegalArgumentException("Invalid fragment index " + index + " of " + last);
+            }
+            if (data.length == 0 || data.length > FRAGMENT_DATA_SIZE || (index < last && data.length != FRAGMENT_DATA_SIZE)) {
+                throw new IllegalArgumentException("Invalid fragment length: " + data.length);
+            }
+            this.seq = seq;
+            this.index = index;
+            this.last = last;
+            this.data = data.clone();
+        }
+
+        /**
+         * Seq of the text's first fragment
+         */
+        public byte firstSeq() {
+            return (byte) (seq - index);
+        }
+
+        @Override
+        public byte[] serialize() {
+            byte[] frame = new byte[FRAGMENT_HEADER_SIZE + data.length];
+            frame[0] = MessageType.FRAGMENT.getValue();
+            frame[1] = seq;
+            frame[2] = (byte) ((index << 4) | last);
+            System.arraycopy(data, 0, frame, FRAGMENT_HEADER_SIZE, data.length);
+            return frame;
+        }
+
+        @Override
+        public boolean equals(Object obj) {
+            if (this == obj)
+                return true;
+            if (obj == null || getClass() != obj.getClass())
+                return false;
+            FragmentMessage that = (FragmentMessage) obj;
+            return seq == that.seq && index == that.index && last == that.last && Arrays.equals(data, that.data);
+        }
+
+        @Override
+        public int hashCode() {
+            return 31 * (31 * (31 * Byte.hashCode(seq) + index) + last) + Arrays.hashCode(data);
+        }
+
+        @NonNull
+        @Override
+        public String toString() {
+            return "FragmentMessage{seq=" + seq + ", index=" + index + ", last=" + last + ", len=" + data.length + "}";
+        }
+    }
+
+    /**
+     * Text of up to LONG_TEXT_MAX_LENGTH characters, sent as FRAGMENT frames
+     * Payload: [char count][flags][coded text][lat lon, 4 bytes LE each], coded as a
+     * TEXT frame's text (Huffman when that is shorter, else 6-bit packed).
+     */
+    public static class LongText {
+        public final String text;
+        public final boolean hasGps;
+        public final int lat; // latitude * 1_000_000 (only valid if hasGps=true)
+        public final int lon; // longitude * 1_000_000 (only valid if hasGps=true)
+
+        public LongText(String text) {
+            this(text, false, 0, 0);
+        }
+
+        public LongText(String text, int lat, int lon) {
+            this(text, true, lat, lon);
+        }
+
+        private LongText(String text, boolean hasGps, int lat, int lon) {
+            if (text.length() > LONG_TEXT_MAX_LENGTH) {
+                throw new IllegalArgumentException("Text too long (max " + LONG_TEXT_MAX_LENGTH + " chars)");
+            }
+            this.text = text;
+            this.hasGps = hasGps;
+            this.lat = hasGps ? lat : 0;
+            this.lon = hasGps ? lon : 0;
+        }
+
+        /**
+         * Payload the fragments carry
+         */
+        public byte[] encode() {
+            boolean compressed = calculateCompressedSize(text) < calculatePackedSize(text);
+            byte[] packed = compressed ? packTextCompressed(text) : packText(text);
+            ByteBuffer buf = ByteBuffer.allocate(2 + packed.length + (hasGps ? 8 : 0)).order(ByteOrder.LITTLE_ENDIAN);
+            buf.put((byte) text.length());
+            buf.put((byte) ((compressed ? LONG_TEXT_COMPRESSED_FLAG : 0) | (hasGps ? LONG_TEXT_GPS_FLAG : 0)));
+            buf.put(packed);
+            if (hasGps) {
+                buf.putInt(lat);
+                buf.putInt(lon);
+            }
+            return buf.array();
+        }
+
+        /**
+         * The text's fragments, taking seqs firstSeq, firstSeq + 1 ...
+         */
+        public List<Message> toFragments(byte firstSeq) {
+            byte[] payload = encode();
+            int count = (payload.length + FRAGMENT_DATA_SIZE - 1) / FRAGMENT_DATA_SIZE;
+            List<Message> fragments = new ArrayList<>(count);
+            for (int i = 0; i < count; i++) {
+                int offset = i * FRAGMENT_DATA_SIZE;
+                byte[] data = Arrays.copyOfRange(payload, offset, Math.min(payload.length, offset + FRAGMENT_DATA_SIZE));
+                fragments.add(new FragmentMessage((byte) (firstSeq + i), i, count - 1, data));
+            }
+            return fragments;
+        }
+
+        public static LongText decode(byte[] payload) throws IllegalArgumentException {
+            if (payload.length < 2) {
+                throw new IllegalArgumentException("Data too short for LongText header");
+            }
+            int charCount = payload[0] & 0xFF;
+            int flags = payload[1] & 0xFF;
+            if (charCount > LONG_TEXT_MAX_LENGTH || (flags & ~(LONG_TEXT_COMPRESSED_FLAG | LONG_TEXT_GPS_FLAG)) != 0) {
+                throw new IllegalArgumentException("Invalid LongText header");
+            }
+            boolean hasGps = (flags & LONG_TEXT_GPS_FLAG) != 0;
+            int packedLen = payload.length - 2 - (hasGps ? 8 : 0);
+            if (packedLen < 0) {
+                throw new IllegalArgumentException("Data too short for GPS data");
+            }
+            byte[] packed = Arrays.copyOfRange(payload, 2, 2 + packedLen);
+            String text;
+            if ((flags & LONG_TEXT_COMPRESSED_FLAG) != 0) {
+                text = unpackTextCompressed(packed, charCount);
+            } else if (packedLen == (charCount * 6 + 7) / 8) {
+                text = unpackText(packed, charCount);
+            } else {
+                throw new IllegalArgumentException("Invalid packed text length");
+            }
+            if (!hasGps) {
+                return new LongText(text);
+            }
+            ByteBuffer buf = ByteBuffer.wrap(payload, 2 + packedLen, 8).order(ByteOrder.LITTLE_ENDIAN);
+            int lat = buf.getInt();
+            int lon = buf.getInt();
+            return new LongText(text, lat, lon);
+        }
+
+        @Override
+        public boolean equals(Object obj) {
+            if (this == obj)
+                return true;
+            if (obj == null || getClass() != obj.getClass())
+                return false;
+            LongText that = (LongText) obj;
+            return hasGps == that.hasGps && lat == that.lat && lon == that.lon && text.equals(that.text);
+        }
+
+        @Override
+        public int hashCode() {
+            return 31 * (31 * (31 * text.hashCode() + Boolean.hashCode(hasGps)) + lat) + lon;
+        }
+
+        @NonNull
+        @Override
+        public String toString() {
+            return "LongText{text='" + text + "', hasGps=" + hasGps + ", lat=" + lat + ", lon=" + lon + "}";
+        }
+    }
+
+    /**
+     * Collects the fragments of long texts, in any order. Keeps at most two
+     * incomplete texts; the oldest one gives way to a new text. Not thread-safe.
+     */
+    public static class FragmentAssembler {
+        private static final int MAX_PENDING = 2;
+
+        private final Map<Byte, byte[][]> pending = new LinkedHashMap<>();
+
+        /**
+         * Stores a fragment. Returns the text's payload (see LongText.decode) once its
+         * last missing fragment arrived, else null.
+         */
+        public byte[] add(FragmentMessage fragment) {
+            byte first = fragment.firstSeq();
+            byte[][] parts = pending.get(first);
+            if (parts == null || parts.length != fragment.last + 1) {
+                // New text, or the sender restarted its seqs
+                pending.remove(first);
+                if (pending.size() >= MAX_PENDING) {
+                    pending.remove(pending.keySet().iterator().next());
+                }
+                parts = new byte[fragment.last + 1][];
+                pending.put(first, parts);
+            }
+            parts[fragment.index] = fragment.data;
+
+            int size = 0;
+            for (byte[] part : parts) {
+                if (part == null) {
+                    return null;
+                }
+                size += part.length;
+            }
+            pending.remove(first);
+            byte[] payload = new byte[size];
+            int offset = 0;
+            for (byte[] part : parts) {
+                System.arraycopy(part, 0, payload, offset, part.length);
+                offset += part.length;
+            }
+            return payload;
+        }
+
+        /**
+         * Incomplete texts waiting for fragments
+         */
+        public int pendingCount() {
+            return pending.size();
+        }
+    }
+
+    /**
+     * Container of several Text/Ack/Fragment messages in one LoRa packet
+     * Format: [0x03][count][len1][frame1]...[lenN][frameN], aggregates do not nest
+     */
+    public static class AggregateMessage extends Message {
+        public final List<Message> messages;
+
+        public AggregateMessage(List<Message> messages) {
+            super(MessageType.AGGREGATE);
+            if (messages.isEmpty() || messages.size() > 255) {
+                throw new IllegalArgumentException("Aggregate needs 1-255 messages");
+            }
+            for (Message m : messages) {
+                if (m instanceof AggregateMessage) {
+                    throw new IllegalArgumentException("Aggregates cannot be nested");
+                }
+            }
+            this.messages = Collections.unmodifiableList(new ArrayList<>(messages));
+        }
+
+        @Override
+        public byte[] serialize() {
+            List<byte[]> frames = new ArrayList<>(messages.size());
+            int totalSize = 2; // type + count
+            for (Message m : messages) {
+                byte[] frame = m.serialize();
+                frames.add(frame);
+                totalSize += 1 + frame.length;
+            }
+            if (totalSize > MAX_AGGREGATE_SIZE) {
+                throw new IllegalArgumentException("Aggregate too large (max " + MAX_AGGREGATE_SIZE + " bytes)");
+            }
+            byte[] data = new byte[totalSize];
+            data[0] = MessageType.AGGREGATE.getValue();
+            data[1] = (byte) frames.size();
+            int offset = 2;
+            for (byte[] frame : frames) {
+                data[offset] = (byte) frame.length;
+                System.arraycopy(frame, 0, data, offset + 1, frame.length);
+                offset += 1 + frame.length;
+            }
+            return data;
+        }
+
+        @Override
+        public boolean equals(Object obj) {
+            if (this == obj)
+                return true;
+            if (obj == null || getClass() != obj.getClass())
+                return false;
+            AggregateMessage that = (AggregateMessage) obj;
+            return messages.equals(that.messages);
+        }
+
+        @Override
+        public int hashCode() {
+            return messages.hashCode();
+        }
+
+        @NonNull
+        @Override
+        public String toString() {
+            return "AggregateMessage{messages=" + messages + "}";
+        }
+    }
+
     public static abstract class Message {
         public final MessageType type;
 
@@ -314,29 +863,66 @@ public class Protocol {
             return switch (type) {
                 case TEXT -> deserializeText(data);
                 case ACK -> deserializeAck(data);
+                case AGGREGATE -> deserializeAggregate(data);
+                case SELECTIVE_ACK -> deserializeSelectiveAck(data);
+                case DATA_RATE -> deserializeDataRate(data);
+                case FRAGMENT -> deserializeFragment(data);
             };
         }
 
+        private static AggregateMessage deserializeAggregate(byte[] data) {
+            if (data.length < 2 || data.length > MAX_AGGREGATE_SIZE) {
+                throw new IllegalArgumentException("Invalid AggregateMessage length");
+            }
+            int count = data[1] & 0xFF;
+            List<Message> messages = new ArrayList<>(count);
+            int offset = 2;
+            for (int i = 0; i < count; i++) {
+                if (offset >= data.length) {
+                    throw new IllegalArgumentException("Data too short for aggregate frame count");
+                }
+                int frameLen = data[offset] & 0xFF;
+                if (frameLen == 0 || frameLen > MAX_FRAME_SIZE || offset + 1 + frameLen > data.length) {
+                    throw new IllegalArgumentException("Invalid aggregate frame length");
+                }
+                byte[] frame = new byte[frameLen];
+                System.arraycopy(data, offset + 1, frame, 0, frameLen);
+                if (MessageType.fromByte(frame[0]) == MessageType.AGGREGATE) {
+                    throw new IllegalArgumentException("Aggregates cannot be nested");
+                }
+                messages.add(deserialize(frame));
+                offset += 1 + frameLen;
+            }
+            if (offset != data.length) {
+                throw new IllegalArgumentException("Trailing bytes after aggregate frames");
+            }
+            return new AggregateMessage(messages);
+        }
+
         private static TextMessage deserializeText(byte[] data) {
-            if (data.length < 5) {
+            if (data.length < 4) {
                 throw new IllegalArgumentException("Data too short for TextMessage header");
             }
             byte seq = data[1];
-            int charCount = data[2] & 0xFF; // Original character count
-            int packedLen = data[3] & 0xFF; // Packed byte count
-            if (data.length < 5 + packedLen) {
-                throw new IllegalArgumentException("Data too short for packed text + hasGps flag");
+            boolean compressed = (data[2] & TEXT_COMPRESSED_FLAG) != 0;
+            int charCount = data[2] & 0x7F; // Original character count
+            int gps = (data[3] & 0xFF) >>> TEXT_GPS_SHIFT; // GPS encoding
+            int packedLen = data[3] & TEXT_PACKED_LEN_MASK; // Packed byte count
+            if (data.length < 4 + packedLen) {
+                throw new IllegalArgumentException("Data too short for packed text");
             }
             byte[] packedBytes = new byte[packedLen];
             System.arraycopy(data, 4, packedBytes, 0, packedLen);
-            String text = unpackText(packedBytes, charCount);
-            boolean hasGps = data[4 + packedLen] != 0;
+            String text = compressed ? unpackTextCompressed(packedBytes, charCount) : unpackText(packedBytes, charCount);
 
-            if (hasGps) {
-                if (data.length < 5 + packedLen + 8) {
+            if (gps == GPS_DELTA) {
+                throw new IllegalArgumentException("Delta coded GPS is expanded by the bridge");
+            }
+            if (gps != GPS_NONE) {
+                if (data.length < 4 + packedLen + 8) {
                     throw new IllegalArgumentException("Data too short for GPS data");
                 }
-                ByteBuffer buf = ByteBuffer.wrap(data, 5 + packedLen, 8).order(ByteOrder.LITTLE_ENDIAN);
+                ByteBuffer buf = ByteBuffer.wrap(data, 4 + packedLen, 8).order(ByteOrder.LITTLE_ENDIAN);
                 int lat = buf.getInt();
                 int lon = buf.getInt();
                 return new TextMessage(seq, text, lat, lon);
@@ -353,6 +939,31 @@ public class Protocol {
             return new AckMessage(seq);
         }
 
+        private static SelectiveAckMessage deserializeSelectiveAck(byte[] data) {
+            if (data.length < 3) {
+                throw new IllegalArgumentException("Data too short for SelectiveAckMessage");
+            }
+            return new SelectiveAckMessage(data[1], data[2]);
+        }
+
+        private static DataRateMessage deserializeDataRate(byte[] data) {
+            if (data.length < 3) {
+                throw new IllegalArgumentException("Data too short for DataRateMessage");
+            }
+            return new DataRateMessage(data[1], data[2]);
+        }
+
+        private static FragmentMessage deserializeFragment(byte[] data) {
+            if (data.length <= FRAGMENT_HEADER_SIZE || data.length > MAX_FRAME_SIZE) {
+                throw new IllegalArgumentException("Invalid FragmentMessage length");
+            }
+            int index = (data[2] & 0xFF) >>> 4;
+            int last = data[2] & 0x0F;
+            byte[] payload = new byte[data.length - FRAGMENT_HEADER_SIZE];
+            System.arraycopy(data, FRAGMENT_HEADER_SIZE, payload, 0, payload.length);
+            return new FragmentMessage(data[1], index, last, payload);
+        }
+
         public abstract byte[] serialize();
     }
 }
\ No newline at end of file
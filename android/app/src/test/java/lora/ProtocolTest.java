@@ -1,14 +1,19 @@
 package lora;
 
+import static org.junit.Assert.assertArrayEquals;
 import static org.junit.Assert.assertEquals;
 import static org.junit.Assert.assertFalse;
+import static org.junit.Assert.assertThrows;
 import static org.junit.Assert.assertTrue;
 
 import org.junit.Test;
 
+import java.util.Arrays;
+import java.util.List;
+
 /**
  * Unit tests for the LoRa Protocol
- * Tests 6-bit packed text encoding and separate Text/GPS message types
+ * Tests 6-bit packed and Huffman coded text encoding and separate Text/GPS message types
  */
 public class ProtocolTest {
 
@@ -16,7 +21,7 @@ public class ProtocolTest {
     public void testTextMessageSerialization_Empty() {
         Protocol.TextMessage msg = new Protocol.TextMessage((byte) 0, "");
         byte[] data = msg.serialize();
-        assertEquals(5, data.length);
+        assertEquals(4, data.length);
 
         Protocol.Message deserialized = Protocol.Message.deserialize(data);
         assertTrue(deserialized instanceof Protocol.TextMessage);
@@ -30,7 +35,7 @@ public class ProtocolTest {
     public void testTextMessageSerialization_Short() {
         Protocol.TextMessage msg = new Protocol.TextMessage((byte) 1, "HELLO");
         byte[] data = msg.serialize();
-        assertEquals(9, data.length);
+        assertEquals(7, data.length); // Huffman: 22 bits in 3 bytes
 
         Protocol.Message deserialized = Protocol.Message.deserialize(data);
         assertTrue(deserialized instanceof Protocol.TextMessage);
@@ -126,5 +131,166 @@ public class ProtocolTest {
         assertEquals(0, Protocol.calculatePackedSize(""));
         assertEquals(1, Protocol.calculatePackedSize("A"));
         assertEquals(4, Protocol.calculatePackedSize("HELLO"));
+        assertEquals(3, Protocol.calculateCompressedSize("HELLO"));
+        assertEquals(3, Protocol.calculateEncodedSize("HELLO"));
+        assertEquals(4, Protocol.calculateEncodedSize("12345")); // Digits: 6-bit packing is smaller
+    }
+
+    @Test
+    public void testTextWireFormat() {
+        // Same vectors as test_text_message_wire_format / test_text_message_keeps_six_bit_when_smaller
+        // in esp32/test/test_protocol
+        byte[] huffman = {0x01, 0x01, (byte) 0x83, 0x02, (byte) 0x87, (byte) 0x80};
+        assertArrayEquals(huffman, new Protocol.TextMessage((byte) 1, "SOS").serialize());
+        assertEquals(new Protocol.TextMessage((byte) 1, "SOS"), Protocol.Message.deserialize(huffman));
+
+        byte[] sixBit = {0x01, 0x02, 0x05, 0x04, 0x71, (byte) 0xD7, (byte) 0x9F, (byte) 0x80};
+        assertArrayEquals(sixBit, new Protocol.TextMessage((byte) 2, "12345").serialize());
+        assertEquals(new Protocol.TextMessage((byte) 2, "12345"), Protocol.Message.deserialize(sixBit));
+
+        // Every character survives the Huffman code, lowercase is folded
+        String all = " ABCDEFGHIJKLMNOPQRSTUVWXYZ0123456789.,!?-:;'\"@#$%&*()[]{}=+/<>_";
+        for (int i = 0; i < all.length(); i += Protocol.MAX_TEXT_LENGTH) {
+            String chunk = all.substring(i, Math.min(all.length(), i + Protocol.MAX_TEXT_LENGTH));
+            byte[] data = new Protocol.TextMessage((byte) 3, chunk.toLowerCase()).serialize();
+            assertEquals(chunk, ((Protocol.TextMessage) Protocol.Message.deserialize(data)).text);
+        }
+
+        // The code running past the packed bytes is rejected
+        byte[] truncated = {0x01, 0x01, (byte) 0x85, 0x02, (byte) 0x87, (byte) 0x80};
+        assertThrows(IllegalArgumentException.class, () -> Protocol.Message.deserialize(truncated));
+    }
+
+    @Test
+    public void testGpsEncodingInHeader() {
+        // Byte 3: GPS encoding in bits 7-6, then 9 packed bytes; no hasGps byte
+        byte[] data = new Protocol.TextMessage((byte) 5, "AT CHECKPOINT 2", 37774200, -122419200).serialize();
+        assertEquals(4 + 9 + 8, data.length);
+        assertEquals(0x40 | 9, data[3] & 0xFF);
+
+        // Keyframes decode like absolute positions
+        byte[] keyframe = data.clone();
+        keyframe[3] = (byte) (Protocol.GPS_KEYFRAME << Protocol.TEXT_GPS_SHIFT | 9);
+        assertEquals(Protocol.Message.deserialize(data), Protocol.Message.deserialize(keyframe));
+
+        // Delta coded positions only exist between the bridges
+        byte[] delta = {0x01, 0x05, (byte) 0x83, (byte) 0xC2, (byte) 0x87, (byte) 0x80, 0x01, 0x02};
+        assertThrows(IllegalArgumentException.class, () -> Protocol.Message.deserialize(delta));
+    }
+
+    @Test
+    public void testAggregateWireFormat() {
+        // Same vector as test_aggregate_wire_format in esp32/test/test_protocol
+        Protocol.AggregateMessage agg = new Protocol.AggregateMessage(Arrays.asList(
+                new Protocol.AckMessage((byte) 5),
+                new Protocol.TextMessage((byte) 1, "SOS")));
+        byte[] expected = {0x03, 0x02, 0x02, 0x02, 0x05, 0x06, 0x01, 0x01, (byte) 0x83, 0x02, (byte) 0x87, (byte) 0x80};
+        assertArrayEquals(expected, agg.serialize());
+
+        Protocol.Message deserialized = Protocol.Message.deserialize(expected);
+        assertTrue(deserialized instanceof Protocol.AggregateMessage);
+        assertEquals(agg, deserialized);
+    }
+
+    @Test
+    public void testAggregateRoundTrip() {
+        List<Protocol.Message> messages = Arrays.asList(
+                new Protocol.TextMessage((byte) 7, "FIRST"),
+                new Protocol.TextMessage((byte) 8, "WITH GPS", 47376887, 8541694),
+                new Protocol.AckMessage((byte) 9));
+        byte[] data = new Protocol.AggregateMessage(messages).serialize();
+
+        Protocol.AggregateMessage result = (Protocol.AggregateMessage) Protocol.Message.deserialize(data);
+        assertEquals(messages, result.messages);
+    }
+
+    @Test
+    public void testAggregateRejectsMalformed() {
+        // Empty, count too high, trailing bytes, nested aggregate
+        assertThrows(IllegalArgumentException.class, () -> Protocol.Message.deserialize(new byte[]{0x03, 0x00}));
+        assertThrows(IllegalArgumentException.class,
+                () -> Protocol.Message.deserialize(new byte[]{0x03, 0x02, 0x02, 0x02, 0x01}));
+        assertThrows(IllegalArgumentException.class,
+                () -> Protocol.Message.deserialize(new byte[]{0x03, 0x01, 0x02, 0x02, 0x01, 0x00}));
+        assertThrows(IllegalArgumentException.class,
+                () -> Protocol.Message.deserialize(new byte[]{0x03, 0x01, 0x05, 0x03, 0x01, 0x02, 0x02, 0x01}));
+    }
+
+    @Test
+    public void testSelectiveAckWireFormat() {
+        // Same vector as test_selective_ack_wire_format in esp32/test/test_protocol
+        Protocol.SelectiveAckMessage ack = new Protocol.SelectiveAckMessage((byte) 9, (byte) 0x05);
+        byte[] data = ack.serialize();
+        assertArrayEquals(new byte[]{0x04, 0x09, 0x05}, data);
+        assertEquals(ack, Protocol.Message.deserialize(data));
+        assertThrows(IllegalArgumentException.class, () -> Protocol.Message.deserialize(new byte[]{0x04, 0x09}));
+    }
+
+    @Test
+    public void testDataRateWireFormat() {
+        // Same vector as test_data_rate_wire_format in esp32/test/test_protocol
+        Protocol.DataRateMessage accept = new Protocol.DataRateMessage(Protocol.DataRateMessage.OP_ACCEPT, (byte) 3);
+        byte[] data = accept.serialize();
+        assertArrayEquals(new byte[]{0x05, 0x01, 0x03}, data);
+        assertEquals(accept, Protocol.Message.deserialize(data));
+        assertThrows(IllegalArgumentException.class, () -> Protocol.Message.deserialize(new byte[]{0x05, 0x02, 0x03}));
+        assertThrows(IllegalArgumentException.class, () -> Protocol.Message.deserialize(new byte[]{0x05, 0x01}));
+    }
+
+    @Test
+    public void testFragmentWireFormat() {
+        // Same vector as test_fragment_wire_format in esp32/test/test_protocol
+        Protocol.FragmentMessage fragment = new Protocol.FragmentMessage((byte) 0x2A, 2, 2, new byte[]{(byte) 0xDE, (byte) 0xAD});
+        byte[] data = fragment.serialize();
+        assertArrayEquals(new byte[]{0x07, 0x2A, 0x22, (byte) 0xDE, (byte) 0xAD}, data);
+        assertEquals(fragment, Protocol.Message.deserialize(data));
+        assertEquals((byte) 0x28, fragment.firstSeq());
+
+        // No data, index past the last fragment, short fragment before the last one
+        assertThrows(IllegalArgumentException.class, () -> Protocol.Message.deserialize(new byte[]{0x07, 0x2A, 0x22}));
+        assertThrows(IllegalArgumentException.class, () -> Protocol.Message.deserialize(new byte[]{0x07, 0x2A, 0x32, 0x01}));
+        assertThrows(IllegalArgumentException.class, () -> Protocol.Message.deserialize(new byte[]{0x07, 0x2A, 0x12, 0x01}));
+    }
+
+    @Test
+    public void testLongTextWireFormat() {
+        // Same vector as test_long_text_wire_format in esp32/test/test_fragment
+        List<Protocol.Message> fragments = new Protocol.LongText("HELLO WORLD", 47376900, 8541700).toFragments((byte) 0x10);
+        byte[] expected = {
+                0x07, 0x10, 0x00, // Fragment 0 of 0, seq 16
+                0x0B, (byte) 0xC0, // 11 characters, Huffman coded, position
+                (byte) 0xA9, (byte) 0xB5, (byte) 0x9C, 0x6C, (byte) 0xF7, (byte) 0xB5, 0x00, // Coded text
+                0x04, (byte) 0xEA, (byte) 0xD2, 0x02, 0x04, 0x56, (byte) 0x82, 0x00}; // lat, lon (little-endian)
+        assertEquals(1, fragments.size());
+        assertArrayEquals(expected, fragments.get(0).serialize());
+    }
+
+    @Test
+    public void testLongTextReassembly() {
+        StringBuilder text = new StringBuilder();
+        while (text.length() < Protocol.LONG_TEXT_MAX_LENGTH) {
+            text.append("0123456789");
+        }
+        Protocol.LongText longText = new Protocol.LongText(text.toString(), 47376900, 8541700);
+        List<Protocol.Message> fragments = longText.toFragments((byte) 254);
+        assertEquals(4, fragments.size());
+
+        // Travels as one aggregate; seqs wrap, fragments arrive in any order
+        byte[] data = new Protocol.AggregateMessage(fragments).serialize();
+        assertTrue(data.length <= Protocol.MAX_AGGREGATE_SIZE);
+        List<Protocol.Message> received = ((Protocol.AggregateMessage) Protocol.Message.deserialize(data)).messages;
+        Protocol.FragmentAssembler assembler = new Protocol.FragmentAssembler();
+        int[] order = {2, 0, 3, 1};
+        byte[] payload = null;
+        for (int i : order) {
+            Protocol.FragmentMessage fragment = (Protocol.FragmentMessage) received.get(i);
+            assertEquals((byte) 254, fragment.firstSeq());
+            assertTrue(payload == null);
+            payload = assembler.add(fragment);
+        }
+        assertEquals(longText, Protocol.LongText.decode(payload));
+        assertEquals(0, assembler.pendingCount());
+
+        assertThrows(IllegalArgumentException.class, () -> new Protocol.LongText(text + "X"));
     }
 }
@@ -4,12 +4,16 @@
 #include <Arduino.h>
 #include <NimBLEDevice.h>
 #include <freertos/queue.h>
+#include <freertos/event_groups.h>
+#include <atomic>
 #include "Protocol.h"
+#include "BridgeEvents.h"
 
 // Service and Characteristic UUIDs
 #define SERVICE_UUID "00001234-0000-1000-8000-00805f9b34fb"
 #define TX_CHARACTERISTIC_UUID "00005678-0000-1000-8000-00805f9b34fb"
 #define RX_CHARACTERISTIC_UUID "00005679-0000-1000-8000-00805f9b34fb"
+#define STATS_CHARACTERISTIC_UUID "0000567a-0000-1000-8000-00805f9b34fb"
 
 class BLEManager;
 
@@ -20,6 +24,7 @@ public:
     MyServerCallbacks(BLEManager *manager) : bleManager(manager) {}
     void onConnect(NimBLEServer *pServer, NimBLEConnInfo &connInfo);
     void onDisconnect(NimBLEServer *pServer, NimBLEConnInfo &connInfo, int reason);
+    void onMTUChange(uint16_t MTU, NimBLEConnInfo &connInfo);
 
 private:
     BLEManager *bleManager;
@@ -36,17 +41,35 @@ private:
     BLEManager *bleManager;
 };
 
-class BLEManager
+// Callback for TX characteristic notification results
+class MyTxCallbacks : public NimBLECharacteristicCallbacks
 {
 public:
-    void stopAdvertising();
-    void disconnect();
-    void updateActivity();
+    MyTxCallbacks(BLEManager *manager) : bleManager(manager) {}
+    void onStatus(NimBLECharacteristic *pCharacteristic, int code);
+
+private:
+    BLEManager *bleManager;
+};
+
+// Callback for stats characteristic reads and subscriptions
+class MyStatsCallbacks : public NimBLECharacteristicCallbacks
+{
+public:
+    MyStatsCallbacks(BLEManager *manager) : bleManager(manager) {}
+    void onRead(NimBLECharacteristic *pCharacteristic, NimBLEConnInfo &connInfo);
+    void onSubscribe(NimBLECharacteristic *pCharacteristic, NimBLEConnInfo &connInfo, uint16_t subValue);
 
 private:
-    unsigned long lastActivityTime;
+    BLEManager *bleManager;
+};
 
+class BLEManager
+{
 public:
+    void stopAdvertising();
+    void disconnect();
+
     BLEManager(QueueHandle_t bleToLoraQueue);
 
     /// Initialize BLE with device name
@@ -55,6 +78,12 @@ public:
     /// Set activity callback (called on BLE events)
     void setActivityCallback(void (*callback)()) { activityCallback = callback; }
 
+    /// Set the function writing the stats characteristic's value (returns its length, 0 on failure)
+    void setStatsSource(size_t (*source)(uint8_t *out, size_t len)) { statsSource = source; }
+
+    /// Set event group notified on queued frames and connection changes (BRIDGE_EVENT_* bits)
+    void setEventGroup(EventGroupHandle_t group) { events = group; }
+
     /// Start BLE advertising
     void startAdvertising();
 
@@ -64,20 +93,61 @@ public:
     /// Send a message to the connected BLE client via notification
     bool sendMessage(const Message &msg);
 
+    /// Send an already-serialized frame to the connected BLE client via notification
+    /// Returns false if not connected or NimBLE could not queue the notification (retry later)
+    bool sendFrame(const uint8_t *data, size_t length);
+
+    /// Largest notification payload on the current connection (ATT MTU - 3, at most MAX_AGGREGATE_SIZE)
+    size_t maxNotifySize() const;
+
+    /// True while connected and fewer than MAX_NOTIFY_IN_FLIGHT notifications wait for NimBLE
+    bool canNotify() const { return deviceConnected && notifiesInFlight < MAX_NOTIFY_IN_FLIGHT; }
+
+    /// True while a sent notification has not been reported by NimBLE yet (a completion will wake the bridge)
+    bool hasNotifyInFlight() const { return notifiesInFlight > 0; }
+
+    /// True while the client has notifications of the stats characteristic enabled
+    bool isStatsSubscribed() const { return deviceConnected && statsSubscribed; }
+
+    /// Notify a stats snapshot to a subscribed client, cut to the notification size
+    /// (the client reads the characteristic for all of it). False if not sent.
+    bool notifyStats();
+
     /// Process BLE events (call in main loop)
     void process();
 
-    /// Called when RX characteristic is written
+    /// Called when RX characteristic is written: a frame, or an aggregate of frames
+    /// (the fragments of a long message), for the LoRa queue
     void onMessageReceived(const uint8_t *data, size_t length);
 
     /// Connection state callbacks
-    void onConnected();
+    void onConnected(uint16_t mtu);
     void onDisconnected();
+    void onMtuChanged(uint16_t mtu);
+
+    /// NimBLE finished a notification (sent or failed), frees its slot
+    void onNotifyStatus(int code);
+
+    /// Stats characteristic callbacks (NimBLE host task)
+    void onStatsRead(NimBLECharacteristic *characteristic);
+    void onStatsSubscribed(bool notify)
+    {
+        statsSubscribed = notify;
+        signal(BRIDGE_EVENT_BLE_TX); // The forwarding task sends the first snapshot
+    }
+
+    /// Notifications handed to NimBLE before waiting for completions; keeps the
+    /// host's buffer pool from running dry during a backlog flush
+    static const uint8_t MAX_NOTIFY_IN_FLIGHT = 4;
+
+    /// ATT MTU until the client negotiates a larger one
+    static const uint16_t DEFAULT_ATT_MTU = 23;
 
 private:
     NimBLEServer *pServer;
     NimBLECharacteristic *pTxCharacteristic;
     NimBLECharacteristic *pRxCharacteristic;
+    NimBLECharacteristic *pStatsCharacteristic;
     NimBLEAdvertising *pAdvertising;
 
     bool deviceConnected;
@@ -88,8 +158,34 @@ private:
 
     MyServerCallbacks *serverCallbacks;
     MyCharacteristicCallbacks *rxCallbacks;
+    MyTxCallbacks *txCallbacks;
+    MyStatsCallbacks *statsCallbacks;
+
+    uint16_t attMtu;
+    std::atomic<uint8_t> notifiesInFlight; // Updated from the NimBLE host task
+
+    // Hand-over times of the notifications in flight, for the BleNotify stage of
+    // linkStats. NimBLE completes them in order: sent and completed count up.
+    uint32_t notifyStartUs[MAX_NOTIFY_IN_FLIGHT];
+    std::atomic<uint8_t> notifiesSent;
+    std::atomic<uint8_t> notifiesCompleted;
+
+    size_t (*statsSource)(uint8_t *out, size_t len);
+    std::atomic<bool> statsSubscribed;
 
     void (*activityCallback)(); // Callback for activity updates
+    EventGroupHandle_t events;  // Bridge loop wake-up, may be null
+
+    /// Copies a validated frame into the LoRa queue (which has room for it)
+    void queueFrame(const uint8_t *data, size_t length);
+
+    void signal(EventBits_t bits)
+    {
+        if (events)
+        {
+            xEventGroupSetBits(events, bits);
+        }
+    }
 };
 
 #endif // BLE_MANAGER_H
@@ -0,0 +1,26 @@
+#ifndef BRIDGE_EVENTS_H
+#define BRIDGE_EVENTS_H
+
+#include <freertos/FreeRTOS.h>
+#include <freertos/event_groups.h>
+
+/**
+ * Event bits the bridge tasks block on (one event group, see main.cpp)
+ *
+ * Producers set a bit after their queue write. Each task waits on its own
+ * subset, clears those bits on wake-up and then drains every source it owns
+ * completely, so no event can be lost between the wake-up and the drain.
+ */
+const EventBits_t BRIDGE_EVENT_BLE_RX = (1 << 0);           // Frame queued on bleToLoraQueue
+const EventBits_t BRIDGE_EVENT_BLE_CONNECTION = (1 << 1);   // BLE client connected or disconnected
+const EventBits_t BRIDGE_EVENT_LORA_RX = (1 << 2);          // Packet pushed to the LoRa RX ring
+const EventBits_t BRIDGE_EVENT_LORA_TX_DONE = (1 << 3);     // Radio task finished a transmission
+const EventBits_t BRIDGE_EVENT_BLE_TX = (1 << 4);           // Frame for the app pushed to loraToBle, or a notification completed
+
+/// Bridge task: everything on the LoRa side, including ACK generation
+const EventBits_t BRIDGE_TASK_EVENTS = BRIDGE_EVENT_BLE_RX | BRIDGE_EVENT_LORA_RX | BRIDGE_EVENT_LORA_TX_DONE;
+
+/// Forwarding task: BLE notifications and the disconnected-buffer flush
+const EventBits_t FORWARDING_TASK_EVENTS = BRIDGE_EVENT_BLE_CONNECTION | BRIDGE_EVENT_BLE_TX;
+
+#endif // BRIDGE_EVENTS_H
@@ -2,10 +2,17 @@
 #ifndef LED_MANAGER_H
 #define LED_MANAGER_H
 
+#include <freertos/FreeRTOS.h>
+#include <freertos/queue.h>
+#include <freertos/task.h>
+
 class LEDManager
 {
 public:
-    LEDManager(int pin) : ledPin(pin) {}
+    static const uint32_t INDICATOR_TASK_STACK_SIZE = 2048;
+    static const int INDICATOR_QUEUE_SIZE = 8;
+
+    LEDManager(int pin) : ledPin(pin), requests(nullptr) {}
 
     /**
      * @brief Initializes the LED.
@@ -16,24 +23,48 @@ public:
         digitalWrite(ledPin, LOW); // Ensure LED is off initially
     }
 
+    /**
+     * @brief Starts the indicator task that performs the blinks.
+     *
+     * Once running, blink() only posts a request and returns immediately, so
+     * callers in the radio or bridge path never wait on the LED delays.
+     * @param priority Task priority (keep it below every bridging task).
+     * @param core Core to pin the indicator task to.
+     * @return True if the task was created.
+     */
+    bool startTask(UBaseType_t priority = tskIDLE_PRIORITY + 1, BaseType_t core = tskNO_AFFINITY)
+    {
+        requests = xQueueCreate(INDICATOR_QUEUE_SIZE, sizeof(BlinkRequest));
+        if (requests == nullptr)
+        {
+            return false;
+        }
+        if (xTaskCreatePinnedToCore(indicatorTask, "led", INDICATOR_TASK_STACK_SIZE, this, priority, nullptr, core) != pdPASS)
+        {
+            vQueueDelete(requests);
+            requests = nullptr;
+            return false;
+        }
+        return true;
+    }
+
     /**
      * @brief Blinks the LED a specified number of times.
+     * Non-blocking once startTask() succeeded (requests are dropped if the queue is full),
+     * blocking otherwise.
      * @param times Number of blinks (default: 1).
      * @param duration Duration of each blink in milliseconds (default: 50 - reduced for power saving).
      * @param delayBetween Delay between blinks in milliseconds (default: 200 - increased for power saving).
      */
     void blink(int times = 1, int duration = 50, int delayBetween = 200)
     {
-        for (int i = 0; i < times; i++)
+        if (requests)
         {
-            setOn();
-            delay(duration);
-            setOff();
-            if (i < times - 1)
-            {
-                delay(delayBetween);
-            }
+            BlinkRequest request = {(uint8_t)times, (uint16_t)duration, (uint16_t)delayBetween};
+            xQueueSend(requests, &request, 0);
+            return;
         }
+        blinkNow(times, duration, delayBetween);
     }
 
     /**
@@ -53,7 +84,42 @@ public:
     }
 
 private:
+    struct BlinkRequest
+    {
+        uint8_t times;
+        uint16_t duration;
+        uint16_t delayBetween;
+    };
+
     int ledPin;
+    QueueHandle_t requests;
+
+    void blinkNow(int times, int duration, int delayBetween)
+    {
+        for (int i = 0; i < times; i++)
+        {
+            setOn();
+            delay(duration);
+            setOff();
+            if (i < times - 1)
+            {
+                delay(delayBetween);
+            }
+        }
+    }
+
+    static void indicatorTask(void *param)
+    {
+        LEDManager *self = static_cast<LEDManager *>(param);
+        BlinkRequest request;
+        for (;;)
+        {
+            if (xQueueReceive(self->requests, &request, portMAX_DELAY) == pdTRUE)
+            {
+                self->blinkNow(request.times, request.duration, request.delayBetween);
+            }
+        }
+    }
 };
 
-#endif // LED_MANAGER_H
\ No newline at end of file
+#endif // LED_MANAGER_H
@@ -0,0 +1,166 @@
+#ifndef LITTLEFS_FRAME_STORAGE_H
+#define LITTLEFS_FRAME_STORAGE_H
+
+#include <Arduino.h>
+#include <LittleFS.h>
+#include "FrameStore.h"
+
+/**
+ * FrameStore segments as LittleFS files: /frames/<id>.seg plus /frames/cursor
+ *
+ * Uses the "spiffs" data partition of the default partition tables.
+ * LittleFS commits a file on close, so an append or cursor write cut short
+ * by a reset leaves the previous contents. Until begin() succeeded every call
+ * fails, and the store keeps frames in RAM only.
+ */
+class LittleFsFrameStorage : public FrameStorage
+{
+public:
+    LittleFsFrameStorage() : mounted(false), readSegment(0) {}
+
+    /**
+     * Mount the filesystem (formatting it if it has never been mounted)
+     * @return true if the frame store can use it
+     */
+    bool begin()
+    {
+        if (!LittleFS.begin(true))
+        {
+            return false;
+        }
+        mounted = LittleFS.exists(DIR) || LittleFS.mkdir(DIR);
+        return mounted;
+    }
+
+    size_t listSegments(uint32_t *ids, size_t max) override
+    {
+        size_t count = 0;
+        File dir = mounted ? LittleFS.open(DIR) : File();
+        if (!dir)
+        {
+            return 0;
+        }
+        for (File file = dir.openNextFile(); file && count < max; file = dir.openNextFile())
+        {
+            char *end;
+            unsigned long id = strtoul(file.name(), &end, 16);
+            if (end != file.name() && strcmp(end, ".seg") == 0)
+            {
+                ids[count++] = id;
+            }
+        }
+        return count;
+    }
+
+    int read(uint32_t segment, size_t offset, uint8_t *buf, size_t len) override
+    {
+        // Sequential reads of one segment reuse the open file
+        if (!readFile || readSegment != segment)
+        {
+            closeReadFile();
+            if (!mounted)
+            {
+                return -1;
+            }
+            char path[PATH_SIZE];
+            readFile = LittleFS.open(segmentPath(segment, path), FILE_READ);
+            readSegment = segment;
+            if (!readFile)
+            {
+                return -1;
+            }
+        }
+        if (offset >= readFile.size())
+        {
+            return 0;
+        }
+        if (!readFile.seek(offset))
+        {
+            return -1;
+        }
+        return readFile.read(buf, len);
+    }
+
+    bool append(uint32_t segment, const uint8_t *data, size_t len) override
+    {
+        if (!mounted)
+        {
+            return false;
+        }
+        closeReadFile(); // Reopened with the new size
+        char path[PATH_SIZE];
+        File file = LittleFS.open(segmentPath(segment, path), FILE_APPEND);
+        if (!file)
+        {
+            return false;
+        }
+        size_t written = file.write(data, len);
+        file.close();
+        return written == len;
+    }
+
+    bool remove(uint32_t segment) override
+    {
+        if (!mounted)
+        {
+            return false;
+        }
+        if (readSegment == segment)
+        {
+            closeReadFile();
+        }
+        char path[PATH_SIZE];
+        return LittleFS.remove(segmentPath(segment, path));
+    }
+
+    bool writeCursor(uint32_t segment, uint32_t offset) override
+    {
+        File file = mounted ? LittleFS.open(CURSOR_PATH, FILE_WRITE) : File();
+        if (!file)
+        {
+            return false;
+        }
+        uint32_t cursor[2] = {segment, offset};
+        size_t written = file.write(reinterpret_cast<const uint8_t *>(cursor), sizeof(cursor));
+        file.close();
+        return written == sizeof(cursor);
+    }
+
+    bool readCursor(uint32_t &segment, uint32_t &offset) override
+    {
+        File file = mounted ? LittleFS.open(CURSOR_PATH, FILE_READ) : File();
+        uint32_t cursor[2];
+        if (!file || file.read(reinterpret_cast<uint8_t *>(cursor), sizeof(cursor)) != sizeof(cursor))
+        {
+            return false;
+        }
+        segment = cursor[0];
+        offset = cursor[1];
+        return true;
+    }
+
+private:
+    static constexpr const char *DIR = "/frames";
+    static constexpr const char *CURSOR_PATH = "/frames/cursor";
+    static const size_t PATH_SIZE = 24;
+
+    bool mounted;
+    File readFile;
+    uint32_t readSegment;
+
+    static const char *segmentPath(uint32_t segment, char *path)
+    {
+        snprintf(path, PATH_SIZE, "%s/%08lx.seg", DIR, static_cast<unsigned long>(segment));
+        return path;
+    }
+
+    void closeReadFile()
+    {
+        if (readFile)
+        {
+            readFile.close();
+        }
+    }
+};
+
+#endif // LITTLEFS_FRAME_STORAGE_H
@@ -2,7 +2,40 @@
 #define POWER_MANAGER_H
 
 #include "esp_pm.h"
+#include <esp_timer.h>
 #include <Arduino.h>
+#include <atomic>
+#include "EventLog.h"
+#include "LoRaAirtime.h"
+
+/**
+ * @brief Current draw figures behind the charge estimate, in mA (override with -D...).
+ * Defaults: ESP32 awake at 10-80 MHz with BLE, light sleep with BLE modem sleep,
+ * SX1278 at +20 dBm on PA_BOOST and in continuous RX.
+ */
+#ifndef POWER_ACTIVE_MA
+#define POWER_ACTIVE_MA 25.0f
+#endif
+#ifndef POWER_LIGHT_SLEEP_MA
+#define POWER_LIGHT_SLEEP_MA 1.0f
+#endif
+#ifndef POWER_LORA_TX_MA
+#define POWER_LORA_TX_MA 120.0f
+#endif
+#ifndef POWER_LORA_RX_MA
+#define POWER_LORA_RX_MA 11.0f
+#endif
+
+/**
+ * @brief Why a high-power hold is taken; hold time is accounted per reason.
+ */
+enum class PowerReason : uint8_t
+{
+    LoRaTx,   // Frame on air (radio task, from TX start to TxDone)
+    Ack,      // Received packets handled up to the ACKs they need (bridge task)
+    BleFlush, // Buffered frames read back and notified to the app (forwarding task)
+    Count
+};
 
 /**
  * @brief Power management for LoRa transmission
@@ -13,39 +46,77 @@
  * Usage:
  * - Call acquireForLoRaTx() before starting LoRa transmission
  * - Call releaseAfterLoRaTx() after transmission completes
+ * - Hold a PowerLockGuard for other short bursts (ACKs, BLE flush)
  *
  * Power savings:
  * - During RX/idle: CPU can run at 10 MHz, system can enter light sleep
  * - During TX: CPU runs at 80 MHz, light sleep disabled for reliable transmission
+ * - Listen-before-talk CADs and backoffs run before acquireForLoRaTx(), in low power
+ * - With RX sniffing (LORA_RX_SNIFF_MS) the radio sleeps too; the sniff timer and
+ *   the DIO0 GPIO wake-up bring the CPU out of light sleep
+ *
+ * Accounting: every reason has its own pair of locks (visible by name in
+ * esp_pm_dump_locks()) and accumulates the time it held them. Light sleep
+ * residency comes from the esp_pm light sleep exit callback, where the build
+ * has CONFIG_PM_LIGHT_SLEEP_CALLBACKS; without it the chip counts as awake
+ * all the time. estimateChargeUah() turns both into charge with the
+ * POWER_*_MA figures. Each reason must only be taken by one task at a time.
  */
 class PowerManager
 {
 public:
-    PowerManager() : cpu_freq_lock(nullptr), no_light_sleep_lock(nullptr)
+    PowerManager() : messages(0), lightSleepMsTotal(0), lightSleepCount(0), lightSleepRemainderUs(0), sleepStats(false),
+                     radioSymbolUs(0)
     {
-        // Create power management lock for maximum CPU frequency during LoRa TX
-        esp_err_t err = esp_pm_lock_create(ESP_PM_CPU_FREQ_MAX, 0, "lora_tx", &cpu_freq_lock);
-        if (err != ESP_OK)
+        static const char *const names[] = {"lora_tx", "ack", "ble_flush"};
+        static const char *const noSleepNames[] = {"lora_tx_nosleep", "ack_nosleep", "ble_flush_nosleep"};
+        for (size_t i = 0; i < REASON_COUNT; i++)
         {
-            Serial.printf("Failed to create CPU freq lock: %d\n", err);
-        }
+            Hold &hold = holds[i];
+            hold.cpuFreqLock = nullptr;
+            hold.noLightSleepLock = nullptr;
+            hold.depth = 0;
+            hold.startUs = 0;
+            hold.remainderUs = 0;
+            hold.heldMs = 0;
+            hold.count = 0;
 
-        // Create power management lock to prevent light sleep during LoRa TX
-        err = esp_pm_lock_create(ESP_PM_NO_LIGHT_SLEEP, 0, "lora_tx_nosleep", &no_light_sleep_lock);
-        if (err != ESP_OK)
-        {
-            Serial.printf("Failed to create no-light-sleep lock: %d\n", err);
+            // Maximum CPU frequency while held
+            esp_err_t err = esp_pm_lock_create(ESP_PM_CPU_FREQ_MAX, 0, names[i], &hold.cpuFreqLock);
+            if (err != ESP_OK)
+            {
+                Serial.printf("Failed to create CPU freq lock: %d\n", err);
+            }
+
+            // No light sleep while held
+            err = esp_pm_lock_create(ESP_PM_NO_LIGHT_SLEEP, 0, noSleepNames[i], &hold.noLightSleepLock);
+            if (err != ESP_OK)
+            {
+                Serial.printf("Failed to create no-light-sleep lock: %d\n", err);
+            }
         }
 
+#ifdef CONFIG_PM_LIGHT_SLEEP_CALLBACKS
+        esp_pm_sleep_cbs_register_config_t callbacks = {};
+        callbacks.exit_cb = onLightSleepExit;
+        callbacks.exit_cb_user_arg = this;
+        sleepStats = esp_pm_light_sleep_register_cbs(&callbacks) == ESP_OK;
+#endif
+
         Serial.println("PowerManager initialized - dynamic power control enabled");
+        Serial.println(sleepStats ? "PowerManager: light sleep residency tracked"
+                                  : "PowerManager: no light sleep callbacks, residency not tracked");
     }
 
     ~PowerManager()
     {
-        if (cpu_freq_lock)
-            esp_pm_lock_delete(cpu_freq_lock);
-        if (no_light_sleep_lock)
-            esp_pm_lock_delete(no_light_sleep_lock);
+        for (Hold &hold : holds)
+        {
+            if (hold.cpuFreqLock)
+                esp_pm_lock_delete(hold.cpuFreqLock);
+            if (hold.noLightSleepLock)
+                esp_pm_lock_delete(hold.noLightSleepLock);
+        }
     }
 
     /**
@@ -56,15 +127,8 @@ public:
      */
     void acquireForLoRaTx()
     {
-        if (cpu_freq_lock)
-        {
-            esp_pm_lock_acquire(cpu_freq_lock);
-        }
-        if (no_light_sleep_lock)
-        {
-            esp_pm_lock_acquire(no_light_sleep_lock);
-        }
-        Serial.println("PM: High power mode for LoRa TX");
+        acquire(PowerReason::LoRaTx);
+        LOG_DEBUG(PmHighPower);
     }
 
     /**
@@ -75,20 +139,209 @@ public:
      */
     void releaseAfterLoRaTx()
     {
-        if (no_light_sleep_lock)
+        release(PowerReason::LoRaTx);
+        LOG_DEBUG(PmLowPower);
+    }
+
+    /**
+     * @brief Takes the reason's locks; nested acquires of one reason are timed once.
+     */
+    void acquire(PowerReason reason)
+    {
+        Hold &hold = holds[static_cast<size_t>(reason)];
+        if (hold.depth++ == 0)
         {
-            esp_pm_lock_release(no_light_sleep_lock);
+            hold.startUs = static_cast<uint32_t>(esp_timer_get_time());
         }
-        if (cpu_freq_lock)
+        if (hold.cpuFreqLock)
         {
-            esp_pm_lock_release(cpu_freq_lock);
+            esp_pm_lock_acquire(hold.cpuFreqLock);
+        }
+        if (hold.noLightSleepLock)
+        {
+            esp_pm_lock_acquire(hold.noLightSleepLock);
         }
-        Serial.println("PM: Released to low power mode");
     }
 
+    /**
+     * @brief Releases the reason's locks and adds the hold time once the outermost acquire is released.
+     */
+    void release(PowerReason reason)
+    {
+        Hold &hold = holds[static_cast<size_t>(reason)];
+        if (hold.depth == 0)
+        {
+            return; // Not held
+        }
+        if (hold.noLightSleepLock)
+        {
+            esp_pm_lock_release(hold.noLightSleepLock);
+        }
+        if (hold.cpuFreqLock)
+        {
+            esp_pm_lock_release(hold.cpuFreqLock);
+        }
+        if (--hold.depth == 0)
+        {
+            hold.remainderUs += static_cast<uint32_t>(esp_timer_get_time()) - hold.startUs;
+            hold.heldMs.fetch_add(hold.remainderUs / 1000, std::memory_order_relaxed);
+            hold.remainderUs %= 1000;
+            hold.count.fetch_add(1, std::memory_order_relaxed);
+        }
+    }
+
+    /**
+     * @brief Counts messages carried over the link (the divisor of uahPerMessage()).
+     */
+    void countMessage(uint32_t n = 1) { messages.fetch_add(n, std::memory_order_relaxed); }
+
+    /**
+     * @brief Total time the reason held its locks, in ms.
+     */
+    uint32_t heldMs(PowerReason reason) const
+    {
+        return holds[static_cast<size_t>(reason)].heldMs.load(std::memory_order_relaxed);
+    }
+
+    /**
+     * @brief Completed holds of the reason.
+     */
+    uint32_t holdCount(PowerReason reason) const
+    {
+        return holds[static_cast<size_t>(reason)].count.load(std::memory_order_relaxed);
+    }
+
+    /**
+     * @brief True if light sleep residency is tracked (CONFIG_PM_LIGHT_SLEEP_CALLBACKS).
+     */
+    bool hasSleepStats() const { return sleepStats; }
+
+    /**
+     * @brief Time spent in automatic light sleep since boot, in ms.
+     */
+    uint32_t lightSleepMs() const { return lightSleepMsTotal.load(std::memory_order_relaxed); }
+
+    /**
+     * @brief Number of automatic light sleeps since boot.
+     */
+    uint32_t lightSleeps() const { return lightSleepCount.load(std::memory_order_relaxed); }
+
+    /**
+     * @brief Radio rate in use, for the CAD share of an RX sniff period. Call
+     * once the radio is set up and again on every data rate switch.
+     */
+    void setRadioRate(uint8_t spreadingFactor, uint32_t bandwidthHz)
+    {
+        radioSymbolUs.store(lora_symbol_time_us(spreadingFactor, lora_effective_bandwidth_hz(bandwidthHz)),
+                            std::memory_order_relaxed);
+    }
+
+    /**
+     * @brief Estimated charge drawn since boot, in µAh.
+     *
+     * Awake time at POWER_ACTIVE_MA, light sleep at POWER_LIGHT_SLEEP_MA, LoRa
+     * TX holds at POWER_LORA_TX_MA and the rest of the time the radio listening:
+     * POWER_LORA_RX_MA, scaled down to the CAD share of a period with RX sniffing.
+     */
+    uint32_t estimateChargeUah() const
+    {
+        float uptimeMs = static_cast<float>(esp_timer_get_time() / 1000);
+        float sleepMs = static_cast<float>(lightSleepMs());
+        float txMs = static_cast<float>(heldMs(PowerReason::LoRaTx));
+        float mAms = (uptimeMs - sleepMs) * POWER_ACTIVE_MA + sleepMs * POWER_LIGHT_SLEEP_MA + txMs * POWER_LORA_TX_MA +
+                     (uptimeMs - txMs) * radioListenMa();
+        return static_cast<uint32_t>(mAms / 3600.0f); // mA x ms -> µAh
+    }
+
+    /**
+     * @brief Estimated charge per message counted with countMessage(), in µAh (0 before the first).
+     */
+    uint32_t uahPerMessage() const
+    {
+        uint32_t n = messages.load(std::memory_order_relaxed);
+        return n == 0 ? 0 : estimateChargeUah() / n;
+    }
+
+    /**
+     * @brief Logs residency, hold times and the charge estimate.
+     */
+    void report() const
+    {
+        uint32_t uptimeS = static_cast<uint32_t>(esp_timer_get_time() / 1000000);
+        if (sleepStats && uptimeS > 0)
+        {
+            LOG_INFO(PmResidency, lightSleepMs() / uptimeS, uptimeS, lightSleeps()); // ms per s = permille
+        }
+        LOG_INFO(PmHolds, heldMs(PowerReason::LoRaTx), heldMs(PowerReason::Ack), heldMs(PowerReason::BleFlush));
+        LOG_INFO(PmCharge, uahPerMessage(), messages.load(std::memory_order_relaxed), estimateChargeUah());
+    }
+
+private:
+    static const size_t REASON_COUNT = static_cast<size_t>(PowerReason::Count);
+
+    struct Hold
+    {
+        esp_pm_lock_handle_t cpuFreqLock;
+        esp_pm_lock_handle_t noLightSleepLock;
+        uint8_t depth;        // Nested acquires (owner task only)
+        uint32_t startUs;     // Of the outermost acquire (owner task only)
+        uint32_t remainderUs; // Below 1 ms, carried to the next hold (owner task only)
+        std::atomic<uint32_t> heldMs;
+        std::atomic<uint32_t> count;
+    };
+
+    Hold holds[REASON_COUNT];
+    std::atomic<uint32_t> messages;
+    std::atomic<uint32_t> lightSleepMsTotal;
+    std::atomic<uint32_t> lightSleepCount;
+    uint32_t lightSleepRemainderUs; // Only touched by the sleep callback
+    bool sleepStats;
+    std::atomic<uint32_t> radioSymbolUs; // From setRadioRate()
+
+    /**
+     * @brief Average radio current while not transmitting, in mA, at the rate from setRadioRate().
+     */
+    float radioListenMa() const
+    {
+        float cadMs = LORA_CAD_SYMBOLS * radioSymbolUs.load(std::memory_order_relaxed) / 1000.0f;
+        return LORA_RX_SNIFF_MS == 0 ? POWER_LORA_RX_MA : POWER_LORA_RX_MA * cadMs / (LORA_RX_SNIFF_MS + 0.0f);
+    }
+
+#ifdef CONFIG_PM_LIGHT_SLEEP_CALLBACKS
+    /**
+     * @brief Light sleep exit callback (idle task, interrupts off): adds the time slept.
+     */
+    static esp_err_t IRAM_ATTR onLightSleepExit(int64_t sleepTimeUs, void *arg)
+    {
+        PowerManager *self = static_cast<PowerManager *>(arg);
+        self->lightSleepRemainderUs += static_cast<uint32_t>(sleepTimeUs);
+        self->lightSleepMsTotal.fetch_add(self->lightSleepRemainderUs / 1000, std::memory_order_relaxed);
+        self->lightSleepRemainderUs %= 1000;
+        self->lightSleepCount.fetch_add(1, std::memory_order_relaxed);
+        return ESP_OK;
+    }
+#endif
+};
+
+/**
+ * @brief Holds a PowerReason's locks for the lifetime of the guard.
+ */
+class PowerLockGuard
+{
+public:
+    PowerLockGuard(PowerManager &manager, PowerReason reason) : manager(manager), reason(reason)
+    {
+        manager.acquire(reason);
+    }
+
+    ~PowerLockGuard() { manager.release(reason); }
+
+    PowerLockGuard(const PowerLockGuard &) = delete;
+    PowerLockGuard &operator=(const PowerLockGuard &) = delete;
+
 private:
-    esp_pm_lock_handle_t cpu_freq_lock;
-    esp_pm_lock_handle_t no_light_sleep_lock;
+    PowerManager &manager;
+    PowerReason reason;
 };
 
 #endif // POWER_MANAGER_H
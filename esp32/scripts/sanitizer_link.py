@@ -0,0 +1,5 @@
+# PlatformIO extra script for the native_fuzz env
+# build_flags only reach the compiler, so the sanitizer runtime has to be added to the link step too
+Import("env")
+
+env.Append(LINKFLAGS=["-fsanitize=address,undefined"])
@@ -1,4 +1,6 @@
 #include "BLEManager.h"
+#include "EventLog.h"
+#include "LinkStats.h"
 
 // Server callbacks implementation
 void MyServerCallbacks::onConnect(NimBLEServer *pServer, NimBLEConnInfo &connInfo)
@@ -10,7 +12,7 @@ void MyServerCallbacks::onConnect(NimBLEServer *pServer, NimBLEConnInfo &connInf
     Serial.print("MTU: ");
     Serial.println(connInfo.getMTU());
 
-    bleManager->onConnected();
+    bleManager->onConnected(connInfo.getMTU());
 
     // Stop advertising when connected
     NimBLEDevice::getAdvertising()->stop();
@@ -24,34 +26,51 @@ void MyServerCallbacks::onDisconnect(NimBLEServer *pServer, NimBLEConnInfo &conn
     bleManager->onDisconnected();
 }
 
+void MyServerCallbacks::onMTUChange(uint16_t MTU, NimBLEConnInfo &connInfo)
+{
+    LOG_INFO(BleMtu, MTU);
+    bleManager->onMtuChanged(MTU);
+}
+
 // Characteristic callbacks implementation
 void MyCharacteristicCallbacks::onWrite(NimBLECharacteristic *pCharacteristic, NimBLEConnInfo &connInfo)
 {
     std::string value = pCharacteristic->getValue();
     if (value.length() > 0)
     {
-        Serial.print("Received BLE write on RX characteristic, ");
-        Serial.print(value.length());
-        Serial.print(" bytes from client: ");
-        Serial.println(connInfo.getAddress().toString().c_str());
-
-        // Add hex dump for debugging
-        Serial.print("Data (hex): ");
-        for (size_t i = 0; i < value.length(); i++)
+        // Runs in the NimBLE host task: the first 4 bytes (type, seq, header) instead of a hex dump
+        uint32_t head = 0;
+        for (size_t i = 0; i < 4; i++)
         {
-            Serial.printf("%02X ", (uint8_t)value[i]);
+            head = (head << 8) | (i < value.length() ? (uint8_t)value[i] : 0);
         }
-        Serial.println();
+        LOG_DEBUG(BleWrite, value.length(), head);
 
         bleManager->onMessageReceived((const uint8_t *)value.data(), value.length());
     }
 }
 
+void MyTxCallbacks::onStatus(NimBLECharacteristic *pCharacteristic, int code)
+{
+    bleManager->onNotifyStatus(code);
+}
+
+void MyStatsCallbacks::onRead(NimBLECharacteristic *pCharacteristic, NimBLEConnInfo &connInfo)
+{
+    bleManager->onStatsRead(pCharacteristic);
+}
+
+void MyStatsCallbacks::onSubscribe(NimBLECharacteristic *pCharacteristic, NimBLEConnInfo &connInfo, uint16_t subValue)
+{
+    bleManager->onStatsSubscribed((subValue & 0x0001) != 0); // Bit 0 of the CCCD: notifications
+}
+
 // BLEManager implementation
 BLEManager::BLEManager(QueueHandle_t queue)
     : pServer(nullptr),
       pTxCharacteristic(nullptr),
       pRxCharacteristic(nullptr),
+      pStatsCharacteristic(nullptr),
       pAdvertising(nullptr),
       deviceConnected(false),
       oldDeviceConnected(false),
@@ -59,7 +78,16 @@ BLEManager::BLEManager(QueueHandle_t queue)
       deviceNameStr(""),
       serverCallbacks(nullptr),
       rxCallbacks(nullptr),
-      activityCallback(nullptr)
+      txCallbacks(nullptr),
+      statsCallbacks(nullptr),
+      attMtu(DEFAULT_ATT_MTU),
+      notifiesInFlight(0),
+      notifiesSent(0),
+      notifiesCompleted(0),
+      statsSource(nullptr),
+      statsSubscribed(false),
+      activityCallback(nullptr),
+      events(nullptr)
 {
 }
 
@@ -87,6 +115,8 @@ bool BLEManager::setup(const char *deviceName)
         NIMBLE_PROPERTY::READ |
             NIMBLE_PROPERTY::WRITE |
             NIMBLE_PROPERTY::NOTIFY);
+    txCallbacks = new MyTxCallbacks(this);
+    pTxCharacteristic->setCallbacks(txCallbacks);
 
     // Create the RX Characteristic (for receiving data from phone)
     pRxCharacteristic = pService->createCharacteristic(
@@ -98,6 +128,14 @@ bool BLEManager::setup(const char *deviceName)
     rxCallbacks = new MyCharacteristicCallbacks(this);
     pRxCharacteristic->setCallbacks(rxCallbacks);
 
+    // Create the Stats Characteristic (link statistics, filled on every read)
+    pStatsCharacteristic = pService->createCharacteristic(
+        STATS_CHARACTERISTIC_UUID,
+        NIMBLE_PROPERTY::READ |
+            NIMBLE_PROPERTY::NOTIFY);
+    statsCallbacks = new MyStatsCallbacks(this);
+    pStatsCharacteristic->setCallbacks(statsCallbacks);
+
     // Start the service
     pService->start();
 
@@ -126,12 +164,19 @@ bool BLEManager::setup(const char *deviceName)
     Serial.println(TX_CHARACTERISTIC_UUID);
     Serial.print("RX Characteristic UUID: ");
     Serial.println(RX_CHARACTERISTIC_UUID);
+    Serial.print("Stats Characteristic UUID: ");
+    Serial.println(STATS_CHARACTERISTIC_UUID);
 
     return true;
 }
 
 void BLEManager::startAdvertising()
 {
+    if (pAdvertising && pAdvertising->isAdvertising())
+    {
+        return; // Called for every frame buffered while disconnected
+    }
+
     Serial.println("Starting BLE advertising...");
 
     // Additional debugging information
@@ -148,13 +193,7 @@ void BLEManager::startAdvertising()
 }
 bool BLEManager::sendMessage(const Message &msg)
 {
-    if (!deviceConnected)
-    {
-        Serial.println("Cannot send message: BLE not connected");
-        return false;
-    }
-
-    uint8_t buf[64];
+    uint8_t buf[MAX_FRAME_SIZE];
     int len = msg.serialize(buf, sizeof(buf));
 
     if (len < 0)
@@ -163,17 +202,61 @@ bool BLEManager::sendMessage(const Message &msg)
         return false;
     }
 
-    Serial.print("Sending ");
-    Serial.print(len);
-    Serial.println(" bytes via BLE notification");
+    return sendFrame(buf, len);
+}
+
+bool BLEManager::sendFrame(const uint8_t *data, size_t length)
+{
+    if (!deviceConnected)
+    {
+        LOG_WARN(BleNotConnected);
+        return false;
+    }
 
-    pTxCharacteristic->setValue(buf, len);
-    pTxCharacteristic->notify();
+    // Counted before notify(): the completion may arrive before notify() returns
+    notifiesInFlight++;
+    notifyStartUs[notifiesSent % MAX_NOTIFY_IN_FLIGHT] = STATS_CLOCK_US();
+    notifiesSent++;
+    pTxCharacteristic->setValue(data, length);
+    if (!pTxCharacteristic->notify())
+    {
+        notifiesInFlight--;
+        notifiesSent--;
+        LOG_WARN(BleNotifyBusy);
+        return false;
+    }
 
-    Serial.println("Message forwarded from LoRa to BLE via notification");
+    LOG_DEBUG(BleNotify, length);
     return true;
 }
 
+size_t BLEManager::maxNotifySize() const
+{
+    size_t payload = attMtu - 3; // ATT notification header: opcode + handle
+    return payload < MAX_AGGREGATE_SIZE ? payload : MAX_AGGREGATE_SIZE;
+}
+
+bool BLEManager::notifyStats()
+{
+    if (!isStatsSubscribed() || !statsSource)
+    {
+        return false;
+    }
+
+    uint8_t value[LINK_STATS_SIZE];
+    size_t len = statsSource(value, sizeof(value));
+    size_t payload = attMtu - 3;
+    return len > 0 && pStatsCharacteristic->notify(value, len < payload ? len : payload);
+}
+
+void BLEManager::onStatsRead(NimBLECharacteristic *characteristic)
+{
+    // Runs before NimBLE answers the read, long reads get the rest of the same value
+    uint8_t value[LINK_STATS_SIZE];
+    size_t len = statsSource ? statsSource(value, sizeof(value)) : 0;
+    characteristic->setValue(value, len);
+}
+
 void BLEManager::process()
 {
     // Handle disconnection/reconnection
@@ -206,11 +289,6 @@ void BLEManager::stopAdvertising()
     }
 }
 
-void BLEManager::updateActivity()
-{
-    lastActivityTime = millis();
-}
-
 void BLEManager::disconnect()
 {
     if (deviceConnected)
@@ -230,40 +308,80 @@ void BLEManager::disconnect()
     }
 }
 
-void BLEManager::onMessageReceived(const uint8_t *data, size_t length)
+/**
+ * @brief True if the app may send this frame: a valid bare message, without link-only coordinates
+ */
+static bool isAppFrame(const uint8_t *data, size_t length)
 {
-    Serial.print("Parsing BLE message, length: ");
-    Serial.println(length);
+    // Keyframe/Delta coordinates are link-only, the bridge derives them from absolute ones
+    bool linkOnlyGps = length >= 4 && data[0] == static_cast<uint8_t>(MessageType::Text) &&
+                       static_cast<GpsEncoding>(data[3] >> TEXT_GPS_SHIFT) > GpsEncoding::Absolute;
 
+    // Validate the header only - the frame is queued and transmitted as-is
+    return length <= MAX_FRAME_SIZE && Message::isValidFrame(data, length) && !linkOnlyGps;
+}
+
+void BLEManager::queueFrame(const uint8_t *data, size_t length)
+{
+    WireFrame frame;
+    frame.len = length;
+    memcpy(frame.data, data, length);
+    xQueueSend(bleToLoraQueue, &frame, 0);
+    LOG_INFO(BleFrameQueued, data[0]);
+}
+
+void BLEManager::onMessageReceived(const uint8_t *data, size_t length)
+{
     // Update activity callback if set
     if (activityCallback)
     {
         activityCallback();
     }
 
-    Message msg;
-    if (msg.deserialize(data, length))
+    // The app writes the fragments of a long message as one aggregate: every
+    // inner frame is checked like a bare one, and all of them are queued or none
+    bool isAggregate = length > 0 && data[0] == static_cast<uint8_t>(MessageType::Aggregate);
+    AggregateReader reader(data, length);
+    bool valid = isAggregate ? reader.isValid() : isAppFrame(data, length);
+    const uint8_t *frame;
+    size_t frameLen;
+    for (AggregateReader check(data, length); valid && isAggregate && check.next(frame, frameLen);)
     {
-        Serial.print("Deserialized message type: ");
-        Serial.println((int)msg.type);
-        // Send to queue instead of storing internally
-        if (xQueueSend(bleToLoraQueue, &msg, 0) != pdTRUE)
-        {
-            Serial.println("Warning: BLE to LoRa queue full, message dropped");
-        }
-        else
-        {
-            Serial.println("Message forwarded from BLE to LoRa queue");
-        }
+        valid = isAppFrame(frame, frameLen);
+    }
+    if (!valid)
+    {
+        LOG_WARN(BleInvalidFrame, length);
+        return;
+    }
+
+    // Only this callback fills the queue, so the space it reports stays free
+    UBaseType_t frames = isAggregate ? reader.count() : 1;
+    if (uxQueueSpacesAvailable(bleToLoraQueue) < frames)
+    {
+        LOG_WARN(BleQueueFull);
+        STATS_COUNT(BleQueueFull);
+        return;
     }
-    else
+
+    if (!isAggregate)
     {
-        Serial.println("Failed to deserialize message from BLE");
+        queueFrame(data, length);
     }
+    while (isAggregate && reader.next(frame, frameLen))
+    {
+        queueFrame(frame, frameLen);
+    }
+    signal(BRIDGE_EVENT_BLE_RX);
 }
 
-void BLEManager::onConnected()
+void BLEManager::onConnected(uint16_t mtu)
 {
+    attMtu = mtu;
+    notifiesInFlight = 0;
+    notifiesSent = 0;
+    notifiesCompleted = 0;
+    statsSubscribed = false;
     deviceConnected = true;
 
     // Update activity callback if set
@@ -271,9 +389,34 @@ void BLEManager::onConnected()
     {
         activityCallback();
     }
+
+    signal(BRIDGE_EVENT_BLE_CONNECTION);
 }
 
 void BLEManager::onDisconnected()
 {
     deviceConnected = false;
+    attMtu = DEFAULT_ATT_MTU;
+    signal(BRIDGE_EVENT_BLE_CONNECTION);
+}
+
+void BLEManager::onMtuChanged(uint16_t mtu)
+{
+    attMtu = mtu;
+    signal(BRIDGE_EVENT_BLE_TX); // Frames waiting for a larger notification can go now
+}
+
+void BLEManager::onNotifyStatus(int code)
+{
+    if (notifiesInFlight > 0)
+    {
+        notifiesInFlight--;
+        linkStats.record(LinkStage::BleNotify, STATS_CLOCK_US() - notifyStartUs[notifiesCompleted % MAX_NOTIFY_IN_FLIGHT]);
+        notifiesCompleted++;
+    }
+    if (code != 0)
+    {
+        LOG_WARN(BleNotifyFailed, code);
+    }
+    signal(BRIDGE_EVENT_BLE_TX); // A slot is free, the forwarding task sends the next batch
 }
@@ -6,19 +6,45 @@
 //! Features:
 //! - BLE GATT server with TX/RX characteristics for message exchange
 //! - LoRa radio for long-range communication (5-10 km typical)
-//! - Message queue for inter-task communication
-//! - Message buffering (up to 10 messages) when BLE disconnected
-//! - Light sleep for power optimization
-//! - Interrupt-driven LoRa reception (always listening)
+//! - Message queue for inter-task communication (serialized wire frames, no re-encoding)
+//! - Store-and-forward: messages for a disconnected phone are kept on flash (LittleFS, thousands,
+//!   batched writes, survive resets) and streamed out on reconnect
+//! - Batched BLE notifications: frames share one notification up to the MTU, paced by NimBLE completions
+//! - Light sleep for power optimization (tasks block on an event group, tickless idle sleeps)
+//! - Interrupt-driven LoRa reception (always listening, FIFO drained by a radio task)
+//! - Non-blocking LoRa TX: frames are queued to the radio task, which returns to RX on TxDone
+//! - Aggregate frames: queued texts and ACKs share one LoRa packet while the radio is busy
+//! - Link ARQ: up to 8 texts in flight, selective ACKs, retransmission on an RTT/airtime timeout
+//! - Duty-cycle aware TX scheduler: airtime per hour is capped, ACKs go before new text
+//! - Adaptive data rate: both bridges switch to the fastest SF/BW the measured SNR/RSSI allows
+//! - Delta GPS: positions go over LoRa as offsets from the last one the peer acknowledged
+//! - Core-pinned tasks: radio + bridge (ACKs) on the app core, BLE forwarding next to
+//!   the NimBLE host, LED indicator at the lowest priority
+//! - Binary event log: hot paths record ids + arguments, a low-priority task formats them
+//! - Link statistics: per-stage latency histograms and drop counters on a BLE stats characteristic
 #include <Arduino.h>
 #include "lora_config.h"
 #include "LoRaManager.h"
 #include "BLEManager.h"
 #include "Protocol.h"
+#include "Arq.h"
+#include "LoRaAirtime.h"
+#include "TxScheduler.h"
+#include "Adr.h"
+#include "GpsDelta.h"
+#include "Dedup.h"
+#include "Relay.h"
+#include "Fragment.h"
 #include "LEDManager.h"
-#include "MessageBuffer.h"
+#include "FrameStore.h"
+#include "SpscRing.h"
+#include "LittleFsFrameStorage.h"
 #include "PowerManager.h"
+#include "BridgeEvents.h"
+#include "EventLog.h"
+#include "LinkStats.h"
 #include <freertos/queue.h>
+#include <freertos/event_groups.h>
 #include <esp_task_wdt.h>
 #include <freertos/task.h>
 #include <LoRa.h>
@@ -27,7 +53,9 @@
 #include "esp_pm.h"
 
 // Manager objects
-LoRaManager loraManager(LORA_SCK, LORA_MISO, LORA_MOSI, LORA_SS, LORA_RST, LORA_DIO0, LORA_FREQUENCY);
+// Radio: board pins from platformio.ini, long-range settings from lora_config.h
+using BridgeLoRa = LoRaManager<LoRaProfile<LoRaPins<LORA_SCK, LORA_MISO, LORA_MOSI, LORA_SS, LORA_RST, LORA_DIO0>, LongRangeRadio>>;
+BridgeLoRa loraManager;
 PowerManager powerManager;
 #ifdef LED_PIN
 LEDManager ledManager(LED_PIN);
@@ -35,51 +63,231 @@ LEDManager ledManager(LED_PIN);
 
 // Message queues using FreeRTOS
 const int BLE_TO_LORA_QUEUE_SIZE = 10;
-const int LORA_TO_BLE_QUEUE_SIZE = 15;
 
 QueueHandle_t bleToLoraQueue;
-QueueHandle_t loraToBleQueue;
 
-// Struct for LoRa packets with metadata
-struct LoRaPacket
-{
-    uint8_t buffer[256];
-    int len;
-    int rssi;
-    float snr;
-};
+// Frames for the app, bridge task -> forwarding task. ACKs get their own lane:
+// they overtake stored texts and are coalesced, texts go on to frameStore.
+const size_t LORA_TO_BLE_LANE_SIZE = 16;
+const size_t LORA_TO_BLE_ACK_LANE = 0;
+const size_t LORA_TO_BLE_TEXT_LANE = 1;
+SpscLanes<WireFrame, LORA_TO_BLE_LANE_SIZE, 2> loraToBle;
 
-QueueHandle_t loRaQueue;
+// Received LoRa packets, variable-length records filled by the LoRaManager radio task
+LoRaPacketRing loRaRing(LORA_RX_RING_BYTES);
 
 // BLEManager declared after queues
 BLEManager *bleManager;
 
-// Message buffer for when BLE is disconnected (SINGLE GLOBAL INSTANCE)
-MessageBuffer messageBuffer;
+// Frames for the app, kept on flash while BLE is disconnected (owned by the forwarding task)
+LittleFsFrameStorage frameStorage;
+FrameStore frameStore(&frameStorage);
+
+// Wake-up sources for the bridge and forwarding tasks, see BridgeEvents.h
+EventGroupHandle_t bridgeEvents;
+
+// Longest idle wait - bounded so every task still feeds the 30 s task watchdog
+const TickType_t IDLE_WAIT_TICKS = pdMS_TO_TICKS(10000);
+
+// Task layout. NimBLE host and controller run on core 0; the radio task and the
+// bridge task (RX processing, ACKs, BLE->LoRa dispatch) get core 1 to themselves,
+// so a slow BLE flush or an LED blink can never delay an ACK going out on air.
+#if CONFIG_FREERTOS_UNICORE
+const BaseType_t APP_CORE = 0;
+#else
+const BaseType_t APP_CORE = 1;
+#endif
+const BaseType_t BLE_CORE = 0;
+
+const UBaseType_t BRIDGE_TASK_PRIORITY = 5;
+const UBaseType_t FORWARDING_TASK_PRIORITY = 3;
+const UBaseType_t INDICATOR_TASK_PRIORITY = tskIDLE_PRIORITY + 1;
+const UBaseType_t LOG_TASK_PRIORITY = tskIDLE_PRIORITY + 1;
+const uint32_t BRIDGE_TASK_STACK_SIZE = 4096;
+const uint32_t FORWARDING_TASK_STACK_SIZE = 4096;
+const uint32_t LOG_TASK_STACK_SIZE = 3072;
+
+// Formats and prints the event log, see EventLog.h
+TaskHandle_t logTaskHandle = nullptr;
 
-// Flag for LoRa activity (set in ISR, checked in loop)
-volatile bool loraActivity = false;
+// Delay after a BLE connect before the buffered messages are flushed
+const unsigned long BUFFER_FLUSH_DELAY_MS = 2000;
+
+// Retry delay when NimBLE refuses a notification while none is pending
+const uint32_t BLE_NOTIFY_RETRY_MS = 20;
+
+// Interval of link statistics notifications while the app is subscribed to them
+const uint32_t STATS_NOTIFY_INTERVAL_MS = 30000;
+
+// Interval of the power accounting log lines (residency, hold times, charge per message)
+const uint32_t POWER_REPORT_INTERVAL_MS = 300000;
+
+// Link quality and data-rate negotiation with the peer bridge (declared before
+// txScheduler, whose constructor already asks for airtimes)
+AdrController adr;
+
+// Relay mode puts a relay header in front of every packet we send
+const size_t LORA_RELAY_OVERHEAD = LORA_RELAY_ENABLED ? RELAY_HEADER_SIZE : 0;
+
+static_assert(LORA_AGGREGATE_MAX_BYTES + LORA_RELAY_OVERHEAD <= MAX_AGGREGATE_SIZE,
+              "a full aggregate and its relay header must fit one packet");
+static_assert(LORA_NODE_ID >= 0 && LORA_NODE_ID <= 255 && LORA_RELAY_PEER >= -1 && LORA_RELAY_PEER <= 255,
+              "relay origin ids are one byte");
 
 /**
- * @brief LoRa receive callback - handles incoming LoRa packets event-driven (ISR)
+ * @brief Time on air of one of our packets at the current data rate (relay header included)
  */
-void IRAM_ATTR onLoRaReceive(int packetSize)
+uint32_t loraAirtimeMs(size_t len)
 {
-    if (packetSize == 0)
-        return;
+    return adr_time_on_air_ms(len + LORA_RELAY_OVERHEAD, adr.rate());
+}
+
+// Outbound LoRa frames collected by the bridge task. Held while the radio is
+// busy or the duty-cycle budget is used up, and sent as one aggregate frame
+// (or bare, if only one) once both allow it - selective ACKs first.
+// Fragments of a long message may fill a packet up to LORA_FRAGMENT_MAX_AIRTIME_MS.
+TxScheduler txScheduler(loraAirtimeMs, LORA_DUTY_CYCLE_WINDOW_MS, LORA_DUTY_CYCLE_PERMILLE, LORA_AGGREGATE_MAX_BYTES,
+                        MAX_AGGREGATE_SIZE - LORA_RELAY_OVERHEAD, LORA_FRAGMENT_MAX_AIRTIME_MS);
+
+static_assert(lora_config_time_on_air_ms(LORA_AGGREGATE_MAX_BYTES + LORA_RELAY_OVERHEAD) +
+                      lora_config_time_on_air_ms(3 + LORA_RELAY_OVERHEAD) <=
+                  LORA_DUTY_CYCLE_BUDGET_MS,
+              "a full aggregate plus the ACK reserve must fit the duty-cycle budget");
+static_assert(LORA_FRAGMENT_MAX_AIRTIME_MS + lora_config_time_on_air_ms(3 + LORA_RELAY_OVERHEAD) <=
+                  LORA_DUTY_CYCLE_BUDGET_MS,
+              "a full packet of fragments plus the ACK reserve must fit the duty-cycle budget");
+
+// Link ARQ between the bridges. Texts from the app stay in arqSender until the
+// peer acknowledges them; received texts are recorded in arqReceiver and
+// acknowledged with one selective ACK per outbound packet.
+ArqSender arqSender;
+ArqReceiver arqReceiver;
+bool selectiveAckPending = false;
+
+// Delta GPS coding on the link: texts from the app are re-encoded against the
+// position the peer acknowledged last, received ones are expanded again before
+// they reach the app. One peer bridge, so one reference each way.
+GpsDeltaEncoder gpsEncoder;
+GpsDeltaDecoder gpsDecoder;
+
+#if LORA_RELAY_ENABLED
+/**
+ * @brief Time on air of a packet to rebroadcast (its relay header is already in place)
+ */
+uint32_t relayAirtimeMs(size_t len)
+{
+    return adr_time_on_air_ms(len, adr.rate());
+}
+
+// Managed flooding: our packets go out behind a relay header, relayed ones
+// heard for the first time are rebroadcast after an SNR-weighted backoff.
+// Rebroadcasts share our duty-cycle budget.
+RelayRouter relayRouter(relayAirtimeMs, LORA_RELAY_TTL);
+uint8_t relayBuf[MAX_AGGREGATE_SIZE];
+#endif
+
+// Texts already delivered to the app. A retransmission (the peer missed our
+// selective ACK) is only acknowledged again, never delivered twice.
+DedupCache rxDedup;
+
+// Long messages from the peer: fragments are acknowledged as they arrive, the
+// app gets them once all of them are here (in order, after any retransmission)
+FragmentReassembler rxFragments;
+
+// Peer turnaround on top of the airtime: its own pending packet and the debugger's ACK delay
+const uint32_t ARQ_ACK_TURNAROUND_MS = 1000;
+
+// Completed LoRa transmissions reported by the radio task (true = TxDone), drained by the bridge task
+const int LORA_TX_RESULT_QUEUE_SIZE = 8;
+QueueHandle_t loraTxResultQueue;
+
+void bridgeTask(void *param);
+void forwardingTask(void *param);
+void logTask(void *param);
 
-    LoRaPacket packet;
-    packet.len = LoRa.readBytes(packet.buffer, sizeof(packet.buffer));
-    packet.rssi = LoRa.packetRssi();
-    packet.snr = LoRa.packetSnr();
+/**
+ * @brief Called by whichever task recorded the first event into an empty log
+ */
+void onLogEvent()
+{
+    xTaskNotifyGive(logTaskHandle);
+}
+
+/**
+ * @brief Called from the LoRa radio task with the first bytes of a received packet
+ *
+ * Rejects what processLoRaPacket() would discard anyway, so such packets are
+ * never read further or wake the bridge task: unknown types, relay headers
+ * outside relay mode, our own packets relayed back, and last-hop packets of
+ * origins we neither deliver nor relay.
+ */
+bool acceptLoRaPacket(const uint8_t *header, size_t headerLen, size_t packetLen)
+{
+    static_assert(BridgeLoRa::RX_HEADER_BYTES >= RELAY_HEADER_SIZE, "the filter needs the whole relay header");
 
-    if (packet.len > 0)
+    switch (static_cast<MessageType>(header[0]))
     {
-        BaseType_t xHigherPriorityTaskWoken = pdFALSE;
-        xQueueSendFromISR(loRaQueue, &packet, &xHigherPriorityTaskWoken);
-        loraActivity = true; // Wake up main loop
-        portYIELD_FROM_ISR(xHigherPriorityTaskWoken);
+    case MessageType::Text:
+    case MessageType::Ack:
+    case MessageType::Aggregate:
+    case MessageType::SelectiveAck:
+    case MessageType::DataRate:
+    case MessageType::Fragment:
+        return true;
+
+    case MessageType::Relay:
+#if LORA_RELAY_ENABLED
+        if (headerLen < RELAY_HEADER_SIZE || packetLen <= RELAY_HEADER_SIZE)
+        {
+            return false;
+        }
+        return header[1] != relayRouter.nodeId() && (header[2] > 0 || header[1] == LORA_RELAY_PEER);
+#else
+        return false;
+#endif
     }
+    return false;
+}
+
+/**
+ * @brief Writes a link statistics snapshot for the BLE stats characteristic
+ *
+ * Called from the NimBLE host task (reads) and the forwarding task (notifications).
+ * The radio driver's own drop counters are copied in first.
+ */
+size_t fillLinkStats(uint8_t *out, size_t len)
+{
+    linkStats.set(LinkCounter::RxRingFull, loraManager.getRxDropped());
+    linkStats.set(LinkCounter::RxCrcError, loraManager.getRxCrcErrors());
+    linkStats.set(LinkCounter::RxFiltered, loraManager.getRxFiltered());
+    return linkStats.serialize(out, len, millis() / 1000);
+}
+
+/**
+ * @brief Called from the LoRa radio task after a received packet was queued
+ */
+void onLoRaPacketQueued()
+{
+    xEventGroupSetBits(bridgeEvents, BRIDGE_EVENT_LORA_RX); // Wake up the bridge task
+}
+
+/**
+ * @brief Called from the LoRa radio task right before a frame goes on air
+ */
+void onLoRaTxStart()
+{
+    // High-power locks are held only while the radio is actually transmitting
+    powerManager.acquireForLoRaTx();
+}
+
+/**
+ * @brief Called from the LoRa radio task once a frame is sent (radio already back in RX)
+ */
+void onLoRaTxDone(bool success)
+{
+    powerManager.releaseAfterLoRaTx();
+    xQueueSend(loraTxResultQueue, &success, 0);
+    xEventGroupSetBits(bridgeEvents, BRIDGE_EVENT_LORA_TX_DONE);
 }
 
 /**
@@ -133,19 +341,31 @@ void setup()
         .timeout_ms = 30000, // 30 seconds
         .trigger_panic = true,
     };
-    esp_task_wdt_init(&wdt_config);
-    esp_task_wdt_add(xTaskGetCurrentTaskHandle());
+    esp_task_wdt_init(&wdt_config); // Each bridging task subscribes itself
 
     Serial.println("===================================");
     Serial.println("ESP32 LoRa-BLE Bridge starting...");
     Serial.println("===================================");
 
+    // Event log output shares the UART with setup's prints, at the lowest priority
+    if (xTaskCreatePinnedToCore(logTask, "log", LOG_TASK_STACK_SIZE, nullptr, LOG_TASK_PRIORITY,
+                                &logTaskHandle, BLE_CORE) == pdPASS)
+    {
+        eventLog.setWakeCallback(onLogEvent);
+    }
+    else
+    {
+        Serial.println("Log task failed to start, runtime events are not printed");
+    }
+
     // Create message queues
-    bleToLoraQueue = xQueueCreate(BLE_TO_LORA_QUEUE_SIZE, sizeof(Message));
-    loraToBleQueue = xQueueCreate(LORA_TO_BLE_QUEUE_SIZE, sizeof(Message));
-    loRaQueue = xQueueCreate(15, sizeof(LoRaPacket));
+    bleToLoraQueue = xQueueCreate(BLE_TO_LORA_QUEUE_SIZE, sizeof(WireFrame));
+    loraTxResultQueue = xQueueCreate(LORA_TX_RESULT_QUEUE_SIZE, sizeof(bool));
+    bridgeEvents = xEventGroupCreate();
+    bool loRaRingReady = loRaRing.begin();
 
-    if (bleToLoraQueue == nullptr || loraToBleQueue == nullptr || loRaQueue == nullptr)
+    if (bleToLoraQueue == nullptr || loraTxResultQueue == nullptr ||
+        bridgeEvents == nullptr || !loRaRingReady)
     {
         Serial.println("Failed to create message queues. Halting execution.");
         while (1)
@@ -154,8 +374,22 @@ void setup()
         }
     }
 
+    // Messages stored for the app before a reset are delivered first
+    if (frameStorage.begin())
+    {
+        Serial.print("Message store: ");
+        Serial.print(frameStore.begin());
+        Serial.println(" messages recovered from flash");
+    }
+    else
+    {
+        Serial.println("LittleFS mount failed, messages for the app are buffered in RAM only");
+    }
+
     // Initialize BLE with queue
     bleManager = new BLEManager(bleToLoraQueue);
+    bleManager->setEventGroup(bridgeEvents);
+    bleManager->setStatsSource(fillLinkStats);
 
     // Initialize BLE with retry logic
     const int BLE_RETRY_COUNT = 3;
@@ -199,7 +433,14 @@ void setup()
 
     // Initialize LoRa
     Serial.println("\nInitializing LoRa radio...");
-    Serial.println(loraManager.getConfigurationString());
+    loraManager.printConfiguration(Serial);
+    Serial.print("Duty-cycle capacity per window: ");
+    Serial.print(lora_config_packets_per_window(MAX_FRAME_SIZE));
+    Serial.print(" full texts (");
+    Serial.print(lora_config_time_on_air_ms(MAX_FRAME_SIZE));
+    Serial.print(" ms each) or ");
+    Serial.print(lora_config_packets_per_window(3));
+    Serial.println(" selective ACKs");
 
     const int LORA_RETRY_COUNT = 3;
     int loraRetries = LORA_RETRY_COUNT;
@@ -238,13 +479,53 @@ void setup()
         }
     }
 
-    // Set up event-driven LoRa reception (CRITICAL: Always listening)
-    LoRa.onReceive(onLoRaReceive);
+#if LORA_RELAY_ENABLED
+    // A random first packet id, so peers do not take our packets for ones they saw before a reboot
+    uint8_t nodeId = LORA_NODE_ID != 0 ? LORA_NODE_ID : static_cast<uint8_t>(ESP.getEfuseMac() >> 40);
+    relayRouter.begin(nodeId, static_cast<uint8_t>(esp_random()));
+    Serial.print("Relay mode: node id ");
+    Serial.print(nodeId);
+    Serial.print(", TTL ");
+    Serial.print(LORA_RELAY_TTL);
+    if (LORA_RELAY_PEER < 0)
+    {
+        Serial.println(", relay only");
+    }
+    else
+    {
+        Serial.print(", delivering packets of node ");
+        Serial.println(LORA_RELAY_PEER);
+    }
+#endif
 
     // Start continuous receive mode
     loraManager.startReceiveMode();
+    powerManager.setRadioRate(loraManager.getSpreadingFactor(), loraManager.getBandwidth());
+
+    // Set up event-driven LoRa reception and transmission (CRITICAL: Always listening)
+    // DIO0 ISR only notifies the radio task, which owns the SX127x over SPI
+    loraManager.setRxCallback(onLoRaPacketQueued);
+    loraManager.setRxFilter(acceptLoRaPacket);
+    loraManager.setTxStartCallback(onLoRaTxStart);
+    loraManager.setTxDoneCallback(onLoRaTxDone);
+#if LORA_RX_SNIFF_MS > 0
+    // Battery mode: the radio sleeps between CADs instead of drawing RX current all the time
+    loraManager.enableRxSniffing();
+    Serial.print("LoRa RX sniffing every ");
+    Serial.print(LORA_RX_SNIFF_MS);
+    Serial.println(" ms");
+#endif
+    if (!loraManager.startRadioTask(&loRaRing, BridgeLoRa::RADIO_TASK_PRIORITY, APP_CORE))
+    {
+        Serial.println("LoRa radio task failed to start. Halting execution.");
+        while (1)
+        {
+            delay(1000);
+        }
+    }
 
     // Configure GPIO wake-up for LoRa interrupt (allows wake from light sleep)
+    // DIO0 carries RxDone, TxDone and CadDone, so sniffing and listen-before-talk wake the CPU too
     gpio_wakeup_enable((gpio_num_t)LORA_DIO0, GPIO_INTR_HIGH_LEVEL);
     esp_sleep_enable_gpio_wakeup();
     Serial.println("GPIO wake-up enabled for LoRa DIO0 - can wake from light sleep");
@@ -252,185 +533,585 @@ void setup()
     // Initialize LED
 #ifdef LED_PIN
     ledManager.setup();
+    if (!ledManager.startTask(INDICATOR_TASK_PRIORITY, BLE_CORE))
+    {
+        Serial.println("LED indicator task failed to start, blinking inline");
+    }
 #endif
 
+    if (xTaskCreatePinnedToCore(bridgeTask, "bridge", BRIDGE_TASK_STACK_SIZE, nullptr,
+                                BRIDGE_TASK_PRIORITY, nullptr, APP_CORE) != pdPASS ||
+        xTaskCreatePinnedToCore(forwardingTask, "ble_forward", FORWARDING_TASK_STACK_SIZE, nullptr,
+                                FORWARDING_TASK_PRIORITY, nullptr, BLE_CORE) != pdPASS)
+    {
+        Serial.println("Failed to create bridge tasks. Halting execution.");
+        while (1)
+        {
+            delay(1000);
+        }
+    }
+
     Serial.println("\n===================================");
     Serial.println("All systems initialized successfully");
     Serial.println("System running - waiting for connections...");
     Serial.println("===================================\n");
 }
 
+/**
+ * @brief Send the oldest buffered frames to the app in one notification
+ *
+ * As many frames as fit the connection's notification size go out as one
+ * aggregate container (a lone frame as-is), the app splits it again.
+ * Pending ACKs come first, then the stored texts. Frames stay queued until
+ * NimBLE has accepted the notification.
+ * @return Number of frames sent, 0 if the notification could not be queued
+ */
+int notifyBufferedFrames()
+{
+    uint8_t container[MAX_AGGREGATE_SIZE];
+    AggregateBuilder batch(container, bleManager->maxNotifySize());
+    SpscRing<WireFrame, LORA_TO_BLE_LANE_SIZE> &ackLane = loraToBle.lane(LORA_TO_BLE_ACK_LANE);
+    WireFrame frame;
+    bool room = true;
+    size_t acks = 0;
+    while (room && ackLane.peek(acks, frame))
+    {
+        room = batch.add(frame.data, frame.len);
+        acks += room;
+    }
+    size_t texts = 0;
+    while (room && frameStore.peek(texts, frame))
+    {
+        room = batch.add(frame.data, frame.len);
+        texts += room;
+    }
+
+    const uint8_t *data;
+    size_t len;
+    if (acks + texts > 0)
+    {
+        len = batch.finish(data);
+    }
+    else
+    {
+        // Larger than the notification size (client kept the default MTU): sent on its own.
+        // Never an ACK, 2 bytes always fit. The store can still turn out empty
+        // when the rest of its flash records were damaged: nothing to send.
+        if (!frameStore.peek(0, frame))
+        {
+            return 0;
+        }
+        data = frame.data;
+        len = frame.len;
+        texts = 1;
+    }
+
+    if (!bleManager->sendFrame(data, len))
+    {
+        return 0;
+    }
+    ackLane.drop(acks);
+    frameStore.drop(texts, millis());
+    return acks + texts;
+}
+
+/**
+ * @brief True if two ACKs for the app acknowledge the same seq (the older one is redundant)
+ */
+bool sameAppAck(const WireFrame &older, const WireFrame &newer)
+{
+    return older.len == newer.len && older.data[1] == newer.data[1];
+}
+
 /**
  * @brief Handle LoRa to BLE message forwarding and buffering
+ *
+ * Every text passes through frameStore, so texts stored while
+ * disconnected stay ahead of live ones and both are batched into as few
+ * notifications as the MTU allows. Texts delivered soon after they arrive
+ * never reach flash. ACKs wait in their lane (RAM only, duplicates coalesced)
+ * and go out ahead of the texts. Pacing comes from NimBLE: a completed
+ * notification wakes this task again (BRIDGE_EVENT_BLE_TX), frames wait
+ * while MAX_NOTIFY_IN_FLIGHT notifications are pending.
+ * @return Ticks until this needs to run again without a new event (flush delay, flash write), or portMAX_DELAY
  */
-void handleLoRaToBleForwarding()
+TickType_t handleLoRaToBleForwarding()
 {
-    // Send buffered messages if BLE just connected
+    TickType_t nextRun = portMAX_DELAY;
+    bool connected = bleManager->isConnected();
+
+    // Give the app time to enable notifications after a connect
     static bool justConnected = false;
     static unsigned long connectTime = 0;
-    if (bleManager->isConnected() && !messageBuffer.isEmpty())
+    if (!connected)
     {
-        if (!justConnected)
+        justConnected = false;
+    }
+    else if (!justConnected)
+    {
+        justConnected = true;
+        connectTime = millis();
+        if (!frameStore.isEmpty() || !loraToBle.empty())
         {
-            // First time BLE is connected since last disconnect
-            justConnected = true;
-            connectTime = millis();
-            Serial.println("BLE connected - waiting before sending buffered messages...");
+            LOG_INFO(BleFlushWait);
         }
-        // Wait at least 2s after connection before sending buffered messages
-        if (millis() - connectTime < 2000)
+    }
+    unsigned long sinceConnect = millis() - connectTime;
+    bool flushAllowed = connected && sinceConnect >= BUFFER_FLUSH_DELAY_MS;
+
+    SpscRing<WireFrame, LORA_TO_BLE_LANE_SIZE> &ackLane = loraToBle.lane(LORA_TO_BLE_ACK_LANE);
+    int sentFrames = 0;
+    int notifications = 0;
+    for (;;)
+    {
+        WireFrame loraFrame;
+        while (loraToBle.lane(LORA_TO_BLE_TEXT_LANE).pop(loraFrame))
         {
-            return;
+            frameStore.add(loraFrame, millis());
+            if (!connected)
+            {
+                // Start advertising to allow Android to reconnect
+                LOG_INFO(BleBuffered, frameStore.count());
+                bleManager->startAdvertising();
+            }
         }
-        Serial.print("BLE connected - sending ");
-        Serial.print(messageBuffer.getCount());
-        Serial.println(" buffered messages");
+        ackLane.coalesce(sameAppAck);
 
-        Message bufferedMsg;
-        while (messageBuffer.get(bufferedMsg))
+        if (!flushAllowed || (frameStore.isEmpty() && ackLane.empty()) || !bleManager->canNotify())
         {
-            if (bleManager->sendMessage(bufferedMsg))
-            {
-                Serial.println("Buffered message sent successfully");
+            break;
+        }
+        PowerLockGuard flushPower(powerManager, PowerReason::BleFlush);
+        int sent = notifyBufferedFrames();
+        if (sent == 0)
+        {
+            break;
+        }
+        sentFrames += sent;
+        notifications++;
+    }
+
+    if (notifications > 0)
+    {
+        LOG_INFO(BleForwarded, sentFrames, notifications);
 #ifdef LED_PIN
-                ledManager.blink();
+        ledManager.blink();
 #endif
-                delay(20); // Small delay between messages to avoid overwhelming BLE
-            }
-            else
-            {
-                Serial.println("Failed to send buffered message");
-                break; // Stop if send fails
-            }
+    }
+
+    uint32_t dropped = frameStore.takeDropped();
+    if (dropped > 0)
+    {
+        LOG_WARN(StoreDropped, dropped);
+        STATS_COUNT(StoreDropped, dropped);
+    }
+
+    if (connected && (!frameStore.isEmpty() || !ackLane.empty()))
+    {
+        if (!flushAllowed)
+        {
+            nextRun = pdMS_TO_TICKS(BUFFER_FLUSH_DELAY_MS - sinceConnect) + 1;
+        }
+        else if (!bleManager->hasNotifyInFlight())
+        {
+            // NimBLE refused without anything pending, no completion will wake us
+            nextRun = pdMS_TO_TICKS(BLE_NOTIFY_RETRY_MS) + 1;
         }
     }
-    else if (!bleManager->isConnected())
+
+    // Batched flash write of new frames and delivery progress
+    uint32_t syncMs = frameStore.service(millis());
+    if (syncMs != UINT32_MAX)
     {
-        // Reset justConnected flag when disconnected
-        justConnected = false;
+        nextRun = min(nextRun, pdMS_TO_TICKS(syncMs) + 1);
+    }
+
+    return nextRun;
+}
+
+/**
+ * @brief Hand a received frame to the forwarding task (delivered or buffered there)
+ *
+ * Never blocks the bridge task. The forwarding task owns frameStore.
+ */
+void forwardToBle(const WireFrame &frame)
+{
+    bool isAck = frame.data[0] == static_cast<uint8_t>(MessageType::Ack);
+    if (!loraToBle.push(isAck ? LORA_TO_BLE_ACK_LANE : LORA_TO_BLE_TEXT_LANE, frame))
+    {
+        LOG_WARN(LoRaToBleQueueFull);
+        STATS_COUNT(AppQueueFull);
+        return;
     }
+    xEventGroupSetBits(bridgeEvents, BRIDGE_EVENT_BLE_TX);
+}
+
+/**
+ * @brief Shortest retransmission timeout for a text of len bytes
+ *
+ * The frame and the selective ACK on air plus the peer's turnaround.
+ * Measured RTTs only ever raise it.
+ */
+uint32_t arqMinRtoMs(size_t len)
+{
+    return loraAirtimeMs(len) + loraAirtimeMs(3) + ARQ_ACK_TURNAROUND_MS;
+}
 
-    // Process live queue messages
-    Message loraMsg;
-    if (xQueueReceive(loraToBleQueue, &loraMsg, 0) == pdTRUE)
+/**
+ * @brief Move the radio to one of the ADR_RATES (after any frames already handed to it)
+ */
+void switchDataRate(uint8_t rate)
+{
+    const LoRaRate &target = ADR_RATES[rate];
+    LOG_INFO(AdrSwitch, rate, target.spreadingFactor, target.bandwidthHz);
+
+    loraManager.setDataRate(target.spreadingFactor, target.bandwidthHz);
+    powerManager.setRadioRate(target.spreadingFactor, target.bandwidthHz);
+    adr.switched(rate, millis());
+}
+
+/**
+ * @brief Update link state for a frame of a packet that was just handed to the radio
+ *
+ * Text or fragment: its ARQ timer starts now. DataRate Accept: we switch once it is on air.
+ */
+void onFrameQueued(const uint8_t *frame, uint32_t nowMs)
+{
+    if (frame[0] == static_cast<uint8_t>(MessageType::Text) || frame[0] == static_cast<uint8_t>(MessageType::Fragment))
+    {
+        arqSender.transmitted(frame[1], nowMs);
+    }
+    else if (frame[0] == static_cast<uint8_t>(MessageType::DataRate) &&
+             frame[1] == static_cast<uint8_t>(DataRateOp::Accept) && frame[2] != adr.rate())
     {
-        if (bleManager->isConnected())
+        switchDataRate(frame[2]);
+    }
+}
+
+/**
+ * @brief Run onFrameQueued() for every frame of a packet
+ */
+void onPacketQueued(const uint8_t *packet, size_t len, uint32_t nowMs)
+{
+    if (packet[0] != static_cast<uint8_t>(MessageType::Aggregate))
+    {
+        onFrameQueued(packet, nowMs);
+        return;
+    }
+
+    AggregateReader reader(packet, len);
+    const uint8_t *frame;
+    size_t frameLen;
+    while (reader.next(frame, frameLen))
+    {
+        onFrameQueued(frame, nowMs);
+    }
+}
+
+/**
+ * @brief Hand the next scheduled packet to the radio task
+ * @return Milliseconds until the duty cycle allows the next packet (0 after a send), UINT32_MAX if nothing is queued
+ */
+uint32_t flushOutbound()
+{
+    static bool deferred = false;
+    uint32_t now = millis();
+    const uint8_t *packet;
+    uint32_t waitMs;
+    size_t len = txScheduler.next(now, packet, waitMs);
+    if (len == 0)
+    {
+        if (waitMs != UINT32_MAX && !deferred)
         {
-            if (bleManager->sendMessage(loraMsg))
-            {
-                Serial.println("Message forwarded from LoRa to BLE");
-#ifdef LED_PIN
-                ledManager.blink();
+            // Reported once per deferral, the bridge task sleeps until the budget frees up
+            deferred = true;
+            LOG_INFO(DutyCycleDeferred, txScheduler.dutyCycle().usedMs(now), txScheduler.dutyCycle().budgetMs(), waitMs);
+        }
+        return waitMs;
+    }
+    deferred = false;
+
+    LOG_INFO(TxQueued, packet[0] == static_cast<uint8_t>(MessageType::Aggregate) ? packet[1] : 1, len, loraAirtimeMs(len));
+
+    // Radio task sends it and returns to RX on its own
+    const uint8_t *onAir = packet;
+    size_t onAirLen = len;
+#if LORA_RELAY_ENABLED
+    onAirLen = relayRouter.wrap(packet, len, relayBuf);
+    onAir = relayBuf;
 #endif
-            }
+    if (!loraManager.queuePacket(onAir, onAirLen))
+    {
+        LOG_WARN(TxQueueFull);
+        STATS_COUNT(TxQueueFull);
+        return 0;
+    }
+    onPacketQueued(packet, len, now);
+    return 0;
+}
+
+#if LORA_RELAY_ENABLED
+/**
+ * @brief Hand the next due rebroadcast to the radio task
+ *
+ * A rebroadcast that does not fit the duty-cycle budget now (one ACK of ours
+ * kept in reserve) is dropped, not held: other relays cover it, and a late
+ * copy only costs airtime.
+ * @return Milliseconds until the next rebroadcast is due (0 after a send), UINT32_MAX if none waits
+ */
+uint32_t flushRelay()
+{
+    uint32_t now = millis();
+    const uint8_t *packet;
+    uint32_t waitMs;
+    size_t len;
+    while ((len = relayRouter.next(now, packet, waitMs)) > 0)
+    {
+        uint32_t airtimeMs = relayAirtimeMs(len);
+        if (txScheduler.dutyCycle().waitMs(now, airtimeMs + loraAirtimeMs(3)) != 0)
+        {
+            LOG_WARN(RelayDutyCycle, packet[1], packet[3]);
+            continue;
         }
-        else
+
+        LOG_INFO(RelayTx, packet[1], packet[3], packet[2]);
+        if (!loraManager.queuePacket(packet, len))
         {
-            // Buffer message for later delivery
-            messageBuffer.add(loraMsg);
-            Serial.print("Buffered message (total: ");
-            Serial.print(messageBuffer.getCount());
-            Serial.println(")");
+            LOG_WARN(TxQueueFull);
+            STATS_COUNT(TxQueueFull);
+            return 0;
         }
+        txScheduler.dutyCycle().record(now, airtimeMs);
+        return 0;
     }
+    return waitMs;
 }
+#endif
 
 /**
- * @brief Process received LoRa packet
+ * @brief Add a text or retransmission for LoRa transmission
  */
-void processLoRaPacket(const LoRaPacket &packet)
+void queueForLoRa(const uint8_t *data, size_t len)
+{
+    if (!txScheduler.queueData(data, len))
+    {
+        LOG_WARN(FrameRejected);
+    }
+}
+
+/**
+ * @brief Add the selective ACK for every text received since the last one
+ *
+ * Called right before a flush, so a burst of texts costs a single 3-byte ACK.
+ */
+void queueSelectiveAck()
 {
-    bleManager->updateActivity();
+    if (!selectiveAckPending)
+    {
+        return;
+    }
+    selectiveAckPending = false;
+
+    SelectiveAckMessage state = arqReceiver.ack();
+    uint8_t ackBuf[3];
+    int ackLen = Message::createSelectiveAck(state.cumulative, state.bitmap).serialize(ackBuf, sizeof(ackBuf));
+    if (ackLen > 0)
+    {
+        LOG_INFO(SelectiveAckTx, state.cumulative, state.bitmap);
+        if (!txScheduler.queuePriority(ackBuf, ackLen))
+        {
+            LOG_WARN(SelectiveAckRejected);
+        }
+    }
+}
+
+/**
+ * @brief Queue a DataRate Request/Accept for the peer bridge, ahead of any text
+ */
+void queueDataRate(DataRateOp op, uint8_t rate)
+{
+    uint8_t buf[3];
+    int len = Message::createDataRate(op, rate).serialize(buf, sizeof(buf));
+    if (len <= 0 || !txScheduler.queuePriority(buf, len))
+    {
+        LOG_WARN(DataRateRejected);
+    }
+}
 
-    // If not connected, start advertising to allow Android to reconnect
-    if (!bleManager->isConnected())
+/**
+ * @brief Propose a better data rate, or fall back to rate 0 after a silent link
+ */
+void serviceAdr()
+{
+    uint8_t rate;
+    switch (adr.poll(millis(), rate))
     {
-        Serial.println("LoRa message received but no BLE connection - starting advertising");
-        bleManager->startAdvertising();
+    case AdrController::Event::Propose:
+        LOG_INFO(AdrPropose, rate, lroundf(adr.smoothedSnr()), lroundf(adr.smoothedRssi()));
+        queueDataRate(DataRateOp::Request, rate);
+        break;
+
+    case AdrController::Event::Fallback:
+        LOG_INFO(AdrFallback);
+        switchDataRate(rate);
+        break;
+
+    case AdrController::Event::None:
+        break;
     }
+}
 
-    Serial.print("LoRa RX: ");
-    Serial.print(packet.len);
-    Serial.print(" bytes, RSSI: ");
-    Serial.print(packet.rssi);
-    Serial.print(" dBm, SNR: ");
-    Serial.print(packet.snr);
-    Serial.println(" dB");
+/**
+ * @brief Retransmit the texts whose ACK is overdue, drop those out of attempts
+ */
+void serviceArq()
+{
+    const WireFrame *frame;
+    ArqSender::Event event;
+    while ((event = arqSender.poll(millis(), frame)) != ArqSender::Event::None)
+    {
+        if (event == ArqSender::Event::Retransmit)
+        {
+            LOG_INFO(ArqRetransmit, frame->data[1], arqSender.smoothedRtt());
+            STATS_COUNT(ArqRetransmit);
+            queueForLoRa(frame->data, frame->len);
+        }
+        else
+        {
+            LOG_WARN(ArqGaveUp, frame->data[1]);
+            STATS_COUNT(ArqGaveUp);
+            gpsEncoder.dropped(frame->data[1]);
+        }
+    }
+}
 
-    // Deserialize message
-    Message msg;
-    if (!msg.deserialize(packet.buffer, packet.len))
+/**
+ * @brief Ticks until the bridge task has timed work, at most IDLE_WAIT_TICKS
+ *
+ * The next ARQ timeout, or the duty-cycle wait. While texts are still queued
+ * for TX their timers have not started yet, so only the duty cycle counts.
+ * @param txWaitMs Wait reported by flushOutbound(), UINT32_MAX if none
+ */
+TickType_t bridgeWaitTicks(uint32_t txWaitMs)
+{
+    uint32_t waitMs = txWaitMs;
+    if (!txScheduler.hasData())
+    {
+        uint32_t arqWaitMs = arqSender.nextTimeout(millis());
+        waitMs = arqWaitMs < waitMs ? arqWaitMs : waitMs;
+    }
+    if (waitMs >= pdTICKS_TO_MS(IDLE_WAIT_TICKS))
     {
-        Serial.println("Failed to deserialize LoRa message");
+        return IDLE_WAIT_TICKS;
+    }
+    return pdMS_TO_TICKS(waitMs) + 1;
+}
+
+/**
+ * @brief Process a single non-aggregate frame received over LoRa
+ *
+ * The frame is validated from its header and forwarded to BLE as-is.
+ * Only the type and sequence bytes are needed to update the ARQ state.
+ * @param sender Relay origin of the packet, DEDUP_LINK_PEER if it came without a relay header
+ */
+void processLoRaFrame(const uint8_t *data, size_t len, uint16_t sender)
+{
+    // Copy into a wire frame (any bytes beyond the largest message are padding)
+    WireFrame frame;
+    frame.len = min(len, MAX_FRAME_SIZE);
+    memcpy(frame.data, data, frame.len);
+
+    if (!Message::isValidFrame(frame.data, frame.len))
+    {
+        LOG_WARN(InvalidFrame);
+        STATS_COUNT(RxInvalid);
         return;
     }
 
-    Serial.print("Deserialized: type=");
-    Serial.println((int)msg.type);
+    MessageType type = static_cast<MessageType>(frame.data[0]);
+    uint8_t seq = frame.data[1];
 
     // Handle message types
-    switch (msg.type)
+    switch (type)
     {
     case MessageType::Text:
     {
-        Serial.print("Text - seq: ");
-        Serial.print(msg.textData.seq);
-        Serial.print(", text: \"");
-        Serial.print(msg.textData.text);
-        Serial.print("\"");
-
-        if (msg.textData.hasGps)
+        // Checked on the coded frame, before the GPS reference moves on
+        if (rxDedup.isDuplicate(sender, frame.data, frame.len, millis()))
         {
-            Serial.print(", GPS: ");
-            Serial.print(msg.textData.lat / 1000000.0, 6);
-            Serial.print("°, ");
-            Serial.print(msg.textData.lon / 1000000.0, 6);
-            Serial.print("°");
+            LOG_INFO(DuplicateText, seq);
+            STATS_COUNT(DuplicateText);
+            arqReceiver.receive(seq, millis());
+            selectiveAckPending = true;
+            break;
         }
-        Serial.println();
 
-        // Send ACK
-        Message ack = Message::createAck(msg.textData.seq);
-        uint8_t ackBuf[64];
-        int ackLen = ack.serialize(ackBuf, sizeof(ackBuf));
+        LOG_INFO(TextRx, seq, frame.data[2] & ~TEXT_COMPRESSED_FLAG, frame.data[3] >> TEXT_GPS_SHIFT);
+        if (frame.data[2] & TEXT_COMPRESSED_FLAG)
+        {
+            LOG_DEBUG(TextHuffman, seq);
+        }
 
-        if (ackLen > 0)
+        // The app only knows absolute coordinates
+        if (!gpsDecoder.decode(frame))
         {
-            Serial.print("Sending ACK for seq: ");
-            Serial.println(msg.textData.seq);
+            LOG_WARN(GpsWithoutKeyframe);
+        }
 
-            // Acquire high-power locks for ACK transmission
-            powerManager.acquireForLoRaTx();
+        // Acknowledged by the next selective ACK, packed with any other pending outbound frames
+        arqReceiver.receive(seq, millis());
+        selectiveAckPending = true;
+        powerManager.countMessage();
 
-            if (loraManager.sendPacket(ackBuf, ackLen))
-            {
-                Serial.println("ACK sent successfully");
-            }
-            else
-            {
-                Serial.println("ACK send failed");
-            }
+        // Queue or buffer message for BLE delivery
+        forwardToBle(frame);
 
-            // Release power locks after transmission
-            powerManager.releaseAfterLoRaTx();
-            loraManager.startReceiveMode();
-        }
+#ifdef LED_PIN
+        ledManager.blink();
+#endif
+        break;
+    }
 
-        // Queue or buffer message for BLE delivery
-        if (bleManager->isConnected())
+    case MessageType::Fragment:
+    {
+        // Acknowledged on arrival like a text, so the peer only retransmits the missing ones
+        arqReceiver.receive(seq, millis());
+        selectiveAckPending = true;
+        if (rxDedup.isDuplicate(sender, frame.data, frame.len, millis()))
         {
-            if (xQueueSend(loraToBleQueue, &msg, 0) != pdTRUE)
-            {
-                Serial.println("Warning: LoRa to BLE queue full, buffering");
-                messageBuffer.add(msg);
-            }
+            LOG_INFO(DuplicateFragment, seq);
+            STATS_COUNT(DuplicateText);
+            break;
         }
-        else
+        LOG_DEBUG(FragmentRx, seq, (frame.data[2] >> FRAGMENT_INDEX_SHIFT) + 1,
+                  (frame.data[2] & FRAGMENT_LAST_MASK) + 1);
+
+        const uint8_t *payload;
+        size_t payloadLen;
+        uint8_t firstSeq;
+        uint8_t count;
+        FragmentReassembler::Result result =
+            rxFragments.add(sender, frame.data, frame.len, millis(), payload, payloadLen, firstSeq, count);
+
+        static uint32_t reportedDropped = 0;
+        if (rxFragments.dropped() != reportedDropped)
         {
-            messageBuffer.add(msg);
-            Serial.print("Buffered text message (total: ");
-            Serial.print(messageBuffer.getCount());
-            Serial.println(")");
+            LOG_WARN(FragmentsDropped, rxFragments.dropped() - reportedDropped);
+            reportedDropped = rxFragments.dropped();
+        }
+        if (result != FragmentReassembler::Result::Complete)
+        {
+            break;
+        }
+
+        // The app gets the whole message at once, its fragments in order
+        LOG_INFO(LongMessageRx, firstSeq, count, payloadLen);
+        powerManager.countMessage();
+        for (uint8_t i = 0; i < count; i++)
+        {
+            WireFrame fragment;
+            fragment.len = fragment_frame(payload, payloadLen, firstSeq, i, fragment.data);
+            forwardToBle(fragment);
         }
 
 #ifdef LED_PIN
@@ -441,126 +1122,385 @@ void processLoRaPacket(const LoRaPacket &packet)
 
     case MessageType::Ack:
     {
-        Serial.print("ACK - seq: ");
-        Serial.println(msg.ackData.seq);
+        LOG_INFO(AckRx, seq);
+        if (arqSender.acknowledge(seq, millis()))
+        {
+            gpsEncoder.acknowledged(seq);
+            powerManager.countMessage();
+        }
 
         // Queue or buffer ACK for BLE delivery
-        if (bleManager->isConnected())
+        forwardToBle(frame);
+
+#ifdef LED_PIN
+        ledManager.blink();
+#endif
+        break;
+    }
+
+    case MessageType::SelectiveAck:
+    {
+        SelectiveAckMessage ack = {frame.data[1], frame.data[2]};
+        LOG_INFO(SelectiveAckRx, ack.cumulative, ack.bitmap);
+
+        // The app only knows plain ACKs: forward one per newly acknowledged text
+        uint8_t acked[ARQ_WINDOW_SIZE];
+        uint8_t count = arqSender.acknowledge(ack, millis(), acked);
+        powerManager.countMessage(count);
+        for (uint8_t i = 0; i < count; i++)
         {
-            if (xQueueSend(loraToBleQueue, &msg, 0) != pdTRUE)
-            {
-                Serial.println("Warning: LoRa to BLE queue full, buffering");
-                messageBuffer.add(msg);
-            }
+            gpsEncoder.acknowledged(acked[i]);
+            WireFrame ackFrame;
+            ackFrame.len = Message::createAck(acked[i]).serialize(ackFrame.data, sizeof(ackFrame.data));
+            forwardToBle(ackFrame);
+        }
+
+#ifdef LED_PIN
+        if (count > 0)
+        {
+            ledManager.blink();
+        }
+#endif
+        break;
+    }
+
+    case MessageType::DataRate:
+    {
+        DataRateOp op = static_cast<DataRateOp>(frame.data[1]);
+        uint8_t rate = frame.data[2];
+        if (op == DataRateOp::Request)
+        {
+            LOG_INFO(DataRateRequestRx, rate);
         }
         else
         {
-            messageBuffer.add(msg);
-            Serial.print("Buffered ACK (total: ");
-            Serial.print(messageBuffer.getCount());
-            Serial.println(")");
+            LOG_INFO(DataRateAcceptRx, rate);
         }
 
-#ifdef LED_PIN
-        ledManager.blink();
-#endif
+        // Link control between the bridges only, never forwarded to the app
+        if (op == DataRateOp::Request)
+        {
+            // Answered at the current rate, the switch follows once the Accept is on air.
+            // Every node of a relay deployment stays at the lora_config.h rate.
+            queueDataRate(DataRateOp::Accept, LORA_RELAY_ENABLED ? adr.rate() : adr.onRequest(rate));
+        }
+        else if (adr.onAccept(rate))
+        {
+            switchDataRate(rate);
+        }
         break;
     }
+
+    case MessageType::Aggregate:
+    case MessageType::Relay:
+        break; // Unpacked by processLoRaPacket, never valid here
     }
 }
 
 /**
- * @brief Main loop - handles BLE<->LoRa message bridging with light sleep for power savings
+ * @brief Process received LoRa packet
+ *
+ * Aggregate frames are split, every inner message is handled - and forwarded
+ * to BLE - on its own, so the Android app only ever sees single messages.
  */
-void loop()
+void processLoRaPacket(const LoRaPacket &packet)
 {
-    // Reset watchdog
-    esp_task_wdt_reset();
+    adr.onPacket(packet.rssi, packet.snr, millis());
 
-    // Process BLE events (non-blocking)
-    bleManager->process();
+    LOG_INFO(LoRaRx, packet.len, packet.rssi, lroundf(packet.snr));
 
-    // Check for messages from BLE to send via LoRa
-    Message bleMsg;
-    if (xQueueReceive(bleToLoraQueue, &bleMsg, 0) == pdTRUE)
+    // Corrupt frames are dropped by the radio task without waking us, report them with the next good one
+    static uint32_t reportedCrcErrors = 0;
+    uint32_t crcErrors = loraManager.getRxCrcErrors();
+    if (crcErrors != reportedCrcErrors)
     {
-        Serial.print("Received from BLE queue: type=");
-        Serial.println((int)bleMsg.type);
+        LOG_WARN(LoRaCrcErrors, crcErrors - reportedCrcErrors);
+        reportedCrcErrors = crcErrors;
+    }
+    static uint32_t reportedFiltered = 0;
+    uint32_t filtered = loraManager.getRxFiltered();
+    if (filtered != reportedFiltered)
+    {
+        LOG_DEBUG(LoRaRxFiltered, filtered - reportedFiltered);
+        reportedFiltered = filtered;
+    }
 
-        // Serialize and send via LoRa
-        uint8_t buf[64];
-        int len = bleMsg.serialize(buf, sizeof(buf));
+    const uint8_t *data = packet.buffer;
+    size_t len = packet.len;
+    uint16_t sender = DEDUP_LINK_PEER;
+#if LORA_RELAY_ENABLED
+    if (len > 0 && data[0] == static_cast<uint8_t>(MessageType::Relay))
+    {
+        RelayHeader header;
+        switch (relayRouter.receive(packet.buffer, packet.len, packet.snr, millis(), header, data, len))
+        {
+        case RelayRouter::Verdict::Deliver:
+            LOG_DEBUG(RelayRx, header.origin, header.packetId, header.ttl);
+            break;
+        case RelayRouter::Verdict::Suppressed:
+            LOG_INFO(RelaySuppressed, header.origin, header.packetId);
+            return;
+        case RelayRouter::Verdict::Duplicate:
+        case RelayRouter::Verdict::Own:
+            LOG_DEBUG(RelayDuplicate, header.origin, header.packetId);
+            return;
+        case RelayRouter::Verdict::Invalid:
+            LOG_WARN(RelayInvalid);
+            STATS_COUNT(RxInvalid);
+            return;
+        }
 
-        if (len > 0)
+        // ARQ, delta GPS and ADR state is kept for one far-end bridge only
+        if (header.origin != LORA_RELAY_PEER)
         {
-            Serial.print("Transmitting ");
-            Serial.print(len);
-            Serial.println(" bytes via LoRa");
+            return;
+        }
+        sender = header.origin;
+    }
+#endif
 
-            // Acquire high-power locks for transmission
-            powerManager.acquireForLoRaTx();
+    if (len > 0 && data[0] == static_cast<uint8_t>(MessageType::Aggregate))
+    {
+        AggregateReader reader(data, len);
+        if (!reader.isValid())
+        {
+            LOG_WARN(InvalidAggregate);
+            STATS_COUNT(RxInvalid);
+            return;
+        }
 
-            bool sendSuccess = loraManager.sendPacket(buf, len);
+        LOG_DEBUG(AggregateRx, reader.count());
 
-            if (!sendSuccess)
-            {
-                Serial.println("LoRa TX failed, retrying once...");
-                delay(100);
-                sendSuccess = loraManager.sendPacket(buf, len);
-            }
+        const uint8_t *frame;
+        size_t frameLen;
+        while (reader.next(frame, frameLen))
+        {
+            processLoRaFrame(frame, frameLen, sender);
+        }
+        return;
+    }
+
+    processLoRaFrame(data, len, sender);
+}
 
-            // Release power locks after transmission
-            powerManager.releaseAfterLoRaTx();
+/**
+ * @brief Bridge task - LoRa side of the bridge (pinned next to the radio task)
+ *
+ * Processes received packets (ARQ state, plus the selective ACK), runs the
+ * retransmission timers, reports TX results and dispatches BLE frames to the
+ * radio. Nothing in here waits on BLE or the LED. Blocks on the event group -
+ * or until the next retransmission is due - so tickless idle can light sleep.
+ *
+ * Outbound frames are collected while a transmission is in flight and go out
+ * together when TxDone wakes the task, so bursts share one preamble. The TX
+ * scheduler holds them back while the hourly duty-cycle budget is used up.
+ */
+void bridgeTask(void *param)
+{
+    esp_task_wdt_add(nullptr);
+    TickType_t waitTicks = IDLE_WAIT_TICKS;
 
-            if (sendSuccess)
+    for (;;)
+    {
+        // Clear on exit: every source below is drained completely, so an event
+        // posted after this returns simply makes the next wait return at once
+        xEventGroupWaitBits(bridgeEvents, BRIDGE_TASK_EVENTS, pdTRUE, pdFALSE, waitTicks);
+        esp_task_wdt_reset();
+
+        // Report transmissions completed by the radio task
+        bool txSuccess;
+        while (xQueueReceive(loraTxResultQueue, &txSuccess, 0) == pdTRUE)
+        {
+            if (txSuccess)
             {
-                Serial.println("LoRa TX successful");
+                LOG_INFO(TxDone);
 #ifdef LED_PIN
                 ledManager.blink(2);
 #endif
             }
             else
             {
-                Serial.println("LoRa TX failed permanently");
+                LOG_WARN(TxFailed);
+                STATS_COUNT(TxFailed);
             }
+        }
 
-            // Return to RX mode (CRITICAL: Always listening)
-            loraManager.startReceiveMode();
-            delay(50);
+        // Process LoRa packets queued by the radio task - ACKs first free up the ARQ window
+        LoRaPacket packet;
+        if (loRaRing.pop(packet))
+        {
+            // Full speed until every received packet is handled and its ACK state recorded
+            PowerLockGuard ackPower(powerManager, PowerReason::Ack);
+            do
+            {
+                uint32_t startUs = STATS_CLOCK_US();
+                linkStats.record(LinkStage::RxQueued, startUs - packet.timestampUs);
+                processLoRaPacket(packet);
+                STATS_SINCE(RxProcess, startUs);
+            } while (loRaRing.pop(packet));
         }
-        else
+
+#if !LORA_RELAY_ENABLED
+        serviceAdr();
+#endif
+
+        // Timers of texts still waiting for airtime restart once they are sent
+        if (!txScheduler.hasData())
+        {
+            serviceArq();
+        }
+
+        // Check for messages from BLE to send via LoRa. Texts wait in the queue
+        // while the ARQ window or the TX queue is full; an ACK or a timeout wakes us again.
+        WireFrame bleFrame;
+        while (xQueuePeek(bleToLoraQueue, &bleFrame, 0) == pdTRUE)
         {
-            Serial.println("Failed to serialize message for LoRa TX");
+            bool isText = bleFrame.len > 0 && bleFrame.data[0] == static_cast<uint8_t>(MessageType::Text);
+            bool isFragment = bleFrame.len > 0 && bleFrame.data[0] == static_cast<uint8_t>(MessageType::Fragment);
+            bool isArqFrame = isText || isFragment;
+            if (isArqFrame && !arqSender.canTrack(bleFrame.data[1]))
+            {
+                LOG_DEBUG(ArqWindowFull);
+                break;
+            }
+            if (!txScheduler.canQueueData())
+            {
+                LOG_DEBUG(TxHoldingBle);
+                break;
+            }
+            xQueueReceive(bleToLoraQueue, &bleFrame, 0);
+
+            LOG_DEBUG(BleFrameDequeued, bleFrame.data[0]);
+
+            // Frame was validated on BLE write - it is sent as-is, possibly inside an aggregate
+            if (bleFrame.len > 0)
+            {
+                if (isText)
+                {
+                    // Coordinates are delta coded once, retransmissions resend the same bytes
+                    gpsEncoder.encode(bleFrame);
+                }
+                if (isArqFrame)
+                {
+                    arqSender.track(bleFrame.data, bleFrame.len, millis(), arqMinRtoMs(bleFrame.len));
+                }
+                queueForLoRa(bleFrame.data, bleFrame.len);
+            }
+            else
+            {
+                LOG_WARN(EmptyBleFrame);
+            }
         }
+
+        // Send collected frames once the radio is free; TxDone wakes us again otherwise
+        uint32_t txWaitMs = UINT32_MAX;
+        if (!loraManager.isTxBusy())
+        {
+#if LORA_RELAY_ENABLED
+            // Rebroadcasts first: their backoff already decided when they go
+            txWaitMs = flushRelay();
+            if (txWaitMs != 0)
+#endif
+            {
+                queueSelectiveAck();
+                txWaitMs = min(txWaitMs, flushOutbound());
+            }
+        }
+
+        waitTicks = bridgeWaitTicks(txWaitMs);
     }
+}
 
-    // Check for LoRa packets (event-driven via ISR callback)
-    LoRaPacket packet;
-    if (xQueueReceive(loRaQueue, &packet, 0) == pdTRUE)
+/**
+ * @brief Forwarding task - BLE side of the bridge (pinned next to the NimBLE host)
+ *
+ * Delivers received frames as notifications, buffers them while disconnected
+ * and flushes the buffer after a reconnect. Its delays only hold up BLE delivery.
+ */
+void forwardingTask(void *param)
+{
+    esp_task_wdt_add(nullptr);
+    TickType_t waitTicks = 0;
+
+    for (;;)
     {
-        processLoRaPacket(packet);
-        loraActivity = false;
-    }
+        EventBits_t events = xEventGroupWaitBits(bridgeEvents, FORWARDING_TASK_EVENTS, pdTRUE, pdFALSE, waitTicks);
+        esp_task_wdt_reset();
 
-    // Forward queued/buffered messages from LoRa to BLE
-    handleLoRaToBleForwarding();
+        // Process BLE connection state changes (restarts advertising after disconnect)
+        if (events & BRIDGE_EVENT_BLE_CONNECTION)
+        {
+            bleManager->process();
+        }
 
-    // Adaptive delay for power savings
-    // With automatic light sleep enabled, longer delays allow the system to
-    // enter light sleep mode for significant power savings
-    bool hasActivity = uxQueueMessagesWaiting(bleToLoraQueue) > 0 ||
-                       uxQueueMessagesWaiting(loRaQueue) > 0 ||
-                       loraActivity;
+        // Forward queued/buffered messages from LoRa to BLE; wake early only
+        // for the buffer flush delay and the watchdog
+        waitTicks = min(handleLoRaToBleForwarding(), IDLE_WAIT_TICKS);
 
-    if (hasActivity)
-    {
-        // Activity detected - short delay for responsiveness
-        vTaskDelay(pdMS_TO_TICKS(10));
+        // Link statistics for a subscribed app, at most every STATS_NOTIFY_INTERVAL_MS
+        static uint32_t lastStatsMs = 0;
+        if (bleManager->isStatsSubscribed())
+        {
+            uint32_t sinceStats = millis() - lastStatsMs;
+            if (sinceStats >= STATS_NOTIFY_INTERVAL_MS)
+            {
+                bleManager->notifyStats();
+                lastStatsMs = millis();
+                sinceStats = 0;
+            }
+            waitTicks = min(waitTicks, pdMS_TO_TICKS(STATS_NOTIFY_INTERVAL_MS - sinceStats) + 1);
+        }
+
+        // Power accounting, for tuning SF, advertising and timing against battery life
+        static uint32_t lastPowerMs = 0;
+        uint32_t sincePower = millis() - lastPowerMs;
+        if (sincePower >= POWER_REPORT_INTERVAL_MS)
+        {
+            powerManager.report();
+            lastPowerMs = millis();
+            sincePower = 0;
+        }
+        waitTicks = min(waitTicks, pdMS_TO_TICKS(POWER_REPORT_INTERVAL_MS - sincePower) + 1);
     }
-    else
+}
+
+/**
+ * @brief Log task - prints the binary event log
+ *
+ * Sleeps until an event lands in the empty ring, then formats everything
+ * recorded meanwhile. Only ever preempted: the UART time it spends is time
+ * no other task wanted.
+ */
+void logTask(void *param)
+{
+    LogRecord record;
+    char line[128];
+    for (;;)
     {
-        // Idle - long delay enables automatic light sleep
-        // BLE modem and LoRa GPIO interrupts will wake the system
-        vTaskDelay(pdMS_TO_TICKS(2000)); // 2 seconds (was 100ms)
+        ulTaskNotifyTake(pdTRUE, portMAX_DELAY);
+        while (eventLog.pending())
+        {
+            if (!eventLog.read(record))
+            {
+                vTaskDelay(1); // A producer claimed the slot but was preempted before publishing
+                continue;
+            }
+            EventLog::format(record, line, sizeof(line));
+            Serial.println(line);
+        }
+
+        uint32_t dropped = eventLog.takeDropped();
+        if (dropped > 0)
+        {
+            Serial.printf("%lu log events dropped (ring full)\n", static_cast<unsigned long>(dropped));
+        }
     }
 }
+
+/**
+ * @brief Arduino loop task is not used - all work runs in the pinned tasks created in setup()
+ */
+void loop()
+{
+    vTaskDelete(nullptr);
+}
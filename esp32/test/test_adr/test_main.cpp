@@ -0,0 +1,170 @@
+//! Host-side unit tests for adaptive data rate (shared/Adr)
+//!
+//! Run with: pio test -e native -f test_adr
+//!
+//! Time is simulated: every call gets an explicit millisecond timestamp.
+#include <unity.h>
+#include "Adr.h"
+
+void setUp(void) {}
+void tearDown(void) {}
+
+/// Feeds ADR_MIN_SAMPLES packets of the same link quality
+static void hear(AdrController &adr, int rssi, float snr, uint32_t now)
+{
+    for (uint8_t i = 0; i < ADR_MIN_SAMPLES; i++)
+    {
+        adr.onPacket(rssi, snr, now);
+    }
+}
+
+void test_rates_get_faster_from_the_config_profile(void)
+{
+    TEST_ASSERT_EQUAL_UINT8(LORA_SPREADING_FACTOR, ADR_RATES[0].spreadingFactor);
+    TEST_ASSERT_EQUAL_UINT32(4932, adr_time_on_air_ms(51, 0));
+    TEST_ASSERT_EQUAL_UINT32(98, adr_time_on_air_ms(51, ADR_RATE_COUNT - 1)); // SF7 / 125 kHz
+
+    // Receiver limits from the SX1276 datasheet
+    TEST_ASSERT_FLOAT_WITHIN(0.01f, -7.5f, adr_required_snr_db(7));
+    TEST_ASSERT_FLOAT_WITHIN(0.01f, -20.0f, adr_required_snr_db(12));
+    TEST_ASSERT_FLOAT_WITHIN(0.1f, -124.5f, adr_sensitivity_dbm(ADR_RATES[ADR_RATE_COUNT - 1]));
+}
+
+void test_best_rate_follows_link_quality(void)
+{
+    AdrController strong;
+    hear(strong, -60, 9.0f, 0);
+    TEST_ASSERT_EQUAL_UINT8(ADR_RATE_COUNT - 1, strong.bestRate());
+
+    // SNR 0 dB at 31.25 kHz: 3 dB less at 62.5 kHz still leaves 12 dB over SF10's limit
+    AdrController medium;
+    hear(medium, -110, 0.0f, 0);
+    TEST_ASSERT_EQUAL_UINT8(1, medium.bestRate());
+
+    // High SNR but a weak signal: limited by the sensitivity of the wider bandwidths
+    AdrController faint;
+    hear(faint, -128, 8.0f, 0);
+    TEST_ASSERT_EQUAL_UINT8(0, faint.bestRate());
+
+    AdrController none;
+    TEST_ASSERT_EQUAL_UINT8(0, none.bestRate());
+}
+
+void test_hysteresis_keeps_the_current_rate(void)
+{
+    AdrController adr;
+    adr.switched(2, 0); // SF9 / 125 kHz
+
+    // 8.5 dB margin: below ADR_MARGIN_DB, but not by more than the hysteresis
+    hear(adr, -100, -4.0f, 0);
+    TEST_ASSERT_EQUAL_UINT8(2, adr.bestRate());
+
+    // 5.5 dB: step down to SF10 / 62.5 kHz (3 dB less noise, 2.5 dB lower limit)
+    adr.switched(2, 0);
+    hear(adr, -100, -7.0f, 0);
+    TEST_ASSERT_EQUAL_UINT8(1, adr.bestRate());
+}
+
+void test_negotiation_settles_on_the_slower_side(void)
+{
+    AdrController a, b;
+    hear(a, -60, 9.0f, 1000); // a hears b well
+    hear(b, -110, 0.0f, 1000); // b hears a only at rate 1
+
+    uint8_t rate = 0;
+    TEST_ASSERT_TRUE(a.poll(ADR_HOLDOFF_MS - 1, rate) == AdrController::Event::None);
+    TEST_ASSERT_TRUE(a.poll(ADR_HOLDOFF_MS, rate) == AdrController::Event::Propose);
+    TEST_ASSERT_EQUAL_UINT8(ADR_RATE_COUNT - 1, rate);
+
+    // b answers with what it can receive and switches after sending the Accept
+    b.onPacket(-110, 0.0f, ADR_HOLDOFF_MS);
+    uint8_t accepted = b.onRequest(rate);
+    TEST_ASSERT_EQUAL_UINT8(1, accepted);
+    b.switched(accepted, ADR_HOLDOFF_MS);
+
+    TEST_ASSERT_TRUE(a.onAccept(accepted));
+    a.switched(accepted, ADR_HOLDOFF_MS);
+    TEST_ASSERT_EQUAL_UINT8(1, a.rate());
+    TEST_ASSERT_EQUAL_UINT8(1, b.rate());
+
+    // A stray Accept without a request changes nothing
+    TEST_ASSERT_FALSE(a.onAccept(3));
+}
+
+void test_crossing_requests_agree(void)
+{
+    AdrController a, b;
+    hear(a, -60, 9.0f, 0);
+    hear(b, -110, 0.0f, 0);
+
+    uint8_t aWants = 0, bWants = 0;
+    TEST_ASSERT_TRUE(a.poll(ADR_HOLDOFF_MS, aWants) == AdrController::Event::Propose);
+    TEST_ASSERT_TRUE(b.poll(ADR_HOLDOFF_MS, bWants) == AdrController::Event::Propose);
+
+    // Each receives the other's request before any Accept: both pick the lower one
+    TEST_ASSERT_EQUAL_UINT8(bWants, a.onRequest(bWants));
+    TEST_ASSERT_EQUAL_UINT8(bWants, b.onRequest(aWants));
+}
+
+void test_silent_link_falls_back_to_rate_zero(void)
+{
+    AdrController adr;
+    adr.switched(3, 10000);
+
+    uint8_t rate = 99;
+    TEST_ASSERT_TRUE(adr.poll(10000 + ADR_FALLBACK_MS - 1, rate) == AdrController::Event::None);
+
+    // Any packet restarts the silence timer
+    adr.onPacket(-80, 5.0f, 20000);
+    TEST_ASSERT_TRUE(adr.poll(10000 + ADR_FALLBACK_MS, rate) == AdrController::Event::None);
+    TEST_ASSERT_TRUE(adr.poll(20000 + ADR_FALLBACK_MS, rate) == AdrController::Event::Fallback);
+    TEST_ASSERT_EQUAL_UINT8(0, rate);
+
+    adr.switched(rate, 20000 + ADR_FALLBACK_MS);
+    TEST_ASSERT_TRUE(adr.poll(UINT32_MAX / 2, rate) == AdrController::Event::None); // Rate 0 never falls back
+}
+
+void test_unanswered_requests_back_off(void)
+{
+    AdrController adr;
+    hear(adr, -60, 9.0f, 0);
+
+    uint8_t rate = 0;
+    uint32_t proposedAt = ADR_HOLDOFF_MS;
+    TEST_ASSERT_TRUE(adr.poll(proposedAt, rate) == AdrController::Event::Propose);
+
+    // No Accept (peer without ADR): the request expires and the holdoff doubles
+    TEST_ASSERT_TRUE(adr.poll(proposedAt + ADR_REQUEST_TIMEOUT_MS, rate) == AdrController::Event::None);
+    TEST_ASSERT_TRUE(adr.poll(proposedAt + 2 * ADR_HOLDOFF_MS - 1, rate) == AdrController::Event::None);
+    TEST_ASSERT_TRUE(adr.poll(proposedAt + 2 * ADR_HOLDOFF_MS, rate) == AdrController::Event::Propose);
+}
+
+int runUnityTests(void)
+{
+    UNITY_BEGIN();
+    RUN_TEST(test_rates_get_faster_from_the_config_profile);
+    RUN_TEST(test_best_rate_follows_link_quality);
+    RUN_TEST(test_hysteresis_keeps_the_current_rate);
+    RUN_TEST(test_negotiation_settles_on_the_slower_side);
+    RUN_TEST(test_crossing_requests_agree);
+    RUN_TEST(test_silent_link_falls_back_to_rate_zero);
+    RUN_TEST(test_unanswered_requests_back_off);
+    return UNITY_END();
+}
+
+#ifdef ARDUINO
+#include <Arduino.h>
+
+void setup()
+{
+    delay(2000); // Wait for the serial monitor to attach
+    runUnityTests();
+}
+
+void loop() {}
+#else
+int main(void)
+{
+    return runUnityTests();
+}
+#endif
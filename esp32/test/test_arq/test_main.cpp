@@ -0,0 +1,379 @@
+//! Host-side unit tests for the link ARQ (shared/Arq)
+//!
+//! Run with: pio test -e native -f test_arq
+//!
+//! Time is simulated: every call gets an explicit millisecond timestamp.
+#include <unity.h>
+#include "Arq.h"
+#include "LoRaAirtime.h"
+
+// Airtime floor used by the sender tests, roughly a 51-byte frame at SF11/31.25 kHz
+static const uint32_t MIN_RTO_MS = 7000;
+
+static WireFrame make_text(uint8_t seq, const char *text = "HELLO")
+{
+    WireFrame frame;
+    frame.len = Message::createText(seq, text).serialize(frame.data, sizeof(frame.data));
+    return frame;
+}
+
+static bool track(ArqSender &sender, uint8_t seq, uint32_t now)
+{
+    WireFrame frame = make_text(seq);
+    return sender.track(frame.data, frame.len, now, MIN_RTO_MS);
+}
+
+void setUp(void) {}
+void tearDown(void) {}
+
+void test_receiver_in_order_is_cumulative(void)
+{
+    ArqReceiver receiver;
+    receiver.receive(0, 0);
+
+    // Nothing before the first seq is assumed received, so the window starts behind it
+    SelectiveAckMessage ack = receiver.ack();
+    TEST_ASSERT_TRUE(arq_ack_covers(ack, 0));
+    TEST_ASSERT_FALSE(arq_ack_covers(ack, 255));
+
+    // Once the older seqs are settled, in-order traffic is acknowledged cumulatively
+    for (uint8_t seq = 1; seq <= 12; seq++)
+    {
+        receiver.receive(seq, 0);
+    }
+    for (uint8_t seq = 4; seq <= 12; seq++)
+    {
+        TEST_ASSERT_TRUE(arq_ack_covers(receiver.ack(), seq));
+    }
+    TEST_ASSERT_FALSE(arq_ack_covers(receiver.ack(), 13));
+
+    receiver.receive(5, 0); // Duplicate
+    TEST_ASSERT_TRUE(arq_ack_covers(receiver.ack(), 12));
+}
+
+void test_receiver_reports_gaps_in_bitmap(void)
+{
+    ArqReceiver receiver;
+    for (uint8_t seq = 0; seq <= 10; seq++)
+    {
+        receiver.receive(seq, 0);
+    }
+    const uint8_t received[] = {12, 14};
+    for (uint8_t seq : received)
+    {
+        receiver.receive(seq, 0);
+    }
+
+    SelectiveAckMessage ack = receiver.ack();
+    TEST_ASSERT_TRUE(arq_ack_covers(ack, 10));
+    TEST_ASSERT_FALSE(arq_ack_covers(ack, 11));
+    TEST_ASSERT_TRUE(arq_ack_covers(ack, 12));
+    TEST_ASSERT_FALSE(arq_ack_covers(ack, 13));
+    TEST_ASSERT_TRUE(arq_ack_covers(ack, 14));
+    TEST_ASSERT_FALSE(arq_ack_covers(ack, 15));
+    TEST_ASSERT_FALSE(arq_ack_covers(ack, 100));
+
+    // Filling the gaps moves the cumulative point to the newest seq
+    receiver.receive(11, 0);
+    receiver.receive(11, 0);
+    receiver.receive(13, 0);
+    TEST_ASSERT_EQUAL_UINT8(14, receiver.ack().cumulative);
+    TEST_ASSERT_EQUAL_HEX8(0x00, receiver.ack().bitmap);
+}
+
+void test_receiver_selective_ack_layout(void)
+{
+    // Bit i reports cumulative + 1 + i
+    SelectiveAckMessage ack = {2, 0x0A};
+    TEST_ASSERT_TRUE(arq_ack_covers(ack, 250));
+    TEST_ASSERT_TRUE(arq_ack_covers(ack, 2));
+    TEST_ASSERT_FALSE(arq_ack_covers(ack, 3));
+    TEST_ASSERT_TRUE(arq_ack_covers(ack, 4));
+    TEST_ASSERT_FALSE(arq_ack_covers(ack, 5));
+    TEST_ASSERT_TRUE(arq_ack_covers(ack, 6));
+    TEST_ASSERT_FALSE(arq_ack_covers(ack, 7));
+    TEST_ASSERT_FALSE(arq_ack_covers(ack, 11));
+}
+
+void test_receiver_wraps_and_slides(void)
+{
+    ArqReceiver receiver;
+    for (uint8_t seq = 246; seq != 2; seq++)
+    {
+        receiver.receive(seq, 0);
+    }
+    TEST_ASSERT_EQUAL_UINT8(1, receiver.ack().cumulative);
+
+    // 2 never arrives and the sender gave up on it: 12 pushes the window past it
+    receiver.receive(3, 0);
+    receiver.receive(12, 0);
+    SelectiveAckMessage ack = receiver.ack();
+    TEST_ASSERT_TRUE(arq_ack_covers(ack, 12));
+    TEST_ASSERT_FALSE(arq_ack_covers(ack, 11));
+    TEST_ASSERT_EQUAL_UINT8(4, ack.cumulative);
+}
+
+void test_receiver_resyncs_after_restart_or_idle(void)
+{
+    ArqReceiver receiver;
+    receiver.receive(40, 0);
+    receiver.receive(41, 0);
+
+    // App restarted, seq back to 0: a lost seq 1 must not look acknowledged
+    receiver.receive(0, 1000);
+    SelectiveAckMessage ack = receiver.ack();
+    TEST_ASSERT_TRUE(arq_ack_covers(ack, 0));
+    TEST_ASSERT_FALSE(arq_ack_covers(ack, 1));
+    TEST_ASSERT_FALSE(arq_ack_covers(ack, 41));
+
+    // Long silence: a seq just behind the old window starts a new one too
+    receiver.receive(0xFE, 1000 + ARQ_RECEIVER_IDLE_MS + 1);
+    ack = receiver.ack();
+    TEST_ASSERT_TRUE(arq_ack_covers(ack, 0xFE));
+    TEST_ASSERT_FALSE(arq_ack_covers(ack, 0xFD));
+    TEST_ASSERT_FALSE(arq_ack_covers(ack, 0));
+}
+
+void test_sender_window_limit(void)
+{
+    ArqSender sender;
+    for (uint8_t seq = 0; seq < ARQ_WINDOW_SIZE; seq++)
+    {
+        TEST_ASSERT_TRUE(track(sender, seq, 0));
+    }
+    TEST_ASSERT_FALSE(sender.canTrack(ARQ_WINDOW_SIZE));
+    TEST_ASSERT_FALSE(track(sender, ARQ_WINDOW_SIZE, 0));
+
+    // Acknowledging the newest frames does not help while the oldest is in flight
+    TEST_ASSERT_TRUE(sender.acknowledge(7, 100));
+    TEST_ASSERT_FALSE(sender.canTrack(ARQ_WINDOW_SIZE));
+    TEST_ASSERT_TRUE(sender.acknowledge(0, 100));
+    TEST_ASSERT_TRUE(sender.canTrack(ARQ_WINDOW_SIZE));
+
+    // Re-sending a seq that is in flight replaces it instead of using a slot
+    TEST_ASSERT_TRUE(track(sender, 3, 10));
+    TEST_ASSERT_EQUAL_UINT8(ARQ_WINDOW_SIZE - 2, sender.inFlight());
+
+    // Only texts and fragments are tracked
+    const uint8_t ack[] = {0x02, 0x01};
+    ArqSender empty;
+    TEST_ASSERT_FALSE(empty.track(ack, sizeof(ack), 0, MIN_RTO_MS));
+    TEST_ASSERT_EQUAL_UINT32(UINT32_MAX, empty.nextTimeout(0));
+    const uint8_t fragment[] = {0x07, 0x01, 0x00, 'A'};
+    TEST_ASSERT_TRUE(empty.track(fragment, sizeof(fragment), 0, MIN_RTO_MS));
+    TEST_ASSERT_EQUAL_UINT8(1, empty.inFlight());
+}
+
+void test_sender_selective_ack_and_fast_retransmit(void)
+{
+    ArqSender sender;
+    track(sender, 1, 0);
+    track(sender, 2, 100);
+    track(sender, 3, 200);
+
+    // Receiver got 1 and 3: cumulative 1, bit 1 = seq 3
+    uint8_t acked[ARQ_WINDOW_SIZE];
+    uint8_t count = sender.acknowledge(SelectiveAckMessage{1, 0x02}, 5000, acked);
+    TEST_ASSERT_EQUAL_UINT8(2, count);
+    TEST_ASSERT_EQUAL_UINT8(1, sender.inFlight());
+
+    // 2 was sent before 3, which got through: resent without waiting for its RTO
+    TEST_ASSERT_EQUAL_UINT32(0, sender.nextTimeout(5000));
+    const WireFrame *frame = nullptr;
+    TEST_ASSERT_TRUE(sender.poll(5000, frame) == ArqSender::Event::Retransmit);
+    TEST_ASSERT_EQUAL_UINT8(2, frame->data[1]);
+    TEST_ASSERT_TRUE(sender.poll(5000, frame) == ArqSender::Event::None);
+    TEST_ASSERT_EQUAL_UINT32(1, sender.retransmissions());
+
+    // A repeated ACK acknowledges nothing new and triggers nothing
+    TEST_ASSERT_EQUAL_UINT8(0, sender.acknowledge(SelectiveAckMessage{1, 0x02}, 5100, acked));
+    TEST_ASSERT_TRUE(sender.poll(5100, frame) == ArqSender::Event::None);
+
+    TEST_ASSERT_TRUE(sender.acknowledge(2, 9000));
+    TEST_ASSERT_FALSE(sender.acknowledge(2, 9000));
+    TEST_ASSERT_EQUAL_UINT8(0, sender.inFlight());
+}
+
+void test_sender_backoff_and_give_up(void)
+{
+    ArqSender sender;
+    track(sender, 7, 0);
+
+    // No RTT sample yet: first timeout is twice the airtime floor, then it doubles
+    uint32_t now = 0;
+    uint32_t rto = 2 * MIN_RTO_MS;
+    const WireFrame *frame = nullptr;
+    for (uint8_t sent = 1; sent < ARQ_MAX_TRANSMISSIONS; sent++)
+    {
+        TEST_ASSERT_EQUAL_UINT32(rto, sender.nextTimeout(now));
+        TEST_ASSERT_TRUE(sender.poll(now + rto - 1, frame) == ArqSender::Event::None);
+        now += rto;
+        TEST_ASSERT_TRUE(sender.poll(now, frame) == ArqSender::Event::Retransmit);
+        TEST_ASSERT_EQUAL_UINT8(7, frame->data[1]);
+        rto = rto * 2 < ARQ_MAX_RTO_MS ? rto * 2 : ARQ_MAX_RTO_MS;
+    }
+
+    now += rto;
+    TEST_ASSERT_TRUE(sender.poll(now, frame) == ArqSender::Event::GaveUp);
+    TEST_ASSERT_EQUAL_UINT8(7, frame->data[1]);
+    TEST_ASSERT_EQUAL_UINT8(0, sender.inFlight());
+}
+
+void test_sender_rto_follows_measured_rtt(void)
+{
+    ArqSender sender;
+
+    // First sample: SRTT = R, RTTVAR = R/2 (RFC 6298)
+    track(sender, 1, 0);
+    sender.acknowledge(1, 10000);
+    TEST_ASSERT_EQUAL_UINT32(10000, sender.smoothedRtt());
+
+    // RTO = SRTT + 4 * RTTVAR = 30000
+    track(sender, 2, 20000);
+    TEST_ASSERT_EQUAL_UINT32(30000, sender.nextTimeout(20000));
+
+    // Retransmitted frames are not sampled (Karn)
+    const WireFrame *frame;
+    TEST_ASSERT_TRUE(sender.poll(50000, frame) == ArqSender::Event::Retransmit);
+    sender.acknowledge(2, 50100);
+    TEST_ASSERT_EQUAL_UINT32(10000, sender.smoothedRtt());
+
+    // Fast, steady RTTs shrink the timeout, but never below the airtime floor
+    for (uint8_t seq = 3; seq < 40; seq++)
+    {
+        uint32_t sent = seq * 10000;
+        track(sender, seq, sent);
+        sender.acknowledge(seq, sent + 100);
+    }
+    track(sender, 40, 500000);
+    TEST_ASSERT_EQUAL_UINT32(MIN_RTO_MS, sender.nextTimeout(500000));
+}
+
+void test_sender_timer_restarts_when_transmitted(void)
+{
+    ArqSender sender;
+    track(sender, 3, 0);
+
+    // Held in a TX queue for 30 s: the timeout counts from the actual transmission
+    sender.transmitted(3, 30000);
+    TEST_ASSERT_EQUAL_UINT32(2 * MIN_RTO_MS, sender.nextTimeout(30000));
+
+    const WireFrame *frame = nullptr;
+    TEST_ASSERT_TRUE(sender.poll(30000 + 2 * MIN_RTO_MS - 1, frame) == ArqSender::Event::None);
+
+    // The RTT sample is taken from the transmission as well
+    TEST_ASSERT_TRUE(sender.acknowledge(3, 32000));
+    TEST_ASSERT_EQUAL_UINT32(2000, sender.smoothedRtt());
+}
+
+void test_lossy_link_delivers_everything(void)
+{
+    // Every third data frame and every fourth ACK are lost; a full window is kept in flight
+    ArqSender sender;
+    ArqReceiver receiver;
+    bool delivered[256] = {};
+    uint8_t nextSeq = 0;
+    uint32_t dataSent = 0;
+    uint32_t acksSent = 0;
+    uint32_t now = 0;
+    const uint8_t TOTAL = 40;
+
+    while (true)
+    {
+        bool received = false;
+        while (nextSeq < TOTAL && sender.canTrack(nextSeq))
+        {
+            TEST_ASSERT_TRUE(track(sender, nextSeq, now));
+            if (++dataSent % 3 != 0)
+            {
+                receiver.receive(nextSeq, now);
+                delivered[nextSeq] = true;
+                received = true;
+            }
+            nextSeq++;
+        }
+
+        const WireFrame *frame;
+        ArqSender::Event event;
+        while ((event = sender.poll(now, frame)) != ArqSender::Event::None)
+        {
+            TEST_ASSERT_TRUE(event == ArqSender::Event::Retransmit);
+            if (++dataSent % 3 != 0)
+            {
+                receiver.receive(frame->data[1], now);
+                delivered[frame->data[1]] = true;
+                received = true;
+            }
+        }
+
+        now += 3000; // One round trip
+        if (received && ++acksSent % 4 != 0)
+        {
+            uint8_t acked[ARQ_WINDOW_SIZE];
+            uint8_t count = sender.acknowledge(receiver.ack(), now, acked);
+            for (uint8_t i = 0; i < count; i++)
+            {
+                TEST_ASSERT_TRUE(delivered[acked[i]]); // Never acknowledged without delivery
+            }
+        }
+
+        if (nextSeq == TOTAL && sender.inFlight() == 0)
+        {
+            break;
+        }
+        uint32_t wait = sender.nextTimeout(now);
+        if (nextSeq == TOTAL || !sender.canTrack(nextSeq))
+        {
+            now += wait;
+        }
+        TEST_ASSERT_TRUE(now < 3600000);
+    }
+
+    for (uint8_t seq = 0; seq < TOTAL; seq++)
+    {
+        TEST_ASSERT_TRUE(delivered[seq]);
+    }
+}
+
+void test_airtime_floor_matches_semtech_calculator(void)
+{
+    // Reference values from the Semtech LoRa calculator
+    TEST_ASSERT_EQUAL_UINT32(31250, lora_effective_bandwidth_hz(31E3));
+    TEST_ASSERT_EQUAL_UINT32(103, lora_time_on_air_ms(51, 7, 125000, 5));
+    TEST_ASSERT_EQUAL_UINT32(4932, lora_time_on_air_ms(51, 11, 31250, 5, 8, false));
+}
+
+int runUnityTests(void)
+{
+    UNITY_BEGIN();
+    RUN_TEST(test_receiver_in_order_is_cumulative);
+    RUN_TEST(test_receiver_reports_gaps_in_bitmap);
+    RUN_TEST(test_receiver_selective_ack_layout);
+    RUN_TEST(test_receiver_wraps_and_slides);
+    RUN_TEST(test_receiver_resyncs_after_restart_or_idle);
+    RUN_TEST(test_sender_window_limit);
+    RUN_TEST(test_sender_selective_ack_and_fast_retransmit);
+    RUN_TEST(test_sender_backoff_and_give_up);
+    RUN_TEST(test_sender_rto_follows_measured_rtt);
+    RUN_TEST(test_sender_timer_restarts_when_transmitted);
+    RUN_TEST(test_lossy_link_delivers_everything);
+    RUN_TEST(test_airtime_floor_matches_semtech_calculator);
+    return UNITY_END();
+}
+
+#ifdef ARDUINO
+#include <Arduino.h>
+
+void setup()
+{
+    delay(2000); // Wait for the serial monitor to attach
+    runUnityTests();
+}
+
+void loop() {}
+#else
+int main(void)
+{
+    return runUnityTests();
+}
+#endif
@@ -0,0 +1,271 @@
+//! Micro-benchmarks for the shared Protocol library
+//!
+//! Run with: pio test -e native -f test_benchmark -v
+//!
+//! Reports ns/op and bytes/op for pack_text, unpack_text, Message::serialize
+//! and Message::deserialize across text lengths 0-50, with and without GPS,
+//! and compares 6-bit packing with the Huffman text code on typical field messages.
+//! Output is CSV so runs can be diffed or plotted:
+//!   op,len,gps,ns_per_op,bytes_per_op
+//!
+//! Optional regression gate: build with -DBENCH_MAX_NS_PER_OP=<n> to fail the
+//! suite if any measured operation is slower than n ns/op.
+#include <unity.h>
+#include <stdio.h>
+#include "Protocol.h"
+
+#ifdef ARDUINO
+#include <Arduino.h>
+#include <esp_timer.h>
+#else
+#include <chrono>
+#endif
+
+#ifndef BENCH_ITERATIONS
+#ifdef ARDUINO
+#define BENCH_ITERATIONS 2000
+#else
+#define BENCH_ITERATIONS 200000
+#endif
+#endif
+
+static const uint8_t TEXT_LENGTHS[] = {0, 1, 2, 3, 4, 5, 10, 15, 20, 25, 30, 35, 40, 45, 50};
+
+/// Typical crew messages for the compression comparison
+static const char *const FIELD_MESSAGES[] = {
+    "OK",
+    "ALL GOOD HERE",
+    "NEED WATER AT CAMP",
+    "ARRIVED AT THE HUT, STARTING DESCENT NOW",
+    "WEATHER TURNING, HEADING BACK TO THE CAR",
+    "MEET AT THE NORTH TRAILHEAD AT 1530",
+    "LOW BATTERY, WILL CHECK IN AGAIN TOMORROW",
+    "SOS INJURED LEG, CANNOT WALK, SEND HELP",
+    "WHERE ARE YOU?",
+    "GRID 4471 2093 ETA 20 MIN",
+};
+
+// Accumulates results so the compiler cannot drop the benchmarked calls
+static volatile uint32_t benchSink = 0;
+
+static uint64_t now_ns()
+{
+#ifdef ARDUINO
+    return static_cast<uint64_t>(esp_timer_get_time()) * 1000;
+#else
+    return std::chrono::duration_cast<std::chrono::nanoseconds>(
+               std::chrono::steady_clock::now().time_since_epoch())
+        .count();
+#endif
+}
+
+/// Builds a deterministic text of the requested length from CHARSET
+static void make_text(char *text, uint8_t len)
+{
+    for (uint8_t i = 0; i < len; i++)
+    {
+        text[i] = CHARSET[(i * 7 + 1) % 64];
+    }
+    text[len] = '\0';
+}
+
+static void report(const char *op, uint8_t len, bool gps, uint64_t elapsedNs, int bytesPerOp)
+{
+    double nsPerOp = static_cast<double>(elapsedNs) / BENCH_ITERATIONS;
+    char line[96];
+    snprintf(line, sizeof(line), "%s,%u,%d,%.1f,%d", op, len, gps ? 1 : 0, nsPerOp, bytesPerOp);
+    TEST_MESSAGE(line);
+
+#ifdef BENCH_MAX_NS_PER_OP
+    TEST_ASSERT_LESS_OR_EQUAL(BENCH_MAX_NS_PER_OP, static_cast<uint64_t>(nsPerOp));
+#endif
+}
+
+void setUp(void) {}
+void tearDown(void) {}
+
+void test_bench_pack_text(void)
+{
+    char text[MAX_TEXT_LENGTH + 1];
+    uint8_t packed[64];
+
+    for (uint8_t len : TEXT_LENGTHS)
+    {
+        make_text(text, len);
+        int packedLen = pack_text(text, packed, sizeof(packed));
+        TEST_ASSERT_EQUAL_INT((len * 6 + 7) / 8, packedLen);
+
+        uint64_t start = now_ns();
+        for (uint32_t i = 0; i < BENCH_ITERATIONS; i++)
+        {
+            benchSink = benchSink + pack_text(text, packed, sizeof(packed));
+        }
+        report("pack_text", len, false, now_ns() - start, packedLen);
+    }
+}
+
+void test_bench_unpack_text(void)
+{
+    char text[MAX_TEXT_LENGTH + 1];
+    char unpacked[MAX_TEXT_LENGTH + 1];
+    uint8_t packed[64];
+
+    for (uint8_t len : TEXT_LENGTHS)
+    {
+        make_text(text, len);
+        int packedLen = pack_text(text, packed, sizeof(packed));
+        TEST_ASSERT_TRUE(unpack_text(packed, packedLen, len, unpacked, sizeof(unpacked)));
+        TEST_ASSERT_EQUAL_STRING(text, unpacked);
+
+        uint64_t start = now_ns();
+        for (uint32_t i = 0; i < BENCH_ITERATIONS; i++)
+        {
+            benchSink = benchSink + unpack_text(packed, packedLen, len, unpacked, sizeof(unpacked));
+        }
+        report("unpack_text", len, false, now_ns() - start, packedLen);
+    }
+}
+
+void test_bench_compressed_text(void)
+{
+    uint8_t packed[64];
+    char unpacked[MAX_TEXT_LENGTH + 1];
+    int sixBitTotal = 0;
+    int compressedTotal = 0;
+
+    for (const char *text : FIELD_MESSAGES)
+    {
+        uint8_t len = static_cast<uint8_t>(strlen(text));
+        int sixBitLen = pack_text(text, packed, sizeof(packed));
+        int packedLen = pack_text_compressed(text, packed, sizeof(packed));
+        TEST_ASSERT_TRUE(unpack_text_compressed(packed, packedLen, len, unpacked, sizeof(unpacked)));
+        TEST_ASSERT_EQUAL_STRING(text, unpacked);
+        sixBitTotal += sixBitLen;
+        compressedTotal += packedLen;
+
+        uint64_t start = now_ns();
+        for (uint32_t i = 0; i < BENCH_ITERATIONS; i++)
+        {
+            benchSink = benchSink + pack_text_compressed(text, packed, sizeof(packed));
+        }
+        report("pack_text_compressed", len, false, now_ns() - start, packedLen);
+
+        start = now_ns();
+        for (uint32_t i = 0; i < BENCH_ITERATIONS; i++)
+        {
+            benchSink = benchSink + unpack_text_compressed(packed, packedLen, len, unpacked, sizeof(unpacked));
+        }
+        report("unpack_text_compressed", len, false, now_ns() - start, packedLen);
+    }
+
+    char line[96];
+    snprintf(line, sizeof(line), "# field messages: %d bytes 6-bit, %d bytes Huffman (%.1f%% smaller)", sixBitTotal,
+             compressedTotal, 100.0 * (sixBitTotal - compressedTotal) / sixBitTotal);
+    TEST_MESSAGE(line);
+
+    // Regression gate on the code table: at least 15% below 6-bit packing for English text
+    TEST_ASSERT_TRUE(compressedTotal * 100 <= sixBitTotal * 85);
+}
+
+void test_bench_serialize(void)
+{
+    char text[MAX_TEXT_LENGTH + 1];
+    uint8_t buf[64];
+
+    for (int gps = 0; gps <= 1; gps++)
+    {
+        for (uint8_t len : TEXT_LENGTHS)
+        {
+            make_text(text, len);
+            Message msg = gps ? Message::createTextWithGps(1, text, 47376887, 8541694)
+                              : Message::createText(1, text);
+            int frameLen = msg.serialize(buf, sizeof(buf));
+            TEST_ASSERT_GREATER_THAN(0, frameLen);
+
+            uint64_t start = now_ns();
+            for (uint32_t i = 0; i < BENCH_ITERATIONS; i++)
+            {
+                benchSink = benchSink + msg.serialize(buf, sizeof(buf));
+            }
+            report("serialize", len, gps, now_ns() - start, frameLen);
+        }
+    }
+}
+
+void test_bench_deserialize(void)
+{
+    char text[MAX_TEXT_LENGTH + 1];
+    uint8_t buf[64];
+
+    for (int gps = 0; gps <= 1; gps++)
+    {
+        for (uint8_t len : TEXT_LENGTHS)
+        {
+            make_text(text, len);
+            Message msg = gps ? Message::createTextWithGps(1, text, 47376887, 8541694)
+                              : Message::createText(1, text);
+            int frameLen = msg.serialize(buf, sizeof(buf));
+
+            Message decoded;
+            TEST_ASSERT_TRUE(decoded.deserialize(buf, frameLen));
+            TEST_ASSERT_EQUAL_STRING(text, decoded.textData.text);
+
+            uint64_t start = now_ns();
+            for (uint32_t i = 0; i < BENCH_ITERATIONS; i++)
+            {
+                benchSink = benchSink + decoded.deserialize(buf, frameLen);
+            }
+            report("deserialize", len, gps, now_ns() - start, frameLen);
+        }
+    }
+}
+
+void test_bench_ack(void)
+{
+    uint8_t buf[64];
+    Message ack = Message::createAck(7);
+    int frameLen = ack.serialize(buf, sizeof(buf));
+
+    uint64_t start = now_ns();
+    for (uint32_t i = 0; i < BENCH_ITERATIONS; i++)
+    {
+        benchSink = benchSink + ack.serialize(buf, sizeof(buf));
+    }
+    report("serialize_ack", 0, false, now_ns() - start, frameLen);
+
+    Message decoded;
+    start = now_ns();
+    for (uint32_t i = 0; i < BENCH_ITERATIONS; i++)
+    {
+        benchSink = benchSink + decoded.deserialize(buf, frameLen);
+    }
+    report("deserialize_ack", 0, false, now_ns() - start, frameLen);
+}
+
+int runUnityTests(void)
+{
+    UNITY_BEGIN();
+    TEST_MESSAGE("op,len,gps,ns_per_op,bytes_per_op");
+    RUN_TEST(test_bench_pack_text);
+    RUN_TEST(test_bench_unpack_text);
+    RUN_TEST(test_bench_compressed_text);
+    RUN_TEST(test_bench_serialize);
+    RUN_TEST(test_bench_deserialize);
+    RUN_TEST(test_bench_ack);
+    return UNITY_END();
+}
+
+#ifdef ARDUINO
+void setup()
+{
+    delay(2000); // Wait for the serial monitor to attach
+    runUnityTests();
+}
+
+void loop() {}
+#else
+int main(void)
+{
+    return runUnityTests();
+}
+#endif
@@ -0,0 +1,127 @@
+//! Host-side unit tests for the received text dedup cache (shared/Dedup)
+//!
+//! Run with: pio test -e native -f test_dedup
+#include <unity.h>
+#include <stdio.h>
+#include "Dedup.h"
+#include "Protocol.h"
+
+static DedupCache cache;
+
+static WireFrame make_text(uint8_t seq, const char *text)
+{
+    WireFrame frame;
+    frame.len = Message::createText(seq, text).serialize(frame.data, sizeof(frame.data));
+    return frame;
+}
+
+static bool seen_before(uint16_t peer, const WireFrame &frame, uint32_t nowMs)
+{
+    return cache.isDuplicate(peer, frame.data, frame.len, nowMs);
+}
+
+void setUp(void)
+{
+    cache.reset();
+}
+
+void tearDown(void) {}
+
+void test_retransmission_is_a_duplicate(void)
+{
+    WireFrame first = make_text(7, "HELLO");
+    TEST_ASSERT_FALSE(seen_before(DEDUP_LINK_PEER, first, 1000));
+    TEST_ASSERT_TRUE(seen_before(DEDUP_LINK_PEER, first, 5000));
+    TEST_ASSERT_TRUE(seen_before(DEDUP_LINK_PEER, first, 9000));
+
+    // Out of order within the window: each one is new once
+    WireFrame later = make_text(9, "LATER");
+    WireFrame gap = make_text(8, "GAP");
+    TEST_ASSERT_FALSE(seen_before(DEDUP_LINK_PEER, later, 10000));
+    TEST_ASSERT_FALSE(seen_before(DEDUP_LINK_PEER, gap, 11000));
+    TEST_ASSERT_TRUE(seen_before(DEDUP_LINK_PEER, gap, 12000));
+    TEST_ASSERT_TRUE(seen_before(DEDUP_LINK_PEER, first, 13000));
+}
+
+void test_same_seq_with_new_content_is_delivered(void)
+{
+    WireFrame before = make_text(0, "BEFORE RESTART");
+    WireFrame after = make_text(0, "AFTER RESTART");
+    TEST_ASSERT_FALSE(seen_before(DEDUP_LINK_PEER, before, 1000));
+    TEST_ASSERT_FALSE(seen_before(DEDUP_LINK_PEER, after, 2000));
+    TEST_ASSERT_TRUE(seen_before(DEDUP_LINK_PEER, after, 3000));
+}
+
+void test_window_slides_and_wraps(void)
+{
+    uint32_t now = 1000;
+    for (int i = 0; i < 300; i++)
+    {
+        uint8_t seq = static_cast<uint8_t>(i);
+        char text[8];
+        snprintf(text, sizeof(text), "M%d", i);
+        WireFrame frame = make_text(seq, text);
+        TEST_ASSERT_FALSE(seen_before(DEDUP_LINK_PEER, frame, now));
+        TEST_ASSERT_TRUE(seen_before(DEDUP_LINK_PEER, frame, now));
+        now += 1000;
+    }
+
+    // Seq 299 - 31 is the oldest one remembered, 299 - 32 is beyond the window again
+    TEST_ASSERT_TRUE(seen_before(DEDUP_LINK_PEER, make_text(268 % 256, "M268"), now));
+    TEST_ASSERT_FALSE(seen_before(DEDUP_LINK_PEER, make_text(267 % 256, "M267"), now));
+}
+
+void test_quiet_sender_expires(void)
+{
+    WireFrame frame = make_text(3, "HELLO");
+    TEST_ASSERT_FALSE(seen_before(DEDUP_LINK_PEER, frame, 1000));
+    TEST_ASSERT_TRUE(seen_before(DEDUP_LINK_PEER, frame, 1000 + DEDUP_EXPIRY_MS));
+    TEST_ASSERT_FALSE(seen_before(DEDUP_LINK_PEER, frame, 2001 + 2 * DEDUP_EXPIRY_MS));
+
+    // Expiry also holds across the 32-bit millis() wrap
+    TEST_ASSERT_FALSE(seen_before(DEDUP_LINK_PEER, frame, 0xFFFFF000u));
+    TEST_ASSERT_TRUE(seen_before(DEDUP_LINK_PEER, frame, 0x00001000u));
+}
+
+void test_peers_are_separate_and_least_recent_is_evicted(void)
+{
+    WireFrame frame = make_text(1, "HELLO");
+    for (uint16_t peer = 1; peer <= DEDUP_MAX_PEERS; peer++)
+    {
+        TEST_ASSERT_FALSE(seen_before(peer, frame, 1000 + peer));
+    }
+    TEST_ASSERT_TRUE(seen_before(1, frame, 2000)); // Peer 2 is now the least recent
+
+    TEST_ASSERT_FALSE(seen_before(DEDUP_MAX_PEERS + 1, frame, 3000));
+    TEST_ASSERT_TRUE(seen_before(1, frame, 4000));
+    TEST_ASSERT_TRUE(seen_before(3, frame, 4000));
+    TEST_ASSERT_FALSE(seen_before(2, frame, 5000)); // Forgotten
+}
+
+int runUnityTests(void)
+{
+    UNITY_BEGIN();
+    RUN_TEST(test_retransmission_is_a_duplicate);
+    RUN_TEST(test_same_seq_with_new_content_is_delivered);
+    RUN_TEST(test_window_slides_and_wraps);
+    RUN_TEST(test_quiet_sender_expires);
+    RUN_TEST(test_peers_are_separate_and_least_recent_is_evicted);
+    return UNITY_END();
+}
+
+#ifdef ARDUINO
+#include <Arduino.h>
+
+void setup()
+{
+    delay(2000); // Wait for the serial monitor to attach
+    runUnityTests();
+}
+
+void loop() {}
+#else
+int main(void)
+{
+    return runUnityTests();
+}
+#endif
@@ -0,0 +1,150 @@
+//! Host-side unit tests for the binary event log (shared/EventLog)
+//!
+//! Run with: pio test -e native -f test_event_log
+//!
+//! The native build uses the default LOG_LEVEL (info), so LOG_DEBUG compiles to nothing.
+#include <unity.h>
+#include <string.h>
+#include "EventLog.h"
+
+static int wakeups = 0;
+
+static void count_wakeup()
+{
+    wakeups++;
+}
+
+void setUp(void) {}
+void tearDown(void) {}
+
+void test_records_round_trip_in_order(void)
+{
+    EventLog log;
+    TEST_ASSERT_TRUE(log.record(1000, LogLevel::Info, LogId::LoRaRx, 12, -87, -7));
+    TEST_ASSERT_TRUE(log.record(1001, LogLevel::Warn, LogId::InvalidFrame));
+    TEST_ASSERT_TRUE(log.pending());
+
+    LogRecord record;
+    TEST_ASSERT_TRUE(log.read(record));
+    TEST_ASSERT_EQUAL_UINT32(1000, record.timestampMs);
+    TEST_ASSERT_TRUE(record.id == LogId::LoRaRx);
+    TEST_ASSERT_TRUE(record.level == LogLevel::Info);
+    TEST_ASSERT_EQUAL_INT32(-87, record.args[1]);
+
+    TEST_ASSERT_TRUE(log.read(record));
+    TEST_ASSERT_TRUE(record.id == LogId::InvalidFrame);
+    TEST_ASSERT_EQUAL_INT32(0, record.args[0]);
+    TEST_ASSERT_FALSE(log.read(record));
+    TEST_ASSERT_FALSE(log.pending());
+}
+
+void test_format_applies_the_table(void)
+{
+    LogRecord record = {4321, LogId::LoRaRx, LogLevel::Info, {12, -87, -7}};
+    char line[96];
+    int len = EventLog::format(record, line, sizeof(line));
+    TEST_ASSERT_EQUAL_STRING("[4321] LoRa RX: 12 bytes, RSSI: -87 dBm, SNR: -7 dB", line);
+    TEST_ASSERT_EQUAL_INT(static_cast<int>(strlen(line)), len);
+
+    LogRecord ack = {5, LogId::SelectiveAckRx, LogLevel::Info, {3, 0x05, 0}};
+    EventLog::format(ack, line, sizeof(line));
+    TEST_ASSERT_EQUAL_STRING("[5] Selective ACK - cumulative: 3, bitmap: 0x05", line);
+
+    // Truncated like snprintf, and unknown ids do not index past the table
+    char small[12];
+    EventLog::format(record, small, sizeof(small));
+    TEST_ASSERT_EQUAL_STRING("[4321] LoRa", small);
+    LogRecord bogus = {0, static_cast<LogId>(0x7FFF), LogLevel::Error, {0, 0, 0}};
+    EventLog::format(bogus, line, sizeof(line));
+    TEST_ASSERT_EQUAL_STRING("[0] unknown event 32767", line);
+}
+
+void test_full_ring_drops_new_events(void)
+{
+    EventLog log;
+    for (int32_t i = 0; i < EVENT_LOG_CAPACITY; i++)
+    {
+        TEST_ASSERT_TRUE(log.record(i, LogLevel::Info, LogId::AckRx, i));
+    }
+    TEST_ASSERT_FALSE(log.record(999, LogLevel::Info, LogId::AckRx, 999));
+    TEST_ASSERT_FALSE(log.record(999, LogLevel::Info, LogId::AckRx, 999));
+    TEST_ASSERT_EQUAL_UINT32(2, log.takeDropped());
+    TEST_ASSERT_EQUAL_UINT32(0, log.takeDropped());
+
+    // The oldest events survive; reading frees slots for another lap
+    LogRecord record;
+    for (int32_t lap = 0; lap < 3; lap++)
+    {
+        for (int32_t i = 0; i < EVENT_LOG_CAPACITY; i++)
+        {
+            TEST_ASSERT_TRUE(log.read(record));
+            TEST_ASSERT_EQUAL_INT32(i, record.args[0]);
+            TEST_ASSERT_TRUE(log.record(i, LogLevel::Info, LogId::AckRx, i));
+        }
+    }
+}
+
+void test_wake_callback_only_for_an_empty_ring(void)
+{
+    EventLog log;
+    wakeups = 0;
+    log.setWakeCallback(count_wakeup);
+
+    log.record(0, LogLevel::Info, LogId::TxDone);
+    log.record(0, LogLevel::Info, LogId::TxDone);
+    TEST_ASSERT_EQUAL_INT(1, wakeups);
+
+    LogRecord record;
+    while (log.read(record))
+    {
+    }
+    log.record(0, LogLevel::Info, LogId::TxFailed);
+    TEST_ASSERT_EQUAL_INT(2, wakeups);
+}
+
+void test_levels_compile_out(void)
+{
+    LogRecord record;
+    while (eventLog.read(record))
+    {
+    }
+
+    int evaluated = 0;
+    LOG_DEBUG(AckRx, ++evaluated); // Arguments are not even evaluated
+    TEST_ASSERT_EQUAL_INT(0, evaluated);
+    TEST_ASSERT_FALSE(eventLog.read(record));
+
+    LOG_WARN(AckRx, ++evaluated);
+    TEST_ASSERT_EQUAL_INT(1, evaluated);
+    TEST_ASSERT_TRUE(eventLog.read(record));
+    TEST_ASSERT_TRUE(record.level == LogLevel::Warn);
+    TEST_ASSERT_EQUAL_INT32(1, record.args[0]);
+}
+
+int runUnityTests(void)
+{
+    UNITY_BEGIN();
+    RUN_TEST(test_records_round_trip_in_order);
+    RUN_TEST(test_format_applies_the_table);
+    RUN_TEST(test_full_ring_drops_new_events);
+    RUN_TEST(test_wake_callback_only_for_an_empty_ring);
+    RUN_TEST(test_levels_compile_out);
+    return UNITY_END();
+}
+
+#ifdef ARDUINO
+#include <Arduino.h>
+
+void setup()
+{
+    delay(2000); // Wait for the serial monitor to attach
+    runUnityTests();
+}
+
+void loop() {}
+#else
+int main(void)
+{
+    return runUnityTests();
+}
+#endif
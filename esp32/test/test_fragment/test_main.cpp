@@ -0,0 +1,255 @@
+//! Host-side unit tests for long message fragmentation and reassembly (shared/Fragment)
+//!
+//! Run with: pio test -e native -f test_fragment
+#include <unity.h>
+#include <string.h>
+#include "Fragment.h"
+#include "Protocol.h"
+
+static FragmentReassembler reassembler;
+
+// Result of the last feed() that completed a message
+static const uint8_t *donePayload;
+static size_t doneLen;
+static uint8_t doneFirstSeq;
+static uint8_t doneCount;
+
+static const char *LONG_MESSAGE = "MEET AT THE NORTH RIDGE HUT AT 14:30, BRING ROPE, TWO HEADLAMPS AND "
+                                  "WATER FOR THE SECOND DAY. WE TAKE THE EAST TRAIL IF THE WEATHER HOLDS.";
+
+static FragmentReassembler::Result feed(uint16_t sender, const uint8_t *payload, size_t len, uint8_t firstSeq,
+                                        uint8_t index, uint32_t nowMs)
+{
+    uint8_t frame[MAX_FRAME_SIZE];
+    int frameLen = fragment_frame(payload, len, firstSeq, index, frame);
+    TEST_ASSERT_GREATER_THAN(0, frameLen);
+    return reassembler.add(sender, frame, frameLen, nowMs, donePayload, doneLen, doneFirstSeq, doneCount);
+}
+
+void setUp(void)
+{
+    reassembler = FragmentReassembler();
+}
+
+void tearDown(void) {}
+
+void test_long_text_round_trip(void)
+{
+    uint8_t payload[FRAGMENT_MAX_PAYLOAD];
+    int len = long_text_encode(LONG_MESSAGE, true, 47376900, -8541700, payload, sizeof(payload));
+    TEST_ASSERT_GREATER_THAN(0, len);
+    TEST_ASSERT_EQUAL_UINT8(strlen(LONG_MESSAGE), payload[0]);
+    TEST_ASSERT_TRUE(payload[1] & LONG_TEXT_GPS_FLAG);
+    TEST_ASSERT_TRUE(payload[1] & LONG_TEXT_COMPRESSED_FLAG); // English text: Huffman wins
+
+    LongText text;
+    TEST_ASSERT_TRUE(long_text_decode(payload, len, text));
+    TEST_ASSERT_EQUAL_STRING(LONG_MESSAGE, text.text);
+    TEST_ASSERT_TRUE(text.hasGps);
+    TEST_ASSERT_EQUAL_INT32(47376900, text.lat);
+    TEST_ASSERT_EQUAL_INT32(-8541700, text.lon);
+
+    // Digits: 6-bit packing, no position
+    len = long_text_encode("0123456789", false, 0, 0, payload, sizeof(payload));
+    TEST_ASSERT_EQUAL_INT(2 + 8, len);
+    TEST_ASSERT_EQUAL_HEX8(0x00, payload[1]);
+    TEST_ASSERT_TRUE(long_text_decode(payload, len, text));
+    TEST_ASSERT_EQUAL_STRING("0123456789", text.text);
+    TEST_ASSERT_FALSE(text.hasGps);
+}
+
+void test_long_text_wire_format(void)
+{
+    uint8_t payload[FRAGMENT_MAX_PAYLOAD];
+    int len = long_text_encode("HELLO WORLD", true, 47376900, 8541700, payload, sizeof(payload));
+    uint8_t frame[MAX_FRAME_SIZE];
+    int frameLen = fragment_frame(payload, len, 0x10, 0, frame);
+
+    // Same vector as ProtocolTest.testLongTextWireFormat on Android
+    const uint8_t expected[] = {
+        0x07, 0x10, 0x00,                         // Fragment 0 of 0, seq 16
+        0x0B, 0xC0,                               // 11 characters, Huffman coded, position
+        0xA9, 0xB5, 0x9C, 0x6C, 0xF7, 0xB5, 0x00, // Coded text
+        0x04, 0xEA, 0xD2, 0x02, 0x04, 0x56, 0x82, 0x00, // lat, lon (little-endian)
+    };
+    TEST_ASSERT_EQUAL_INT(sizeof(expected), frameLen);
+    TEST_ASSERT_EQUAL_UINT8_ARRAY(expected, frame, sizeof(expected));
+}
+
+void test_longest_text_fits_four_fragments(void)
+{
+    char text[LONG_TEXT_MAX_LENGTH + 2];
+    memset(text, '7', LONG_TEXT_MAX_LENGTH);
+    text[LONG_TEXT_MAX_LENGTH] = '\0';
+
+    uint8_t payload[FRAGMENT_MAX_PAYLOAD];
+    int len = long_text_encode(text, true, 1, 2, payload, sizeof(payload));
+    TEST_ASSERT_EQUAL_INT(2 + 150 + 8, len);
+    TEST_ASSERT_EQUAL_UINT8(4, fragment_count(len));
+    TEST_ASSERT_LESS_OR_EQUAL(MAX_AGGREGATE_SIZE, AGGREGATE_HEADER_SIZE + 4 * AggregateBuilder::cost(MAX_FRAME_SIZE));
+
+    // One character more, or one outside CHARSET, is refused
+    text[LONG_TEXT_MAX_LENGTH] = '7';
+    text[LONG_TEXT_MAX_LENGTH + 1] = '\0';
+    TEST_ASSERT_EQUAL_INT(-1, long_text_encode(text, false, 0, 0, payload, sizeof(payload)));
+    TEST_ASSERT_EQUAL_INT(-1, long_text_encode("BAD ~", false, 0, 0, payload, sizeof(payload)));
+    TEST_ASSERT_EQUAL_INT(-1, long_text_encode("HELLO", true, 0, 0, payload, 9)); // No room for the position
+}
+
+void test_malformed_long_text_is_rejected(void)
+{
+    uint8_t payload[FRAGMENT_MAX_PAYLOAD];
+    int len = long_text_encode("0123456789", false, 0, 0, payload, sizeof(payload));
+    LongText text;
+    TEST_ASSERT_FALSE(long_text_decode(payload, 1, text));
+    TEST_ASSERT_FALSE(long_text_decode(payload, len - 1, text)); // Packed text cut short
+
+    payload[1] = 0x20; // Unknown flag
+    TEST_ASSERT_FALSE(long_text_decode(payload, len, text));
+    payload[1] = LONG_TEXT_GPS_FLAG; // Position missing
+    TEST_ASSERT_FALSE(long_text_decode(payload, len, text));
+}
+
+void test_fragment_frames(void)
+{
+    uint8_t payload[100];
+    for (size_t i = 0; i < sizeof(payload); i++)
+    {
+        payload[i] = static_cast<uint8_t>(i);
+    }
+    TEST_ASSERT_EQUAL_UINT8(0, fragment_count(0));
+    TEST_ASSERT_EQUAL_UINT8(1, fragment_count(FRAGMENT_DATA_SIZE));
+    TEST_ASSERT_EQUAL_UINT8(3, fragment_count(sizeof(payload)));
+    TEST_ASSERT_EQUAL_UINT8(0, fragment_count(FRAGMENT_MAX_PAYLOAD + 1));
+
+    // 47 + 47 + 6 bytes, seqs 254, 255, 0
+    uint8_t frame[MAX_FRAME_SIZE];
+    TEST_ASSERT_EQUAL_INT(MAX_FRAME_SIZE, fragment_frame(payload, sizeof(payload), 254, 0, frame));
+    TEST_ASSERT_EQUAL_HEX8(0x07, frame[0]);
+    TEST_ASSERT_EQUAL_HEX8(254, frame[1]);
+    TEST_ASSERT_EQUAL_HEX8(0x02, frame[2]);
+    TEST_ASSERT_EQUAL_INT(FRAGMENT_HEADER_SIZE + 6, fragment_frame(payload, sizeof(payload), 254, 2, frame));
+    TEST_ASSERT_EQUAL_HEX8(0, frame[1]);
+    TEST_ASSERT_EQUAL_HEX8(0x22, frame[2]);
+    TEST_ASSERT_EQUAL_HEX8(94, frame[3]);
+    TEST_ASSERT_EQUAL_INT(-1, fragment_frame(payload, sizeof(payload), 254, 3, frame));
+}
+
+void test_reassembly_in_any_order(void)
+{
+    uint8_t payload[FRAGMENT_MAX_PAYLOAD];
+    int len = long_text_encode(LONG_MESSAGE, true, 47376900, 8541700, payload, sizeof(payload));
+    uint8_t count = fragment_count(len);
+    TEST_ASSERT_EQUAL_UINT8(2, count);
+
+    // Last fragment first, seqs wrap from 255 to 0
+    TEST_ASSERT_EQUAL(FragmentReassembler::Result::Pending, feed(1, payload, len, 255, 1, 1000));
+    TEST_ASSERT_EQUAL(FragmentReassembler::Result::Duplicate, feed(1, payload, len, 255, 1, 2000));
+    TEST_ASSERT_EQUAL_UINT8(1, reassembler.pending());
+    TEST_ASSERT_EQUAL(FragmentReassembler::Result::Complete, feed(1, payload, len, 255, 0, 3000));
+
+    TEST_ASSERT_EQUAL_UINT8(0, reassembler.pending());
+    TEST_ASSERT_EQUAL_UINT8(255, doneFirstSeq);
+    TEST_ASSERT_EQUAL_UINT8(count, doneCount);
+    TEST_ASSERT_EQUAL_INT(len, doneLen);
+    TEST_ASSERT_EQUAL_MEMORY(payload, donePayload, len);
+
+    LongText text;
+    TEST_ASSERT_TRUE(long_text_decode(donePayload, doneLen, text));
+    TEST_ASSERT_EQUAL_STRING(LONG_MESSAGE, text.text);
+    TEST_ASSERT_EQUAL_UINT32(0, reassembler.dropped());
+}
+
+void test_messages_of_senders_are_separate(void)
+{
+    uint8_t a[60];
+    uint8_t b[60];
+    memset(a, 0xAA, sizeof(a));
+    memset(b, 0xBB, sizeof(b));
+
+    // Same seqs from two peers: two messages
+    TEST_ASSERT_EQUAL(FragmentReassembler::Result::Pending, feed(1, a, sizeof(a), 10, 0, 1000));
+    TEST_ASSERT_EQUAL(FragmentReassembler::Result::Pending, feed(2, b, sizeof(b), 10, 1, 1000));
+    TEST_ASSERT_EQUAL_UINT8(2, reassembler.pending());
+    TEST_ASSERT_EQUAL(FragmentReassembler::Result::Complete, feed(2, b, sizeof(b), 10, 0, 2000));
+    TEST_ASSERT_EQUAL_MEMORY(b, donePayload, sizeof(b));
+    TEST_ASSERT_EQUAL(FragmentReassembler::Result::Complete, feed(1, a, sizeof(a), 10, 1, 2000));
+    TEST_ASSERT_EQUAL_MEMORY(a, donePayload, sizeof(a));
+}
+
+void test_incomplete_messages_expire_and_are_evicted(void)
+{
+    uint8_t payload[60];
+    memset(payload, 0x55, sizeof(payload));
+
+    TEST_ASSERT_EQUAL(FragmentReassembler::Result::Pending, feed(1, payload, sizeof(payload), 10, 0, 1000));
+    TEST_ASSERT_EQUAL_UINT8(0, reassembler.expire(1000 + FRAGMENT_REASSEMBLY_TIMEOUT_MS - 1));
+    TEST_ASSERT_EQUAL_UINT8(1, reassembler.expire(1000 + FRAGMENT_REASSEMBLY_TIMEOUT_MS));
+    TEST_ASSERT_EQUAL_UINT32(1, reassembler.dropped());
+
+    // The late fragment starts over instead of completing the dropped message
+    TEST_ASSERT_EQUAL(FragmentReassembler::Result::Pending,
+                      feed(1, payload, sizeof(payload), 10, 1, 2000 + FRAGMENT_REASSEMBLY_TIMEOUT_MS));
+    reassembler = FragmentReassembler();
+
+    // Every slot busy: the oldest message makes room
+    TEST_ASSERT_EQUAL(FragmentReassembler::Result::Pending, feed(1, payload, sizeof(payload), 20, 0, 1000));
+    TEST_ASSERT_EQUAL(FragmentReassembler::Result::Pending, feed(1, payload, sizeof(payload), 30, 0, 2000));
+    TEST_ASSERT_EQUAL(FragmentReassembler::Result::Pending, feed(1, payload, sizeof(payload), 40, 0, 3000));
+    TEST_ASSERT_EQUAL_UINT32(1, reassembler.dropped());
+    TEST_ASSERT_EQUAL(FragmentReassembler::Result::Pending, feed(1, payload, sizeof(payload), 20, 1, 4000));
+    TEST_ASSERT_EQUAL(FragmentReassembler::Result::Complete, feed(1, payload, sizeof(payload), 40, 1, 5000));
+}
+
+void test_invalid_fragments_are_rejected(void)
+{
+    const uint8_t *payload;
+    size_t len;
+    uint8_t firstSeq;
+    uint8_t count;
+
+    // Short middle fragment, index past the last one, not a fragment at all
+    uint8_t shortMiddle[] = {0x07, 5, 0x01, 'A', 'B'};
+    uint8_t pastLast[] = {0x07, 5, 0x21, 'A'};
+    uint8_t text[MAX_FRAME_SIZE];
+    int textLen = Message::createText(5, "HI").serialize(text, sizeof(text));
+    TEST_ASSERT_EQUAL(FragmentReassembler::Result::Invalid,
+                      reassembler.add(1, shortMiddle, sizeof(shortMiddle), 0, payload, len, firstSeq, count));
+    TEST_ASSERT_EQUAL(FragmentReassembler::Result::Invalid,
+                      reassembler.add(1, pastLast, sizeof(pastLast), 0, payload, len, firstSeq, count));
+    TEST_ASSERT_EQUAL(FragmentReassembler::Result::Invalid,
+                      reassembler.add(1, text, textLen, 0, payload, len, firstSeq, count));
+    TEST_ASSERT_EQUAL_UINT8(0, reassembler.pending());
+}
+
+int runUnityTests(void)
+{
+    UNITY_BEGIN();
+    RUN_TEST(test_long_text_round_trip);
+    RUN_TEST(test_long_text_wire_format);
+    RUN_TEST(test_longest_text_fits_four_fragments);
+    RUN_TEST(test_malformed_long_text_is_rejected);
+    RUN_TEST(test_fragment_frames);
+    RUN_TEST(test_reassembly_in_any_order);
+    RUN_TEST(test_messages_of_senders_are_separate);
+    RUN_TEST(test_incomplete_messages_expire_and_are_evicted);
+    RUN_TEST(test_invalid_fragments_are_rejected);
+    return UNITY_END();
+}
+
+#ifdef ARDUINO
+#include <Arduino.h>
+
+void setup()
+{
+    delay(2000); // Wait for the serial monitor to attach
+    runUnityTests();
+}
+
+void loop() {}
+#else
+int main(void)
+{
+    return runUnityTests();
+}
+#endif
@@ -0,0 +1,349 @@
+//! Host-side unit tests for the persistent store-and-forward buffer (shared/FrameStore)
+//!
+//! Run with: pio test -e native -f test_frame_store
+//!
+//! Flash is a RAM FrameStorage that survives "reboots" (a new FrameStore on the
+//! same storage) and can fail or tear appends. Time is simulated.
+#include <unity.h>
+#include <map>
+#include <vector>
+#include "FrameStore.h"
+
+class RamStorage : public FrameStorage
+{
+public:
+    std::map<uint32_t, std::vector<uint8_t>> segments;
+    bool hasCursor = false;
+    uint32_t cursorSegment = 0;
+    uint32_t cursorOffset = 0;
+    int appends = 0;
+    int cursorWrites = 0;
+    bool failAppends = false;
+    size_t tearAfter = SIZE_MAX; // Next append stops after this many bytes and fails
+
+    size_t listSegments(uint32_t *ids, size_t max) override
+    {
+        size_t count = 0;
+        for (auto it = segments.rbegin(); it != segments.rend() && count < max; ++it)
+        {
+            ids[count++] = it->first; // Newest first: the store must sort
+        }
+        return count;
+    }
+
+    int read(uint32_t segment, size_t offset, uint8_t *buf, size_t len) override
+    {
+        auto it = segments.find(segment);
+        if (it == segments.end())
+        {
+            return -1;
+        }
+        size_t available = offset < it->second.size() ? it->second.size() - offset : 0;
+        size_t n = len < available ? len : available;
+        memcpy(buf, it->second.data() + offset, n);
+        return static_cast<int>(n);
+    }
+
+    bool append(uint32_t segment, const uint8_t *data, size_t len) override
+    {
+        if (failAppends)
+        {
+            return false;
+        }
+        std::vector<uint8_t> &file = segments[segment];
+        if (tearAfter < len)
+        {
+            file.insert(file.end(), data, data + tearAfter);
+            tearAfter = SIZE_MAX;
+            return false;
+        }
+        file.insert(file.end(), data, data + len);
+        appends++;
+        return true;
+    }
+
+    bool remove(uint32_t segment) override
+    {
+        return segments.erase(segment) > 0;
+    }
+
+    bool writeCursor(uint32_t segment, uint32_t offset) override
+    {
+        hasCursor = true;
+        cursorSegment = segment;
+        cursorOffset = offset;
+        cursorWrites++;
+        return true;
+    }
+
+    bool readCursor(uint32_t &segment, uint32_t &offset) override
+    {
+        segment = cursorSegment;
+        offset = cursorOffset;
+        return hasCursor;
+    }
+};
+
+/// Text frame n (its seq, modulo 256); every frame of a size has the same length on the wire
+static WireFrame make_text(uint16_t n, size_t chars = 10)
+{
+    char text[MAX_TEXT_LENGTH + 1];
+    for (size_t i = 0; i < chars; i++)
+    {
+        text[i] = static_cast<char>('A' + i % 26);
+    }
+    text[chars] = '\0';
+    WireFrame frame;
+    frame.len = Message::createText(static_cast<uint8_t>(n), text).serialize(frame.data, sizeof(frame.data));
+    return frame;
+}
+
+static void assert_frame(uint16_t n, const WireFrame &frame, size_t chars = 10)
+{
+    WireFrame expected = make_text(n, chars);
+    TEST_ASSERT_EQUAL_UINT(expected.len, frame.len);
+    TEST_ASSERT_EQUAL_UINT8_ARRAY(expected.data, frame.data, expected.len);
+}
+
+/// Delivers up to n frames in peek/drop batches of 5, checking they continue from first
+static uint16_t deliver(FrameStore &store, uint16_t first, size_t n, uint32_t nowMs, size_t chars = 10)
+{
+    while (n > 0)
+    {
+        size_t batch = 0;
+        WireFrame frame;
+        while (batch < 5 && batch < n && store.peek(batch, frame))
+        {
+            assert_frame(first + batch, frame, chars);
+            batch++;
+        }
+        TEST_ASSERT_TRUE(batch > 0);
+        store.drop(batch, nowMs);
+        first += batch;
+        n -= batch;
+    }
+    return first;
+}
+
+void setUp(void) {}
+void tearDown(void) {}
+
+void test_record_format(void)
+{
+    WireFrame frame = make_text(7);
+    uint8_t record[FRAME_RECORD_MAX_SIZE];
+    size_t size = frame_record_encode(frame, record);
+    TEST_ASSERT_EQUAL_UINT(frame.len + FRAME_RECORD_OVERHEAD, size);
+
+    WireFrame decoded;
+    TEST_ASSERT_EQUAL_INT(size, frame_record_decode(record, size, decoded));
+    TEST_ASSERT_EQUAL_UINT8_ARRAY(frame.data, decoded.data, frame.len);
+
+    // Torn, damaged, erased and zeroed flash
+    TEST_ASSERT_EQUAL_INT(0, frame_record_decode(record, size - 1, decoded));
+    record[3] ^= 0x10;
+    TEST_ASSERT_EQUAL_INT(-1, frame_record_decode(record, size, decoded));
+    const uint8_t erased[4] = {0xFF, 0xFF, 0xFF, 0xFF};
+    TEST_ASSERT_EQUAL_INT(-1, frame_record_decode(erased, sizeof(erased), decoded));
+    const uint8_t zeroed[4] = {0x02, 0x00, 0x00, 0x00};
+    TEST_ASSERT_EQUAL_INT(-1, frame_record_decode(zeroed, sizeof(zeroed), decoded));
+}
+
+void test_frames_delivered_in_time_never_touch_flash(void)
+{
+    RamStorage flash;
+    FrameStore store(&flash);
+    TEST_ASSERT_EQUAL_UINT(0, store.begin());
+
+    for (uint16_t i = 0; i < 3; i++)
+    {
+        store.add(make_text(i), 1000);
+    }
+    TEST_ASSERT_EQUAL_UINT(3, store.count());
+    TEST_ASSERT_EQUAL_UINT32(FRAME_STORE_SYNC_DELAY_MS - 500, store.service(1500));
+
+    deliver(store, 0, 3, 2000);
+    TEST_ASSERT_TRUE(store.isEmpty());
+    TEST_ASSERT_EQUAL_UINT32(UINT32_MAX, store.service(1000 + FRAME_STORE_SYNC_DELAY_MS));
+    TEST_ASSERT_EQUAL_INT(0, flash.appends);
+    TEST_ASSERT_EQUAL_INT(0, flash.cursorWrites);
+}
+
+void test_batches_are_written_when_due_or_full(void)
+{
+    RamStorage flash;
+    FrameStore store(&flash);
+    store.begin();
+
+    // Idle frames: one append once the oldest is due
+    store.add(make_text(0), 0);
+    store.add(make_text(1), 4000);
+    TEST_ASSERT_EQUAL_UINT32(FRAME_STORE_SYNC_DELAY_MS - 5000, store.service(5000));
+    TEST_ASSERT_EQUAL_UINT32(UINT32_MAX, store.service(FRAME_STORE_SYNC_DELAY_MS));
+    TEST_ASSERT_EQUAL_INT(1, flash.appends);
+    TEST_ASSERT_EQUAL_UINT(2, store.storedCount());
+
+    // A burst: one append per full batch
+    uint32_t now = FRAME_STORE_SYNC_DELAY_MS;
+    for (uint16_t i = 2; i < 2 + 2 * FRAME_STORE_BATCH_FRAMES; i++)
+    {
+        store.add(make_text(i), now);
+    }
+    TEST_ASSERT_EQUAL_INT(2, flash.appends);
+    TEST_ASSERT_EQUAL_UINT(2 + FRAME_STORE_BATCH_FRAMES, store.storedCount());
+    TEST_ASSERT_EQUAL_UINT(2 + 2 * FRAME_STORE_BATCH_FRAMES, store.count());
+
+    // Stored and RAM frames come out as one queue
+    deliver(store, 0, store.count(), now);
+    TEST_ASSERT_TRUE(store.isEmpty());
+    TEST_ASSERT_TRUE(flash.segments.empty()); // Delivered segments are deleted
+}
+
+void test_recovers_after_reset(void)
+{
+    RamStorage flash;
+    {
+        FrameStore store(&flash);
+        store.begin();
+        for (uint16_t i = 0; i < 40; i++)
+        {
+            store.add(make_text(i), 0);
+        }
+        store.sync();
+        deliver(store, 0, 10, 100);
+        store.service(100 + FRAME_STORE_SYNC_DELAY_MS); // Records the deliveries
+        TEST_ASSERT_EQUAL_INT(1, flash.cursorWrites);
+
+        deliver(store, 10, 3, 200); // Not recorded yet
+        store.add(make_text(40), 200); // Not written yet
+    }
+
+    // At least once: recorded deliveries are skipped, the others come again
+    FrameStore rebooted(&flash);
+    TEST_ASSERT_EQUAL_UINT(30, rebooted.begin());
+    deliver(rebooted, 10, 30, 0);
+    TEST_ASSERT_TRUE(rebooted.isEmpty());
+}
+
+void test_torn_append_is_cut_off_and_sealed(void)
+{
+    RamStorage flash;
+    {
+        FrameStore store(&flash);
+        store.begin();
+        for (uint16_t i = 0; i < 4; i++)
+        {
+            store.add(make_text(i), 0);
+        }
+        store.sync();
+
+        // Reset in the middle of the next batch
+        store.add(make_text(4), 0);
+        store.add(make_text(5), 0);
+        flash.tearAfter = make_text(4).len + FRAME_RECORD_OVERHEAD + 3;
+        TEST_ASSERT_FALSE(store.sync());
+    }
+
+    FrameStore rebooted(&flash);
+    TEST_ASSERT_EQUAL_UINT(5, rebooted.begin());
+
+    // New frames go to a fresh segment, never behind the torn record
+    rebooted.add(make_text(6), 0);
+    TEST_ASSERT_TRUE(rebooted.sync());
+    TEST_ASSERT_EQUAL_UINT(2, flash.segments.size());
+
+    FrameStore again(&flash);
+    TEST_ASSERT_EQUAL_UINT(6, again.begin());
+    deliver(again, 0, 5, 0);
+    WireFrame frame;
+    TEST_ASSERT_TRUE(again.peek(0, frame));
+    assert_frame(6, frame);
+}
+
+void test_holds_thousands_and_drops_the_oldest_when_full(void)
+{
+    RamStorage flash;
+    FrameStore store(&flash);
+    store.begin();
+
+    // Full-size texts: a segment holds FRAME_STORE_SEGMENT_BYTES / record size of them
+    const size_t chars = MAX_TEXT_LENGTH;
+    const size_t recordSize = make_text(0, chars).len + FRAME_RECORD_OVERHEAD;
+    const size_t perSegment = FRAME_STORE_SEGMENT_BYTES / recordSize;
+    const size_t capacity = perSegment * FRAME_STORE_MAX_SEGMENTS;
+    TEST_ASSERT_TRUE(capacity >= 4000);
+
+    for (size_t i = 0; i < capacity + perSegment; i++)
+    {
+        store.add(make_text(static_cast<uint16_t>(i), chars), 0);
+    }
+    store.sync();
+    TEST_ASSERT_EQUAL_UINT(FRAME_STORE_MAX_SEGMENTS, flash.segments.size());
+    TEST_ASSERT_EQUAL_UINT32(perSegment, store.takeDropped());
+
+    FrameStore rebooted(&flash);
+    TEST_ASSERT_EQUAL_UINT(capacity, rebooted.begin());
+    deliver(rebooted, static_cast<uint16_t>(perSegment), 30, 0, chars);
+}
+
+void test_flash_errors_keep_frames_in_ram(void)
+{
+    RamStorage flash;
+    FrameStore store(&flash);
+    store.begin();
+
+    flash.failAppends = true;
+    for (uint16_t i = 0; i < FRAME_STORE_BATCH_FRAMES + 2; i++)
+    {
+        store.add(make_text(i), 0);
+    }
+    TEST_ASSERT_EQUAL_UINT32(FRAME_STORE_SYNC_DELAY_MS, store.service(FRAME_STORE_SYNC_DELAY_MS));
+    TEST_ASSERT_EQUAL_UINT(FRAME_STORE_BATCH_FRAMES, store.count());
+    TEST_ASSERT_EQUAL_UINT32(2, store.takeDropped());
+
+    flash.failAppends = false;
+    TEST_ASSERT_EQUAL_UINT32(UINT32_MAX, store.service(2 * FRAME_STORE_SYNC_DELAY_MS));
+    TEST_ASSERT_EQUAL_UINT(FRAME_STORE_BATCH_FRAMES, store.storedCount());
+    deliver(store, 2, FRAME_STORE_BATCH_FRAMES, 0);
+
+    // Without storage it is a small RAM buffer
+    FrameStore ramOnly(nullptr);
+    TEST_ASSERT_EQUAL_UINT(0, ramOnly.begin());
+    for (uint16_t i = 0; i < FRAME_STORE_BATCH_FRAMES + 1; i++)
+    {
+        ramOnly.add(make_text(i), 0);
+    }
+    TEST_ASSERT_EQUAL_UINT32(UINT32_MAX, ramOnly.service(FRAME_STORE_SYNC_DELAY_MS));
+    TEST_ASSERT_EQUAL_UINT32(1, ramOnly.takeDropped());
+    deliver(ramOnly, 1, FRAME_STORE_BATCH_FRAMES, 0);
+}
+
+int runUnityTests(void)
+{
+    UNITY_BEGIN();
+    RUN_TEST(test_record_format);
+    RUN_TEST(test_frames_delivered_in_time_never_touch_flash);
+    RUN_TEST(test_batches_are_written_when_due_or_full);
+    RUN_TEST(test_recovers_after_reset);
+    RUN_TEST(test_torn_append_is_cut_off_and_sealed);
+    RUN_TEST(test_holds_thousands_and_drops_the_oldest_when_full);
+    RUN_TEST(test_flash_errors_keep_frames_in_ram);
+    return UNITY_END();
+}
+
+#ifdef ARDUINO
+#include <Arduino.h>
+
+void setup()
+{
+    delay(2000); // Wait for the serial monitor to attach
+    runUnityTests();
+}
+
+void loop() {}
+#else
+int main(void)
+{
+    return runUnityTests();
+}
+#endif
@@ -0,0 +1,301 @@
+//! Fuzz harness for Message::deserialize
+//!
+//! Run with: pio test -e native_fuzz
+//! (native_fuzz builds with AddressSanitizer/UBSan so out-of-bounds reads fail loudly)
+//!
+//! Feeds deserialize with random buffers and with bit-flipped / truncated /
+//! extended copies of valid frames. Every accepted frame must decode to a
+//! well-formed Message that re-encodes and decodes back to the same Message.
+//! Every accepted aggregate must re-build byte-for-byte from its inner frames.
+//!
+//! FUZZ_ITERATIONS and FUZZ_SEED can be overridden with build flags.
+//! Defining PROTOCOL_LIBFUZZER instead exposes LLVMFuzzerTestOneInput for
+//! coverage-guided fuzzing with clang -fsanitize=fuzzer.
+#include "Protocol.h"
+
+/// Checks the aggregate container invariants. Returns false on violation.
+static bool check_aggregate(const uint8_t *data, size_t len)
+{
+    AggregateReader reader(data, len);
+    if (!reader.isValid())
+    {
+        return true; // Rejection is always acceptable
+    }
+
+    uint8_t rebuilt[MAX_AGGREGATE_SIZE];
+    AggregateBuilder builder(rebuilt, sizeof(rebuilt));
+    const uint8_t *frame;
+    size_t frameLen;
+    size_t frames = 0;
+    while (reader.next(frame, frameLen))
+    {
+        Message msg;
+        if (!msg.deserialize(frame, frameLen) || !builder.add(frame, frameLen))
+        {
+            return false; // Reader yielded a frame the decoder or builder refuses
+        }
+        frames++;
+    }
+    return frames == reader.count() && builder.size() == len && memcmp(rebuilt, data, len) == 0;
+}
+
+/// Checks the invariants of a single deserialize call. Returns false on violation.
+static bool check_frame(const uint8_t *data, size_t len)
+{
+    if (!check_aggregate(data, len))
+    {
+        return false;
+    }
+
+    Message msg;
+    bool accepted = msg.deserialize(data, len);
+
+    // The header-only check used for pass-through forwarding must agree with the full decoder
+    if (Message::isValidFrame(data, len) != accepted)
+    {
+        return false;
+    }
+
+    if (!accepted)
+    {
+        return true; // Rejection is always acceptable
+    }
+
+    // Accepted frames must re-encode, and decoding that encoding must give the same message
+    uint8_t out[64];
+    int outLen = msg.serialize(out, sizeof(out));
+    Message again;
+    if (outLen < 0 || !again.deserialize(out, outLen) || again.type != msg.type)
+    {
+        return false;
+    }
+
+    switch (msg.type)
+    {
+    case MessageType::Text:
+    {
+        size_t textLen = strnlen(msg.textData.text, sizeof(msg.textData.text));
+        if (textLen > MAX_TEXT_LENGTH || textLen != (data[2] & ~TEXT_COMPRESSED_FLAG))
+        {
+            return false; // Unterminated or wrong length text
+        }
+        return again.textData.seq == msg.textData.seq &&
+               strcmp(again.textData.text, msg.textData.text) == 0 &&
+               again.textData.hasGps == msg.textData.hasGps &&
+               again.textData.gpsEncoding == msg.textData.gpsEncoding &&
+               again.textData.lat == msg.textData.lat &&
+               again.textData.lon == msg.textData.lon;
+    }
+    case MessageType::Ack:
+        return outLen == 2 && memcmp(out, data, 2) == 0;
+    case MessageType::SelectiveAck:
+    case MessageType::DataRate:
+        return outLen == 3 && memcmp(out, data, 3) == 0;
+    case MessageType::Fragment:
+        return outLen == static_cast<int>(len) && memcmp(out, data, len) == 0;
+    case MessageType::Aggregate:
+    case MessageType::Relay:
+        return false; // Never produced by deserialize
+    }
+    return false;
+}
+
+#ifdef PROTOCOL_LIBFUZZER
+extern "C" int LLVMFuzzerTestOneInput(const uint8_t *data, size_t size)
+{
+    if (!check_frame(data, size))
+    {
+        __builtin_trap();
+    }
+    return 0;
+}
+#else
+#include <unity.h>
+#include <stdlib.h>
+
+#ifndef FUZZ_ITERATIONS
+#define FUZZ_ITERATIONS 200000
+#endif
+
+#ifndef FUZZ_SEED
+#define FUZZ_SEED 0xC0FFEE
+#endif
+
+/// Small xorshift PRNG so runs are reproducible across platforms
+static uint32_t fuzzState = FUZZ_SEED;
+
+static uint32_t next_random()
+{
+    fuzzState ^= fuzzState << 13;
+    fuzzState ^= fuzzState >> 17;
+    fuzzState ^= fuzzState << 5;
+    return fuzzState;
+}
+
+/// Serializes a random valid Text/Ack/SelectiveAck/DataRate/Fragment message into buf, returns its length
+static int random_message_frame(uint8_t *buf, size_t bufSize)
+{
+    switch (next_random() & 15)
+    {
+    case 0:
+    case 1:
+        return Message::createAck(next_random()).serialize(buf, bufSize);
+    case 2:
+        return Message::createSelectiveAck(next_random(), next_random()).serialize(buf, bufSize);
+    case 3:
+        return Message::createDataRate(static_cast<DataRateOp>(next_random() & 1), next_random()).serialize(buf, bufSize);
+    case 4:
+    {
+        // Any data, full unless it is the last fragment
+        uint8_t data[FRAGMENT_DATA_SIZE];
+        uint8_t last = next_random() % FRAGMENT_MAX_COUNT;
+        uint8_t index = next_random() % (last + 1);
+        size_t len = index == last ? 1 + next_random() % FRAGMENT_DATA_SIZE : FRAGMENT_DATA_SIZE;
+        for (size_t i = 0; i < len; i++)
+        {
+            data[i] = next_random();
+        }
+        return Message::createFragment(next_random(), index, last, data, len).serialize(buf, bufSize);
+    }
+    }
+
+    char text[MAX_TEXT_LENGTH + 1];
+    size_t len = next_random() % (MAX_TEXT_LENGTH + 1);
+    for (size_t i = 0; i < len; i++)
+    {
+        text[i] = CHARSET[next_random() % 64];
+    }
+    text[len] = '\0';
+
+    Message msg = (next_random() & 1)
+                      ? Message::createTextWithGps(next_random(), text, next_random(), next_random())
+                      : Message::createText(next_random(), text);
+    if (msg.textData.hasGps)
+    {
+        // Keyframe and Delta coordinates travel between bridges (offsets of up to 4 varint bytes each)
+        msg.textData.gpsEncoding = static_cast<GpsEncoding>(1 + next_random() % 3);
+        if (msg.textData.gpsEncoding == GpsEncoding::Delta)
+        {
+            msg.textData.lat = static_cast<int32_t>(next_random()) >> (8 + next_random() % 24);
+            msg.textData.lon = static_cast<int32_t>(next_random()) >> (8 + next_random() % 24);
+        }
+    }
+    return msg.serialize(buf, bufSize);
+}
+
+/// Random valid frame: mostly single messages, sometimes an aggregate of several
+static int random_valid_frame(uint8_t *buf, size_t bufSize)
+{
+    if ((next_random() & 7) != 0)
+    {
+        return random_message_frame(buf, bufSize);
+    }
+
+    AggregateBuilder builder(buf, bufSize);
+    for (int frames = 1 + next_random() % 6; frames > 0; frames--)
+    {
+        uint8_t frame[MAX_FRAME_SIZE];
+        int len = random_message_frame(frame, sizeof(frame));
+        if (!builder.add(frame, len))
+        {
+            break; // Budget reached
+        }
+    }
+    return builder.size();
+}
+
+void setUp(void) {}
+void tearDown(void) {}
+
+void test_fuzz_random_bytes(void)
+{
+    uint8_t buf[256];
+    for (uint32_t iter = 0; iter < FUZZ_ITERATIONS; iter++)
+    {
+        size_t len = next_random() % sizeof(buf);
+        for (size_t i = 0; i < len; i++)
+        {
+            buf[i] = next_random();
+        }
+        // Bias towards known types so the parsers (not just the type switch) get exercised
+        if (len > 0 && (next_random() & 1))
+        {
+            buf[0] = 1 + next_random() % 5;
+        }
+        TEST_ASSERT_TRUE(check_frame(buf, len));
+    }
+}
+
+void test_fuzz_mutated_valid_frames(void)
+{
+    uint8_t buf[256];
+    for (uint32_t iter = 0; iter < FUZZ_ITERATIONS; iter++)
+    {
+        int frameLen = random_valid_frame(buf, sizeof(buf));
+        TEST_ASSERT_GREATER_THAN(0, frameLen);
+        TEST_ASSERT_TRUE(check_frame(buf, frameLen));
+
+        size_t len = frameLen;
+        switch (next_random() % 4)
+        {
+        case 0: // Flip a few bits
+            for (int flips = 1 + next_random() % 4; flips > 0; flips--)
+            {
+                buf[next_random() % len] ^= 1 << (next_random() % 8);
+            }
+            break;
+        case 1: // Truncate
+            len = next_random() % len;
+            break;
+        case 2: // Append garbage
+        {
+            size_t extra = next_random() % (sizeof(buf) - len);
+            for (size_t i = 0; i < extra; i++)
+            {
+                buf[len + i] = next_random();
+            }
+            len += extra;
+            break;
+        }
+        case 3: // Corrupt a header length field
+            if (len > 3)
+            {
+                buf[2 + (next_random() & 1)] = next_random();
+            }
+            break;
+        }
+
+        // Heap copy of exactly len bytes so reads past the end trip ASan
+        uint8_t *exact = static_cast<uint8_t *>(malloc(len > 0 ? len : 1));
+        memcpy(exact, buf, len);
+        bool ok = check_frame(exact, len);
+        free(exact);
+        TEST_ASSERT_TRUE(ok);
+    }
+}
+
+int runUnityTests(void)
+{
+    UNITY_BEGIN();
+    RUN_TEST(test_fuzz_random_bytes);
+    RUN_TEST(test_fuzz_mutated_valid_frames);
+    return UNITY_END();
+}
+
+#ifdef ARDUINO
+#include <Arduino.h>
+
+void setup()
+{
+    delay(2000); // Wait for the serial monitor to attach
+    runUnityTests();
+}
+
+void loop() {}
+#else
+int main(void)
+{
+    return runUnityTests();
+}
+#endif
+#endif // PROTOCOL_LIBFUZZER
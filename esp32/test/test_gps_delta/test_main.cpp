@@ -0,0 +1,296 @@
+//! Host-side unit tests for the delta GPS coding between bridges (shared/GpsDelta)
+//!
+//! Run with: pio test -e native -f test_gps_delta
+//!
+//! The sender's ARQ is simulated by calling acknowledged()/dropped() directly.
+#include <unity.h>
+#include "GpsDelta.h"
+
+// Start of a walk, 1e-6 degree units
+static const int32_t START_LAT = 47376900;
+static const int32_t START_LON = 8541700;
+
+/// A GPS text from the app, as the bridge gets it over BLE
+static WireFrame app_frame(uint8_t seq, int32_t lat, int32_t lon, const char *text = "OK")
+{
+    WireFrame frame;
+    frame.len = Message::createTextWithGps(seq, text, lat, lon).serialize(frame.data, sizeof(frame.data));
+    return frame;
+}
+
+static GpsEncoding encoding_of(const WireFrame &frame)
+{
+    return static_cast<GpsEncoding>(frame.data[3] >> TEXT_GPS_SHIFT);
+}
+
+/// Runs a frame through the receiving bridge and checks it arrives as the app sent it
+static void assert_delivered(GpsDeltaDecoder &decoder, WireFrame frame, int32_t lat, int32_t lon)
+{
+    TEST_ASSERT_TRUE(Message::isValidFrame(frame.data, frame.len));
+    TEST_ASSERT_TRUE(decoder.decode(frame));
+
+    Message msg;
+    TEST_ASSERT_TRUE(msg.deserialize(frame.data, frame.len));
+    TEST_ASSERT_TRUE(msg.textData.gpsEncoding == GpsEncoding::Absolute);
+    TEST_ASSERT_EQUAL_INT32(lat, msg.textData.lat);
+    TEST_ASSERT_EQUAL_INT32(lon, msg.textData.lon);
+}
+
+void setUp(void) {}
+void tearDown(void) {}
+
+void test_varint_and_zigzag(void)
+{
+    TEST_ASSERT_EQUAL_UINT32(0, zigzag_encode(0));
+    TEST_ASSERT_EQUAL_UINT32(1, zigzag_encode(-1));
+    TEST_ASSERT_EQUAL_UINT32(2, zigzag_encode(1));
+    TEST_ASSERT_EQUAL_UINT32(UINT32_MAX, zigzag_encode(INT32_MIN));
+    TEST_ASSERT_EQUAL_INT32(INT32_MIN, zigzag_decode(UINT32_MAX));
+    TEST_ASSERT_EQUAL_INT32(-64, zigzag_decode(zigzag_encode(-64)));
+
+    // 300 = 0b10_0101100 -> AC 02
+    uint8_t buf[VARINT_MAX_SIZE];
+    TEST_ASSERT_EQUAL_UINT(2, write_varint(300, buf));
+    TEST_ASSERT_EQUAL_HEX8(0xAC, buf[0]);
+    TEST_ASSERT_EQUAL_HEX8(0x02, buf[1]);
+    uint32_t value = 0;
+    TEST_ASSERT_EQUAL_INT(2, read_varint(buf, 2, value));
+    TEST_ASSERT_EQUAL_UINT32(300, value);
+
+    // Truncated, and longer than 32 bits
+    TEST_ASSERT_EQUAL_INT(-1, read_varint(buf, 1, value));
+    const uint8_t tooLong[] = {0xFF, 0xFF, 0xFF, 0xFF, 0x1F};
+    TEST_ASSERT_EQUAL_INT(-1, read_varint(tooLong, sizeof(tooLong), value));
+    TEST_ASSERT_EQUAL_UINT(VARINT_MAX_SIZE, write_varint(UINT32_MAX, buf));
+    TEST_ASSERT_EQUAL_INT(VARINT_MAX_SIZE, read_varint(buf, sizeof(buf), value));
+    TEST_ASSERT_EQUAL_UINT32(UINT32_MAX, value);
+}
+
+void test_gps_flag_lives_in_the_header(void)
+{
+    WireFrame frame = app_frame(5, START_LAT, START_LON);
+    TEST_ASSERT_EQUAL_HEX8(static_cast<uint8_t>(GpsEncoding::Absolute) << TEXT_GPS_SHIFT | 2, frame.data[3]);
+    TEST_ASSERT_EQUAL_UINT(4 + 2 + GPS_ABSOLUTE_SIZE, frame.len);
+
+    // No GPS: no trailing byte at all
+    WireFrame plain;
+    plain.len = Message::createText(6, "OK").serialize(plain.data, sizeof(plain.data));
+    TEST_ASSERT_EQUAL_HEX8(2, plain.data[3]);
+    TEST_ASSERT_EQUAL_UINT(4 + 2, plain.len);
+}
+
+void test_deltas_follow_an_acknowledged_keyframe(void)
+{
+    GpsDeltaEncoder encoder;
+    GpsDeltaDecoder decoder;
+
+    // First position: keyframe, full size
+    WireFrame first = app_frame(1, START_LAT, START_LON);
+    encoder.encode(first);
+    TEST_ASSERT_TRUE(encoding_of(first) == GpsEncoding::Keyframe);
+    TEST_ASSERT_EQUAL_UINT(14, first.len);
+    assert_delivered(decoder, first, START_LAT, START_LON);
+
+    // Not acknowledged yet: the next one stays absolute
+    WireFrame early = app_frame(2, START_LAT + 10, START_LON);
+    encoder.encode(early);
+    TEST_ASSERT_TRUE(encoding_of(early) == GpsEncoding::Absolute);
+    assert_delivered(decoder, early, START_LAT + 10, START_LON);
+    encoder.acknowledged(2);
+    TEST_ASSERT_FALSE(encoder.hasReference());
+
+    encoder.acknowledged(1);
+    TEST_ASSERT_TRUE(encoder.hasReference());
+
+    // ~50 m north-east: 2 + 2 varint bytes instead of 8
+    WireFrame walked = app_frame(3, START_LAT + 450, START_LON - 660);
+    encoder.encode(walked);
+    TEST_ASSERT_TRUE(encoding_of(walked) == GpsEncoding::Delta);
+    TEST_ASSERT_EQUAL_UINT(10, walked.len);
+    assert_delivered(decoder, walked, START_LAT + 450, START_LON - 660);
+
+    // Standing still: one byte per axis
+    WireFrame still = app_frame(4, START_LAT, START_LON);
+    encoder.encode(still);
+    TEST_ASSERT_EQUAL_UINT(8, still.len);
+    assert_delivered(decoder, still, START_LAT, START_LON);
+}
+
+void test_keyframes_resync_periodically(void)
+{
+    GpsDeltaEncoder encoder;
+    WireFrame frame = app_frame(0, START_LAT, START_LON);
+    encoder.encode(frame);
+    encoder.acknowledged(0);
+
+    uint8_t seq = 1;
+    for (uint8_t i = 0; i < GPS_KEYFRAME_INTERVAL; i++, seq++)
+    {
+        frame = app_frame(seq, START_LAT + i, START_LON);
+        encoder.encode(frame);
+        TEST_ASSERT_TRUE(encoding_of(frame) == GpsEncoding::Delta);
+    }
+
+    // A new keyframe waits until every delta against the old one is settled
+    frame = app_frame(seq, START_LAT, START_LON);
+    encoder.encode(frame);
+    TEST_ASSERT_TRUE(encoding_of(frame) == GpsEncoding::Absolute);
+    for (uint8_t s = 1; s < seq; s++)
+    {
+        s % 2 ? encoder.acknowledged(s) : encoder.dropped(s);
+    }
+    frame = app_frame(++seq, START_LAT, START_LON);
+    encoder.encode(frame);
+    TEST_ASSERT_TRUE(encoding_of(frame) == GpsEncoding::Keyframe);
+}
+
+void test_far_positions_and_lost_keyframes(void)
+{
+    GpsDeltaEncoder encoder;
+    WireFrame frame = app_frame(1, START_LAT, START_LON);
+    encoder.encode(frame);
+    encoder.acknowledged(1);
+
+    // Across the globe the delta would be longer than absolute coordinates
+    frame = app_frame(2, -33868800, 151209300);
+    encoder.encode(frame);
+    TEST_ASSERT_TRUE(encoding_of(frame) == GpsEncoding::Keyframe);
+
+    // Given up: the peer may or may not hold it, so no deltas until a new keyframe is acknowledged
+    encoder.dropped(2);
+    TEST_ASSERT_FALSE(encoder.hasReference());
+    frame = app_frame(3, START_LAT, START_LON);
+    encoder.encode(frame);
+    TEST_ASSERT_TRUE(encoding_of(frame) == GpsEncoding::Keyframe);
+
+    // The app re-sends the same seq: the replaced keyframe no longer counts
+    WireFrame again = app_frame(3, START_LAT + 1, START_LON);
+    encoder.encode(again);
+    TEST_ASSERT_TRUE(encoding_of(again) == GpsEncoding::Keyframe);
+    encoder.acknowledged(3);
+    TEST_ASSERT_TRUE(encoder.hasReference());
+
+    // Frames without GPS are never touched
+    WireFrame plain;
+    plain.len = Message::createText(4, "NO FIX").serialize(plain.data, sizeof(plain.data));
+    WireFrame copy = plain;
+    encoder.encode(plain);
+    TEST_ASSERT_EQUAL_UINT(copy.len, plain.len);
+    TEST_ASSERT_EQUAL_UINT8_ARRAY(copy.data, plain.data, copy.len);
+}
+
+void test_decoder_without_reference_drops_the_position(void)
+{
+    GpsDeltaEncoder encoder;
+    GpsDeltaDecoder peer;
+    WireFrame frame = app_frame(1, START_LAT, START_LON);
+    encoder.encode(frame);
+    TEST_ASSERT_TRUE(peer.decode(frame)); // Peer stores the keyframe
+    encoder.acknowledged(1);
+
+    WireFrame delta = app_frame(2, START_LAT + 5, START_LON + 5, "HELLO");
+    encoder.encode(delta);
+
+    // Receiver rebooted: the text survives, the position does not
+    GpsDeltaDecoder rebooted;
+    TEST_ASSERT_FALSE(rebooted.decode(delta));
+    Message msg;
+    TEST_ASSERT_TRUE(msg.deserialize(delta.data, delta.len));
+    TEST_ASSERT_EQUAL_STRING("HELLO", msg.textData.text);
+    TEST_ASSERT_FALSE(msg.textData.hasGps);
+}
+
+void test_decoder_table_keeps_senders_apart(void)
+{
+    // Two bridges in range of one receiver, each with its own reference
+    const uint16_t NEAR = 0x100;
+    const uint16_t FAR = 7;
+    const int32_t FAR_LAT = START_LAT + 200000;
+    GpsDeltaEncoder nearEncoder;
+    GpsDeltaEncoder farEncoder;
+    GpsDeltaDecoderTable table;
+
+    WireFrame nearKey = app_frame(1, START_LAT, START_LON);
+    nearEncoder.encode(nearKey);
+    WireFrame farKey = app_frame(1, FAR_LAT, START_LON);
+    farEncoder.encode(farKey);
+    TEST_ASSERT_TRUE(encoding_of(farKey) == GpsEncoding::Keyframe);
+    TEST_ASSERT_TRUE(table.decode(NEAR, nearKey, 0));
+    TEST_ASSERT_TRUE(table.decode(FAR, farKey, 10));
+    nearEncoder.acknowledged(1);
+    farEncoder.acknowledged(1);
+
+    // Interleaved deltas, each expanded against its own sender's keyframe
+    for (uint8_t seq = 2; seq < 6; seq++)
+    {
+        WireFrame nearDelta = app_frame(seq, START_LAT + seq, START_LON - seq);
+        nearEncoder.encode(nearDelta);
+        WireFrame farDelta = app_frame(seq, FAR_LAT - seq, START_LON + seq);
+        farEncoder.encode(farDelta);
+        TEST_ASSERT_TRUE(encoding_of(nearDelta) == GpsEncoding::Delta);
+        TEST_ASSERT_TRUE(encoding_of(farDelta) == GpsEncoding::Delta);
+
+        WireFrame nearCopy = nearDelta;
+        TEST_ASSERT_TRUE(table.decode(NEAR, nearCopy, seq * 100));
+        Message msg;
+        TEST_ASSERT_TRUE(msg.deserialize(nearCopy.data, nearCopy.len));
+        TEST_ASSERT_EQUAL_INT32(START_LAT + seq, msg.textData.lat);
+        TEST_ASSERT_EQUAL_INT32(START_LON - seq, msg.textData.lon);
+
+        TEST_ASSERT_TRUE(table.decode(FAR, farDelta, seq * 100 + 50));
+        TEST_ASSERT_TRUE(msg.deserialize(farDelta.data, farDelta.len));
+        TEST_ASSERT_EQUAL_INT32(FAR_LAT - seq, msg.textData.lat);
+        TEST_ASSERT_EQUAL_INT32(START_LON + seq, msg.textData.lon);
+
+        nearEncoder.acknowledged(seq);
+        farEncoder.acknowledged(seq);
+    }
+
+    // A third sender's delta has no reference and is not expanded against either
+    WireFrame stranger = app_frame(9, FAR_LAT, START_LON);
+    farEncoder.encode(stranger);
+    TEST_ASSERT_TRUE(encoding_of(stranger) == GpsEncoding::Delta);
+    TEST_ASSERT_FALSE(table.decode(42, stranger, 1000));
+    TEST_ASSERT_FALSE(table.hasReference(42));
+
+    // Newer senders push out the least recently heard one, which then needs a new keyframe
+    for (uint16_t sender = 100; sender < 100 + GPS_DELTA_MAX_PEERS - 1; sender++)
+    {
+        WireFrame key = app_frame(1, START_LAT, START_LON);
+        GpsDeltaEncoder encoder;
+        encoder.encode(key);
+        TEST_ASSERT_TRUE(table.decode(sender, key, 2000 + sender));
+    }
+    TEST_ASSERT_FALSE(table.hasReference(NEAR));
+    TEST_ASSERT_TRUE(table.hasReference(FAR));
+}
+
+int runUnityTests(void)
+{
+    UNITY_BEGIN();
+    RUN_TEST(test_varint_and_zigzag);
+    RUN_TEST(test_gps_flag_lives_in_the_header);
+    RUN_TEST(test_deltas_follow_an_acknowledged_keyframe);
+    RUN_TEST(test_keyframes_resync_periodically);
+    RUN_TEST(test_far_positions_and_lost_keyframes);
+    RUN_TEST(test_decoder_without_reference_drops_the_position);
+    RUN_TEST(test_decoder_table_keeps_senders_apart);
+    return UNITY_END();
+}
+
+#ifdef ARDUINO
+#include <Arduino.h>
+
+void setup()
+{
+    delay(2000); // Wait for the serial monitor to attach
+    runUnityTests();
+}
+
+void loop() {}
+#else
+int main(void)
+{
+    return runUnityTests();
+}
+#endif
@@ -0,0 +1,158 @@
+//! Host-side unit tests for the link latency histograms and counters (shared/LinkStats)
+//!
+//! Run with: pio test -e native -f test_link_stats
+#include <unity.h>
+#include "LinkStats.h"
+
+static LinkStats stats;
+
+static uint32_t get32(const uint8_t *p)
+{
+    return (static_cast<uint32_t>(p[0]) << 24) | (static_cast<uint32_t>(p[1]) << 16) |
+           (static_cast<uint32_t>(p[2]) << 8) | p[3];
+}
+
+void setUp(void)
+{
+    stats.reset();
+}
+
+void tearDown(void) {}
+
+void test_bucket_edges(void)
+{
+    TEST_ASSERT_EQUAL_UINT8(0, LinkStats::bucketFor(0));
+    TEST_ASSERT_EQUAL_UINT8(0, LinkStats::bucketFor(15));
+    TEST_ASSERT_EQUAL_UINT8(1, LinkStats::bucketFor(16));
+    TEST_ASSERT_EQUAL_UINT8(1, LinkStats::bucketFor(31));
+    TEST_ASSERT_EQUAL_UINT8(2, LinkStats::bucketFor(32));
+    TEST_ASSERT_EQUAL_UINT8(10, LinkStats::bucketFor(LINK_STATS_FIRST_BUCKET_US << 9));
+    TEST_ASSERT_EQUAL_UINT8(LINK_STATS_BUCKETS - 2, LinkStats::bucketFor((LINK_STATS_FIRST_BUCKET_US << 18) - 1));
+
+    // Everything from the last edge up, wrapped clocks included
+    TEST_ASSERT_EQUAL_UINT8(LINK_STATS_BUCKETS - 1, LinkStats::bucketFor(LINK_STATS_FIRST_BUCKET_US << 18));
+    TEST_ASSERT_EQUAL_UINT8(LINK_STATS_BUCKETS - 1, LinkStats::bucketFor(UINT32_MAX));
+}
+
+void test_record_counts_and_keeps_the_maximum(void)
+{
+    stats.record(LinkStage::RxRead, 100);
+    stats.record(LinkStage::RxRead, 120);
+    stats.record(LinkStage::RxRead, 5000);
+    stats.record(LinkStage::TxAir, 7);
+
+    TEST_ASSERT_EQUAL_UINT32(3, stats.samples(LinkStage::RxRead));
+    TEST_ASSERT_EQUAL_UINT32(2, stats.bucket(LinkStage::RxRead, LinkStats::bucketFor(100)));
+    TEST_ASSERT_EQUAL_UINT32(1, stats.bucket(LinkStage::RxRead, LinkStats::bucketFor(5000)));
+    TEST_ASSERT_EQUAL_UINT32(5000, stats.maxUs(LinkStage::RxRead));
+    TEST_ASSERT_EQUAL_UINT32(7, stats.maxUs(LinkStage::TxAir));
+    TEST_ASSERT_EQUAL_UINT32(0, stats.samples(LinkStage::RxWake));
+}
+
+void test_percentile_reports_the_bucket_edge(void)
+{
+    TEST_ASSERT_EQUAL_UINT32(0, stats.percentileUs(LinkStage::RxProcess, 95));
+
+    for (int i = 0; i < 95; i++)
+    {
+        stats.record(LinkStage::RxProcess, 40); // Bucket [32, 64)
+    }
+    for (int i = 0; i < 5; i++)
+    {
+        stats.record(LinkStage::RxProcess, 900); // Bucket [512, 1024)
+    }
+    TEST_ASSERT_EQUAL_UINT32(64, stats.percentileUs(LinkStage::RxProcess, 50));
+    TEST_ASSERT_EQUAL_UINT32(64, stats.percentileUs(LinkStage::RxProcess, 95));
+    TEST_ASSERT_EQUAL_UINT32(1024, stats.percentileUs(LinkStage::RxProcess, 96));
+
+    // The last bucket has no upper edge: its samples report the maximum
+    stats.record(LinkStage::TxQueued, 10000000);
+    TEST_ASSERT_EQUAL_UINT32(10000000, stats.percentileUs(LinkStage::TxQueued, 50));
+}
+
+void test_counters(void)
+{
+    stats.count(LinkCounter::ArqRetransmit);
+    stats.count(LinkCounter::ArqRetransmit);
+    stats.count(LinkCounter::StoreDropped, 12);
+    stats.set(LinkCounter::RxCrcError, 40);
+    stats.set(LinkCounter::RxCrcError, 41); // Mirrored from elsewhere, not added
+
+    TEST_ASSERT_EQUAL_UINT32(2, stats.counter(LinkCounter::ArqRetransmit));
+    TEST_ASSERT_EQUAL_UINT32(12, stats.counter(LinkCounter::StoreDropped));
+    TEST_ASSERT_EQUAL_UINT32(41, stats.counter(LinkCounter::RxCrcError));
+    TEST_ASSERT_EQUAL_UINT32(0, stats.counter(LinkCounter::TxFailed));
+}
+
+void test_serialize_layout(void)
+{
+    stats.count(LinkCounter::RxRingFull, 3);
+    stats.count(LinkCounter::DuplicateText, 0x01020304);
+    stats.record(LinkStage::RxWake, 20);
+    stats.record(LinkStage::TxAir, 70000);
+    for (uint32_t i = 0; i < 70000; i++)
+    {
+        stats.record(LinkStage::BleNotify, 1);
+    }
+
+    uint8_t buf[LINK_STATS_SIZE];
+    TEST_ASSERT_EQUAL_UINT(0, stats.serialize(buf, sizeof(buf) - 1, 0));
+    TEST_ASSERT_EQUAL_UINT(LINK_STATS_SIZE, stats.serialize(buf, sizeof(buf), 3600));
+
+    const size_t counters = static_cast<size_t>(LinkCounter::Count);
+    const size_t stageSize = 4 + 2 * LINK_STATS_BUCKETS;
+    TEST_ASSERT_EQUAL_UINT8(LINK_STATS_VERSION, buf[0]);
+    TEST_ASSERT_EQUAL_UINT8(static_cast<uint8_t>(LinkStage::Count), buf[1]);
+    TEST_ASSERT_EQUAL_UINT8(LINK_STATS_BUCKETS, buf[2]);
+    TEST_ASSERT_EQUAL_UINT8(counters, buf[3]);
+    TEST_ASSERT_EQUAL_UINT32(3600, get32(buf + 4));
+
+    // Counters first, big-endian
+    const uint8_t *counter = buf + 8;
+    TEST_ASSERT_EQUAL_UINT32(3, get32(counter + 4 * static_cast<size_t>(LinkCounter::RxRingFull)));
+    const uint8_t duplicates[] = {1, 2, 3, 4};
+    TEST_ASSERT_EQUAL_HEX8_ARRAY(duplicates, counter + 4 * static_cast<size_t>(LinkCounter::DuplicateText), 4);
+
+    // Then per stage: maximum and bucket counts
+    const uint8_t *stage = counter + 4 * counters;
+    const uint8_t *wake = stage + stageSize * static_cast<size_t>(LinkStage::RxWake);
+    TEST_ASSERT_EQUAL_UINT32(20, get32(wake));
+    TEST_ASSERT_EQUAL_UINT8(1, wake[4 + 2 * LinkStats::bucketFor(20) + 1]);
+
+    const uint8_t *air = stage + stageSize * static_cast<size_t>(LinkStage::TxAir);
+    TEST_ASSERT_EQUAL_UINT32(70000, get32(air));
+
+    // Bucket counts saturate instead of wrapping
+    const uint8_t *notify = stage + stageSize * static_cast<size_t>(LinkStage::BleNotify);
+    TEST_ASSERT_EQUAL_HEX8(0xFF, notify[4]);
+    TEST_ASSERT_EQUAL_HEX8(0xFF, notify[5]);
+    TEST_ASSERT_EQUAL_UINT32(70000, stats.bucket(LinkStage::BleNotify, 0));
+}
+
+int runUnityTests(void)
+{
+    UNITY_BEGIN();
+    RUN_TEST(test_bucket_edges);
+    RUN_TEST(test_record_counts_and_keeps_the_maximum);
+    RUN_TEST(test_percentile_reports_the_bucket_edge);
+    RUN_TEST(test_counters);
+    RUN_TEST(test_serialize_layout);
+    return UNITY_END();
+}
+
+#ifdef ARDUINO
+#include <Arduino.h>
+
+void setup()
+{
+    delay(2000); // Wait for the serial monitor to attach
+    runUnityTests();
+}
+
+void loop() {}
+#else
+int main(void)
+{
+    return runUnityTests();
+}
+#endif
@@ -0,0 +1,671 @@
+//! Host-side unit tests for the shared Protocol library
+//!
+//! Run with: pio test -e native
+//!
+//! The reference_* functions below are the original bit-at-a-time codec
+//! (toupper + linear CHARSET scan). The table-driven codec must produce
+//! bit-identical output for every input, so the wire format never changes.
+#include <unity.h>
+#include <ctype.h>
+#include <stdlib.h>
+#include "Protocol.h"
+
+// --- Reference implementation (original codec, kept for equivalence checks) ---
+
+static int reference_char_to_6bit(char ch)
+{
+    char upper_ch = toupper(ch);
+    for (int i = 0; i < 64; i++)
+    {
+        if (CHARSET[i] == upper_ch)
+        {
+            return i;
+        }
+    }
+    return -1;
+}
+
+static int reference_pack_text(const char *text, uint8_t *output, size_t maxLen)
+{
+    size_t charCount = strlen(text);
+    size_t byteCount = (charCount * 6 + 7) / 8;
+
+    if (byteCount > maxLen)
+    {
+        return -1;
+    }
+
+    memset(output, 0, byteCount);
+
+    size_t bitOffset = 0;
+    for (size_t i = 0; i < charCount; i++)
+    {
+        int value = reference_char_to_6bit(text[i]);
+        if (value < 0)
+        {
+            return -1;
+        }
+
+        size_t byteIdx = bitOffset / 8;
+        size_t bitInByte = bitOffset % 8;
+
+        if (bitInByte <= 2)
+        {
+            output[byteIdx] |= (value << (2 - bitInByte));
+        }
+        else
+        {
+            size_t bitsInFirst = 8 - bitInByte;
+            size_t bitsInSecond = 6 - bitsInFirst;
+
+            output[byteIdx] |= (value >> bitsInSecond);
+            if (byteIdx + 1 < byteCount)
+            {
+                output[byteIdx + 1] |= (value << (8 - bitsInSecond));
+            }
+        }
+
+        bitOffset += 6;
+    }
+
+    return byteCount;
+}
+
+static bool reference_unpack_text(const uint8_t *packed, size_t packedLen, uint8_t charCount, char *output, size_t maxOutputLen)
+{
+    if (charCount >= maxOutputLen)
+    {
+        return false;
+    }
+
+    size_t bitOffset = 0;
+    for (uint8_t i = 0; i < charCount; i++)
+    {
+        size_t byteIdx = bitOffset / 8;
+        size_t bitInByte = bitOffset % 8;
+
+        if (byteIdx >= packedLen)
+        {
+            return false;
+        }
+
+        uint8_t value;
+        if (bitInByte <= 2)
+        {
+            value = (packed[byteIdx] >> (2 - bitInByte)) & 0x3F;
+        }
+        else
+        {
+            size_t bitsInFirst = 8 - bitInByte;
+            size_t bitsInSecond = 6 - bitsInFirst;
+
+            uint8_t firstPart = packed[byteIdx] & ((1 << bitsInFirst) - 1);
+            if (byteIdx + 1 >= packedLen)
+            {
+                return false;
+            }
+            uint8_t secondPart = packed[byteIdx + 1] >> (8 - bitsInSecond);
+            value = (firstPart << bitsInSecond) | secondPart;
+        }
+
+        output[i] = sixbit_to_char(value);
+        bitOffset += 6;
+    }
+
+    output[charCount] = '\0';
+    return true;
+}
+
+// --- Helpers ---
+
+/// Fills text with len random characters from CHARSET (mixed case)
+static void random_text(char *text, size_t len)
+{
+    for (size_t i = 0; i < len; i++)
+    {
+        char ch = CHARSET[rand() % 64];
+        if (ch >= 'A' && ch <= 'Z' && (rand() & 1))
+        {
+            ch = ch - 'A' + 'a';
+        }
+        text[i] = ch;
+    }
+    text[len] = '\0';
+}
+
+void setUp(void) {}
+void tearDown(void) {}
+
+// --- Codec equivalence ---
+
+void test_char_to_6bit_matches_reference_for_all_bytes(void)
+{
+    for (int b = 0; b < 256; b++)
+    {
+        char ch = static_cast<char>(b);
+        TEST_ASSERT_EQUAL_INT(reference_char_to_6bit(ch), char_to_6bit(ch));
+    }
+}
+
+void test_pack_text_matches_reference_all_lengths(void)
+{
+    srand(1234);
+    char text[MAX_TEXT_LENGTH + 1];
+    uint8_t expected[64];
+    uint8_t actual[64];
+
+    for (int round = 0; round < 200; round++)
+    {
+        for (size_t len = 0; len <= MAX_TEXT_LENGTH; len++)
+        {
+            random_text(text, len);
+            memset(expected, 0xAA, sizeof(expected));
+            memset(actual, 0x55, sizeof(actual));
+
+            int expectedLen = reference_pack_text(text, expected, sizeof(expected));
+            int actualLen = pack_text(text, actual, sizeof(actual));
+
+            TEST_ASSERT_EQUAL_INT(expectedLen, actualLen);
+            TEST_ASSERT_EQUAL_MEMORY(expected, actual, expectedLen);
+        }
+    }
+}
+
+void test_pack_text_rejects_invalid_characters(void)
+{
+    char text[MAX_TEXT_LENGTH + 1];
+    uint8_t out[64];
+    const char invalid[] = {'~', '\n', '\t', '\\', '`', '|', '^', static_cast<char>(0xC3)};
+
+    for (size_t len = 1; len <= MAX_TEXT_LENGTH; len++)
+    {
+        for (size_t pos = 0; pos < len; pos++)
+        {
+            random_text(text, len);
+            text[pos] = invalid[(len + pos) % sizeof(invalid)];
+            TEST_ASSERT_EQUAL_INT(-1, reference_pack_text(text, out, sizeof(out)));
+            TEST_ASSERT_EQUAL_INT(-1, pack_text(text, out, sizeof(out)));
+        }
+    }
+}
+
+void test_pack_text_rejects_small_buffer(void)
+{
+    uint8_t out[4];
+    TEST_ASSERT_EQUAL_INT(4, pack_text("HELLO", out, 4));
+    TEST_ASSERT_EQUAL_INT(-1, pack_text("HELLO", out, 3));
+}
+
+void test_unpack_text_matches_reference_random_bytes(void)
+{
+    srand(5678);
+    uint8_t packed[64];
+    char expected[MAX_TEXT_LENGTH + 1];
+    char actual[MAX_TEXT_LENGTH + 1];
+
+    for (int round = 0; round < 200; round++)
+    {
+        for (size_t i = 0; i < sizeof(packed); i++)
+        {
+            packed[i] = static_cast<uint8_t>(rand());
+        }
+
+        for (uint8_t charCount = 0; charCount <= MAX_TEXT_LENGTH + 1; charCount++)
+        {
+            size_t needed = (charCount * 6 + 7) / 8;
+            // Exercise exact, short-by-one and generous packed lengths
+            size_t lengths[] = {needed, needed > 0 ? needed - 1 : 0, needed + 3};
+            for (size_t packedLen : lengths)
+            {
+                bool expectedOk = reference_unpack_text(packed, packedLen, charCount, expected, sizeof(expected));
+                bool actualOk = unpack_text(packed, packedLen, charCount, actual, sizeof(actual));
+
+                TEST_ASSERT_EQUAL(expectedOk, actualOk);
+                if (expectedOk)
+                {
+                    TEST_ASSERT_EQUAL_STRING(expected, actual);
+                }
+            }
+        }
+    }
+}
+
+void test_pack_unpack_round_trip(void)
+{
+    const char *text = "Hello World, 123! <test> {ok} [x]=y+z/w_";
+    uint8_t packed[64];
+    char unpacked[MAX_TEXT_LENGTH + 1];
+
+    int packedLen = pack_text(text, packed, sizeof(packed));
+    TEST_ASSERT_EQUAL_INT((strlen(text) * 6 + 7) / 8, packedLen);
+    TEST_ASSERT_TRUE(unpack_text(packed, packedLen, strlen(text), unpacked, sizeof(unpacked)));
+    TEST_ASSERT_EQUAL_STRING("HELLO WORLD, 123! <TEST> {OK} [X]=Y+Z/W_", unpacked);
+}
+
+// --- Huffman text coding ---
+
+void test_compressed_round_trip_every_character(void)
+{
+    char text[2] = {0, 0};
+    uint8_t packed[4];
+    char unpacked[2];
+    for (int i = 0; i < 64; i++)
+    {
+        text[0] = CHARSET[i];
+        int packedLen = pack_text_compressed(text, packed, sizeof(packed));
+        TEST_ASSERT_EQUAL_INT(compressed_text_size(text), packedLen);
+        TEST_ASSERT_TRUE(unpack_text_compressed(packed, packedLen, 1, unpacked, sizeof(unpacked)));
+        TEST_ASSERT_EQUAL_STRING(text, unpacked);
+    }
+
+    const char *mixed = "Need water at camp 2, ETA 14:30? <ok> {x}=y+z/w_";
+    uint8_t buf[64];
+    char out[MAX_TEXT_LENGTH + 1];
+    int packedLen = pack_text_compressed(mixed, buf, sizeof(buf));
+    TEST_ASSERT_TRUE(packedLen > 0);
+    TEST_ASSERT_TRUE(unpack_text_compressed(buf, packedLen, strlen(mixed), out, sizeof(out)));
+    TEST_ASSERT_EQUAL_STRING("NEED WATER AT CAMP 2, ETA 14:30? <OK> {X}=Y+Z/W_", out);
+
+    // One byte short of the code, unsupported characters, small buffers
+    TEST_ASSERT_FALSE(unpack_text_compressed(buf, packedLen - 1, strlen(mixed), out, sizeof(out)));
+    TEST_ASSERT_EQUAL_INT(-1, compressed_text_size("TILDE~"));
+    TEST_ASSERT_EQUAL_INT(-1, pack_text_compressed("TILDE~", buf, sizeof(buf)));
+    TEST_ASSERT_EQUAL_INT(-1, pack_text_compressed(mixed, buf, packedLen - 1));
+}
+
+// --- Message wire format ---
+
+void test_text_message_wire_format(void)
+{
+    Message msg = Message::createText(1, "SOS");
+    uint8_t buf[64];
+    int len = msg.serialize(buf, sizeof(buf));
+
+    // Huffman: S=1000, O=0111 -> 1000 0111 1000 (0000 padding), 2 bytes instead of 3
+    // Same vector as ProtocolTest.testTextWireFormat on Android
+    const uint8_t expected[] = {0x01, 0x01, 0x83, 0x02, 0x87, 0x80};
+    TEST_ASSERT_EQUAL_INT(sizeof(expected), len);
+    TEST_ASSERT_EQUAL_MEMORY(expected, buf, sizeof(expected));
+
+    Message decoded;
+    TEST_ASSERT_TRUE(decoded.deserialize(buf, len));
+    TEST_ASSERT_EQUAL_STRING("SOS", decoded.textData.text);
+}
+
+void test_text_message_keeps_six_bit_when_smaller(void)
+{
+    // Digits cost 7 bits in the Huffman code: 6-bit packing wins, no flag
+    // '1'=28 ... '5'=32 -> 011100 011101 011110 011111 100000 (00 padding)
+    uint8_t buf[64];
+    int len = Message::createText(2, "12345").serialize(buf, sizeof(buf));
+    const uint8_t expected[] = {0x01, 0x02, 0x05, 0x04, 0x71, 0xD7, 0x9F, 0x80};
+    TEST_ASSERT_EQUAL_INT(sizeof(expected), len);
+    TEST_ASSERT_EQUAL_UINT8_ARRAY(expected, buf, sizeof(expected));
+
+    // Typical field message: 10 bytes instead of 14
+    len = Message::createText(3, "NEED WATER AT CAMP").serialize(buf, sizeof(buf));
+    TEST_ASSERT_EQUAL_HEX8(TEXT_COMPRESSED_FLAG | 18, buf[2]);
+    TEST_ASSERT_EQUAL_UINT8(10, buf[3]);
+    TEST_ASSERT_EQUAL_INT(4 + 10, len);
+}
+
+void test_text_message_with_gps_round_trip(void)
+{
+    Message msg = Message::createTextWithGps(5, "AT CHECKPOINT 2", 37774200, -122419200);
+    uint8_t buf[64];
+    int len = msg.serialize(buf, sizeof(buf));
+    TEST_ASSERT_EQUAL_INT(4 + 9 + 8, len); // 71 Huffman bits
+    TEST_ASSERT_EQUAL_HEX8(0x40 | 9, buf[3]); // GPS encoding Absolute, 9 packed bytes
+
+    Message decoded;
+    TEST_ASSERT_TRUE(decoded.deserialize(buf, len));
+    TEST_ASSERT_TRUE(decoded.type == MessageType::Text);
+    TEST_ASSERT_EQUAL_UINT8(5, decoded.textData.seq);
+    TEST_ASSERT_EQUAL_STRING("AT CHECKPOINT 2", decoded.textData.text);
+    TEST_ASSERT_TRUE(decoded.textData.hasGps);
+    TEST_ASSERT_EQUAL_INT32(37774200, decoded.textData.lat);
+    TEST_ASSERT_EQUAL_INT32(-122419200, decoded.textData.lon);
+
+    // Delta coordinates between bridges: zigzag varints, -1 -> 01, 300 -> D8 04
+    msg.textData.gpsEncoding = GpsEncoding::Delta;
+    msg.textData.lat = -1;
+    msg.textData.lon = 300;
+    len = msg.serialize(buf, sizeof(buf));
+    TEST_ASSERT_EQUAL_INT(4 + 9 + 3, len);
+    TEST_ASSERT_EQUAL_HEX8(0xC0 | 9, buf[3]);
+    const uint8_t offsets[] = {0x01, 0xD8, 0x04};
+    TEST_ASSERT_EQUAL_UINT8_ARRAY(offsets, buf + 13, sizeof(offsets));
+    TEST_ASSERT_TRUE(decoded.deserialize(buf, len));
+    TEST_ASSERT_TRUE(decoded.textData.gpsEncoding == GpsEncoding::Delta);
+    TEST_ASSERT_EQUAL_INT32(-1, decoded.textData.lat);
+    TEST_ASSERT_EQUAL_INT32(300, decoded.textData.lon);
+    TEST_ASSERT_FALSE(Message::isValidFrame(buf, len - 1)); // Second varint cut short
+}
+
+void test_max_length_message_size(void)
+{
+    // Digits: the 6-bit fallback bounds the frame size
+    char text[MAX_TEXT_LENGTH + 1];
+    memset(text, '7', MAX_TEXT_LENGTH);
+    text[MAX_TEXT_LENGTH] = '\0';
+
+    Message msg = Message::createTextWithGps(10, text, 1, 2);
+    uint8_t buf[64];
+    TEST_ASSERT_EQUAL_INT(50, msg.serialize(buf, sizeof(buf)));
+}
+
+void test_ack_message_round_trip(void)
+{
+    Message ack = Message::createAck(42);
+    uint8_t buf[64];
+    int len = ack.serialize(buf, sizeof(buf));
+    TEST_ASSERT_EQUAL_INT(2, len);
+    TEST_ASSERT_EQUAL_UINT8(0x02, buf[0]);
+    TEST_ASSERT_EQUAL_UINT8(42, buf[1]);
+
+    Message decoded;
+    TEST_ASSERT_TRUE(decoded.deserialize(buf, len));
+    TEST_ASSERT_TRUE(decoded.type == MessageType::Ack);
+    TEST_ASSERT_EQUAL_UINT8(42, decoded.ackData.seq);
+}
+
+void test_data_rate_wire_format(void)
+{
+    uint8_t buf[64];
+    int len = Message::createDataRate(DataRateOp::Accept, 3).serialize(buf, sizeof(buf));
+
+    // Same vector as ProtocolTest.testDataRateWireFormat on Android
+    const uint8_t expected[] = {0x05, 0x01, 0x03};
+    TEST_ASSERT_EQUAL_INT(sizeof(expected), len);
+    TEST_ASSERT_EQUAL_UINT8_ARRAY(expected, buf, sizeof(expected));
+
+    Message decoded;
+    TEST_ASSERT_TRUE(decoded.deserialize(buf, len));
+    TEST_ASSERT_TRUE(decoded.type == MessageType::DataRate);
+    TEST_ASSERT_TRUE(decoded.dataRateData.op == DataRateOp::Accept);
+    TEST_ASSERT_EQUAL_UINT8(3, decoded.dataRateData.rate);
+    TEST_ASSERT_FALSE(Message::isValidFrame(buf, 2));
+
+    // Unknown operations are rejected
+    const uint8_t badOp[] = {0x05, 0x02, 0x03};
+    TEST_ASSERT_FALSE(decoded.deserialize(badOp, sizeof(badOp)));
+    TEST_ASSERT_FALSE(Message::isValidFrame(badOp, sizeof(badOp)));
+}
+
+void test_selective_ack_wire_format(void)
+{
+    uint8_t buf[64];
+    int len = Message::createSelectiveAck(9, 0x05).serialize(buf, sizeof(buf));
+
+    // Same vector as ProtocolTest.testSelectiveAckWireFormat on Android
+    const uint8_t expected[] = {0x04, 0x09, 0x05};
+    TEST_ASSERT_EQUAL_INT(sizeof(expected), len);
+    TEST_ASSERT_EQUAL_UINT8_ARRAY(expected, buf, sizeof(expected));
+
+    Message decoded;
+    TEST_ASSERT_TRUE(decoded.deserialize(buf, len));
+    TEST_ASSERT_TRUE(decoded.type == MessageType::SelectiveAck);
+    TEST_ASSERT_EQUAL_UINT8(9, decoded.selectiveAckData.cumulative);
+    TEST_ASSERT_EQUAL_UINT8(0x05, decoded.selectiveAckData.bitmap);
+    TEST_ASSERT_FALSE(decoded.deserialize(buf, 2));
+    TEST_ASSERT_FALSE(Message::isValidFrame(buf, 2));
+
+    // Packs into aggregates like any other frame
+    uint8_t aggregate[MAX_AGGREGATE_SIZE];
+    AggregateBuilder builder(aggregate, sizeof(aggregate));
+    TEST_ASSERT_TRUE(builder.add(buf, len));
+    TEST_ASSERT_TRUE(builder.add(buf, len));
+    TEST_ASSERT_TRUE(AggregateReader::isValidAggregate(aggregate, builder.size()));
+}
+
+void test_fragment_wire_format(void)
+{
+    uint8_t buf[64];
+    const uint8_t data[] = {0xDE, 0xAD};
+    int len = Message::createFragment(0x2A, 2, 2, data, sizeof(data)).serialize(buf, sizeof(buf));
+
+    // Same vector as ProtocolTest.testFragmentWireFormat on Android
+    const uint8_t expected[] = {0x07, 0x2A, 0x22, 0xDE, 0xAD};
+    TEST_ASSERT_EQUAL_INT(sizeof(expected), len);
+    TEST_ASSERT_EQUAL_UINT8_ARRAY(expected, buf, sizeof(expected));
+
+    Message decoded;
+    TEST_ASSERT_TRUE(decoded.deserialize(buf, len));
+    TEST_ASSERT_TRUE(decoded.type == MessageType::Fragment);
+    TEST_ASSERT_EQUAL_UINT8(0x2A, decoded.fragmentData.seq);
+    TEST_ASSERT_EQUAL_UINT8(2, decoded.fragmentData.index);
+    TEST_ASSERT_EQUAL_UINT8(2, decoded.fragmentData.last);
+    TEST_ASSERT_EQUAL_UINT8(2, decoded.fragmentData.len);
+    TEST_ASSERT_EQUAL_UINT8_ARRAY(data, decoded.fragmentData.data, sizeof(data));
+
+    // Only the last fragment may be short, it holds at least one byte, indexes stay below FRAGMENT_MAX_COUNT
+    const uint8_t bad[][5] = {
+        {0x07, 0x2A, 0x12, 0xDE, 0xAD}, // Short middle fragment
+        {0x07, 0x2A, 0x32, 0xDE, 0xAD}, // Index past the last one
+        {0x07, 0x2A, 0x88, 0xDE, 0xAD}, // Ninth fragment
+    };
+    for (const uint8_t *frame : bad)
+    {
+        TEST_ASSERT_FALSE(decoded.deserialize(frame, sizeof(bad[0])));
+        TEST_ASSERT_FALSE(Message::isValidFrame(frame, sizeof(bad[0])));
+    }
+    TEST_ASSERT_FALSE(decoded.deserialize(buf, FRAGMENT_HEADER_SIZE)); // Empty last fragment
+    TEST_ASSERT_FALSE(Message::isValidFrame(buf, FRAGMENT_HEADER_SIZE));
+    TEST_ASSERT_EQUAL_INT(-1, Message::createFragment(1, 0, 1, data, sizeof(data)).serialize(buf, sizeof(buf)));
+
+    // A full fragment is exactly one wire frame
+    uint8_t full[FRAGMENT_DATA_SIZE] = {0};
+    len = Message::createFragment(1, 0, 1, full, sizeof(full)).serialize(buf, sizeof(buf));
+    TEST_ASSERT_EQUAL_INT(MAX_FRAME_SIZE, len);
+    TEST_ASSERT_TRUE(Message::isValidFrame(buf, len));
+}
+
+void test_deserialize_rejects_truncated_frames(void)
+{
+    Message msg = Message::createTextWithGps(7, "TRUNCATED", 100, 200);
+    uint8_t buf[64];
+    int len = msg.serialize(buf, sizeof(buf));
+
+    Message decoded;
+    for (int cut = 0; cut < len; cut++)
+    {
+        TEST_ASSERT_FALSE(decoded.deserialize(buf, cut));
+    }
+    TEST_ASSERT_TRUE(decoded.deserialize(buf, len));
+}
+
+void test_is_valid_frame_matches_deserialize(void)
+{
+    uint8_t buf[64];
+    int len = Message::createTextWithGps(3, "PASS THROUGH", 1, 2).serialize(buf, sizeof(buf));
+
+    Message decoded;
+    for (int cut = 0; cut <= len; cut++)
+    {
+        TEST_ASSERT_EQUAL(decoded.deserialize(buf, cut), Message::isValidFrame(buf, cut));
+    }
+
+    // Character count beyond MAX_TEXT_LENGTH is rejected by both
+    buf[2] = MAX_TEXT_LENGTH + 1;
+    buf[3] = 40;
+    TEST_ASSERT_FALSE(Message::isValidFrame(buf, sizeof(buf)));
+    TEST_ASSERT_FALSE(decoded.deserialize(buf, sizeof(buf)));
+
+    // Huffman text: the code has to fit into packedLen, whatever the frame length
+    len = Message::createText(4, "PASS THROUGH").serialize(buf, sizeof(buf));
+    TEST_ASSERT_TRUE(Message::isValidFrame(buf, len));
+    buf[2]++; // One character more than coded
+    TEST_ASSERT_EQUAL(decoded.deserialize(buf, len), Message::isValidFrame(buf, len));
+    buf[2] += 10;
+    TEST_ASSERT_FALSE(Message::isValidFrame(buf, len));
+    TEST_ASSERT_FALSE(decoded.deserialize(buf, len));
+
+    const uint8_t ack[] = {0x02, 0x09};
+    TEST_ASSERT_TRUE(Message::isValidFrame(ack, sizeof(ack)));
+    TEST_ASSERT_FALSE(Message::isValidFrame(ack, 1));
+
+    const uint8_t unknown[] = {0x7F, 0x00};
+    TEST_ASSERT_FALSE(Message::isValidFrame(unknown, sizeof(unknown)));
+}
+
+void test_wire_frame_holds_largest_message(void)
+{
+    char text[MAX_TEXT_LENGTH + 1];
+    memset(text, 'Z', MAX_TEXT_LENGTH);
+    text[MAX_TEXT_LENGTH] = '\0';
+
+    WireFrame frame;
+    int len = Message::createTextWithGps(1, text, -1, -1).serialize(frame.data, sizeof(frame.data));
+    TEST_ASSERT_EQUAL_INT(MAX_FRAME_SIZE, len);
+
+    // Queue items must be smaller than the decoded representation
+    TEST_ASSERT_TRUE(sizeof(WireFrame) < sizeof(Message));
+}
+
+void test_aggregate_wire_format(void)
+{
+    uint8_t ack[2];
+    uint8_t text[MAX_FRAME_SIZE];
+    int ackLen = Message::createAck(5).serialize(ack, sizeof(ack));
+    int textLen = Message::createText(1, "SOS").serialize(text, sizeof(text));
+
+    uint8_t buf[MAX_AGGREGATE_SIZE];
+    AggregateBuilder builder(buf, sizeof(buf));
+    TEST_ASSERT_TRUE(builder.add(ack, ackLen));
+    TEST_ASSERT_TRUE(builder.add(text, textLen));
+
+    // Same vector as ProtocolTest.testAggregateWireFormat on Android
+    const uint8_t expected[] = {0x03, 0x02, 0x02, 0x02, 0x05, 0x06, 0x01, 0x01, 0x83, 0x02, 0x87, 0x80};
+    const uint8_t *frame = nullptr;
+    size_t len = builder.finish(frame);
+    TEST_ASSERT_EQUAL_UINT(sizeof(expected), len);
+    TEST_ASSERT_EQUAL_UINT8_ARRAY(expected, frame, sizeof(expected));
+
+    AggregateReader reader(frame, len);
+    TEST_ASSERT_TRUE(reader.isValid());
+    TEST_ASSERT_EQUAL_UINT8(2, reader.count());
+
+    const uint8_t *inner;
+    size_t innerLen;
+    Message msg;
+    TEST_ASSERT_TRUE(reader.next(inner, innerLen));
+    TEST_ASSERT_TRUE(msg.deserialize(inner, innerLen));
+    TEST_ASSERT_EQUAL(MessageType::Ack, msg.type);
+    TEST_ASSERT_EQUAL_UINT8(5, msg.ackData.seq);
+    TEST_ASSERT_TRUE(reader.next(inner, innerLen));
+    TEST_ASSERT_TRUE(msg.deserialize(inner, innerLen));
+    TEST_ASSERT_EQUAL_STRING("SOS", msg.textData.text);
+    TEST_ASSERT_FALSE(reader.next(inner, innerLen));
+}
+
+void test_aggregate_respects_budget(void)
+{
+    uint8_t ack[2] = {0x02, 0x00};
+    uint8_t buf[16];
+    AggregateBuilder builder(buf, sizeof(buf));
+
+    // 2 header bytes + 3 bytes per ACK: four fit in 16 bytes, the fifth does not
+    for (uint8_t seq = 0; seq < 4; seq++)
+    {
+        ack[1] = seq;
+        TEST_ASSERT_TRUE(builder.add(ack, sizeof(ack)));
+    }
+    TEST_ASSERT_FALSE(builder.fits(sizeof(ack)));
+    TEST_ASSERT_FALSE(builder.add(ack, sizeof(ack)));
+    TEST_ASSERT_EQUAL_UINT8(4, builder.count());
+    TEST_ASSERT_EQUAL_UINT(14, builder.size());
+    TEST_ASSERT_TRUE(AggregateReader::isValidAggregate(buf, builder.size()));
+
+    builder.clear();
+    const uint8_t *frame;
+    TEST_ASSERT_EQUAL_UINT(0, builder.finish(frame));
+}
+
+void test_aggregate_single_frame_is_sent_bare(void)
+{
+    uint8_t ack[2] = {0x02, 0x2A};
+    uint8_t buf[MAX_AGGREGATE_SIZE];
+    AggregateBuilder builder(buf, sizeof(buf));
+    TEST_ASSERT_TRUE(builder.add(ack, sizeof(ack)));
+
+    const uint8_t *frame = nullptr;
+    TEST_ASSERT_EQUAL_UINT(2, builder.finish(frame));
+    TEST_ASSERT_EQUAL_UINT8_ARRAY(ack, frame, 2);
+}
+
+void test_aggregate_rejects_malformed(void)
+{
+    uint8_t buf[MAX_AGGREGATE_SIZE];
+    AggregateBuilder builder(buf, sizeof(buf));
+
+    // Invalid inner frames and nested aggregates are refused by the builder
+    const uint8_t badText[] = {0x01, 0x01, 0x05, 0x01, 0x00};
+    const uint8_t nested[] = {0x03, 0x01, 0x02, 0x02, 0x01};
+    TEST_ASSERT_FALSE(builder.add(badText, sizeof(badText)));
+    TEST_ASSERT_FALSE(builder.add(nested, sizeof(nested)));
+    TEST_ASSERT_EQUAL_UINT8(0, builder.count());
+
+    const uint8_t valid[] = {0x03, 0x02, 0x02, 0x02, 0x01, 0x02, 0x02, 0x02};
+    TEST_ASSERT_TRUE(AggregateReader::isValidAggregate(valid, sizeof(valid)));
+
+    const uint8_t empty[] = {0x03, 0x00};
+    const uint8_t countTooHigh[] = {0x03, 0x03, 0x02, 0x02, 0x01, 0x02, 0x02, 0x02};
+    const uint8_t trailing[] = {0x03, 0x01, 0x02, 0x02, 0x01, 0x00};
+    const uint8_t innerOverrun[] = {0x03, 0x01, 0x05, 0x02, 0x01};
+    const uint8_t nestedInner[] = {0x03, 0x01, 0x05, 0x03, 0x01, 0x02, 0x02, 0x01};
+    TEST_ASSERT_FALSE(AggregateReader::isValidAggregate(empty, sizeof(empty)));
+    TEST_ASSERT_FALSE(AggregateReader::isValidAggregate(countTooHigh, sizeof(countTooHigh)));
+    TEST_ASSERT_FALSE(AggregateReader::isValidAggregate(trailing, sizeof(trailing)));
+    TEST_ASSERT_FALSE(AggregateReader::isValidAggregate(innerOverrun, sizeof(innerOverrun)));
+    TEST_ASSERT_FALSE(AggregateReader::isValidAggregate(nestedInner, sizeof(nestedInner)));
+
+    // Aggregates are not single messages
+    Message msg;
+    TEST_ASSERT_FALSE(Message::isValidFrame(valid, sizeof(valid)));
+    TEST_ASSERT_FALSE(msg.deserialize(valid, sizeof(valid)));
+}
+
+int runUnityTests(void)
+{
+    UNITY_BEGIN();
+    RUN_TEST(test_char_to_6bit_matches_reference_for_all_bytes);
+    RUN_TEST(test_pack_text_matches_reference_all_lengths);
+    RUN_TEST(test_pack_text_rejects_invalid_characters);
+    RUN_TEST(test_pack_text_rejects_small_buffer);
+    RUN_TEST(test_unpack_text_matches_reference_random_bytes);
+    RUN_TEST(test_pack_unpack_round_trip);
+    RUN_TEST(test_compressed_round_trip_every_character);
+    RUN_TEST(test_text_message_wire_format);
+    RUN_TEST(test_text_message_keeps_six_bit_when_smaller);
+    RUN_TEST(test_text_message_with_gps_round_trip);
+    RUN_TEST(test_max_length_message_size);
+    RUN_TEST(test_ack_message_round_trip);
+    RUN_TEST(test_selective_ack_wire_format);
+    RUN_TEST(test_fragment_wire_format);
+    RUN_TEST(test_data_rate_wire_format);
+    RUN_TEST(test_deserialize_rejects_truncated_frames);
+    RUN_TEST(test_is_valid_frame_matches_deserialize);
+    RUN_TEST(test_wire_frame_holds_largest_message);
+    RUN_TEST(test_aggregate_wire_format);
+    RUN_TEST(test_aggregate_respects_budget);
+    RUN_TEST(test_aggregate_single_frame_is_sent_bare);
+    RUN_TEST(test_aggregate_rejects_malformed);
+    return UNITY_END();
+}
+
+#ifdef ARDUINO
+#include <Arduino.h>
+
+void setup()
+{
+    delay(2000); // Wait for the serial monitor to attach
+    runUnityTests();
+}
+
+void loop() {}
+#else
+int main(void)
+{
+    return runUnityTests();
+}
+#endif
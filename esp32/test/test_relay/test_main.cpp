@@ -0,0 +1,232 @@
+//! Host-side unit tests for the multi-hop relay header and managed flooding (shared/Relay)
+//!
+//! Run with: pio test -e native -f test_relay
+#include <unity.h>
+#include "Relay.h"
+
+// 1 ms of airtime per byte keeps the backoff arithmetic readable
+static uint32_t fake_airtime(size_t len)
+{
+    return static_cast<uint32_t>(len);
+}
+
+static const uint8_t THIS_NODE = 1;
+static const float FAR_SNR = -20.0f;
+static const float NEAR_SNR = 10.0f;
+
+static RelayRouter router(fake_airtime, 3);
+
+// A relayed text from origin as another node would send it
+static size_t make_relayed_text(uint8_t origin, uint8_t ttl, uint8_t packetId, const char *text, uint8_t *out)
+{
+    uint8_t frame[MAX_FRAME_SIZE];
+    int len = Message::createText(packetId, text).serialize(frame, sizeof(frame));
+    RelayHeader header = {origin, ttl, packetId};
+    return relay_wrap(header, frame, len, out);
+}
+
+static size_t make_relayed_ack(uint8_t origin, uint8_t packetId, uint8_t cumulative, uint8_t *out)
+{
+    uint8_t frame[3];
+    int len = Message::createSelectiveAck(cumulative, 0).serialize(frame, sizeof(frame));
+    RelayHeader header = {origin, 2, packetId};
+    return relay_wrap(header, frame, len, out);
+}
+
+static RelayRouter::Verdict hear(const uint8_t *buf, size_t len, float snr, uint32_t nowMs)
+{
+    RelayHeader header;
+    const uint8_t *packet;
+    size_t packetLen;
+    return router.receive(buf, len, snr, nowMs, header, packet, packetLen);
+}
+
+void setUp(void)
+{
+    router = RelayRouter(fake_airtime, 3);
+    router.begin(THIS_NODE, 200);
+}
+
+void tearDown(void) {}
+
+void test_header_round_trip_and_validation(void)
+{
+    uint8_t frame[MAX_FRAME_SIZE];
+    int frameLen = Message::createText(5, "HELLO").serialize(frame, sizeof(frame));
+    uint8_t buf[MAX_AGGREGATE_SIZE];
+
+    size_t len = router.wrap(frame, frameLen, buf);
+    TEST_ASSERT_EQUAL_UINT(RELAY_HEADER_SIZE + frameLen, len);
+    TEST_ASSERT_EQUAL_HEX8(static_cast<uint8_t>(MessageType::Relay), buf[0]);
+
+    RelayHeader header;
+    const uint8_t *packet;
+    size_t packetLen;
+    TEST_ASSERT_TRUE(relay_unwrap(buf, len, header, packet, packetLen));
+    TEST_ASSERT_EQUAL_UINT8(THIS_NODE, header.origin);
+    TEST_ASSERT_EQUAL_UINT8(3, header.ttl);
+    TEST_ASSERT_EQUAL_UINT8(200, header.packetId);
+    TEST_ASSERT_EQUAL_UINT(frameLen, packetLen);
+    TEST_ASSERT_EQUAL_UINT8_ARRAY(frame, packet, frameLen);
+
+    // Packet ids count up per packet
+    router.wrap(frame, frameLen, buf);
+    TEST_ASSERT_EQUAL_UINT8(201, buf[3]);
+
+    // Truncated, empty, nested or too long: never relayed
+    TEST_ASSERT_FALSE(relay_unwrap(buf, len - 1, header, packet, packetLen));
+    TEST_ASSERT_FALSE(relay_unwrap(buf, RELAY_HEADER_SIZE, header, packet, packetLen));
+    uint8_t nested[MAX_AGGREGATE_SIZE];
+    size_t nestedLen = relay_wrap(header, buf, len, nested);
+    TEST_ASSERT_FALSE(relay_unwrap(nested, nestedLen, header, packet, packetLen));
+    TEST_ASSERT_EQUAL_UINT(0, relay_wrap(header, nested, MAX_AGGREGATE_SIZE - RELAY_HEADER_SIZE + 1, buf));
+}
+
+void test_backoff_lets_distant_nodes_go_first(void)
+{
+    uint32_t farMs = relay_backoff_ms(FAR_SNR, 1000, 0);
+    uint32_t midMs = relay_backoff_ms(-5.0f, 1000, 0);
+    uint32_t nearMs = relay_backoff_ms(NEAR_SNR, 1000, 0);
+    TEST_ASSERT_EQUAL_UINT32(0, farMs);
+    TEST_ASSERT_EQUAL_UINT32(RELAY_BACKOFF_SLOTS * 1000 / 2, midMs);
+    TEST_ASSERT_EQUAL_UINT32(RELAY_BACKOFF_SLOTS * 1000, nearMs);
+
+    // Jitter stays within one airtime
+    TEST_ASSERT_EQUAL_UINT32(999, relay_backoff_ms(FAR_SNR, 1000, 999));
+    TEST_ASSERT_EQUAL_UINT32(0, relay_backoff_ms(FAR_SNR, 1000, 1000));
+    TEST_ASSERT_EQUAL_UINT32(0, relay_backoff_ms(NEAR_SNR, 0, 1234));
+}
+
+void test_first_copy_is_delivered_and_rebroadcast_once(void)
+{
+    uint8_t buf[MAX_AGGREGATE_SIZE];
+    size_t len = make_relayed_text(9, 2, 40, "HELLO", buf);
+
+    RelayHeader header;
+    const uint8_t *packet;
+    size_t packetLen;
+    TEST_ASSERT_EQUAL(RelayRouter::Verdict::Deliver, router.receive(buf, len, NEAR_SNR, 1000, header, packet, packetLen));
+    TEST_ASSERT_EQUAL_UINT8(9, header.origin);
+    TEST_ASSERT_EQUAL_UINT(len - RELAY_HEADER_SIZE, packetLen);
+    TEST_ASSERT_TRUE(router.hasPending());
+
+    // A near sender: we wait for the whole backoff before relaying
+    const uint8_t *out;
+    uint32_t waitMs;
+    TEST_ASSERT_EQUAL_UINT(0, router.next(1000, out, waitMs));
+    TEST_ASSERT_TRUE(waitMs >= RELAY_BACKOFF_SLOTS * len && waitMs < (RELAY_BACKOFF_SLOTS + 1) * len);
+    TEST_ASSERT_EQUAL_UINT(len, router.next(1000 + waitMs, out, waitMs));
+    TEST_ASSERT_EQUAL_UINT8(9, out[1]);
+    TEST_ASSERT_EQUAL_UINT8(1, out[2]); // TTL decremented
+    TEST_ASSERT_EQUAL_UINT8(40, out[3]);
+    TEST_ASSERT_EQUAL_UINT8_ARRAY(buf + RELAY_HEADER_SIZE, out + RELAY_HEADER_SIZE, packetLen);
+    TEST_ASSERT_FALSE(router.hasPending());
+    TEST_ASSERT_EQUAL_UINT32(1, router.relayed());
+
+    // Later copies, even with another TTL, are dropped and never relayed again
+    make_relayed_text(9, 1, 40, "HELLO", buf);
+    TEST_ASSERT_EQUAL(RelayRouter::Verdict::Duplicate, hear(buf, len, FAR_SNR, 9000));
+    TEST_ASSERT_FALSE(router.hasPending());
+
+    // The last hop is delivered but not rebroadcast, our own packets are dropped
+    len = make_relayed_text(9, 0, 41, "LAST HOP", buf);
+    TEST_ASSERT_EQUAL(RelayRouter::Verdict::Deliver, hear(buf, len, FAR_SNR, 9000));
+    TEST_ASSERT_FALSE(router.hasPending());
+    len = make_relayed_text(THIS_NODE, 2, 200, "ECHO", buf);
+    TEST_ASSERT_EQUAL(RelayRouter::Verdict::Own, hear(buf, len, FAR_SNR, 9000));
+    TEST_ASSERT_FALSE(router.hasPending());
+
+    buf[RELAY_HEADER_SIZE] = 0x7F; // Unknown inner type
+    TEST_ASSERT_EQUAL(RelayRouter::Verdict::Invalid, hear(buf, len, FAR_SNR, 9000));
+}
+
+void test_copy_heard_while_waiting_suppresses_ours(void)
+{
+    uint8_t buf[MAX_AGGREGATE_SIZE];
+    size_t len = make_relayed_text(9, 3, 7, "HELLO", buf);
+    TEST_ASSERT_EQUAL(RelayRouter::Verdict::Deliver, hear(buf, len, NEAR_SNR, 1000));
+
+    // A more distant relay went first
+    make_relayed_text(9, 2, 7, "HELLO", buf);
+    TEST_ASSERT_EQUAL(RelayRouter::Verdict::Suppressed, hear(buf, len, FAR_SNR, 1100));
+    TEST_ASSERT_FALSE(router.hasPending());
+    TEST_ASSERT_EQUAL_UINT32(1, router.suppressed());
+
+    const uint8_t *out;
+    uint32_t waitMs;
+    TEST_ASSERT_EQUAL_UINT(0, router.next(100000, out, waitMs));
+    TEST_ASSERT_EQUAL_UINT32(UINT32_MAX, waitMs);
+    TEST_ASSERT_EQUAL(RelayRouter::Verdict::Duplicate, hear(buf, len, FAR_SNR, 1200));
+}
+
+void test_newer_ack_folds_into_the_waiting_one(void)
+{
+    uint8_t buf[MAX_AGGREGATE_SIZE];
+    size_t len = make_relayed_ack(9, 10, 3, buf);
+    TEST_ASSERT_EQUAL(RelayRouter::Verdict::Deliver, hear(buf, len, NEAR_SNR, 1000));
+    len = make_relayed_ack(9, 11, 5, buf);
+    TEST_ASSERT_EQUAL(RelayRouter::Verdict::Deliver, hear(buf, len, NEAR_SNR, 1500));
+    len = make_relayed_ack(8, 1, 2, buf); // Other origin: kept apart
+    TEST_ASSERT_EQUAL(RelayRouter::Verdict::Deliver, hear(buf, len, NEAR_SNR, 1500));
+    TEST_ASSERT_EQUAL_UINT32(1, router.folded());
+
+    // The newer ACK goes out in the older one's turn
+    const uint8_t *out;
+    uint32_t waitMs;
+    TEST_ASSERT_EQUAL_UINT(len, router.next(1000 + (RELAY_BACKOFF_SLOTS + 1) * len, out, waitMs));
+    TEST_ASSERT_EQUAL_UINT8(9, out[1]);
+    TEST_ASSERT_EQUAL_UINT8(11, out[3]);
+    TEST_ASSERT_EQUAL_UINT8(5, out[RELAY_HEADER_SIZE + 1]);
+    TEST_ASSERT_EQUAL_UINT(len, router.next(100000, out, waitMs));
+    TEST_ASSERT_EQUAL_UINT8(8, out[1]);
+    TEST_ASSERT_EQUAL_UINT(0, router.next(100000, out, waitMs));
+}
+
+void test_full_queue_drops_rebroadcasts(void)
+{
+    uint8_t buf[MAX_AGGREGATE_SIZE];
+    for (uint8_t i = 0; i < RELAY_QUEUE_SIZE + 2; i++)
+    {
+        size_t len = make_relayed_text(20 + i, 3, i, "FLOOD", buf);
+        TEST_ASSERT_EQUAL(RelayRouter::Verdict::Deliver, hear(buf, len, FAR_SNR, 1000));
+    }
+    TEST_ASSERT_EQUAL_UINT32(2, router.dropped());
+
+    const uint8_t *out;
+    uint32_t waitMs;
+    uint8_t sent = 0;
+    while (router.next(10000, out, waitMs) > 0)
+    {
+        sent++;
+    }
+    TEST_ASSERT_EQUAL_UINT8(RELAY_QUEUE_SIZE, sent);
+}
+
+int runUnityTests(void)
+{
+    UNITY_BEGIN();
+    RUN_TEST(test_header_round_trip_and_validation);
+    RUN_TEST(test_backoff_lets_distant_nodes_go_first);
+    RUN_TEST(test_first_copy_is_delivered_and_rebroadcast_once);
+    RUN_TEST(test_copy_heard_while_waiting_suppresses_ours);
+    RUN_TEST(test_newer_ack_folds_into_the_waiting_one);
+    RUN_TEST(test_full_queue_drops_rebroadcasts);
+    return UNITY_END();
+}
+
+#ifdef ARDUINO
+#include <Arduino.h>
+
+void setup()
+{
+    delay(2000); // Wait for the serial monitor to attach
+    runUnityTests();
+}
+
+void loop() {}
+#else
+int main(void)
+{
+    return runUnityTests();
+}
+#endif
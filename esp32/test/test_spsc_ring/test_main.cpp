@@ -0,0 +1,196 @@
+//! Host-side unit tests for the lock-free SPSC ring and its priority lanes (shared/SpscRing)
+//!
+//! Run with: pio test -e native -f test_spsc_ring
+//!
+//! The last test runs a real producer and consumer thread against each other.
+#include <unity.h>
+#include <thread>
+#include "SpscRing.h"
+#include "Protocol.h"
+
+static WireFrame make_ack(uint8_t seq)
+{
+    WireFrame frame;
+    frame.len = Message::createAck(seq).serialize(frame.data, sizeof(frame.data));
+    return frame;
+}
+
+static WireFrame make_text(uint8_t seq)
+{
+    WireFrame frame;
+    frame.len = Message::createText(seq, "HELLO").serialize(frame.data, sizeof(frame.data));
+    return frame;
+}
+
+static bool same_ack(const WireFrame &older, const WireFrame &newer)
+{
+    return older.data[0] == static_cast<uint8_t>(MessageType::Ack) && older.len == newer.len &&
+           older.data[0] == newer.data[0] && older.data[1] == newer.data[1];
+}
+
+void setUp(void) {}
+void tearDown(void) {}
+
+void test_fifo_uses_every_slot(void)
+{
+    SpscRing<int, 4> ring;
+    TEST_ASSERT_EQUAL_UINT(4, ring.capacity());
+
+    // Several laps: free-running positions wrap through the mask
+    int next = 0;
+    int expected = 0;
+    for (int lap = 0; lap < 5; lap++)
+    {
+        while (ring.push(next))
+        {
+            next++;
+        }
+        TEST_ASSERT_EQUAL_UINT(4, ring.size());
+
+        int value;
+        TEST_ASSERT_TRUE(ring.peek(3, value));
+        TEST_ASSERT_EQUAL_INT(expected + 3, value);
+        TEST_ASSERT_FALSE(ring.peek(4, value));
+
+        ring.drop(2);
+        while (ring.pop(value))
+        {
+            TEST_ASSERT_EQUAL_INT(expected + 2, value);
+            expected++;
+        }
+        expected += 2;
+        TEST_ASSERT_TRUE(ring.empty());
+    }
+
+    ring.push(1);
+    ring.drop(10); // Never past the tail
+    TEST_ASSERT_TRUE(ring.empty());
+    TEST_ASSERT_TRUE(ring.push(2));
+    TEST_ASSERT_EQUAL_UINT(1, ring.size());
+}
+
+void test_coalesce_keeps_the_latest_in_order(void)
+{
+    SpscRing<WireFrame, 8> ring;
+    ring.push(make_ack(1));
+    ring.push(make_text(1));
+    ring.push(make_ack(2));
+    ring.push(make_ack(1));
+    ring.push(make_text(1)); // Texts are never coalesced
+    ring.push(make_ack(2));
+
+    TEST_ASSERT_EQUAL_UINT(2, ring.coalesce(same_ack));
+    TEST_ASSERT_EQUAL_UINT(4, ring.size());
+
+    const WireFrame expected[] = {make_text(1), make_ack(1), make_text(1), make_ack(2)};
+    WireFrame frame;
+    for (const WireFrame &want : expected)
+    {
+        TEST_ASSERT_TRUE(ring.pop(frame));
+        TEST_ASSERT_EQUAL_UINT(want.len, frame.len);
+        TEST_ASSERT_EQUAL_UINT8_ARRAY(want.data, frame.data, want.len);
+    }
+    TEST_ASSERT_EQUAL_UINT(0, ring.coalesce(same_ack));
+
+    // The freed slots are usable again
+    for (int i = 0; i < 8; i++)
+    {
+        TEST_ASSERT_TRUE(ring.push(make_ack(static_cast<uint8_t>(i % 2))));
+    }
+    TEST_ASSERT_EQUAL_UINT(6, ring.coalesce(same_ack));
+    TEST_ASSERT_TRUE(ring.pop(frame));
+    TEST_ASSERT_EQUAL_UINT8(0, frame.data[1]);
+    TEST_ASSERT_TRUE(ring.pop(frame));
+    TEST_ASSERT_EQUAL_UINT8(1, frame.data[1]);
+}
+
+void test_urgent_lane_overtakes_bulk(void)
+{
+    SpscLanes<int, 4, 2> lanes;
+    for (int i = 0; i < 4; i++)
+    {
+        TEST_ASSERT_TRUE(lanes.push(1, 100 + i));
+    }
+    TEST_ASSERT_FALSE(lanes.push(1, 104));
+    TEST_ASSERT_TRUE(lanes.push(0, 1)); // A full bulk lane does not block control traffic
+    TEST_ASSERT_EQUAL_UINT(5, lanes.size());
+
+    int value;
+    TEST_ASSERT_TRUE(lanes.pop(value));
+    TEST_ASSERT_EQUAL_INT(1, value);
+    TEST_ASSERT_TRUE(lanes.pop(value));
+    TEST_ASSERT_EQUAL_INT(100, value);
+
+    lanes.push(0, 2);
+    TEST_ASSERT_TRUE(lanes.pop(value));
+    TEST_ASSERT_EQUAL_INT(2, value);
+    TEST_ASSERT_EQUAL_UINT(3, lanes.lane(1).size());
+    TEST_ASSERT_TRUE(lanes.lane(0).empty());
+}
+
+void test_threads_see_every_item_once_in_order(void)
+{
+    static SpscRing<uint32_t, 16> ring;
+    const uint32_t COUNT = 100000;
+
+    std::thread producer([] {
+        for (uint32_t i = 0; i < COUNT;)
+        {
+            if (ring.push(i))
+            {
+                i++;
+            }
+            else
+            {
+                std::this_thread::yield(); // Also on a single core
+            }
+        }
+    });
+
+    uint32_t expected = 0;
+    uint32_t value;
+    bool inOrder = true;
+    while (expected < COUNT)
+    {
+        if (ring.pop(value))
+        {
+            inOrder = inOrder && value == expected;
+            expected++;
+        }
+        else
+        {
+            std::this_thread::yield();
+        }
+    }
+    producer.join();
+
+    TEST_ASSERT_TRUE(inOrder);
+    TEST_ASSERT_TRUE(ring.empty());
+}
+
+int runUnityTests(void)
+{
+    UNITY_BEGIN();
+    RUN_TEST(test_fifo_uses_every_slot);
+    RUN_TEST(test_coalesce_keeps_the_latest_in_order);
+    RUN_TEST(test_urgent_lane_overtakes_bulk);
+    RUN_TEST(test_threads_see_every_item_once_in_order);
+    return UNITY_END();
+}
+
+#ifdef ARDUINO
+#include <Arduino.h>
+
+void setup()
+{
+    delay(2000); // Wait for the serial monitor to attach
+    runUnityTests();
+}
+
+void loop() {}
+#else
+int main(void)
+{
+    return runUnityTests();
+}
+#endif
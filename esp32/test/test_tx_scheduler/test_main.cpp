@@ -0,0 +1,290 @@
+//! Host-side unit tests for the duty-cycle aware TX scheduler (shared/TxScheduler)
+//! and the compile-time airtime model and radio profiles it is fed with (shared/LoRaAirtime)
+//!
+//! Run with: pio test -e native -f test_tx_scheduler
+//!
+//! Time is simulated: every call gets an explicit millisecond timestamp.
+#include <unity.h>
+#include <string.h>
+#include "TxScheduler.h"
+#include "LoRaAirtime.h"
+
+// 1 minute window at 10%: 6000 ms of airtime
+static const uint32_t WINDOW_MS = 60000;
+static const uint16_t PERMILLE = 100;
+
+// Simple airtime model: 1000 ms per packet plus 10 ms per byte (an ACK costs 1030 ms)
+static uint32_t test_airtime(size_t len)
+{
+    return 1000 + 10 * static_cast<uint32_t>(len);
+}
+
+static WireFrame make_text(uint8_t seq, const char *text = "HELLO")
+{
+    WireFrame frame;
+    frame.len = Message::createText(seq, text).serialize(frame.data, sizeof(frame.data));
+    return frame;
+}
+
+static WireFrame make_sack(uint8_t cumulative, uint8_t bitmap)
+{
+    WireFrame frame;
+    frame.len = Message::createSelectiveAck(cumulative, bitmap).serialize(frame.data, sizeof(frame.data));
+    return frame;
+}
+
+static WireFrame make_fragment(uint8_t seq, uint8_t index, uint8_t last)
+{
+    uint8_t data[FRAGMENT_DATA_SIZE];
+    memset(data, index, sizeof(data));
+    WireFrame frame;
+    frame.len = Message::createFragment(seq, index, last, data, sizeof(data)).serialize(frame.data, sizeof(frame.data));
+    return frame;
+}
+
+void setUp(void) {}
+void tearDown(void) {}
+
+void test_config_airtime_is_compile_time(void)
+{
+    // SF11 / 31.25 kHz / 4/5, preamble 8, CRC off, 1% duty cycle (lora_config.h)
+    static_assert(lora_config_time_on_air_ms(3) == 1655, "selective ACK time on air");
+    static_assert(lora_config_time_on_air_ms(51) == 4932, "full text time on air");
+    static_assert(LORA_DUTY_CYCLE_BUDGET_MS == 36000, "1% of an hour");
+    static_assert(lora_config_packets_per_window(51) == 7, "full texts per hour");
+
+    TEST_ASSERT_EQUAL_UINT32(5915, lora_config_time_on_air_ms(LORA_AGGREGATE_MAX_BYTES));
+    TEST_ASSERT_TRUE(lora_low_data_rate_optimize(11, 31250));
+    TEST_ASSERT_FALSE(lora_low_data_rate_optimize(7, 125000));
+}
+
+void test_radio_profiles_are_compile_time(void)
+{
+    // lora_config.h is the long-range profile
+    static_assert(LongRangeRadio::timeOnAirMs(51) == lora_config_time_on_air_ms(51), "one definition");
+    static_assert(LongRangeRadio::symbolTimeUs == 65536, "2^11 / 31.25 kHz");
+    static_assert(LongRangeRadio::lowDataRateOptimize, "SF11 / 31.25 kHz needs LDRO");
+    static_assert(LongRangeRadio::maxPayloadForAirtime(2000) == 11, "payload within 2 s");
+
+    // SF7 / 125 kHz with CRC
+    static_assert(FastLocalRadio::symbolTimeUs == 1024, "2^7 / 125 kHz");
+    static_assert(FastLocalRadio::timeOnAirMs(51) == 103, "full text time on air");
+    static_assert(FastLocalRadio::packetsPerWindow(51) == 349, "full texts per hour");
+
+    TEST_ASSERT_FALSE(BenchRadio::lowDataRateOptimize);
+    TEST_ASSERT_EQUAL_INT(255, BenchRadio::maxPayloadForAirtime(1000));
+    TEST_ASSERT_EQUAL_INT(-1, LongRangeRadio::maxPayloadForAirtime(1000)); // Preamble alone is longer
+}
+
+void test_limiter_reports_wait_until_budget_frees(void)
+{
+    DutyCycleLimiter limiter(WINDOW_MS, PERMILLE);
+    TEST_ASSERT_EQUAL_UINT32(6000, limiter.budgetMs());
+
+    // 5000 ms used in the first bucket (0-999 ms), 500 ms more 10 s later
+    limiter.record(0, 5000);
+    limiter.record(10000, 500);
+    TEST_ASSERT_EQUAL_UINT32(5500, limiter.usedMs(20000));
+    TEST_ASSERT_EQUAL_UINT32(0, limiter.waitMs(20000, 500));
+
+    // 1000 ms only fits once the first bucket leaves the window at 60 s
+    TEST_ASSERT_EQUAL_UINT32(40000, limiter.waitMs(20000, 1000));
+    TEST_ASSERT_EQUAL_UINT32(1, limiter.waitMs(59999, 1000));
+    TEST_ASSERT_EQUAL_UINT32(0, limiter.waitMs(60000, 1000));
+    TEST_ASSERT_EQUAL_UINT32(500, limiter.usedMs(60000));
+
+    // More than the whole budget never fits
+    TEST_ASSERT_EQUAL_UINT32(UINT32_MAX, limiter.waitMs(60000, 6001));
+
+    // A long idle period forgets everything
+    TEST_ASSERT_EQUAL_UINT32(0, limiter.usedMs(200000));
+}
+
+void test_limiter_survives_millis_wrap(void)
+{
+    DutyCycleLimiter limiter(WINDOW_MS, PERMILLE);
+    limiter.record(UINT32_MAX - 100, 6000);
+    TEST_ASSERT_TRUE(limiter.waitMs(UINT32_MAX - 50, 100) > 0);
+
+    // After the wrap the history is cleared once instead of blocking for days
+    TEST_ASSERT_EQUAL_UINT32(0, limiter.waitMs(100, 100));
+}
+
+void test_scheduler_aggregates_acks_first(void)
+{
+    TxScheduler scheduler(test_airtime, WINDOW_MS, PERMILLE, 64);
+    WireFrame text = make_text(1);
+    WireFrame sack = make_sack(4, 0);
+    TEST_ASSERT_TRUE(scheduler.queueData(text.data, text.len));
+    TEST_ASSERT_TRUE(scheduler.queuePriority(sack.data, sack.len));
+
+    const uint8_t *packet = nullptr;
+    uint32_t waitMs = 0;
+    size_t len = scheduler.next(0, packet, waitMs);
+    TEST_ASSERT_EQUAL_UINT(2 + 1 + sack.len + 1 + text.len, len);
+    TEST_ASSERT_EQUAL_HEX8(static_cast<uint8_t>(MessageType::Aggregate), packet[0]);
+    TEST_ASSERT_EQUAL_UINT8(2, packet[1]);
+    TEST_ASSERT_EQUAL_HEX8(static_cast<uint8_t>(MessageType::SelectiveAck), packet[3]);
+    TEST_ASSERT_EQUAL_UINT32(test_airtime(len), scheduler.dutyCycle().usedMs(0));
+
+    // Nothing left
+    TEST_ASSERT_EQUAL_UINT(0, scheduler.next(0, packet, waitMs));
+    TEST_ASSERT_EQUAL_UINT32(UINT32_MAX, waitMs);
+    TEST_ASSERT_FALSE(scheduler.hasPending());
+}
+
+void test_scheduler_replaces_queued_selective_ack(void)
+{
+    TxScheduler scheduler(test_airtime, WINDOW_MS, PERMILLE, 64);
+    WireFrame older = make_sack(4, 0);
+    WireFrame newer = make_sack(6, 1);
+    TEST_ASSERT_TRUE(scheduler.queuePriority(older.data, older.len));
+    TEST_ASSERT_TRUE(scheduler.queuePriority(newer.data, newer.len));
+
+    // Duplicate retransmissions collapse into the one still queued
+    WireFrame text = make_text(2);
+    TEST_ASSERT_TRUE(scheduler.queueData(text.data, text.len));
+    TEST_ASSERT_TRUE(scheduler.queueData(text.data, text.len));
+
+    const uint8_t *packet = nullptr;
+    uint32_t waitMs = 0;
+    size_t len = scheduler.next(0, packet, waitMs);
+    AggregateReader reader(packet, len);
+    TEST_ASSERT_TRUE(reader.isValid());
+    TEST_ASSERT_EQUAL_UINT8(2, reader.count());
+
+    const uint8_t *frame;
+    size_t frameLen;
+    TEST_ASSERT_TRUE(reader.next(frame, frameLen));
+    TEST_ASSERT_EQUAL_UINT8_ARRAY(newer.data, frame, newer.len);
+    TEST_ASSERT_TRUE(reader.next(frame, frameLen));
+    TEST_ASSERT_EQUAL_UINT8_ARRAY(text.data, frame, text.len);
+}
+
+void test_scheduler_defers_text_but_keeps_acks_flowing(void)
+{
+    TxScheduler scheduler(test_airtime, WINDOW_MS, PERMILLE, 64);
+    const uint8_t *packet = nullptr;
+    uint32_t waitMs = 0;
+
+    // Use most of the budget at t = 0: 4 packets of one text each
+    for (uint8_t seq = 0; seq < 4; seq++)
+    {
+        WireFrame text = make_text(seq);
+        TEST_ASSERT_TRUE(scheduler.queueData(text.data, text.len));
+        TEST_ASSERT_TRUE(scheduler.next(0, packet, waitMs) > 0);
+    }
+    uint32_t used = scheduler.dutyCycle().usedMs(0);
+    TEST_ASSERT_EQUAL_UINT32(4 * test_airtime(make_text(0).len), used);
+
+    // The next text would eat into the ACK reserve: held back with a computed wait
+    WireFrame text = make_text(9);
+    TEST_ASSERT_TRUE(scheduler.queueData(text.data, text.len));
+    TEST_ASSERT_EQUAL_UINT(0, scheduler.next(1000, packet, waitMs));
+    TEST_ASSERT_EQUAL_UINT32(59000, waitMs);
+    TEST_ASSERT_EQUAL_UINT32(1, scheduler.deferrals());
+
+    // An ACK still fits, and goes out on its own ahead of the text
+    WireFrame sack = make_sack(3, 0);
+    TEST_ASSERT_TRUE(scheduler.queuePriority(sack.data, sack.len));
+    size_t len = scheduler.next(1000, packet, waitMs);
+    TEST_ASSERT_EQUAL_UINT(sack.len, len);
+    TEST_ASSERT_EQUAL_UINT8_ARRAY(sack.data, packet, sack.len);
+    TEST_ASSERT_TRUE(scheduler.hasData());
+
+    // Once the first bucket leaves the window the text is sent
+    TEST_ASSERT_EQUAL_UINT(0, scheduler.next(59999, packet, waitMs));
+    TEST_ASSERT_EQUAL_UINT32(1, waitMs);
+    len = scheduler.next(60000, packet, waitMs);
+    TEST_ASSERT_EQUAL_UINT(text.len, len);
+    TEST_ASSERT_EQUAL_UINT8_ARRAY(text.data, packet, text.len);
+}
+
+void test_scheduler_packs_fragments_up_to_their_airtime(void)
+{
+    // Fragments may grow a packet up to 255 bytes while it stays within 3200 ms (220 bytes)
+    TxScheduler scheduler(test_airtime, WINDOW_MS, PERMILLE, 64, MAX_AGGREGATE_SIZE, 3200);
+    TxScheduler plain(test_airtime, WINDOW_MS, PERMILLE, 64);
+    WireFrame sack = make_sack(4, 0);
+    WireFrame text = make_text(20);
+    TxScheduler *schedulers[] = {&scheduler, &plain};
+    for (TxScheduler *s : schedulers)
+    {
+        TEST_ASSERT_TRUE(s->queuePriority(sack.data, sack.len));
+        for (uint8_t i = 0; i < 4; i++)
+        {
+            WireFrame fragment = make_fragment(10 + i, i, 3);
+            TEST_ASSERT_TRUE(s->queueData(fragment.data, fragment.len));
+        }
+        TEST_ASSERT_TRUE(s->queueData(text.data, text.len));
+    }
+
+    // The ACK and all 4 fragments share one packet, the text waits for the next one
+    const uint8_t *packet = nullptr;
+    uint32_t waitMs = 0;
+    size_t len = scheduler.next(0, packet, waitMs);
+    TEST_ASSERT_EQUAL_UINT(2 + 1 + sack.len + 4 * (1 + MAX_FRAME_SIZE), len);
+    TEST_ASSERT_EQUAL_UINT8(5, packet[1]);
+    TEST_ASSERT_LESS_OR_EQUAL_UINT32(3200, test_airtime(len));
+    len = scheduler.next(0, packet, waitMs);
+    TEST_ASSERT_EQUAL_UINT(text.len, len);
+
+    // Without a fragment budget they are packed like texts: one per 64-byte packet
+    len = plain.next(0, packet, waitMs);
+    TEST_ASSERT_EQUAL_UINT(2 + 1 + sack.len + 1 + MAX_FRAME_SIZE, len);
+}
+
+void test_scheduler_rejects_what_never_fits(void)
+{
+    // 1% of a minute (600 ms) is shorter than any packet of this airtime model
+    TxScheduler scheduler(test_airtime, WINDOW_MS, 10, 64);
+    WireFrame text = make_text(1);
+    TEST_ASSERT_FALSE(scheduler.queueData(text.data, text.len));
+    TEST_ASSERT_FALSE(scheduler.hasPending());
+
+    // Queue limits and malformed frames
+    TxScheduler roomy(test_airtime, WINDOW_MS, 1000, 64);
+    for (uint8_t seq = 0; seq < TxScheduler::DATA_QUEUE_SIZE; seq++)
+    {
+        WireFrame frame = make_text(seq);
+        TEST_ASSERT_TRUE(roomy.queueData(frame.data, frame.len));
+    }
+    TEST_ASSERT_FALSE(roomy.canQueueData());
+    WireFrame extra = make_text(200);
+    TEST_ASSERT_FALSE(roomy.queueData(extra.data, extra.len));
+
+    const uint8_t bogus[] = {0x7F, 0x00};
+    TEST_ASSERT_FALSE(roomy.queuePriority(bogus, sizeof(bogus)));
+}
+
+int runUnityTests(void)
+{
+    UNITY_BEGIN();
+    RUN_TEST(test_config_airtime_is_compile_time);
+    RUN_TEST(test_radio_profiles_are_compile_time);
+    RUN_TEST(test_limiter_reports_wait_until_budget_frees);
+    RUN_TEST(test_limiter_survives_millis_wrap);
+    RUN_TEST(test_scheduler_aggregates_acks_first);
+    RUN_TEST(test_scheduler_replaces_queued_selective_ack);
+    RUN_TEST(test_scheduler_defers_text_but_keeps_acks_flowing);
+    RUN_TEST(test_scheduler_packs_fragments_up_to_their_airtime);
+    RUN_TEST(test_scheduler_rejects_what_never_fits);
+    return UNITY_END();
+}
+
+#ifdef ARDUINO
+#include <Arduino.h>
+
+void setup()
+{
+    delay(2000); // Wait for the serial monitor to attach
+    runUnityTests();
+}
+
+void loop() {}
+#else
+int main(void)
+{
+    return runUnityTests();
+}
+#endif
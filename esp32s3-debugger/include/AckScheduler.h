@@ -0,0 +1,203 @@
+#ifndef ACK_SCHEDULER_H
+#define ACK_SCHEDULER_H
+
+#include <Arduino.h>
+#include <esp_timer.h>
+#include <freertos/FreeRTOS.h>
+#include <freertos/semphr.h>
+#include <atomic>
+#include "Protocol.h"
+#include "EventLog.h"
+
+/**
+ * @brief Timer-driven queue of ACKs, each sent a fixed delay after its text arrived
+ *
+ * Every scheduled ACK gets its own due time (arrival + delay), so a second
+ * text inside the delay never moves or replaces the first one's ACK. A
+ * one-shot esp_timer fires at the oldest due time and its callback (esp_timer
+ * task) sends everything due by then - plus whatever falls due within the
+ * coalescing window - as one aggregate packet, a bare ACK if it is alone.
+ * The loop task never polls, so ACK timing does not depend on how long a
+ * display update or a log flush takes.
+ *
+ * The delay is the same for every ACK, so due order is arrival order and the
+ * queue is a plain FIFO ring. schedule() may be called from any task except
+ * the esp_timer task itself.
+ */
+class AckScheduler
+{
+public:
+    /// Queues a finished packet for LoRa TX, false if it was not taken
+    typedef bool (*SendFn)(const uint8_t *packet, size_t len);
+
+    /// ACKs waiting at once; arrivals beyond that push the oldest ones out early
+    static const uint8_t CAPACITY = 32;
+
+    /**
+     * @param send Called from the esp_timer task with every packet of ACKs.
+     * @param delayMs Delay of each ACK after schedule().
+     * @param coalesceMs ACKs due at most this much later go out with the one that is due.
+     * @param maxPacket Budget for one packet of ACKs (clamped to MAX_AGGREGATE_SIZE).
+     */
+    AckScheduler(SendFn send, uint32_t delayMs, uint32_t coalesceMs, size_t maxPacket)
+        : send(send), delayUs((int64_t)delayMs * 1000), coalesceUs((int64_t)coalesceMs * 1000),
+          maxPacket(maxPacket < MAX_AGGREGATE_SIZE ? maxPacket : MAX_AGGREGATE_SIZE), timer(nullptr),
+          mutex(nullptr), head(0), count(0), armed(false) {}
+
+    /**
+     * @brief Creates the timer and the queue lock.
+     * @return True if both were created.
+     */
+    bool begin()
+    {
+        mutex = xSemaphoreCreateMutex();
+        esp_timer_create_args_t args = {};
+        args.callback = onTimer;
+        args.arg = this;
+        args.dispatch_method = ESP_TIMER_TASK;
+        args.name = "ack";
+        return mutex != nullptr && esp_timer_create(&args, &timer) == ESP_OK;
+    }
+
+    /**
+     * @brief Schedules an ACK for seq, due the delay from now.
+     *
+     * A seq that is already waiting is not added again: the pending ACK
+     * answers the retransmission too.
+     */
+    void schedule(uint8_t seq)
+    {
+        bool arm = false;
+        bool full = false;
+        xSemaphoreTake(mutex, portMAX_DELAY);
+        for (uint8_t i = 0; i < count; i++)
+        {
+            if (slots[(head + i) % CAPACITY].seq == seq)
+            {
+                xSemaphoreGive(mutex);
+                return;
+            }
+        }
+        if (count < CAPACITY)
+        {
+            Slot &slot = slots[(head + count) % CAPACITY];
+            slot.seq = seq;
+            slot.dueUs = esp_timer_get_time() + delayUs;
+            count++;
+            arm = !armed;
+            armed = true;
+        }
+        else
+        {
+            full = true;
+        }
+        xSemaphoreGive(mutex);
+
+        if (arm)
+        {
+            esp_timer_start_once(timer, delayUs);
+        }
+        else if (full)
+        {
+            LOG_WARN(AckQueueFull, seq);
+            sendDue(true); // Oldest ones go early, the new one is added behind them
+            schedule(seq);
+        }
+    }
+
+    /**
+     * @brief Number of ACKs waiting.
+     */
+    uint8_t pending() const
+    {
+        return count;
+    }
+
+private:
+    struct Slot
+    {
+        uint8_t seq;
+        int64_t dueUs; // esp_timer_get_time() at which it is sent
+    };
+
+    SendFn send;
+    int64_t delayUs;
+    int64_t coalesceUs;
+    size_t maxPacket;
+    esp_timer_handle_t timer;
+    SemaphoreHandle_t mutex;
+    Slot slots[CAPACITY];
+    uint8_t head;               // Oldest pending ACK
+    std::atomic<uint8_t> count; // Written under mutex, read by pending()
+    bool armed;                 // Timer started, or a sendDue() call will start it
+
+    static void onTimer(void *arg)
+    {
+        static_cast<AckScheduler *>(arg)->sendDue(false);
+    }
+
+    /**
+     * @brief Sends the due ACKs in packets of at most maxPacket bytes and re-arms the timer.
+     * @param early Also send the oldest packet's worth if nothing is due yet (queue full).
+     */
+    void sendDue(bool early)
+    {
+        uint8_t buf[MAX_AGGREGATE_SIZE];
+        for (;;)
+        {
+            AggregateBuilder batch(buf, maxPacket);
+            int64_t nowUs = esp_timer_get_time();
+            int64_t lateUs = 0;
+            int64_t waitUs = -1;
+
+            xSemaphoreTake(mutex, portMAX_DELAY);
+            while (count > 0 && (early || slots[head].dueUs <= nowUs + coalesceUs))
+            {
+                uint8_t ack[2];
+                int len = Message::createAck(slots[head].seq).serialize(ack, sizeof(ack));
+                if (!batch.fits(len))
+                {
+                    break; // The rest goes in the next packet
+                }
+                if (batch.count() == 0 && nowUs > slots[head].dueUs)
+                {
+                    lateUs = nowUs - slots[head].dueUs;
+                }
+                batch.add(ack, len);
+                head = (head + 1) % CAPACITY;
+                count--;
+            }
+            if (count > 0)
+            {
+                waitUs = slots[head].dueUs > nowUs ? slots[head].dueUs - nowUs : 0;
+            }
+            armed = waitUs > 0;
+            xSemaphoreGive(mutex);
+
+            const uint8_t *packet;
+            size_t len = batch.finish(packet);
+            if (len > 0)
+            {
+                LOG_INFO(AckTx, batch.count(), len, (int32_t)lateUs);
+                if (!send(packet, len))
+                {
+                    LOG_WARN(AckTxRejected, batch.count());
+                }
+            }
+
+            if (waitUs > 0)
+            {
+                esp_timer_stop(timer); // Not running unless a full queue sent early
+                esp_timer_start_once(timer, waitUs);
+                return;
+            }
+            if (waitUs < 0 || len == 0)
+            {
+                return; // Empty, or a lone ACK larger than the budget (never with 2-byte ACKs)
+            }
+            early = false; // More are due right now: next packet
+        }
+    }
+};
+
+#endif // ACK_SCHEDULER_H
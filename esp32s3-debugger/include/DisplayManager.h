@@ -2,23 +2,36 @@
 #define DISPLAY_MANAGER_H
 
 #include <Arduino_GFX_Library.h> // Include Arduino_GFX library
+#include <string.h>
 #define GFX_DEV_DEVICE LILYGO_T_DISPLAY_S3
 
+/**
+ * @brief ST7789 panel on the T-Display S3's 8-bit parallel bus
+ *
+ * Draws straight to the panel until beginSprite() succeeds. In sprite mode
+ * every call draws into an off-screen RGB565 framebuffer instead and only
+ * marks the rows it touched; flush() pushes that dirty band in one transfer,
+ * which the i80 LCD peripheral streams out by DMA. scrollDown() moves rows
+ * inside the framebuffer, so a new line at the top costs one push of the
+ * scrolled area instead of a full repaint.
+ */
 class DisplayManager
 {
 public:
     DisplayManager(int dataPin0, int dataPin1, int dataPin2, int dataPin3, int dataPin4, int dataPin5, int dataPin6, int dataPin7,
                    int writePin, int readPin, int dataCommandPin, int chipSelectPin, int resetPin, int backlightPin)
-        : blPin(backlightPin), currentBrightness(255)
+        : canvas(nullptr), blPin(backlightPin), currentBrightness(255), textSize(1), dirtyTop(0), dirtyBottom(0)
     {
         // Configure PWM for backlight control (ESP32 Arduino 3.x API)
         ledcAttach(backlightPin, 5000, 8); // Pin, 5kHz frequency, 8-bit resolution
         ledcWrite(backlightPin, 255);      // Full brightness initially
 
-        Arduino_DataBus *bus = new Arduino_ESP32PAR8Q(dataCommandPin, chipSelectPin, writePin, readPin,
-                                                      dataPin0, dataPin1, dataPin2, dataPin3,
-                                                      dataPin4, dataPin5, dataPin6, dataPin7);
+        // esp_lcd i80 bus: pixel pushes are DMA transfers, not GPIO writes per byte
+        Arduino_DataBus *bus = new Arduino_ESP32LCD8(dataCommandPin, chipSelectPin, writePin, readPin,
+                                                     dataPin0, dataPin1, dataPin2, dataPin3,
+                                                     dataPin4, dataPin5, dataPin6, dataPin7);
         gfx = new Arduino_ST7789(bus, resetPin, backlightPin, true, 170, 320, 35, 0, 35, 0); // Adjust offsets as needed
+        draw = gfx;
     }
 
     /**
@@ -34,13 +47,91 @@ public:
         gfx->setCursor(0, 0);
     }
 
+    /**
+     * @brief Switches to sprite mode: draws go to an off-screen framebuffer until flush().
+     *
+     * The framebuffer (width x height RGB565, ~106 KB) comes from PSRAM when the
+     * board has it. The current screen content is not copied: clear or repaint
+     * everything after switching.
+     * @return True if the framebuffer was allocated, false to keep drawing directly.
+     */
+    bool beginSprite()
+    {
+        if (canvas)
+        {
+            return true;
+        }
+        canvas = new Arduino_Canvas(gfx->width(), gfx->height(), gfx);
+        if (!canvas->begin(GFX_SKIP_OUTPUT_BEGIN)) // The panel is already initialized
+        {
+            delete canvas;
+            canvas = nullptr;
+            return false;
+        }
+        draw = canvas;
+        draw->setTextColor(WHITE, BLACK);
+        draw->setTextSize(textSize);
+        return true;
+    }
+
+    /**
+     * @brief True while drawing to the off-screen framebuffer.
+     */
+    bool isSprite() const
+    {
+        return canvas != nullptr;
+    }
+
+    /**
+     * @brief Pushes the rows drawn since the last flush to the panel (sprite mode only).
+     */
+    void flush()
+    {
+        if (!canvas || dirtyBottom <= dirtyTop)
+        {
+            return;
+        }
+        int w = gfx->width();
+        gfx->draw16bitRGBBitmap(0, dirtyTop, canvas->getFramebuffer() + dirtyTop * w, w, dirtyBottom - dirtyTop);
+        dirtyTop = dirtyBottom = 0;
+    }
+
+    /**
+     * @brief Moves the rows in [top, bottom) down by pixels and clears the rows freed at the top.
+     *
+     * Rows pushed past bottom are dropped. Sprite mode only: the panel cannot be read back.
+     * @return False if not in sprite mode (repaint instead).
+     */
+    bool scrollDown(int top, int bottom, int pixels)
+    {
+        if (!canvas)
+        {
+            return false;
+        }
+        int w = gfx->width();
+        bottom = bottom < gfx->height() ? bottom : gfx->height();
+        if (top < 0 || pixels <= 0 || top >= bottom)
+        {
+            return true;
+        }
+        if (pixels < bottom - top)
+        {
+            uint16_t *fb = canvas->getFramebuffer();
+            memmove(fb + (top + pixels) * w, fb + top * w, (size_t)(bottom - top - pixels) * w * sizeof(uint16_t));
+        }
+        fillRect(0, top, w, pixels < bottom - top ? pixels : bottom - top, BLACK);
+        markDirty(top, bottom - top);
+        return true;
+    }
+
     /**
      * @brief Clears the screen.
      */
     void clearScreen()
     {
-        gfx->fillScreen(BLACK);
-        gfx->setCursor(0, 0);
+        draw->fillScreen(BLACK);
+        draw->setCursor(0, 0);
+        markDirty(0, gfx->height());
     }
 
     /**
@@ -49,7 +140,9 @@ public:
      */
     void printLine(const String &text)
     {
-        gfx->println(text);
+        int y = draw->getCursorY();
+        draw->println(text);
+        markText(y);
     }
 
     /**
@@ -58,7 +151,9 @@ public:
      */
     void print(const String &text)
     {
-        gfx->print(text);
+        int y = draw->getCursorY();
+        draw->print(text);
+        markText(y);
     }
 
     /**
@@ -67,7 +162,9 @@ public:
      */
     void print(const char *text)
     {
-        gfx->print(text);
+        int y = draw->getCursorY();
+        draw->print(text);
+        markText(y);
     }
 
     /**
@@ -76,7 +173,9 @@ public:
      */
     void print(int value)
     {
-        gfx->print(value);
+        int y = draw->getCursorY();
+        draw->print(value);
+        markText(y);
     }
 
     /**
@@ -86,7 +185,9 @@ public:
      */
     void print(float value, int decimals = 2)
     {
-        gfx->print(value, decimals);
+        int y = draw->getCursorY();
+        draw->print(value, decimals);
+        markText(y);
     }
 
     /**
@@ -96,7 +197,7 @@ public:
      */
     void setCursor(int x, int y)
     {
-        gfx->setCursor(x, y);
+        draw->setCursor(x, y);
     }
 
     /**
@@ -105,7 +206,17 @@ public:
      */
     void setTextSize(int size)
     {
-        gfx->setTextSize(size);
+        textSize = size;
+        draw->setTextSize(size);
+    }
+
+    /**
+     * @brief Sets whether text continues on the next line at the right edge.
+     * @param wrap False to cut text off at the right edge.
+     */
+    void setTextWrap(bool wrap)
+    {
+        draw->setTextWrap(wrap);
     }
 
     /**
@@ -115,7 +226,7 @@ public:
      */
     void setTextColor(uint16_t foreground, uint16_t background)
     {
-        gfx->setTextColor(foreground, background);
+        draw->setTextColor(foreground, background);
     }
 
     /**
@@ -128,7 +239,8 @@ public:
      */
     void fillRect(int x, int y, int w, int h, uint16_t color)
     {
-        gfx->fillRect(x, y, w, h, color);
+        draw->fillRect(x, y, w, h, color);
+        markDirty(y, h);
     }
 
     int width()
@@ -162,8 +274,48 @@ public:
 
 private:
     Arduino_GFX *gfx;          // Pointer to Arduino_GFX object
+    Arduino_Canvas *canvas;    // Off-screen framebuffer in sprite mode, else null
+    Arduino_GFX *draw;         // Where drawing goes: canvas or gfx
     int blPin;                 // Backlight pin
     uint8_t currentBrightness; // Current brightness level
+    int textSize;
+    int dirtyTop;    // Rows [dirtyTop, dirtyBottom) changed since the last flush()
+    int dirtyBottom;
+
+    /**
+     * @brief Adds rows [y, y + h) to the dirty band (sprite mode only).
+     */
+    void markDirty(int y, int h)
+    {
+        if (!canvas || h <= 0)
+        {
+            return;
+        }
+        int top = y < 0 ? 0 : y;
+        int bottom = y + h > gfx->height() ? gfx->height() : y + h;
+        if (top >= bottom)
+        {
+            return;
+        }
+        if (dirtyBottom <= dirtyTop)
+        {
+            dirtyTop = top;
+            dirtyBottom = bottom;
+            return;
+        }
+        dirtyTop = top < dirtyTop ? top : dirtyTop;
+        dirtyBottom = bottom > dirtyBottom ? bottom : dirtyBottom;
+    }
+
+    /**
+     * @brief Marks the rows text printed from line y down to the cursor's line touched.
+     */
+    void markText(int y)
+    {
+        int cursorY = draw->getCursorY();
+        int lastLine = cursorY > y ? cursorY : y;
+        markDirty(y, lastLine - y + 8 * textSize); // Default font: 8 px per line and size
+    }
 };
 
 #endif // DISPLAY_MANAGER_H
@@ -0,0 +1,339 @@
+#ifndef LINK_BENCHMARK_H
+#define LINK_BENCHMARK_H
+
+#include <Arduino.h>
+#include <algorithm>
+#include "Protocol.h"
+#include "Arq.h"
+#include "lora_config.h"
+
+/**
+ * @brief On-air load generator against a bridge: bursts of timestamped texts,
+ * ACK round-trip times, loss and goodput.
+ *
+ * Texts go out in bursts of up to ARQ_WINDOW_SIZE, one burst per interval,
+ * and are never retransmitted: a text the bridge has not acknowledged (plain
+ * or selective ACK) within the timeout counts as lost. No new text is sent
+ * while one ARQ_WINDOW_SIZE seqs older is still open, so the bridge's receive
+ * window never moves past an unanswered text and its selective ACKs can only
+ * cover texts that really arrived. The interval is stretched where needed so
+ * the bursts stay within the LORA_DUTY_CYCLE_PERMILLE budget.
+ *
+ * RTT runs from queueing a text to receiving the packet that acknowledges it,
+ * so it includes listen-before-talk, time on air both ways and the bridge's
+ * own TX scheduling. Everything runs in the caller's task (service() and the
+ * on*Ack() calls from the same loop).
+ */
+class LinkBenchmark
+{
+public:
+    /// Queues a finished packet for LoRa TX, false if it was not taken
+    typedef bool (*SendFn)(const uint8_t *packet, size_t len);
+
+    /// Time on air in ms of a packet of len bytes
+    typedef uint32_t (*AirtimeFn)(size_t len);
+
+    /// Most texts one run keeps RTT samples for
+    static const uint16_t MAX_COUNT = 256;
+
+    struct Config
+    {
+        uint16_t count;      // Texts per run (up to MAX_COUNT)
+        uint8_t burst;       // Texts queued back to back (up to ARQ_WINDOW_SIZE)
+        uint32_t intervalMs; // From one burst to the next
+        uint8_t textLen;     // Characters per text (up to MAX_TEXT_LENGTH)
+        bool gps;            // Texts carry a position
+        uint32_t timeoutMs;  // Unacknowledged this long after queueing = lost
+    };
+
+    LinkBenchmark(SendFn send, AirtimeFn airtime, const Config &config)
+        : send(send), airtime(airtime), config(config), state(State::Idle), nextSeq(0), run(0), startMs(0), endMs(0),
+          nextBurstMs(0), sentCount(0), ackedCount(0), lostCount(0), rejectedCount(0), ackedChars(0), openCount(0)
+    {
+        this->config.count = config.count == 0 ? 1 : config.count > MAX_COUNT ? MAX_COUNT : config.count;
+        this->config.burst = config.burst == 0 ? 1 : config.burst > ARQ_WINDOW_SIZE ? ARQ_WINDOW_SIZE : config.burst;
+        this->config.textLen = config.textLen > MAX_TEXT_LENGTH ? MAX_TEXT_LENGTH : config.textLen;
+    }
+
+    /**
+     * @brief Starts a new run (an old one is abandoned).
+     * @param firstSeq Seq of the first text; runs continue where the last one stopped if it is 0.
+     */
+    void start(uint32_t nowMs, uint8_t firstSeq = 0)
+    {
+        if (firstSeq != 0)
+        {
+            nextSeq = firstSeq;
+        }
+        run++;
+        state = State::Running;
+        startMs = nowMs;
+        endMs = nowMs;
+        nextBurstMs = nowMs;
+        sentCount = ackedCount = lostCount = rejectedCount = 0;
+        ackedChars = 0;
+        openCount = 0;
+
+        // Duty cycle: a burst's time on air per interval may not exceed the budget share
+        uint8_t frame[MAX_FRAME_SIZE];
+        int len = buildText(nextSeq, nowMs, frame);
+        uint32_t burstAirMs = config.burst * airtime(len > 0 ? len : MAX_FRAME_SIZE);
+        intervalMs = std::max<uint32_t>(config.intervalMs, burstAirMs * 1000 / LORA_DUTY_CYCLE_PERMILLE);
+    }
+
+    /**
+     * @brief True while texts are still to be sent or answered.
+     */
+    bool running() const { return state == State::Running; }
+
+    /**
+     * @brief Sends the burst that is due, expires unanswered texts and ends the run.
+     * @return True if the run finished in this call (results are ready).
+     */
+    bool service(uint32_t nowMs)
+    {
+        if (state != State::Running)
+        {
+            return false;
+        }
+
+        for (uint8_t i = 0; i < openCount;)
+        {
+            if (nowMs - open[i].sentMs >= config.timeoutMs)
+            {
+                lostCount++;
+                close(i);
+            }
+            else
+            {
+                i++;
+            }
+        }
+
+        if (sentCount < config.count && static_cast<int32_t>(nowMs - nextBurstMs) >= 0)
+        {
+            for (uint8_t i = 0; i < config.burst && sentCount < config.count && canSend(); i++)
+            {
+                sendText(nowMs);
+            }
+            nextBurstMs += intervalMs;
+            if (static_cast<int32_t>(nowMs - nextBurstMs) >= 0)
+            {
+                nextBurstMs = nowMs + intervalMs; // Fell behind (window full), no catch-up burst
+            }
+        }
+
+        if (sentCount == config.count && openCount == 0)
+        {
+            state = State::Done;
+            endMs = nowMs;
+            std::sort(rtts, rtts + ackedCount);
+            return true;
+        }
+        return false;
+    }
+
+    /**
+     * @brief Handles a plain ACK from the bridge.
+     */
+    void onAck(uint8_t seq, uint32_t nowMs)
+    {
+        for (uint8_t i = 0; i < openCount; i++)
+        {
+            if (open[i].seq == seq)
+            {
+                acknowledge(i, nowMs);
+                return;
+            }
+        }
+    }
+
+    /**
+     * @brief Handles a selective ACK from the bridge.
+     */
+    void onSelectiveAck(const SelectiveAckMessage &ack, uint32_t nowMs)
+    {
+        for (uint8_t i = 0; i < openCount;)
+        {
+            if (arq_ack_covers(ack, open[i].seq))
+            {
+                acknowledge(i, nowMs); // The last entry moved to i
+            }
+            else
+            {
+                i++;
+            }
+        }
+    }
+
+    uint16_t sent() const { return sentCount; }
+    uint16_t acked() const { return ackedCount; }
+    uint16_t lost() const { return lostCount; }
+
+    /**
+     * @brief Loss rate of the texts settled so far, in permille.
+     */
+    uint16_t lossPermille() const
+    {
+        uint16_t settled = ackedCount + lostCount;
+        return settled == 0 ? 0 : static_cast<uint16_t>(lostCount * 1000UL / settled);
+    }
+
+    /**
+     * @brief RTT percentile in ms over the acknowledged texts, 0 without any
+     * (nearest rank; only meaningful once the run is done and the samples are sorted).
+     */
+    uint32_t rttPercentileMs(uint8_t percent) const
+    {
+        if (ackedCount == 0)
+        {
+            return 0;
+        }
+        uint32_t rank = (static_cast<uint32_t>(ackedCount) * percent + 99) / 100;
+        return rtts[rank == 0 ? 0 : rank - 1];
+    }
+
+    /**
+     * @brief Acknowledged text characters per second of run time, in bits/s.
+     */
+    uint32_t goodputBps() const
+    {
+        uint32_t elapsedMs = (state == State::Done ? endMs : millis()) - startMs;
+        return elapsedMs == 0 ? 0 : static_cast<uint32_t>(ackedChars * 8ULL * 1000 / elapsedMs);
+    }
+
+    /**
+     * @brief Writes the progress line for the display's status area.
+     */
+    void formatStatus(char *out, size_t len) const
+    {
+        if (state == State::Done)
+        {
+            snprintf(out, len, "BENCH done %u/%u lost %u rej %u p95 %lu ms", ackedCount, sentCount, lostCount,
+                     rejectedCount, static_cast<unsigned long>(rttPercentileMs(95)));
+        }
+        else
+        {
+            snprintf(out, len, "BENCH %u/%u ok %u lost %u rej %u last %lu ms", sentCount, config.count, ackedCount,
+                     lostCount, rejectedCount, static_cast<unsigned long>(ackedCount > 0 ? rtts[ackedCount - 1] : 0));
+        }
+    }
+
+    /**
+     * @brief Prints the CSV header matching printCsv().
+     */
+    static void printCsvHeader(Print &out)
+    {
+        out.println("bench,run,sf,bw_hz,text_len,gps,burst,interval_ms,sent,acked,lost,rejected,loss_permille,"
+                    "rtt_p50_ms,rtt_p95_ms,rtt_max_ms,goodput_bps,duration_ms");
+    }
+
+    /**
+     * @brief Prints the results of the last run as one CSV row.
+     */
+    void printCsv(Print &out, uint8_t sf, long bw) const
+    {
+        out.printf("bench,%u,%u,%ld,%u,%u,%u,%lu,%u,%u,%u,%u,%u,%lu,%lu,%lu,%lu,%lu\n", run, sf, bw, config.textLen,
+                   config.gps ? 1 : 0, config.burst, static_cast<unsigned long>(intervalMs), sentCount, ackedCount,
+                   lostCount, rejectedCount, lossPermille(), static_cast<unsigned long>(rttPercentileMs(50)),
+                   static_cast<unsigned long>(rttPercentileMs(95)), static_cast<unsigned long>(rttPercentileMs(100)),
+                   static_cast<unsigned long>(goodputBps()), static_cast<unsigned long>(endMs - startMs));
+    }
+
+private:
+    enum class State : uint8_t
+    {
+        Idle,
+        Running,
+        Done
+    };
+
+    struct OpenText
+    {
+        uint8_t seq;
+        uint32_t sentMs;
+    };
+
+    SendFn send;
+    AirtimeFn airtime;
+    Config config;
+    State state;
+    uint8_t nextSeq;
+    uint16_t run;
+    uint32_t startMs;
+    uint32_t endMs;
+    uint32_t nextBurstMs;
+    uint32_t intervalMs; // config.intervalMs, stretched to the duty cycle
+    uint16_t sentCount;
+    uint16_t ackedCount;
+    uint16_t lostCount;
+    uint16_t rejectedCount; // Texts the radio's TX queue had no room for (sent again next burst)
+    uint32_t ackedChars;
+    OpenText open[ARQ_WINDOW_SIZE]; // Sent, not yet acknowledged or lost (unordered)
+    uint8_t openCount;
+    uint32_t rtts[MAX_COUNT]; // Of the acknowledged texts, in arrival order until the run is done
+
+    /**
+     * @brief True if the next seq keeps every open text within one ARQ window.
+     */
+    bool canSend() const
+    {
+        if (openCount == ARQ_WINDOW_SIZE)
+        {
+            return false;
+        }
+        for (uint8_t i = 0; i < openCount; i++)
+        {
+            if (static_cast<uint8_t>(nextSeq - open[i].seq) >= ARQ_WINDOW_SIZE)
+            {
+                return false;
+            }
+        }
+        return true;
+    }
+
+    /**
+     * @brief Serializes the text of seq: "B<run>#<seq>@<ms>" padded to textLen.
+     * @return Frame length, or -1 if it does not serialize.
+     */
+    int buildText(uint8_t seq, uint32_t nowMs, uint8_t *frame) const
+    {
+        char text[MAX_TEXT_LENGTH + 1];
+        int len = snprintf(text, sizeof(text), "B%u#%u@%lu", run, seq, static_cast<unsigned long>(nowMs));
+        len = std::min<int>(len, config.textLen);
+        memset(text + len, '.', config.textLen - len);
+        text[config.textLen] = '\0';
+
+        // A fixed position, written absolute like the app does
+        Message msg = config.gps ? Message::createTextWithGps(seq, text, 47376900, 8541700) : Message::createText(seq, text);
+        return msg.serialize(frame, MAX_FRAME_SIZE);
+    }
+
+    void sendText(uint32_t nowMs)
+    {
+        uint8_t frame[MAX_FRAME_SIZE];
+        int len = buildText(nextSeq, nowMs, frame);
+        if (len <= 0 || !send(frame, len))
+        {
+            rejectedCount++;
+            return;
+        }
+        open[openCount++] = {nextSeq, nowMs};
+        nextSeq++;
+        sentCount++;
+    }
+
+    void acknowledge(uint8_t index, uint32_t nowMs)
+    {
+        rtts[ackedCount++] = nowMs - open[index].sentMs;
+        ackedChars += config.textLen;
+        close(index);
+    }
+
+    void close(uint8_t index)
+    {
+        open[index] = open[--openCount];
+    }
+};
+
+#endif // LINK_BENCHMARK_H
@@ -9,16 +9,37 @@
 //! - LoRa radio for long-range communication (5-10 km typical)
 //! - TFT display for visual feedback
 //! - LED indicator for received messages
+//! - Deferred interrupt handling: DIO0 ISR wakes a radio task that drains the FIFO
+//! - Non-blocking ACKs: queued to the radio task, which returns to RX on TxDone
+//! - Timer-driven ACKs: each one is due ACK_DELAY_MS after its text, an esp_timer sends due ACKs together
+//! - Aggregate frames: inner messages are shown one by one, pending ACKs go out in one packet
+//! - Stays at the lora_config.h data rate: bridge ADR requests are shown, never answered
+//! - Delta GPS: keeps the bridge's last keyframe to expand delta coded positions
+//! - Binary event log from the radio paths, printed at the end of each loop() pass
+//! - Sprite-buffered display: a new message scrolls the framebuffer and pushes the dirty rows once per loop() pass
+//! - Link statistics on the status line: CRC errors, 95th percentile radio task FIFO read time
+//! - Long messages: fragments are ACKed one by one and reassembled, the text is shown once complete
+//! - Benchmark build (DEBUGGER_BENCH=1): sends bursts of texts to a bridge, prints ACK RTT, loss and goodput as CSV
 
 #include <Arduino.h>
 #include "lora_config.h"
 #include "LoRaManager.h"
 #include "Protocol.h"
+#include "GpsDelta.h"
+#include "Dedup.h"
+#include "Relay.h"
+#include "Fragment.h"
+#include "EventLog.h"
+#include "LinkStats.h"
 #include <freertos/queue.h>
 #include <esp_task_wdt.h>
 #include <freertos/task.h>
 #include <LoRa.h>
 #include <DisplayManager.h>
+#include <AckScheduler.h>
+#if DEBUGGER_BENCH
+#include <LinkBenchmark.h>
+#endif
 
 // --- Pin Definitions ---
 /**
@@ -59,35 +80,38 @@
 #define SERIAL_BAUD_RATE 115200
 
 // Manager objects
-LoRaManager loraManager(LORA_SCK, LORA_MISO, LORA_MOSI, LORA_SS, LORA_RST, LORA_DIO0, LORA_FREQUENCY);
-
-// Struct for LoRa packets with metadata
-struct LoRaPacket
-{
-    uint8_t buffer[256];
-    int len;
-    int rssi;
-    float snr;
-};
+// Radio: pins above, long-range settings from lora_config.h
+using DebuggerLoRa = LoRaManager<LoRaProfile<LoRaPins<LORA_SCK, LORA_MISO, LORA_MOSI, LORA_SS, LORA_RST, LORA_DIO0>, LongRangeRadio>>;
+DebuggerLoRa loraManager;
 
-QueueHandle_t loRaQueue;
+// Received LoRa packets, variable-length records filled by the LoRaManager radio task
+LoRaPacketRing loRaRing(LORA_RX_RING_BYTES);
 
 DisplayManager display(LCD_D0, LCD_D1, LCD_D2, LCD_D3, LCD_D4, LCD_D5, LCD_D6, LCD_D7,
                        LCD_WR, LCD_RD, LCD_DC, LCD_CS, LCD_RES, PIN_LCD_BL);
 
 // State tracking
 bool firstMessageReceived = false;
-const int MAX_DISPLAY_LINES = 20;         // Maximum lines to keep in history
-String messageHistory[MAX_DISPLAY_LINES]; // Store message lines
+const int MAX_DISPLAY_LINES = 20;  // Maximum lines to keep in history
+const int DISPLAY_LINE_CHARS = 64; // Per line, including the terminator (the screen shows 26)
+const int DISPLAY_SCREEN_CHARS = 26; // Characters that fit one row at text size 2
+char messageHistory[MAX_DISPLAY_LINES][DISPLAY_LINE_CHARS]; // Ring of lines, newest at historyHead
+int historyHead = 0;
 int messageCount = 0;
 int lastRssi = 0;    // Last received RSSI
 float lastSnr = 0.0; // Last received SNR
 
-// ACK timing (non-blocking)
-unsigned long ackSendTime = 0;
-bool ackPending = false;
-Message pendingAckMsg;
-int pendingAckSeq = 0;
+// Position references of the bridges we hear (link peer or relay origin), for their delta coded GPS
+GpsDeltaDecoderTable gpsDecoders;
+
+// Texts already shown: a retransmission is ACKed again but not redrawn
+DedupCache rxDedup;
+
+// Relayed packets already shown, by origin and packet id (bridges in LORA_RELAY_ENABLED mode)
+DedupCache relaySeen;
+
+// Long messages waiting for the rest of their fragments
+FragmentReassembler rxFragments;
 
 // Button debouncing and long press detection
 unsigned long lastButtonPressTime = 0;
@@ -113,25 +137,72 @@ const int BUTTON_INDICATOR_Y_OFFSET = 32; // Button indicator position from bott
 // ACK delay constant (time to wait for TX->RX mode switch)
 const unsigned long ACK_DELAY_MS = 500; // 500ms delay before sending ACK
 
+// ACKs falling due this much after the one that is due share its packet
+const unsigned long ACK_COALESCE_MS = 50;
+
 /**
- * @brief LoRa receive callback - handles incoming LoRa packets event-driven
+ * @brief Called from the esp_timer task with a packet of due ACKs
  */
-void onLoRaReceive(int packetSize)
+bool queueAckPacket(const uint8_t *packet, size_t len)
 {
-    if (packetSize == 0)
-        return;
+    return loraManager.queuePacket(packet, len); // Radio task sends it and returns to RX on its own
+}
 
-    LoRaPacket packet;
-    packet.len = LoRa.readBytes(packet.buffer, sizeof(packet.buffer));
-    packet.rssi = LoRa.packetRssi();
-    packet.snr = LoRa.packetSnr();
+// Pending ACKs, each sent ACK_DELAY_MS after its text - due ones go out as one aggregate frame
+AckScheduler ackScheduler(queueAckPacket, ACK_DELAY_MS, ACK_COALESCE_MS, LORA_AGGREGATE_MAX_BYTES);
 
-    if (packet.len > 0)
-    {
-        xQueueSend(loRaQueue, &packet, 0);
-    }
+#if DEBUGGER_BENCH
+// --- Benchmark settings (override with -D in the bench environment) ---
+#ifndef BENCH_COUNT
+#define BENCH_COUNT 100 // Texts per run
+#endif
+#ifndef BENCH_BURST
+#define BENCH_BURST 4 // Texts queued back to back (up to ARQ_WINDOW_SIZE)
+#endif
+#ifndef BENCH_INTERVAL_MS
+#define BENCH_INTERVAL_MS 10000 // Between bursts, raised to fit the duty cycle
+#endif
+#ifndef BENCH_TEXT_LEN
+#define BENCH_TEXT_LEN 20 // Characters per text (up to MAX_TEXT_LENGTH)
+#endif
+#ifndef BENCH_GPS
+#define BENCH_GPS 0 // 1 = texts carry a position
+#endif
+#ifndef BENCH_TIMEOUT_MS
+#define BENCH_TIMEOUT_MS 30000 // Unacknowledged this long = lost
+#endif
+
+// Delay after boot before the first run, so a bridge started at the same time is listening
+const unsigned long BENCH_START_DELAY_MS = 5000;
+
+/**
+ * @brief Queues a benchmark text for the radio task
+ */
+bool queueBenchPacket(const uint8_t *packet, size_t len)
+{
+    return loraManager.queuePacket(packet, len);
 }
 
+// Load generator: the bridge answers its texts like any others
+LinkBenchmark benchmark(queueBenchPacket, lora_config_time_on_air_ms,
+                        {BENCH_COUNT, BENCH_BURST, BENCH_INTERVAL_MS, BENCH_TEXT_LEN, BENCH_GPS != 0, BENCH_TIMEOUT_MS});
+bool benchStarted = false;
+
+/**
+ * @brief Starts a benchmark run at the next free seq (random for the first run)
+ */
+void startBenchmark()
+{
+    static bool seeded = false;
+    uint8_t firstSeq = seeded ? 0 : static_cast<uint8_t>(esp_random() | 1); // Fresh seqs, not the bridge's last ARQ window
+    seeded = true;
+    benchmark.start(millis(), firstSeq);
+    benchStarted = true;
+    Serial.printf("Benchmark: %u texts of %u chars, bursts of %u every %lu ms%s\n", BENCH_COUNT, BENCH_TEXT_LEN,
+                  BENCH_BURST, static_cast<unsigned long>(BENCH_INTERVAL_MS), BENCH_GPS ? ", with GPS" : "");
+}
+#endif
+
 /**
  * @brief Configure wake-up sources for deep sleep
  */
@@ -167,6 +238,7 @@ void enterDeepSleep()
         Serial.print(len);
         Serial.println(" bytes via LoRa");
 
+        // Blocks until TxDone, the radio task has already switched back to RX
         if (loraManager.sendPacket(buf, len))
         {
             Serial.println("Deep sleep notification sent successfully");
@@ -175,10 +247,6 @@ void enterDeepSleep()
         {
             Serial.println("Failed to send deep sleep notification");
         }
-
-        // Return to RX mode briefly then proceed to sleep
-        loraManager.startReceiveMode();
-        delay(100); // Brief delay to allow transmission to complete
     }
     else
     {
@@ -194,6 +262,7 @@ void enterDeepSleep()
     display.setTextSize(1);
     display.printLine("Manual sleep activated");
     display.printLine("Press button to wake");
+    display.flush();
 
     delay(2000); // Show message for 2 seconds
 
@@ -244,12 +313,19 @@ void enterLightSleep()
     display.setTextSize(1);
     display.printLine("Send LoRa message");
     display.printLine("to wake up");
+    display.flush();
 
     delay(2000); // Show message for 2 seconds
 
     // Turn off display backlight
     display.setBrightness(0);
 
+    // Let any queued ACK finish - sleeping mid-TX would leave the radio transmitting
+    if (!loraManager.flushTx(pdMS_TO_TICKS(DebuggerLoRa::txDrainTimeoutMs(LORA_AGGREGATE_MAX_BYTES))))
+    {
+        Serial.println("LoRa TX still busy, sleeping anyway");
+    }
+
     // Configure wake-up sources (LoRa only)
     configureLightSleepWakeup();
 
@@ -272,13 +348,18 @@ void enterLightSleep()
     delay(50); // Allow LoRa module to stabilize
     Serial.println("LoRa module back in RX mode");
 
+    // The wake-up packet raised DIO0 while the GPIO ISR was asleep - drain it explicitly
+    loraManager.serviceIrq();
+
     // Restore display brightness
     display.setBrightness(DISPLAY_BRIGHT);
     lastActivityTime = millis();
 
-    // Clear screen and show wake message
+    // Clear screen and show wake message, the next message repaints the history
     display.clearScreen();
     display.printLine("Woke: LoRa Message");
+    display.flush();
+    firstMessageReceived = false;
 
     // LoRa callback will process the queued packet
 }
@@ -309,67 +390,322 @@ void printWakeupReason()
     }
 }
 
+/**
+ * @brief Prints the events the radio paths recorded since the last pass
+ */
+void printLogEvents()
+{
+    LogRecord record;
+    char line[128];
+    while (eventLog.read(record))
+    {
+        EventLog::format(record, line, sizeof(line));
+        Serial.println(line);
+    }
+
+    uint32_t dropped = eventLog.takeDropped();
+    if (dropped > 0)
+    {
+        Serial.printf("%lu log events dropped (ring full)\n", static_cast<unsigned long>(dropped));
+    }
+}
+
+/**
+ * @brief Draws history line index (0 = newest) in its row, cut off at the right edge
+ */
+void drawHistoryLine(int index)
+{
+    int y = index * LINE_HEIGHT;
+    display.fillRect(0, y, display.width(), LINE_HEIGHT, BLACK);
+    display.setCursor(0, y);
+    display.setTextSize(2); // Bigger font
+    display.setTextWrap(false);
+    display.print(messageHistory[(historyHead + index) % MAX_DISPLAY_LINES]);
+    display.setTextWrap(true);
+}
+
+/**
+ * @brief Draws the status line at the bottom with RSSI/SNR and link statistics
+ */
+void drawStatusLine()
+{
+    int statusY = display.height() - STATUS_LINE_Y_OFFSET;
+    display.fillRect(0, statusY, display.width(), STATUS_LINE_Y_OFFSET, BLACK); // Clear status area
+    display.setCursor(0, statusY);
+    display.setTextSize(1); // Smaller font for status
+    display.setTextColor(GREEN, BLACK);
+
+    // Build status string to avoid overload ambiguity
+    char statusBuf[64];
+#if DEBUGGER_BENCH
+    if (benchStarted)
+    {
+        benchmark.formatStatus(statusBuf, sizeof(statusBuf));
+        display.print(statusBuf);
+        display.setTextColor(WHITE, BLACK);
+        return;
+    }
+#endif
+    snprintf(statusBuf, sizeof(statusBuf), "RSSI: %d dBm | SNR: %.1f dB | CRC %lu | rd %lu us", lastRssi,
+             (double)lastSnr, static_cast<unsigned long>(loraManager.getRxCrcErrors()),
+             static_cast<unsigned long>(linkStats.percentileUs(LinkStage::RxRead, 95)));
+    display.print(statusBuf);
+
+    display.setTextColor(WHITE, BLACK); // Reset to default
+}
+
 /**
  * @brief Adds a new message to the display, pushing down existing messages
+ *
+ * In sprite mode the visible lines scroll down by one row inside the
+ * framebuffer and only the new line and the status line are drawn; the
+ * loop pushes the result after the ACKs are handled. Without a framebuffer
+ * every message repaints the screen.
  */
-void addMessageToDisplay(const String &message, int rssi, float snr)
+void addMessageToDisplay(const char *message, int rssi, float snr)
 {
     // Reset activity timer and restore brightness
     lastActivityTime = millis();
-    // Clear screen on first message
-    if (!firstMessageReceived)
-    {
-        firstMessageReceived = true;
-        display.clearScreen();
-        messageCount = 0;
-    }
 
     // Update RSSI/SNR values
     lastRssi = rssi;
     lastSnr = snr;
 
-    // Shift existing messages down
-    for (int i = MAX_DISPLAY_LINES - 1; i > 0; i--)
+    // Newest line first: the ring's head moves back, overwriting the oldest entry
+    historyHead = (historyHead + MAX_DISPLAY_LINES - 1) % MAX_DISPLAY_LINES;
+    strncpy(messageHistory[historyHead], message, DISPLAY_LINE_CHARS - 1);
+    messageHistory[historyHead][DISPLAY_LINE_CHARS - 1] = '\0';
+
+    if (messageCount < MAX_DISPLAY_LINES)
     {
-        messageHistory[i] = messageHistory[i - 1];
+        messageCount++;
     }
 
-    // Add new message at top (without RSSI/SNR, will be shown at bottom)
-    messageHistory[0] = message;
+    int maxVisibleLines = (display.height() - STATUS_HEIGHT) / LINE_HEIGHT;
 
-    if (messageCount < MAX_DISPLAY_LINES)
+    // Clear screen on first message (init messages), repaint if nothing can scroll
+    if (!firstMessageReceived || !display.scrollDown(0, maxVisibleLines * LINE_HEIGHT, LINE_HEIGHT))
     {
-        messageCount++;
+        firstMessageReceived = true;
+        display.clearScreen();
+
+        // Display messages (limit to what fits on screen)
+        int linesToShow = min(messageCount, maxVisibleLines);
+        for (int i = 0; i < linesToShow; i++)
+        {
+            drawHistoryLine(i);
+        }
+    }
+    else
+    {
+        drawHistoryLine(0);
     }
 
-    // Redraw all messages
-    display.clearScreen();
-    display.setTextSize(2); // Bigger font
-    display.setCursor(0, 0);
+    drawStatusLine();
+}
 
-    int maxVisibleLines = (display.height() - STATUS_HEIGHT) / LINE_HEIGHT;
+/**
+ * @brief Schedule an ACK, due ACK_DELAY_MS from now
+ */
+void scheduleAck(uint8_t seq)
+{
+    ackScheduler.schedule(seq);
+}
 
-    // Display messages (limit to what fits on screen)
-    int linesToShow = min(messageCount, maxVisibleLines);
-    for (int i = 0; i < linesToShow; i++)
+/**
+ * @brief Decode, display and ACK a single Text/Ack/Fragment frame
+ * @param packet Link metadata of the LoRa packet the frame arrived in
+ * @param sender Relay origin of the packet, DEDUP_LINK_PEER if it came without a relay header
+ */
+void handleLoRaFrame(const uint8_t *frame, size_t len, const LoRaPacket &packet, uint16_t sender)
+{
+    WireFrame wire;
+    wire.len = min(len, MAX_FRAME_SIZE);
+    memcpy(wire.data, frame, wire.len);
+    bool valid = Message::isValidFrame(wire.data, wire.len);
+
+    // The sender missed our ACK: answer again, the display already has it
+    bool isFragment = wire.data[0] == static_cast<uint8_t>(MessageType::Fragment);
+    if (valid && (wire.data[0] == static_cast<uint8_t>(MessageType::Text) || isFragment) &&
+        rxDedup.isDuplicate(sender, wire.data, wire.len, millis()))
     {
-        display.setCursor(0, i * LINE_HEIGHT);
-        display.printLine(messageHistory[i]);
+        Serial.print(isFragment ? "Duplicate fragment - seq: " : "Duplicate text - seq: ");
+        Serial.print(wire.data[1]);
+        Serial.println(", ACK only");
+        scheduleAck(wire.data[1]);
+        return;
     }
 
-    // Draw status line at bottom with RSSI/SNR
-    int statusY = display.height() - STATUS_LINE_Y_OFFSET;
-    display.fillRect(0, statusY, display.width(), STATUS_LINE_Y_OFFSET, BLACK); // Clear status area
-    display.setCursor(0, statusY);
-    display.setTextSize(1); // Smaller font for status
-    display.setTextColor(GREEN, BLACK);
+    // Keyframe/Delta coordinates back to absolute ones before decoding
+    if (valid && !gpsDecoders.decode(sender, wire, millis()))
+    {
+        Serial.println("Delta GPS without a keyframe, position dropped");
+    }
 
-    // Build status string to avoid overload ambiguity
-    char statusBuf[50];
-    sprintf(statusBuf, "RSSI: %d dBm | SNR: %.1f dB", lastRssi, (double)lastSnr);
-    display.print(statusBuf);
+    // Deserialize message
+    Message msg;
+    if (msg.deserialize(wire.data, wire.len))
+    {
+        Serial.print("LoRa message deserialized: type=");
+        Serial.println((int)msg.type);
 
-    display.setTextColor(WHITE, BLACK); // Reset to default
+        // Handle different message types
+        switch (msg.type)
+        {
+        case MessageType::Text:
+        {
+            Serial.print("Text message - seq: ");
+            Serial.print(msg.textData.seq);
+            Serial.print(", text: \"");
+            Serial.print(msg.textData.text);
+            Serial.print("\"");
+
+            if (msg.textData.hasGps)
+            {
+                Serial.print(", GPS: ");
+                Serial.print(msg.textData.lat / 1000000.0, 6);
+                Serial.print("°, ");
+                Serial.print(msg.textData.lon / 1000000.0, 6);
+                Serial.print("°");
+            }
+            Serial.println();
+
+            // Display text message on screen
+            char displayText[DISPLAY_LINE_CHARS];
+            int textLen = snprintf(displayText, sizeof(displayText), "TXT #%u: %s", msg.textData.seq, msg.textData.text);
+
+            // Add GPS info if available
+            if (msg.textData.hasGps && textLen < (int)sizeof(displayText))
+            {
+                snprintf(displayText + textLen, sizeof(displayText) - textLen, " [%.5f°,%.5f°]",
+                         msg.textData.lat / 1000000.0, msg.textData.lon / 1000000.0);
+            }
+
+            addMessageToDisplay(displayText, packet.rssi, packet.snr);
+
+            // Schedule ACK to send after delay (non-blocking)
+            // This allows sender time to switch from TX to RX mode
+            scheduleAck(msg.textData.seq);
+
+            Serial.print("ACK scheduled for seq ");
+            Serial.print(msg.textData.seq);
+            Serial.print(" in ");
+            Serial.print(ACK_DELAY_MS);
+            Serial.println("ms");
+
+            break;
+        }
+
+        case MessageType::Fragment:
+        {
+            const FragmentMessage &fragment = msg.fragmentData;
+            Serial.printf("Fragment - seq: %u, %u of %u, %u bytes\n", fragment.seq, fragment.index + 1,
+                          fragment.last + 1, fragment.len);
+
+            // Every fragment is ACKed on its own, the bridge retransmits only the missing ones
+            scheduleAck(fragment.seq);
+
+            const uint8_t *payload;
+            size_t payloadLen;
+            uint8_t firstSeq;
+            uint8_t count;
+            if (rxFragments.add(sender, wire.data, wire.len, millis(), payload, payloadLen, firstSeq, count) !=
+                FragmentReassembler::Result::Complete)
+            {
+                break;
+            }
+
+            LongText text;
+            if (!long_text_decode(payload, payloadLen, text))
+            {
+                Serial.println("Long message: not a long text, dropped");
+                addMessageToDisplay("ERROR: Long message", packet.rssi, packet.snr);
+                break;
+            }
+
+            Serial.printf("Long text - first seq: %u, %u fragments, text: \"%s\"", firstSeq, count, text.text);
+            if (text.hasGps)
+            {
+                Serial.printf(", GPS: %.6f°, %.6f°", text.lat / 1000000.0, text.lon / 1000000.0);
+            }
+            Serial.println();
+
+            // Wrapped over as many rows as it takes, pushed last row first so it reads top-down
+            char displayText[LONG_TEXT_MAX_LENGTH + 48];
+            int textLen = snprintf(displayText, sizeof(displayText), "TXT #%u: %s", firstSeq, text.text);
+            if (text.hasGps && textLen < (int)sizeof(displayText))
+            {
+                textLen += snprintf(displayText + textLen, sizeof(displayText) - textLen, " [%.5f°,%.5f°]",
+                                    text.lat / 1000000.0, text.lon / 1000000.0);
+            }
+            textLen = min(textLen, (int)sizeof(displayText) - 1);
+            for (int start = (textLen - 1) / DISPLAY_SCREEN_CHARS * DISPLAY_SCREEN_CHARS; start >= 0;
+                 start -= DISPLAY_SCREEN_CHARS)
+            {
+                char row[DISPLAY_SCREEN_CHARS + 1];
+                snprintf(row, sizeof(row), "%s", displayText + start);
+                addMessageToDisplay(row, packet.rssi, packet.snr);
+            }
+            break;
+        }
+
+        case MessageType::Ack:
+        {
+            Serial.print("Received ACK for seq: ");
+            Serial.println(msg.ackData.seq);
+#if DEBUGGER_BENCH
+            benchmark.onAck(msg.ackData.seq, millis());
+#endif
+
+            // Display ACK on screen (brief info)
+            char ackDisplay[16];
+            snprintf(ackDisplay, sizeof(ackDisplay), "ACK #%u", msg.ackData.seq);
+            addMessageToDisplay(ackDisplay, packet.rssi, packet.snr);
+            break;
+        }
+
+        case MessageType::SelectiveAck:
+        {
+            Serial.print("Received selective ACK - cumulative: ");
+            Serial.print(msg.selectiveAckData.cumulative);
+            Serial.print(", bitmap: 0x");
+            Serial.println(msg.selectiveAckData.bitmap, HEX);
+#if DEBUGGER_BENCH
+            benchmark.onSelectiveAck(msg.selectiveAckData, millis());
+#endif
+
+            char ackDisplay[24];
+            snprintf(ackDisplay, sizeof(ackDisplay), "SACK #%u +0x%x", msg.selectiveAckData.cumulative,
+                     msg.selectiveAckData.bitmap);
+            addMessageToDisplay(ackDisplay, packet.rssi, packet.snr);
+            break;
+        }
+
+        case MessageType::DataRate:
+        {
+            bool request = msg.dataRateData.op == DataRateOp::Request;
+            Serial.print(request ? "Received data rate request: " : "Received data rate accept: ");
+            Serial.println(msg.dataRateData.rate);
+
+            char rateDisplay[16];
+            snprintf(rateDisplay, sizeof(rateDisplay), "%s %u", request ? "ADR REQ" : "ADR ACC", msg.dataRateData.rate);
+            addMessageToDisplay(rateDisplay, packet.rssi, packet.snr);
+
+            // No ADR here: an unanswered request makes the bridge stay at rate 0 and back off.
+            // Answering could be mistaken for the peer bridge's Accept when both are in range.
+            break;
+        }
+
+        case MessageType::Aggregate:
+        case MessageType::Relay:
+            break; // Unpacked by the caller, never produced by deserialize
+        }
+    }
+    else
+    {
+        Serial.println("Failed to deserialize LoRa message");
+        addMessageToDisplay("ERROR: Decode failed", packet.rssi, packet.snr);
+    }
 }
 
 /**
@@ -419,10 +755,8 @@ void setup()
     Serial.println("ESP32 LoRa Receiver starting...");
     Serial.println("===================================");
 
-    // Create message queue for LoRa packets
-    loRaQueue = xQueueCreate(15, sizeof(LoRaPacket));
-
-    if (loRaQueue == nullptr)
+    // Create the variable-length ring for received LoRa packets
+    if (!loRaRing.begin())
     {
         Serial.println("Failed to create message queue. Halting execution.");
         display.printLine("Queue creation failed!");
@@ -434,7 +768,7 @@ void setup()
 
     // Initialize LoRa
     Serial.println("\nInitializing LoRa radio...");
-    Serial.println(loraManager.getConfigurationString());
+    loraManager.printConfiguration(Serial);
     display.printLine("Initializing LoRa...");
 
     const int LORA_RETRY_COUNT = 3;
@@ -477,11 +811,29 @@ void setup()
         }
     }
 
-    // Set up event-driven LoRa reception
-    LoRa.onReceive(onLoRaReceive);
-
     // Start continuous receive mode
     loraManager.startReceiveMode();
+
+    // Set up event-driven LoRa reception and transmission
+    // DIO0 ISR only notifies the radio task, which owns the SX127x over SPI
+    if (!loraManager.startRadioTask(&loRaRing))
+    {
+        Serial.println("LoRa radio task failed to start. Halting execution.");
+        display.printLine("Radio task failed!");
+        while (1)
+        {
+            delay(1000);
+        }
+    }
+    if (!ackScheduler.begin())
+    {
+        Serial.println("ACK timer failed to start. Halting execution.");
+        display.printLine("ACK timer failed!");
+        while (1)
+        {
+            delay(1000);
+        }
+    }
     display.printLine("LoRa Receiver ready.");
     Serial.println("LoRa Receiver ready.");
 
@@ -498,13 +850,22 @@ void setup()
     lastActivityTime = millis();
 
     // Initialize message history
-    for (int i = 0; i < MAX_DISPLAY_LINES; i++)
-    {
-        messageHistory[i] = "";
-    }
+    memset(messageHistory, 0, sizeof(messageHistory));
+    historyHead = 0;
     messageCount = 0;
 
     Serial.println("Message history initialized");
+
+    // From here on draws go to a framebuffer, pushed once per loop() pass. The
+    // panel keeps the init messages until the first message repaints it.
+    if (display.beginSprite())
+    {
+        Serial.println("Display framebuffer allocated (incremental redraws)");
+    }
+    else
+    {
+        Serial.println("No memory for the display framebuffer, drawing directly");
+    }
 }
 
 /**
@@ -553,6 +914,9 @@ void loop()
                 // Short press - reset activity timer
                 Serial.println("Button short press - activity reset");
                 lastActivityTime = millis();
+#if DEBUGGER_BENCH
+                startBenchmark(); // And a new benchmark run
+#endif
             }
         }
         else if (pressDuration >= LONG_PRESS_DURATION)
@@ -566,122 +930,108 @@ void loop()
 
     // Check for messages from LoRa (event-driven via callback)
     LoRaPacket packet;
-    if (xQueueReceive(loRaQueue, &packet, 0) == pdTRUE)
+    if (loRaRing.pop(packet))
     {
-        Serial.print("LoRa RX: received ");
-        Serial.print(packet.len);
-        Serial.print(" bytes, RSSI: ");
-        Serial.print(packet.rssi);
-        Serial.print(" dBm, SNR: ");
-        Serial.print(packet.snr);
-        Serial.println(" dB");
-
-        // Deserialize message
-        Message msg;
-        if (msg.deserialize(packet.buffer, packet.len))
+        LOG_INFO(LoRaRx, packet.len, packet.rssi, lroundf(packet.snr));
+
+        // Corrupt frames are dropped by the radio task without waking us, report them with the next good one
+        static uint32_t reportedCrcErrors = 0;
+        uint32_t crcErrors = loraManager.getRxCrcErrors();
+        if (crcErrors != reportedCrcErrors)
         {
-            Serial.print("LoRa message deserialized: type=");
-            Serial.println((int)msg.type);
+            LOG_WARN(LoRaCrcErrors, crcErrors - reportedCrcErrors);
+            reportedCrcErrors = crcErrors;
+        }
 
-            // Handle different message types
-            switch (msg.type)
+        // Relayed packets are shown once per origin and packet id, never rebroadcast from here
+        const uint8_t *data = packet.buffer;
+        size_t len = packet.len;
+        uint16_t sender = DEDUP_LINK_PEER;
+        RelayHeader relay;
+        if (len > 0 && data[0] == static_cast<uint8_t>(MessageType::Relay))
+        {
+            if (!relay_unwrap(packet.buffer, packet.len, relay, data, len))
             {
-            case MessageType::Text:
+                Serial.println("Invalid relayed packet");
+                len = 0;
+            }
+            else if (relaySeen.isDuplicate(relay.origin, relay.packetId, dedup_hash(data, len), millis()))
             {
-                Serial.print("Text message - seq: ");
-                Serial.print(msg.textData.seq);
-                Serial.print(", text: \"");
-                Serial.print(msg.textData.text);
-                Serial.print("\"");
-
-                if (msg.textData.hasGps)
-                {
-                    Serial.print(", GPS: ");
-                    Serial.print(msg.textData.lat / 1000000.0, 6);
-                    Serial.print("°, ");
-                    Serial.print(msg.textData.lon / 1000000.0, 6);
-                    Serial.print("°");
-                }
-                Serial.println();
+                Serial.print("Relayed copy of node ");
+                Serial.print(relay.origin);
+                Serial.print(" packet ");
+                Serial.print(relay.packetId);
+                Serial.println(" seen before");
+                len = 0;
+            }
+            else
+            {
+                Serial.print("Relayed packet from node ");
+                Serial.print(relay.origin);
+                Serial.print(", TTL ");
+                Serial.println(relay.ttl);
+                sender = relay.origin;
+            }
+        }
 
-                // Display text message on screen
-                String displayText = "TXT #";
-                displayText += String(msg.textData.seq);
-                displayText += ": ";
-                displayText += String(msg.textData.text);
+        if (len > 0 && data[0] == static_cast<uint8_t>(MessageType::Aggregate))
+        {
+            AggregateReader reader(data, len);
+            if (reader.isValid())
+            {
+                Serial.print("Aggregate frame with ");
+                Serial.print(reader.count());
+                Serial.println(" messages");
 
-                // Add GPS info if available
-                if (msg.textData.hasGps)
+                const uint8_t *frame;
+                size_t frameLen;
+                while (reader.next(frame, frameLen))
                 {
-                    displayText += " [";
-                    displayText += String(msg.textData.lat / 1000000.0, 5);
-                    displayText += "°,";
-                    displayText += String(msg.textData.lon / 1000000.0, 5);
-                    displayText += "°]";
+                    handleLoRaFrame(frame, frameLen, packet, sender);
                 }
-
-                addMessageToDisplay(displayText, packet.rssi, packet.snr);
-
-                // Schedule ACK to send after delay (non-blocking)
-                // This allows sender time to switch from TX to RX mode
-                ackPending = true;
-                pendingAckSeq = msg.textData.seq;
-                ackSendTime = millis() + ACK_DELAY_MS;
-                pendingAckMsg = Message::createAck(msg.textData.seq);
-
-                Serial.print("ACK scheduled for seq ");
-                Serial.print(msg.textData.seq);
-                Serial.print(" in ");
-                Serial.print(ACK_DELAY_MS);
-                Serial.println("ms");
-
-                break;
             }
-
-            case MessageType::Ack:
+            else
             {
-                Serial.print("Received ACK for seq: ");
-                Serial.println(msg.ackData.seq);
-
-                // Display ACK on screen (brief info)
-                String ackDisplay = "ACK #";
-                ackDisplay += String(msg.ackData.seq);
-                addMessageToDisplay(ackDisplay, packet.rssi, packet.snr);
-                break;
-            }
+                Serial.println("Invalid aggregate frame");
+                addMessageToDisplay("ERROR: Bad aggregate", packet.rssi, packet.snr);
             }
         }
-        else
+        else if (len > 0)
         {
-            Serial.println("Failed to deserialize LoRa message");
-            addMessageToDisplay("ERROR: Decode failed", packet.rssi, packet.snr);
+            handleLoRaFrame(data, len, packet, sender);
         }
     }
 
-    // Check for pending ACK to send (non-blocking)
-    if (ackPending && millis() >= ackSendTime)
+#if DEBUGGER_BENCH
+    if (!benchStarted && millis() > BENCH_START_DELAY_MS)
     {
-        ackPending = false;
-
-        uint8_t ackBuf[64];
-        int ackLen = pendingAckMsg.serialize(ackBuf, sizeof(ackBuf));
+        LinkBenchmark::printCsvHeader(Serial);
+        startBenchmark();
+    }
+    if (benchmark.running())
+    {
+        lastActivityTime = millis(); // No light sleep mid-run: the radio task owns the timing
+        if (benchmark.service(millis()))
+        {
+            benchmark.printCsv(Serial, loraManager.getSpreadingFactor(), loraManager.getBandwidth());
 
-        if (ackLen > 0)
+            char result[DISPLAY_LINE_CHARS];
+            snprintf(result, sizeof(result), "BENCH %u/%u p50 %lu ms %lu bps", benchmark.acked(), benchmark.sent(),
+                     static_cast<unsigned long>(benchmark.rttPercentileMs(50)),
+                     static_cast<unsigned long>(benchmark.goodputBps()));
+            addMessageToDisplay(result, lastRssi, lastSnr);
+        }
+        else
         {
-            Serial.print("Sending ACK for seq: ");
-            Serial.println(pendingAckSeq);
-            bool ackSent = loraManager.sendPacket(ackBuf, ackLen);
-            if (ackSent)
-            {
-                Serial.println("ACK sent successfully");
-            }
-            else
+            static uint16_t shownSent = 0;
+            if (benchmark.sent() != shownSent)
             {
-                Serial.println("ACK send failed");
+                shownSent = benchmark.sent();
+                drawStatusLine(); // Progress between ACKs
             }
-            loraManager.startReceiveMode();
         }
     }
+#endif
 
     // Check for sleep timeout (prevents immediate re-sleep after wake)
     unsigned long timeSinceActivity = millis() - lastActivityTime;
@@ -693,6 +1043,11 @@ void loop()
         // Activity time already reset in enterLightSleep()
     }
 
+    // Push what was drawn this pass in one transfer
+    display.flush();
+
+    printLogEvents();
+
     // Small delay to prevent watchdog issues and allow task switching
     vTaskDelay(pdMS_TO_TICKS(10));
 
@@ -0,0 +1,156 @@
+#include "Adr.h"
+#include <math.h>
+
+float adr_required_snr_db(uint8_t spreadingFactor)
+{
+    // SF6 -5 dB, then 2.5 dB lower per step: SF7 -7.5 ... SF12 -20
+    return -5.0f - 2.5f * (spreadingFactor - 6);
+}
+
+float adr_sensitivity_dbm(const LoRaRate &rate)
+{
+    return -174.0f + 10.0f * log10f(static_cast<float>(rate.bandwidthHz)) + 6.0f +
+           adr_required_snr_db(rate.spreadingFactor);
+}
+
+void AdrController::reset(uint8_t rate)
+{
+    current = rate;
+    samples = 0;
+    rssi = 0;
+    snr = 0;
+    requestPending = false;
+    requested = rate;
+    requestMs = 0;
+    lastChangeMs = 0;
+    lastRxMs = 0;
+}
+
+void AdrController::onPacket(int packetRssi, float packetSnr, uint32_t nowMs)
+{
+    lastRxMs = nowMs;
+    if (samples == 0)
+    {
+        rssi = static_cast<float>(packetRssi);
+        snr = packetSnr;
+    }
+    else
+    {
+        // alpha = 1/4: follows a changing link within a few packets
+        rssi += (packetRssi - rssi) / 4;
+        snr += (packetSnr - snr) / 4;
+    }
+    if (samples < UINT8_MAX)
+    {
+        samples++;
+    }
+}
+
+float AdrController::marginDb(uint8_t rate) const
+{
+    const LoRaRate &from = ADR_RATES[current];
+    const LoRaRate &to = ADR_RATES[rate];
+
+    // Same signal, noise scales with the bandwidth
+    float snrAtRate = snr + 10.0f * log10f(static_cast<float>(from.bandwidthHz) / to.bandwidthHz);
+    float snrMargin = snrAtRate - adr_required_snr_db(to.spreadingFactor);
+    float rssiMargin = rssi - adr_sensitivity_dbm(to);
+    return snrMargin < rssiMargin ? snrMargin : rssiMargin;
+}
+
+uint8_t AdrController::bestRate() const
+{
+    if (samples == 0)
+    {
+        return current;
+    }
+    for (uint8_t rate = ADR_RATE_COUNT - 1; rate > 0; rate--)
+    {
+        float needed = rate > current ? ADR_MARGIN_DB : ADR_MARGIN_DB - ADR_HYSTERESIS_DB;
+        if (marginDb(rate) >= needed)
+        {
+            return rate;
+        }
+    }
+    return 0;
+}
+
+uint8_t AdrController::onRequest(uint8_t rate)
+{
+    if (rate >= ADR_RATE_COUNT)
+    {
+        return current;
+    }
+
+    uint8_t accepted = bestRate();
+    accepted = rate < accepted ? rate : accepted;
+    if (requestPending)
+    {
+        // Both nodes asked at once: both end up at the lower of the two requests
+        accepted = requested < accepted ? requested : accepted;
+        requestPending = false;
+    }
+    return accepted;
+}
+
+void AdrController::backOff()
+{
+    holdoffMs = holdoffMs < ADR_MAX_HOLDOFF_MS / 2 ? 2 * holdoffMs : ADR_MAX_HOLDOFF_MS;
+}
+
+bool AdrController::onAccept(uint8_t rate)
+{
+    if (!requestPending || rate >= ADR_RATE_COUNT || rate > requested)
+    {
+        return false; // Not an answer to our request
+    }
+    requestPending = false;
+    if (rate == requested)
+    {
+        holdoffMs = ADR_HOLDOFF_MS;
+    }
+    else
+    {
+        backOff(); // Peer settled on less than we asked for
+    }
+    return rate != current;
+}
+
+void AdrController::switched(uint8_t rate, uint32_t nowMs)
+{
+    reset(rate < ADR_RATE_COUNT ? rate : 0);
+    lastChangeMs = nowMs;
+    lastRxMs = nowMs;
+}
+
+AdrController::Event AdrController::poll(uint32_t nowMs, uint8_t &rate)
+{
+    if (current != 0 && nowMs - lastRxMs >= ADR_FALLBACK_MS)
+    {
+        rate = 0;
+        return Event::Fallback;
+    }
+
+    if (requestPending && nowMs - requestMs >= ADR_REQUEST_TIMEOUT_MS)
+    {
+        requestPending = false; // Unanswered, try again after a longer holdoff
+        backOff();
+    }
+
+    if (requestPending || samples < ADR_MIN_SAMPLES || nowMs - lastChangeMs < holdoffMs)
+    {
+        return Event::None;
+    }
+
+    uint8_t best = bestRate();
+    if (best == current)
+    {
+        return Event::None;
+    }
+    requestPending = true;
+    requested = best;
+    requestMs = nowMs;
+    lastChangeMs = nowMs;
+    rate = best;
+    return Event::Propose;
+}
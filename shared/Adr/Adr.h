@@ -0,0 +1,141 @@
+#ifndef ADR_H
+#define ADR_H
+
+#include <stddef.h>
+#include <stdint.h>
+#include "LoRaAirtime.h"
+
+/// Spreading factor and bandwidth of one data rate
+struct LoRaRate
+{
+    uint8_t spreadingFactor;
+    uint32_t bandwidthHz;
+};
+
+/// Data rates both bridges can switch between, slowest first. Rate 0 is the
+/// lora_config.h profile every node boots with and falls back to, so it is
+/// always the rate two nodes can meet at.
+constexpr LoRaRate ADR_RATES[] = {
+    {LongRangeRadio::spreadingFactor, LongRangeRadio::effectiveBandwidthHz},
+    {10, 62500},
+    {9, 125000},
+    {8, 125000},
+    {7, 125000},
+};
+
+const uint8_t ADR_RATE_COUNT = sizeof(ADR_RATES) / sizeof(ADR_RATES[0]);
+
+/// Time on air of a packet at one of the ADR_RATES, in ms (coding rate and CRC of
+/// LongRangeRadio, the link's preamble at that rate)
+constexpr uint32_t adr_time_on_air_ms(size_t payloadLen, uint8_t rate)
+{
+    return lora_time_on_air_ms(payloadLen, ADR_RATES[rate].spreadingFactor, ADR_RATES[rate].bandwidthHz,
+                               LongRangeRadio::codingRate,
+                               lora_link_preamble_symbols(ADR_RATES[rate].spreadingFactor, ADR_RATES[rate].bandwidthHz),
+                               LongRangeRadio::crcEnabled);
+}
+
+static_assert(adr_time_on_air_ms(51, 1) < adr_time_on_air_ms(51, 0) && adr_time_on_air_ms(51, 2) < adr_time_on_air_ms(51, 1) &&
+                  adr_time_on_air_ms(51, 3) < adr_time_on_air_ms(51, 2) && adr_time_on_air_ms(51, 4) < adr_time_on_air_ms(51, 3),
+              "ADR_RATES must get faster with every step, starting from the lora_config.h profile");
+
+/// Link margin a faster rate must keep, in dB (as the LoRaWAN ADR installation margin)
+const float ADR_MARGIN_DB = 10.0f;
+
+/// The current rate is kept until its margin drops this far below ADR_MARGIN_DB
+const float ADR_HYSTERESIS_DB = 3.0f;
+
+/// Packets to average at a rate before proposing a switch
+const uint8_t ADR_MIN_SAMPLES = 4;
+
+/// Minimum time between proposals. Doubles (up to ADR_MAX_HOLDOFF_MS) whenever a
+/// proposal is declined or unanswered, so a peer without ADR costs little airtime.
+const uint32_t ADR_HOLDOFF_MS = 60000;
+const uint32_t ADR_MAX_HOLDOFF_MS = 30UL * 60UL * 1000UL;
+
+/// A request without an accept within this time is given up
+const uint32_t ADR_REQUEST_TIMEOUT_MS = 30000;
+
+/// Nothing heard for this long at a faster rate: return to rate 0, where the peer ends up too.
+/// Shorter than ARQ_RECEIVER_IDLE_MS, so a resync after the fallback looks like an idle link.
+const uint32_t ADR_FALLBACK_MS = 5UL * 60UL * 1000UL;
+
+/// Demodulator SNR limit of the SX127x for a spreading factor (datasheet table 13), in dB
+float adr_required_snr_db(uint8_t spreadingFactor);
+
+/// Receiver sensitivity for a rate: -174 dBm/Hz + 10log10(BW) + 6 dB noise figure + required SNR
+float adr_sensitivity_dbm(const LoRaRate &rate);
+
+/// Link-quality estimator and data-rate negotiation for the bridge-to-bridge link.
+///
+/// Every received packet updates a smoothed RSSI/SNR at the current rate. The
+/// SNR is translated to every other rate (a narrower bandwidth collects less
+/// noise) and the fastest rate that keeps ADR_MARGIN_DB over both the
+/// demodulator SNR limit and the sensitivity is the best rate.
+///
+/// Both ends must use the same rate, so a switch is negotiated:
+/// 1. A node whose best rate differs sends DataRate Request(best), at the current rate
+/// 2. The peer answers Accept(min(requested, its own best)) and switches right after sending it
+/// 3. The requester switches when the Accept arrives
+/// Any node that hears nothing for ADR_FALLBACK_MS at a faster rate returns to
+/// rate 0, so a lost Accept or a fading link ends with both nodes at rate 0.
+///
+/// No clock or radio access: every call takes the current time in ms.
+class AdrController
+{
+public:
+    enum class Event
+    {
+        None,    // Nothing to do
+        Propose, // Send Request(rate) to the peer
+        Fallback // Switch the radio to rate (0) now
+    };
+
+    AdrController() : holdoffMs(ADR_HOLDOFF_MS) { reset(0); }
+
+    /// Current rate (index into ADR_RATES)
+    uint8_t rate() const { return current; }
+
+    /// Records a packet received at the current rate
+    void onPacket(int rssi, float snr, uint32_t nowMs);
+
+    /// Fastest rate the measured link supports (the current one without samples)
+    uint8_t bestRate() const;
+
+    /// Margin in dB a rate would have over the receiver limits, from the smoothed link quality
+    float marginDb(uint8_t rate) const;
+
+    /// Handles the peer's Request. Returns the rate to Accept and switch to after sending it,
+    /// or the current rate if nothing changes.
+    uint8_t onRequest(uint8_t requested);
+
+    /// Handles the peer's Accept. Returns true if the radio should switch to rate now.
+    bool onAccept(uint8_t rate);
+
+    /// Must be called once the radio runs at rate (after a switch or a fallback)
+    void switched(uint8_t rate, uint32_t nowMs);
+
+    /// Returns the next due event and its rate
+    Event poll(uint32_t nowMs, uint8_t &rate);
+
+    /// Smoothed RSSI/SNR at the current rate (0 before the first packet)
+    float smoothedRssi() const { return rssi; }
+    float smoothedSnr() const { return snr; }
+
+private:
+    uint8_t current;
+    uint8_t samples;   // Packets averaged at the current rate (saturates)
+    float rssi;        // dBm, smoothed
+    float snr;         // dB, smoothed
+    bool requestPending;
+    uint8_t requested; // Rate of the pending request
+    uint32_t requestMs;
+    uint32_t lastChangeMs; // Last switch or proposal
+    uint32_t holdoffMs;    // Current wait between proposals
+    uint32_t lastRxMs;
+
+    void reset(uint8_t rate);
+    void backOff();
+};
+
+#endif // ADR_H
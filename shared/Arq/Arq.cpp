@@ -0,0 +1,306 @@
+#include "Arq.h"
+
+static_assert(ARQ_WINDOW_SIZE == 8 * sizeof(SelectiveAckMessage::bitmap), "window must match the bitmap width");
+
+bool arq_ack_covers(const SelectiveAckMessage &ack, uint8_t seq)
+{
+    uint8_t ahead = static_cast<uint8_t>(seq - ack.cumulative);
+    if (ahead >= 1 && ahead <= ARQ_WINDOW_SIZE)
+    {
+        return (ack.bitmap >> (ahead - 1)) & 1;
+    }
+    return !arq_seq_before(ack.cumulative, seq); // At or behind the cumulative point
+}
+
+void ArqReceiver::reset()
+{
+    synced = false;
+    cumulative = 0;
+    bitmap = 0;
+    lastReceiveMs = 0;
+}
+
+void ArqReceiver::receive(uint8_t seq, uint32_t nowMs)
+{
+    if (!synced || nowMs - lastReceiveMs > ARQ_RECEIVER_IDLE_MS)
+    {
+        // New window ending at seq: nothing before it is known to have arrived
+        synced = true;
+        cumulative = static_cast<uint8_t>(seq - ARQ_WINDOW_SIZE);
+        bitmap = 0;
+    }
+    lastReceiveMs = nowMs;
+
+    uint8_t ahead = static_cast<uint8_t>(seq - cumulative);
+    uint8_t behind = static_cast<uint8_t>(cumulative - seq);
+    if (ahead >= 1 && ahead <= ARQ_WINDOW_SIZE)
+    {
+        bitmap |= 1 << (ahead - 1);
+    }
+    else if (behind < ARQ_WINDOW_SIZE)
+    {
+        return; // Retransmission of a seq that is already acknowledged cumulatively
+    }
+    else if (ahead < 128)
+    {
+        // Ahead of the window: the sender gave up on the oldest gaps, slide past them
+        uint8_t shift = ahead - ARQ_WINDOW_SIZE;
+        bitmap = shift >= ARQ_WINDOW_SIZE ? 0 : bitmap >> shift;
+        cumulative = static_cast<uint8_t>(cumulative + shift);
+        bitmap |= 1 << (ARQ_WINDOW_SIZE - 1);
+    }
+    else
+    {
+        // Far behind: the sender restarted its sequence numbers
+        cumulative = static_cast<uint8_t>(seq - ARQ_WINDOW_SIZE);
+        bitmap = 1 << (ARQ_WINDOW_SIZE - 1);
+    }
+
+    // Advance the cumulative point over every contiguous received seq
+    while (bitmap & 1)
+    {
+        cumulative++;
+        bitmap >>= 1;
+    }
+}
+
+ArqSender::ArqSender() : srtt(0), rttvar(0), retransmitCount(0)
+{
+    for (Slot &slot : slots)
+    {
+        slot.used = false;
+    }
+}
+
+uint8_t ArqSender::inFlight() const
+{
+    uint8_t count = 0;
+    for (const Slot &slot : slots)
+    {
+        count += slot.used ? 1 : 0;
+    }
+    return count;
+}
+
+ArqSender::Slot *ArqSender::find(uint8_t seq)
+{
+    return const_cast<Slot *>(static_cast<const ArqSender *>(this)->find(seq));
+}
+
+const ArqSender::Slot *ArqSender::find(uint8_t seq) const
+{
+    for (const Slot &slot : slots)
+    {
+        if (slot.used && slot.frame.data[1] == seq)
+        {
+            return &slot;
+        }
+    }
+    return nullptr;
+}
+
+bool ArqSender::canTrack(uint8_t seq) const
+{
+    if (find(seq) != nullptr)
+    {
+        return true;
+    }
+    uint8_t count = 0;
+    for (const Slot &slot : slots)
+    {
+        if (!slot.used)
+        {
+            continue;
+        }
+        if (static_cast<uint8_t>(seq - slot.frame.data[1]) >= ARQ_WINDOW_SIZE)
+        {
+            return false; // Would span more seqs than the bitmap covers
+        }
+        count++;
+    }
+    return count < ARQ_WINDOW_SIZE;
+}
+
+uint32_t ArqSender::initialRto(uint32_t minRtoMs) const
+{
+    // No sample yet: twice the airtime floor leaves room for queueing behind other frames
+    uint32_t rto = srtt == 0 ? 2 * minRtoMs : srtt + 4 * rttvar;
+    if (rto < minRtoMs)
+    {
+        rto = minRtoMs;
+    }
+    return rto < ARQ_MAX_RTO_MS ? rto : ARQ_MAX_RTO_MS;
+}
+
+bool ArqSender::track(const uint8_t *frame, size_t len, uint32_t nowMs, uint32_t minRtoMs)
+{
+    bool arqFrame = len >= 2 && (frame[0] == static_cast<uint8_t>(MessageType::Text) ||
+                                 frame[0] == static_cast<uint8_t>(MessageType::Fragment));
+    if (!arqFrame || len > MAX_FRAME_SIZE)
+    {
+        return false;
+    }
+
+    if (!canTrack(frame[1]))
+    {
+        return false; // Window full
+    }
+
+    Slot *slot = find(frame[1]);
+    for (size_t i = 0; slot == nullptr && i < ARQ_WINDOW_SIZE; i++)
+    {
+        if (!slots[i].used)
+        {
+            slot = &slots[i];
+        }
+    }
+
+    slot->used = true;
+    slot->fastRetransmit = false;
+    slot->transmissions = 1;
+    slot->sentMs = nowMs;
+    slot->rtoMs = initialRto(minRtoMs);
+    slot->frame.len = len;
+    memcpy(slot->frame.data, frame, len);
+    return true;
+}
+
+void ArqSender::transmitted(uint8_t seq, uint32_t nowMs)
+{
+    Slot *slot = find(seq);
+    if (slot != nullptr)
+    {
+        slot->sentMs = nowMs;
+    }
+}
+
+void ArqSender::sampleRtt(uint32_t rttMs)
+{
+    if (srtt == 0)
+    {
+        srtt = rttMs > 0 ? rttMs : 1;
+        rttvar = rttMs / 2;
+        return;
+    }
+    uint32_t delta = srtt > rttMs ? srtt - rttMs : rttMs - srtt;
+    rttvar = (3 * rttvar + delta) / 4; // beta = 1/4
+    srtt = (7 * srtt + rttMs) / 8;     // alpha = 1/8
+    if (srtt == 0)
+    {
+        srtt = 1;
+    }
+}
+
+void ArqSender::complete(Slot &slot, uint32_t nowMs)
+{
+    if (slot.transmissions == 1)
+    {
+        sampleRtt(nowMs - slot.sentMs); // Karn: only unambiguous samples
+    }
+    slot.used = false;
+}
+
+bool ArqSender::acknowledge(uint8_t seq, uint32_t nowMs)
+{
+    Slot *slot = find(seq);
+    if (slot == nullptr)
+    {
+        return false;
+    }
+    complete(*slot, nowMs);
+    return true;
+}
+
+void ArqSender::markGapsBefore(uint32_t sentMs)
+{
+    for (Slot &slot : slots)
+    {
+        if (slot.used && static_cast<int32_t>(sentMs - slot.sentMs) > 0)
+        {
+            slot.fastRetransmit = true; // A later transmission got through, this one did not
+        }
+    }
+}
+
+uint8_t ArqSender::acknowledge(const SelectiveAckMessage &ack, uint32_t nowMs, uint8_t *acked)
+{
+    uint8_t count = 0;
+    uint32_t newestSentMs = 0;
+    for (Slot &slot : slots)
+    {
+        if (!slot.used || !arq_ack_covers(ack, slot.frame.data[1]))
+        {
+            continue;
+        }
+        if (count == 0 || static_cast<int32_t>(slot.sentMs - newestSentMs) > 0)
+        {
+            newestSentMs = slot.sentMs;
+        }
+        acked[count++] = slot.frame.data[1];
+        complete(slot, nowMs);
+    }
+
+    if (count > 0)
+    {
+        markGapsBefore(newestSentMs);
+    }
+    return count;
+}
+
+ArqSender::Event ArqSender::poll(uint32_t nowMs, const WireFrame *&frame)
+{
+    for (Slot &slot : slots)
+    {
+        if (!slot.used)
+        {
+            continue;
+        }
+        bool timedOut = static_cast<int32_t>(nowMs - (slot.sentMs + slot.rtoMs)) >= 0;
+        if (!timedOut && !slot.fastRetransmit)
+        {
+            continue;
+        }
+
+        frame = &slot.frame;
+        if (slot.transmissions >= ARQ_MAX_TRANSMISSIONS)
+        {
+            slot.used = false;
+            return Event::GaveUp;
+        }
+
+        if (timedOut)
+        {
+            // Exponential backoff: the link or the peer is slower than estimated
+            slot.rtoMs = slot.rtoMs < ARQ_MAX_RTO_MS / 2 ? 2 * slot.rtoMs : ARQ_MAX_RTO_MS;
+        }
+        slot.fastRetransmit = false;
+        slot.transmissions++;
+        slot.sentMs = nowMs;
+        retransmitCount++;
+        return Event::Retransmit;
+    }
+    return Event::None;
+}
+
+uint32_t ArqSender::nextTimeout(uint32_t nowMs) const
+{
+    uint32_t next = UINT32_MAX;
+    for (const Slot &slot : slots)
+    {
+        if (!slot.used)
+        {
+            continue;
+        }
+        if (slot.fastRetransmit)
+        {
+            return 0;
+        }
+        int32_t remaining = static_cast<int32_t>(slot.sentMs + slot.rtoMs - nowMs);
+        uint32_t wait = remaining > 0 ? static_cast<uint32_t>(remaining) : 0;
+        if (wait < next)
+        {
+            next = wait;
+        }
+    }
+    return next;
+}
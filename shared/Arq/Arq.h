@@ -0,0 +1,145 @@
+#ifndef ARQ_H
+#define ARQ_H
+
+#include <stddef.h>
+#include <stdint.h>
+#include "Protocol.h"
+
+/// Text frames a sender keeps in flight, also the width of the SelectiveAck bitmap
+const uint8_t ARQ_WINDOW_SIZE = 8;
+
+/// Transmissions per frame (first send + retransmissions) before the sender gives up
+const uint8_t ARQ_MAX_TRANSMISSIONS = 5;
+
+/// Upper bound for a single retransmission timeout
+const uint32_t ARQ_MAX_RTO_MS = 120000;
+
+/// A receiver that heard nothing for this long starts a fresh window on the next
+/// text, so an app restart (seq back to 0) is not mistaken for old traffic.
+/// Longer than the worst case a sender keeps retrying (ARQ_MAX_TRANSMISSIONS RTOs).
+const uint32_t ARQ_RECEIVER_IDLE_MS = 10UL * 60UL * 1000UL;
+
+/// Sequence numbers are compared modulo 256: a is before b if it is less than half the space behind
+inline bool arq_seq_before(uint8_t a, uint8_t b)
+{
+    return a != b && static_cast<uint8_t>(b - a) < 128;
+}
+
+/// True if the selective ACK acknowledges seq: seq is at or behind the cumulative
+/// point (within the window) or its bit is set
+bool arq_ack_covers(const SelectiveAckMessage &ack, uint8_t seq);
+
+/// Receiver half of the link ARQ: remembers which text seqs arrived and builds
+/// the cumulative+bitmap acknowledgment that reports them all in one 3-byte frame.
+///
+/// The window always spans the ARQ_WINDOW_SIZE seqs after the cumulative point.
+/// A seq outside of it (sender restarted, or gave up on a gap) moves the window
+/// so that this seq is its newest entry. Seqs before the first one received are
+/// never assumed to have arrived, so after a reboot the cumulative point trails
+/// the newest seq by up to a window until the sender's older frames are settled.
+class ArqReceiver
+{
+public:
+    ArqReceiver() { reset(); }
+
+    /// Records a received text. Duplicates are fine and leave the state unchanged.
+    void receive(uint8_t seq, uint32_t nowMs);
+
+    /// Current acknowledgment (only meaningful after the first receive())
+    SelectiveAckMessage ack() const { return {cumulative, bitmap}; }
+
+    /// Forgets all state, the next text starts a new window
+    void reset();
+
+private:
+    bool synced;
+    uint8_t cumulative; // Every seq up to here has been received or given up on
+    uint8_t bitmap;     // Bit i: cumulative + 1 + i received
+    uint32_t lastReceiveMs;
+};
+
+/// Sender half of the link ARQ: keeps up to ARQ_WINDOW_SIZE text frames in flight
+/// and retransmits those that are not acknowledged in time.
+///
+/// The retransmission timeout follows RFC 6298 from RTT samples (Karn's rule:
+/// retransmitted frames are not sampled), never below the frame's airtime floor
+/// given by the caller, and doubles on every retransmission. A frame reported
+/// missing by a selective ACK that acknowledges a later frame is retransmitted
+/// right away instead of waiting for its timeout.
+///
+/// No clock or radio access: every call takes the current time in ms.
+class ArqSender
+{
+public:
+    enum class Event
+    {
+        None,       // Nothing due
+        Retransmit, // Send the returned frame again (already rescheduled)
+        GaveUp      // Frame exhausted ARQ_MAX_TRANSMISSIONS and was dropped
+    };
+
+    ArqSender();
+
+    /// True if a text with this seq can be tracked now: a slot is free and every
+    /// frame in flight is less than ARQ_WINDOW_SIZE seqs older, so the receiver's
+    /// bitmap can still report all of them. A seq already in flight always fits.
+    bool canTrack(uint8_t seq) const;
+
+    /// Frames waiting for an acknowledgment
+    uint8_t inFlight() const;
+
+    /// Starts tracking a Text or Fragment frame that was just handed to the radio.
+    /// minRtoMs is the airtime floor: frame + ACK time on air plus the peer's ACK delay.
+    /// A frame with a seq already in flight replaces it (the app re-sent it).
+    /// Returns false for other frames or when canTrack() is false.
+    bool track(const uint8_t *frame, size_t len, uint32_t nowMs, uint32_t minRtoMs);
+
+    /// Restarts the timer of seq when its frame actually goes on air, so time spent
+    /// in a TX queue (radio busy, duty-cycle wait) does not count towards its RTO.
+    void transmitted(uint8_t seq, uint32_t nowMs);
+
+    /// Handles a plain ACK. Returns true if seq was in flight.
+    bool acknowledge(uint8_t seq, uint32_t nowMs);
+
+    /// Handles a selective ACK. Writes the newly acknowledged seqs (up to
+    /// ARQ_WINDOW_SIZE) to acked and returns how many there were.
+    uint8_t acknowledge(const SelectiveAckMessage &ack, uint32_t nowMs, uint8_t *acked);
+
+    /// Returns the next due event. For Retransmit and GaveUp frame points at the
+    /// frame concerned; it stays valid until the next track() call.
+    Event poll(uint32_t nowMs, const WireFrame *&frame);
+
+    /// Milliseconds until poll() has something to do (0 if due now), UINT32_MAX when idle
+    uint32_t nextTimeout(uint32_t nowMs) const;
+
+    /// Smoothed round-trip time in ms, 0 before the first sample
+    uint32_t smoothedRtt() const { return srtt; }
+
+    /// Retransmissions sent since boot
+    uint32_t retransmissions() const { return retransmitCount; }
+
+private:
+    struct Slot
+    {
+        bool used;
+        bool fastRetransmit; // Reported missing, send again on the next poll()
+        uint8_t transmissions;
+        uint32_t sentMs;
+        uint32_t rtoMs;
+        WireFrame frame;
+    };
+
+    Slot slots[ARQ_WINDOW_SIZE];
+    uint32_t srtt;   // Smoothed RTT, ms (0 = no sample yet)
+    uint32_t rttvar; // RTT variation, ms
+    uint32_t retransmitCount;
+
+    Slot *find(uint8_t seq);
+    const Slot *find(uint8_t seq) const;
+    uint32_t initialRto(uint32_t minRtoMs) const;
+    void complete(Slot &slot, uint32_t nowMs);
+    void sampleRtt(uint32_t rttMs);
+    void markGapsBefore(uint32_t sentMs);
+};
+
+#endif // ARQ_H
@@ -0,0 +1,97 @@
+#include "Dedup.h"
+
+static_assert(DEDUP_WINDOW_SIZE == 8 * sizeof(uint32_t), "window must match the seen bitmap width");
+
+uint16_t dedup_hash(const uint8_t *data, size_t len)
+{
+    uint32_t hash = 2166136261u;
+    for (size_t i = 0; i < len; i++)
+    {
+        hash = (hash ^ data[i]) * 16777619u;
+    }
+    return static_cast<uint16_t>((hash >> 16) ^ hash);
+}
+
+void DedupCache::reset()
+{
+    for (Window &w : windows)
+    {
+        w.used = false;
+        w.seen = 0;
+    }
+}
+
+DedupCache::Window &DedupCache::windowFor(uint16_t peer, uint32_t nowMs)
+{
+    Window *victim = &windows[0];
+    for (Window &w : windows)
+    {
+        if (w.used && w.peer == peer)
+        {
+            if (nowMs - w.lastMs > DEDUP_EXPIRY_MS)
+            {
+                w.seen = 0; // Quiet for too long: start over
+            }
+            return w;
+        }
+        if (!w.used)
+        {
+            victim = &w;
+        }
+        else if (victim->used && nowMs - w.lastMs > nowMs - victim->lastMs)
+        {
+            victim = &w; // Least recently heard so far
+        }
+    }
+
+    victim->used = true;
+    victim->peer = peer;
+    victim->seen = 0;
+    return *victim;
+}
+
+bool DedupCache::isDuplicate(uint16_t peer, const uint8_t *frame, size_t len, uint32_t nowMs)
+{
+    if (len < 2)
+    {
+        return false;
+    }
+    return isDuplicate(peer, frame[1], dedup_hash(frame, len), nowMs);
+}
+
+bool DedupCache::isDuplicate(uint16_t peer, uint8_t seq, uint16_t hash, uint32_t nowMs)
+{
+    Window &w = windowFor(peer, nowMs);
+    w.lastMs = nowMs;
+
+    uint8_t behind = static_cast<uint8_t>(w.newest - seq);
+    uint8_t ahead = static_cast<uint8_t>(seq - w.newest);
+    if (w.seen != 0 && behind < DEDUP_WINDOW_SIZE)
+    {
+        uint32_t bit = 1UL << behind;
+        uint16_t &slot = w.hashes[seq % DEDUP_WINDOW_SIZE];
+        if ((w.seen & bit) && slot == hash)
+        {
+            return true;
+        }
+        // New seq inside the window, or the same seq with other content (sender restarted)
+        w.seen |= bit;
+        slot = hash;
+        return false;
+    }
+
+    if (w.seen != 0 && ahead < 128)
+    {
+        // Newer: slide the window so that seq is its newest entry
+        w.seen = ahead >= DEDUP_WINDOW_SIZE ? 0 : w.seen << ahead;
+    }
+    else
+    {
+        // First frame, or far behind the window: the sender restarted its seqs
+        w.seen = 0;
+    }
+    w.newest = seq;
+    w.seen |= 1;
+    w.hashes[seq % DEDUP_WINDOW_SIZE] = hash;
+    return false;
+}
@@ -0,0 +1,62 @@
+#ifndef DEDUP_H
+#define DEDUP_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+/// Senders remembered at once; the least recently heard one is forgotten first
+const uint8_t DEDUP_MAX_PEERS = 4;
+
+/// Seqs remembered per sender, counted back from the newest one
+const uint8_t DEDUP_WINDOW_SIZE = 32;
+
+/// A sender quiet for this long starts over: its next text is new whatever its seq.
+/// As long as the link ARQ's receiver idle time, longer than any sender keeps retrying.
+const uint32_t DEDUP_EXPIRY_MS = 10UL * 60UL * 1000UL;
+
+/// Sender of frames that arrive without a relay header (outside the 8-bit relay origin ids)
+const uint16_t DEDUP_LINK_PEER = 0x100;
+
+/// Remembers the text frames recently received from each sender, to tell a
+/// retransmission (the sender missed our ACK) from a new message.
+///
+/// Per sender: a window of the last DEDUP_WINDOW_SIZE seqs with one seen bit
+/// and a 16-bit hash of the frame bytes each. A frame is a duplicate only if
+/// its seq was seen and the bytes hash the same, so a sender that restarted
+/// its seqs while we were still listening is not silenced. Fixed memory, no
+/// clock access: every call takes the current time. Not thread-safe.
+class DedupCache
+{
+public:
+    DedupCache() { reset(); }
+
+    /// Records a received frame (seq in byte 1). True if the same frame from
+    /// this peer was already recorded within the window and expiry time.
+    bool isDuplicate(uint16_t peer, const uint8_t *frame, size_t len, uint32_t nowMs);
+
+    /// As above for a seq and hash taken from elsewhere (a relay header and its packet)
+    bool isDuplicate(uint16_t peer, uint8_t seq, uint16_t hash, uint32_t nowMs);
+
+    /// Forgets every sender
+    void reset();
+
+private:
+    struct Window
+    {
+        bool used;
+        uint16_t peer;
+        uint8_t newest;                     // Newest seq recorded
+        uint32_t seen;                      // Bit i: newest - i recorded
+        uint16_t hashes[DEDUP_WINDOW_SIZE]; // By seq % DEDUP_WINDOW_SIZE
+        uint32_t lastMs;
+    };
+
+    Window windows[DEDUP_MAX_PEERS];
+
+    Window &windowFor(uint16_t peer, uint32_t nowMs);
+};
+
+/// 16-bit FNV-1a hash (xor-folded) of a frame
+uint16_t dedup_hash(const uint8_t *data, size_t len);
+
+#endif // DEDUP_H
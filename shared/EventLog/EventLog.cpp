@@ -0,0 +1,104 @@
+#include "EventLog.h"
+#include <stdio.h>
+
+EventLog eventLog;
+
+namespace
+{
+    const uint32_t SLOT_MASK = EVENT_LOG_CAPACITY - 1;
+
+    const char *const FORMATS[] = {
+#define LOG_EVENT_FORMAT(name, format) format,
+        LOG_EVENTS(LOG_EVENT_FORMAT)
+#undef LOG_EVENT_FORMAT
+    };
+
+    static_assert(sizeof(FORMATS) / sizeof(FORMATS[0]) == static_cast<size_t>(LogId::Count), "one format per LogId");
+}
+
+EventLog::EventLog() : enqueuePos(0), dequeuePos(0), dropped(0), wakeCallback(nullptr)
+{
+    for (uint32_t i = 0; i < EVENT_LOG_CAPACITY; i++)
+    {
+        slots[i].sequence.store(i, std::memory_order_relaxed);
+    }
+}
+
+bool EventLog::record(uint32_t nowMs, LogLevel level, LogId id, int32_t a, int32_t b, int32_t c)
+{
+    // A slot is free for position pos once its sequence equals pos
+    uint32_t pos = enqueuePos.load(std::memory_order_relaxed);
+    Slot *slot;
+    for (;;)
+    {
+        slot = &slots[pos & SLOT_MASK];
+        int32_t diff = static_cast<int32_t>(slot->sequence.load(std::memory_order_acquire) - pos);
+        if (diff == 0)
+        {
+            if (enqueuePos.compare_exchange_weak(pos, pos + 1, std::memory_order_relaxed))
+            {
+                break;
+            }
+        }
+        else if (diff < 0)
+        {
+            dropped.fetch_add(1, std::memory_order_relaxed); // Reader is a whole ring behind
+            return false;
+        }
+        else
+        {
+            pos = enqueuePos.load(std::memory_order_relaxed); // Another producer took it
+        }
+    }
+    bool wasEmpty = pos == dequeuePos.load(std::memory_order_acquire);
+
+    slot->record.timestampMs = nowMs;
+    slot->record.id = id;
+    slot->record.level = level;
+    slot->record.args[0] = a;
+    slot->record.args[1] = b;
+    slot->record.args[2] = c;
+    slot->sequence.store(pos + 1, std::memory_order_release); // Published
+
+    if (wasEmpty && wakeCallback)
+    {
+        wakeCallback();
+    }
+    return true;
+}
+
+bool EventLog::read(LogRecord &out)
+{
+    uint32_t pos = dequeuePos.load(std::memory_order_relaxed);
+    Slot &slot = slots[pos & SLOT_MASK];
+    if (slot.sequence.load(std::memory_order_acquire) != pos + 1)
+    {
+        return false; // Empty, or claimed but not published yet
+    }
+
+    out = slot.record;
+    slot.sequence.store(pos + EVENT_LOG_CAPACITY, std::memory_order_release); // Free for the next lap
+    dequeuePos.store(pos + 1, std::memory_order_release);
+    return true;
+}
+
+int EventLog::format(const LogRecord &record, char *buf, size_t len)
+{
+    size_t index = static_cast<size_t>(record.id);
+    if (index >= static_cast<size_t>(LogId::Count))
+    {
+        return snprintf(buf, len, "[%lu] unknown event %u", static_cast<unsigned long>(record.timestampMs),
+                        static_cast<unsigned>(index));
+    }
+
+    int prefix = snprintf(buf, len, "[%lu] ", static_cast<unsigned long>(record.timestampMs));
+    if (prefix < 0 || static_cast<size_t>(prefix) >= len)
+    {
+        return prefix;
+    }
+
+    // Every format takes at most EVENT_LOG_MAX_ARGS longs, unused ones are ignored
+    int message = snprintf(buf + prefix, len - prefix, FORMATS[index], static_cast<long>(record.args[0]),
+                           static_cast<long>(record.args[1]), static_cast<long>(record.args[2]));
+    return message < 0 ? message : prefix + message;
+}
@@ -0,0 +1,140 @@
+#ifndef EVENT_LOG_H
+#define EVENT_LOG_H
+
+#include <stddef.h>
+#include <stdint.h>
+#include <atomic>
+#include "LogEvents.h"
+
+#define LOG_LEVEL_NONE 0
+#define LOG_LEVEL_ERROR 1
+#define LOG_LEVEL_WARN 2
+#define LOG_LEVEL_INFO 3
+#define LOG_LEVEL_DEBUG 4
+
+/// Events above this level are compiled out completely (override with -DLOG_LEVEL=LOG_LEVEL_DEBUG)
+#ifndef LOG_LEVEL
+#define LOG_LEVEL LOG_LEVEL_INFO
+#endif
+
+/// Records kept until the log task drains them, must be a power of two
+#ifndef EVENT_LOG_CAPACITY
+#define EVENT_LOG_CAPACITY 64
+#endif
+
+const uint8_t EVENT_LOG_MAX_ARGS = 3;
+
+enum class LogLevel : uint8_t
+{
+    Error = LOG_LEVEL_ERROR,
+    Warn = LOG_LEVEL_WARN,
+    Info = LOG_LEVEL_INFO,
+    Debug = LOG_LEVEL_DEBUG
+};
+
+enum class LogId : uint16_t
+{
+#define LOG_EVENT_ID(name, format) name,
+    LOG_EVENTS(LOG_EVENT_ID)
+#undef LOG_EVENT_ID
+        Count
+};
+
+/// One binary log event: 20 bytes instead of a formatted line
+struct LogRecord
+{
+    uint32_t timestampMs;
+    LogId id;
+    LogLevel level;
+    int32_t args[EVENT_LOG_MAX_ARGS];
+};
+
+/// Lock-free ring of binary log events.
+///
+/// Any task may record (several producers, never from an ISR); one log task
+/// reads and formats. Recording copies a few words and never blocks or
+/// touches the UART, so logging on hot paths and in the NimBLE host task
+/// costs next to nothing. A full ring drops new events and counts them.
+///
+/// Bounded MPSC queue with a sequence number per slot (D. Vyukov): a
+/// producer claims a slot with one compare-exchange and publishes it by
+/// bumping the slot's sequence, so the reader never sees half-written events.
+class EventLog
+{
+public:
+    static_assert((EVENT_LOG_CAPACITY & (EVENT_LOG_CAPACITY - 1)) == 0, "EVENT_LOG_CAPACITY must be a power of two");
+
+    EventLog();
+
+    /// Appends an event. Returns false if the ring was full (counted in takeDropped()).
+    bool record(uint32_t nowMs, LogLevel level, LogId id, int32_t a = 0, int32_t b = 0, int32_t c = 0);
+
+    /// Takes the oldest published event (reader side). False if there is none.
+    bool read(LogRecord &out);
+
+    /// True while a producer has claimed a slot the reader has not taken yet
+    /// (the event may still be written: poll again shortly)
+    bool pending() const { return enqueuePos.load(std::memory_order_acquire) != dequeuePos.load(std::memory_order_relaxed); }
+
+    /// Events lost to a full ring since the last call
+    uint32_t takeDropped() { return dropped.exchange(0); }
+
+    /// Called after an event landed in an empty ring, e.g. to notify the log task.
+    /// Runs in the recording task: keep it to a task notification.
+    void setWakeCallback(void (*callback)()) { wakeCallback = callback; }
+
+    /// Formats an event as "[timestamp] message". Returns the length written
+    /// (truncated to len - 1), like snprintf.
+    static int format(const LogRecord &record, char *buf, size_t len);
+
+private:
+    struct Slot
+    {
+        std::atomic<uint32_t> sequence;
+        LogRecord record;
+    };
+
+    Slot slots[EVENT_LOG_CAPACITY];
+    std::atomic<uint32_t> enqueuePos;
+    std::atomic<uint32_t> dequeuePos; // Written by the reader only
+    std::atomic<uint32_t> dropped;
+    void (*wakeCallback)();
+};
+
+/// The firmware's event log (one per image, like the Serial port it replaces)
+extern EventLog eventLog;
+
+#ifdef ARDUINO
+#include <Arduino.h>
+#define LOG_CLOCK_MS() millis()
+#else
+#define LOG_CLOCK_MS() 0
+#endif
+
+#define LOG_EVENT(level, id, ...) eventLog.record(LOG_CLOCK_MS(), level, LogId::id, ##__VA_ARGS__)
+
+#if LOG_LEVEL >= LOG_LEVEL_ERROR
+#define LOG_ERROR(id, ...) LOG_EVENT(LogLevel::Error, id, ##__VA_ARGS__)
+#else
+#define LOG_ERROR(id, ...) ((void)0)
+#endif
+
+#if LOG_LEVEL >= LOG_LEVEL_WARN
+#define LOG_WARN(id, ...) LOG_EVENT(LogLevel::Warn, id, ##__VA_ARGS__)
+#else
+#define LOG_WARN(id, ...) ((void)0)
+#endif
+
+#if LOG_LEVEL >= LOG_LEVEL_INFO
+#define LOG_INFO(id, ...) LOG_EVENT(LogLevel::Info, id, ##__VA_ARGS__)
+#else
+#define LOG_INFO(id, ...) ((void)0)
+#endif
+
+#if LOG_LEVEL >= LOG_LEVEL_DEBUG
+#define LOG_DEBUG(id, ...) LOG_EVENT(LogLevel::Debug, id, ##__VA_ARGS__)
+#else
+#define LOG_DEBUG(id, ...) ((void)0)
+#endif
+
+#endif // EVENT_LOG_H
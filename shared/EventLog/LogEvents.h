@@ -0,0 +1,90 @@
+#ifndef LOG_EVENTS_H
+#define LOG_EVENTS_H
+
+/// Every runtime log line of the firmwares, as (id, printf format) pairs.
+///
+/// Only the id and up to EVENT_LOG_MAX_ARGS integer arguments are recorded,
+/// the format is applied when the log task drains the ring. Arguments are
+/// int32_t: use %ld/%lu/%lX. Ids are stable only within one build.
+#define LOG_EVENTS(X)                                                                     \
+    /* LoRaManager */                                                                     \
+    X(LoRaSendOk, "LoRa: packet sent")                                                    \
+    X(LoRaSendFailed, "LoRa: failed to send packet")                                      \
+    X(LoRaTxTimeout, "LoRa TX timed out waiting for TxDone")                              \
+    X(LoRaDataRate, "LoRa data rate: SF%ld, %ld Hz")                                      \
+    X(LoRaChannelBusy, "LoRa: channel busy (check %ld), backing off %ld ms")              \
+    X(LoRaChannelBusyTx, "LoRa: channel still busy after %ld checks, sending anyway")     \
+    /* PowerManager */                                                                    \
+    X(PmHighPower, "PM: High power mode for LoRa TX")                                     \
+    X(PmLowPower, "PM: Released to low power mode")                                       \
+    X(PmResidency, "PM: light sleep %ld permille of %lu s, %lu sleeps")                   \
+    X(PmHolds, "PM: high power for LoRa TX %lu ms, ACK %lu ms, BLE flush %lu ms")         \
+    X(PmCharge, "PM: ~%lu uAh per message (%lu messages), ~%lu uAh since boot")           \
+    /* BLEManager */                                                                      \
+    X(BleWrite, "BLE write on RX characteristic: %ld bytes, starting %08lX")              \
+    X(BleFrameQueued, "BLE frame type %ld forwarded to LoRa queue")                       \
+    X(BleQueueFull, "Warning: BLE to LoRa queue full, message dropped")                   \
+    X(BleInvalidFrame, "Invalid message frame from BLE (%ld bytes)")                      \
+    X(BleNotConnected, "Cannot send message: BLE not connected")                          \
+    X(BleNotify, "Sent %ld bytes via BLE notification")                                   \
+    X(BleNotifyBusy, "BLE notification not queued (host busy)")                           \
+    X(BleNotifyFailed, "BLE notification failed, code: %ld")                              \
+    X(BleMtu, "MTU changed: %ld")                                                         \
+    /* Bridge: LoRa RX */                                                                 \
+    X(LoRaRx, "LoRa RX: %ld bytes, RSSI: %ld dBm, SNR: %ld dB")                           \
+    X(LoRaCrcErrors, "LoRa CRC errors: %lu dropped by the radio")                         \
+    X(LoRaRxFiltered, "LoRa RX: %lu packets not for us, dropped from their header")       \
+    X(InvalidFrame, "Invalid LoRa frame, dropped")                                        \
+    X(InvalidAggregate, "Invalid aggregate frame, dropped")                               \
+    X(AggregateRx, "Aggregate with %ld frames")                                           \
+    X(TextRx, "Text - seq: %ld, chars: %ld, GPS encoding: %ld")                           \
+    X(TextHuffman, "Text - seq: %ld is Huffman coded")                                    \
+    X(DuplicateText, "Text - seq: %ld already delivered, ACK only")                       \
+    X(FragmentRx, "Fragment - seq: %ld, %ld of %ld")                                      \
+    X(DuplicateFragment, "Fragment - seq: %ld already delivered, ACK only")               \
+    X(LongMessageRx, "Long message - first seq: %ld, %ld fragments, %ld bytes")           \
+    X(FragmentsDropped, "Fragments: %lu incomplete messages dropped (timeout or no slot)")\
+    X(GpsWithoutKeyframe, "Delta GPS without a keyframe (rebooted?), position dropped")   \
+    X(AckRx, "ACK - seq: %ld")                                                            \
+    X(SelectiveAckRx, "Selective ACK - cumulative: %ld, bitmap: 0x%02lX")                 \
+    X(DataRateRequestRx, "DataRate request - rate: %ld")                                  \
+    X(DataRateAcceptRx, "DataRate accept - rate: %ld")                                    \
+    X(LoRaToBleQueueFull, "Warning: LoRa to BLE queue full, message dropped")             \
+    /* Bridge: LoRa TX */                                                                 \
+    X(TxDone, "LoRa TX successful")                                                       \
+    X(TxFailed, "LoRa TX failed")                                                         \
+    X(DutyCycleDeferred, "Duty cycle: used %ld of %ld ms, next TX in %ld ms")             \
+    X(TxQueued, "Queueing %ld frame(s), %ld bytes, %ld ms on air for LoRa TX")            \
+    X(TxQueueFull, "LoRa TX queue full, frame dropped")                                   \
+    X(FrameRejected, "Frame rejected for LoRa TX")                                        \
+    X(SelectiveAckTx, "Queueing selective ACK - cumulative: %ld, bitmap: 0x%02lX")        \
+    X(SelectiveAckRejected, "Selective ACK rejected for LoRa TX")                         \
+    X(DataRateRejected, "DataRate frame rejected for LoRa TX")                            \
+    X(ArqWindowFull, "ARQ window full, holding BLE frames")                               \
+    X(TxHoldingBle, "LoRa TX queue full, holding BLE frames")                             \
+    X(BleFrameDequeued, "Received from BLE queue: type=%ld")                              \
+    X(EmptyBleFrame, "Empty frame in BLE queue, skipped")                                 \
+    /* Bridge: link control */                                                            \
+    X(AdrSwitch, "ADR: switching to rate %ld (SF%ld, %ld Hz)")                            \
+    X(AdrPropose, "ADR: proposing rate %ld (SNR %ld dB, RSSI %ld dBm)")                   \
+    X(AdrFallback, "ADR: nothing heard from the peer, falling back to rate 0")            \
+    X(ArqRetransmit, "ARQ retransmit seq: %ld (SRTT %ld ms)")                             \
+    X(ArqGaveUp, "ARQ gave up on seq: %ld")                                               \
+    /* Bridge: relay */                                                                   \
+    X(RelayRx, "Relayed packet from node %ld, id %ld, TTL %ld")                           \
+    X(RelayDuplicate, "Relayed packet from node %ld, id %ld seen before, dropped")        \
+    X(RelaySuppressed, "Node %ld packet %ld relayed by another node, ours cancelled")     \
+    X(RelayInvalid, "Invalid relayed packet, dropped")                                    \
+    X(RelayTx, "Rebroadcasting node %ld packet %ld, TTL %ld")                             \
+    X(RelayDutyCycle, "Duty cycle: rebroadcast of node %ld packet %ld dropped")           \
+    /* Bridge: BLE forwarding */                                                          \
+    X(BleFlushWait, "BLE connected - waiting before sending buffered messages...")        \
+    X(BleBuffered, "No BLE connection - buffered message (total: %ld), advertising")      \
+    X(BleForwarded, "Forwarded %ld messages to BLE in %ld notifications")                 \
+    X(StoreDropped, "Message store full or damaged: %ld messages dropped")                \
+    /* Debugger */                                                                        \
+    X(AckTx, "Queueing %ld ACK(s), %ld bytes, %ld us after the first was due")            \
+    X(AckTxRejected, "%ld ACK(s) rejected for LoRa TX")                                   \
+    X(AckQueueFull, "ACK queue full at seq %ld, oldest ACKs sent early")
+
+#endif // LOG_EVENTS_H
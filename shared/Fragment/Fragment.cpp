@@ -0,0 +1,216 @@
+#include "Fragment.h"
+#include <string.h>
+
+static_assert(FRAGMENT_MAX_COUNT <= ARQ_WINDOW_SIZE, "one selective ACK must cover every fragment of a message");
+static_assert(FRAGMENT_MAX_COUNT <= 8, "the received bitmap has one bit per fragment");
+static_assert(FRAGMENT_MAX_COUNT - 1 <= FRAGMENT_LAST_MASK, "the last index must fit its 4 bits");
+static_assert(LONG_TEXT_HEADER_SIZE + (LONG_TEXT_MAX_LENGTH * 6 + 7) / 8 + GPS_ABSOLUTE_SIZE <= FRAGMENT_MAX_PAYLOAD,
+              "the longest long text must fit one message");
+
+int long_text_encode(const char *text, bool hasGps, int32_t lat, int32_t lon, uint8_t *out, size_t maxLen)
+{
+    size_t textLen = strlen(text);
+    size_t gpsSize = hasGps ? GPS_ABSOLUTE_SIZE : 0;
+    if (textLen > LONG_TEXT_MAX_LENGTH || maxLen < LONG_TEXT_HEADER_SIZE + gpsSize)
+    {
+        return -1; // Text too long or buffer too small
+    }
+
+    // Huffman coding when it is shorter, else 6-bit packing, as for a Text frame
+    size_t room = maxLen - LONG_TEXT_HEADER_SIZE - gpsSize;
+    int compressedLen = compressed_text_size(text);
+    bool compressed = compressedLen >= 0 && static_cast<size_t>(compressedLen) < (textLen * 6 + 7) / 8;
+    uint8_t *packed = out + LONG_TEXT_HEADER_SIZE;
+    int packedLen = compressed ? pack_text_compressed(text, packed, room) : pack_text(text, packed, room);
+    if (packedLen < 0)
+    {
+        return -1; // Invalid character or buffer too small
+    }
+
+    out[0] = static_cast<uint8_t>(textLen);
+    out[1] = (compressed ? LONG_TEXT_COMPRESSED_FLAG : 0) | (hasGps ? LONG_TEXT_GPS_FLAG : 0);
+    if (hasGps)
+    {
+        memcpy(packed + packedLen, &lat, 4); // Little-endian
+        memcpy(packed + packedLen + 4, &lon, 4);
+    }
+    return LONG_TEXT_HEADER_SIZE + packedLen + gpsSize;
+}
+
+bool long_text_decode(const uint8_t *payload, size_t len, LongText &text)
+{
+    if (len < LONG_TEXT_HEADER_SIZE)
+    {
+        return false;
+    }
+    uint8_t charCount = payload[0];
+    uint8_t flags = payload[1];
+    if (charCount > LONG_TEXT_MAX_LENGTH || (flags & ~(LONG_TEXT_COMPRESSED_FLAG | LONG_TEXT_GPS_FLAG)) != 0)
+    {
+        return false; // Too long, or flags this version does not know
+    }
+
+    text.hasGps = (flags & LONG_TEXT_GPS_FLAG) != 0;
+    size_t gpsSize = text.hasGps ? GPS_ABSOLUTE_SIZE : 0;
+    if (len < LONG_TEXT_HEADER_SIZE + gpsSize)
+    {
+        return false;
+    }
+    const uint8_t *packed = payload + LONG_TEXT_HEADER_SIZE;
+    size_t packedLen = len - LONG_TEXT_HEADER_SIZE - gpsSize;
+
+    if (flags & LONG_TEXT_COMPRESSED_FLAG)
+    {
+        if (!unpack_text_compressed(packed, packedLen, charCount, text.text, sizeof(text.text)))
+        {
+            return false;
+        }
+    }
+    else if (packedLen != (static_cast<size_t>(charCount) * 6 + 7) / 8 ||
+             !unpack_text(packed, packedLen, charCount, text.text, sizeof(text.text)))
+    {
+        return false;
+    }
+
+    text.lat = 0;
+    text.lon = 0;
+    if (text.hasGps)
+    {
+        memcpy(&text.lat, packed + packedLen, 4); // Little-endian
+        memcpy(&text.lon, packed + packedLen + 4, 4);
+    }
+    return true;
+}
+
+uint8_t fragment_count(size_t len)
+{
+    if (len == 0 || len > FRAGMENT_MAX_PAYLOAD)
+    {
+        return 0;
+    }
+    return static_cast<uint8_t>((len + FRAGMENT_DATA_SIZE - 1) / FRAGMENT_DATA_SIZE);
+}
+
+int fragment_frame(const uint8_t *payload, size_t len, uint8_t firstSeq, uint8_t index, uint8_t *frame)
+{
+    uint8_t count = fragment_count(len);
+    if (index >= count)
+    {
+        return -1;
+    }
+    size_t offset = index * FRAGMENT_DATA_SIZE;
+    size_t dataLen = len - offset < FRAGMENT_DATA_SIZE ? len - offset : FRAGMENT_DATA_SIZE;
+    return Message::createFragment(firstSeq + index, index, count - 1, payload + offset, dataLen)
+        .serialize(frame, MAX_FRAME_SIZE);
+}
+
+void FragmentReassembler::reset()
+{
+    for (Slot &s : slots)
+    {
+        s.used = false;
+    }
+}
+
+FragmentReassembler::Slot &FragmentReassembler::slotFor(uint16_t sender, uint8_t firstSeq, uint8_t last,
+                                                        uint32_t nowMs)
+{
+    Slot *victim = nullptr;
+    for (Slot &s : slots)
+    {
+        if (s.used && s.sender == sender && s.firstSeq == firstSeq)
+        {
+            if (s.last == last)
+            {
+                return s;
+            }
+            victim = &s; // Same seqs, another length: the sender restarted its seqs
+            break;
+        }
+        // A free slot, else the oldest message
+        if (victim == nullptr || (victim->used && (!s.used || nowMs - s.startMs > nowMs - victim->startMs)))
+        {
+            victim = &s;
+        }
+    }
+
+    if (victim->used)
+    {
+        droppedCount++;
+    }
+    victim->used = true;
+    victim->sender = sender;
+    victim->firstSeq = firstSeq;
+    victim->last = last;
+    victim->received = 0;
+    victim->lastLen = 0;
+    victim->startMs = nowMs;
+    return *victim;
+}
+
+FragmentReassembler::Result FragmentReassembler::add(uint16_t sender, const uint8_t *frame, size_t len,
+                                                     uint32_t nowMs, const uint8_t *&payload, size_t &payloadLen,
+                                                     uint8_t &firstSeq, uint8_t &count)
+{
+    Message msg;
+    if (len == 0 || frame[0] != static_cast<uint8_t>(MessageType::Fragment) || !msg.deserialize(frame, len))
+    {
+        return Result::Invalid;
+    }
+    expire(nowMs);
+
+    const FragmentMessage &fragment = msg.fragmentData;
+    uint8_t first = fragment.seq - fragment.index;
+    Slot &slot = slotFor(sender, first, fragment.last, nowMs);
+
+    uint8_t bit = 1 << fragment.index;
+    if (slot.received & bit)
+    {
+        return Result::Duplicate;
+    }
+    memcpy(slot.payload + fragment.index * FRAGMENT_DATA_SIZE, fragment.data, fragment.len);
+    slot.received |= bit;
+    if (fragment.index == fragment.last)
+    {
+        slot.lastLen = fragment.len;
+    }
+
+    uint8_t all = static_cast<uint8_t>((2u << slot.last) - 1);
+    if (slot.received != all)
+    {
+        return Result::Pending;
+    }
+
+    // The bytes stay in place until the slot is taken again
+    slot.used = false;
+    payload = slot.payload;
+    payloadLen = slot.last * FRAGMENT_DATA_SIZE + slot.lastLen;
+    firstSeq = first;
+    count = slot.last + 1;
+    return Result::Complete;
+}
+
+uint8_t FragmentReassembler::expire(uint32_t nowMs)
+{
+    uint8_t expired = 0;
+    for (Slot &s : slots)
+    {
+        if (s.used && nowMs - s.startMs >= FRAGMENT_REASSEMBLY_TIMEOUT_MS)
+        {
+            s.used = false;
+            expired++;
+        }
+    }
+    droppedCount += expired;
+    return expired;
+}
+
+uint8_t FragmentReassembler::pending() const
+{
+    uint8_t count = 0;
+    for (const Slot &s : slots)
+    {
+        count += s.used;
+    }
+    return count;
+}
@@ -0,0 +1,112 @@
+#ifndef FRAGMENT_H
+#define FRAGMENT_H
+
+#include <stddef.h>
+#include <stdint.h>
+#include "Protocol.h"
+#include "Arq.h"
+
+/// Largest payload one long message can carry
+const size_t FRAGMENT_MAX_PAYLOAD = FRAGMENT_MAX_COUNT * FRAGMENT_DATA_SIZE;
+
+/// Longest long text, in characters. With a position it still fits 4 fragments
+/// (one 255-byte packet) and the app's single BLE write of all of them.
+const uint8_t LONG_TEXT_MAX_LENGTH = 200;
+
+/// Long text payload: [char count][flags][coded text][lat lon, 4 bytes LE each if LONG_TEXT_GPS_FLAG]
+const size_t LONG_TEXT_HEADER_SIZE = 2;
+const uint8_t LONG_TEXT_COMPRESSED_FLAG = 0x80; // Text is Huffman coded, else 6-bit packed
+const uint8_t LONG_TEXT_GPS_FLAG = 0x40;        // Absolute coordinates follow the text
+
+/// Incomplete messages reassembled at once; the oldest one gives way to a new message
+const uint8_t FRAGMENT_REASSEMBLY_SLOTS = 2;
+
+/// An incomplete message is dropped this long after its first fragment arrived
+/// (as long as the link ARQ's receiver idle time, longer than any sender keeps retrying)
+const uint32_t FRAGMENT_REASSEMBLY_TIMEOUT_MS = ARQ_RECEIVER_IDLE_MS;
+
+/// A decoded long text
+struct LongText
+{
+    char text[LONG_TEXT_MAX_LENGTH + 1];
+    bool hasGps;
+    int32_t lat; // Degrees * 1e6
+    int32_t lon;
+};
+
+/// Writes the long text payload for text (up to LONG_TEXT_MAX_LENGTH characters
+/// of CHARSET), Huffman coded when that is shorter. Returns its length, or -1
+/// if the text is too long, has a character outside CHARSET or out is too small.
+int long_text_encode(const char *text, bool hasGps, int32_t lat, int32_t lon, uint8_t *out, size_t maxLen);
+
+/// Decodes a long text payload. False if it is malformed.
+bool long_text_decode(const uint8_t *payload, size_t len, LongText &text);
+
+/// Fragments needed for a payload of len bytes (0 if it is empty or longer than FRAGMENT_MAX_PAYLOAD)
+uint8_t fragment_count(size_t len);
+
+/// Serializes fragment index of payload into frame (MAX_FRAME_SIZE bytes). The
+/// message's fragments take seqs firstSeq, firstSeq + 1 ... Returns the frame length, or -1.
+int fragment_frame(const uint8_t *payload, size_t len, uint8_t firstSeq, uint8_t index, uint8_t *frame);
+
+/// Streaming reassembly of long messages from their fragments, in any order.
+///
+/// Every fragment's data is copied straight to its place in its message's slot
+/// (by sender and first seq), so memory stays at FRAGMENT_REASSEMBLY_SLOTS
+/// payloads however the fragments arrive. A slot is freed when its message
+/// completes, after FRAGMENT_REASSEMBLY_TIMEOUT_MS, or - oldest first - when a
+/// fragment of a new message finds every slot busy.
+///
+/// No clock access: every call takes the current time in ms. Not thread-safe.
+class FragmentReassembler
+{
+public:
+    /// What add() made of a fragment
+    enum class Result
+    {
+        Pending,   // Stored, fragments of its message are still missing
+        Complete,  // Its message is complete
+        Duplicate, // Already stored
+        Invalid    // Not a valid fragment frame
+    };
+
+    FragmentReassembler() : droppedCount(0) { reset(); }
+
+    /// Adds a received fragment frame (expired messages are dropped first). On
+    /// Complete, payload and payloadLen describe the message - valid until the
+    /// next call - and firstSeq and count its fragments.
+    Result add(uint16_t sender, const uint8_t *frame, size_t len, uint32_t nowMs, const uint8_t *&payload,
+               size_t &payloadLen, uint8_t &firstSeq, uint8_t &count);
+
+    /// Drops the incomplete messages older than FRAGMENT_REASSEMBLY_TIMEOUT_MS, returns how many
+    uint8_t expire(uint32_t nowMs);
+
+    /// Incomplete messages waiting for fragments
+    uint8_t pending() const;
+
+    /// Incomplete messages dropped (timed out or evicted) since construction
+    uint32_t dropped() const { return droppedCount; }
+
+    /// Forgets every incomplete message
+    void reset();
+
+private:
+    struct Slot
+    {
+        bool used;
+        uint16_t sender;
+        uint8_t firstSeq;
+        uint8_t last;     // Index of the last fragment
+        uint8_t received; // Bit i: fragment i stored
+        uint8_t lastLen;  // Data bytes of the last fragment, once stored
+        uint32_t startMs;
+        uint8_t payload[FRAGMENT_MAX_PAYLOAD];
+    };
+
+    Slot slots[FRAGMENT_REASSEMBLY_SLOTS];
+    uint32_t droppedCount;
+
+    Slot &slotFor(uint16_t sender, uint8_t firstSeq, uint8_t last, uint32_t nowMs);
+};
+
+#endif // FRAGMENT_H
@@ -0,0 +1,459 @@
+#include "FrameStore.h"
+#include <string.h>
+
+static_assert(FRAME_STORE_SEGMENT_BYTES <= UINT16_MAX, "segment offsets are 16 bit");
+
+uint8_t frame_record_crc(const uint8_t *data, size_t len)
+{
+    uint8_t crc = 0xFF; // Zeroed flash never passes
+    for (size_t i = 0; i < len; i++)
+    {
+        crc ^= data[i];
+        for (uint8_t bit = 0; bit < 8; bit++)
+        {
+            crc = (crc & 0x80) ? static_cast<uint8_t>((crc << 1) ^ 0x07) : static_cast<uint8_t>(crc << 1);
+        }
+    }
+    return crc;
+}
+
+size_t frame_record_encode(const WireFrame &frame, uint8_t *buf)
+{
+    buf[0] = frame.len;
+    memcpy(buf + 1, frame.data, frame.len);
+    buf[frame.len + 1] = frame_record_crc(buf, frame.len + 1);
+    return frame.len + FRAME_RECORD_OVERHEAD;
+}
+
+int frame_record_decode(const uint8_t *buf, size_t avail, WireFrame &frame)
+{
+    if (avail < 1)
+    {
+        return 0;
+    }
+    uint8_t len = buf[0];
+    if (len == 0 || len > MAX_FRAME_SIZE) // Also erased flash (0xFF)
+    {
+        return -1;
+    }
+    if (avail < len + FRAME_RECORD_OVERHEAD)
+    {
+        return 0;
+    }
+    if (frame_record_crc(buf, len + 1) != buf[len + 1])
+    {
+        return -1;
+    }
+    frame.len = len;
+    memcpy(frame.data, buf + 1, len);
+    return len + FRAME_RECORD_OVERHEAD;
+}
+
+FrameStore::FrameStore(FrameStorage *storage) : storage(storage)
+{
+    reset();
+}
+
+void FrameStore::reset()
+{
+    segmentCount = 0;
+    tailOpen = false;
+    nextSegmentId = 0;
+    headRecord = 0;
+    headOffset = 0;
+    storedFrames = 0;
+    windowStart = 0;
+    windowCount = 0;
+    loadSegment = 0;
+    loadRecord = 0;
+    loadOffset = 0;
+    pendingStart = 0;
+    pendingCount = 0;
+    cursorDirty = false;
+    dirty = false;
+    dirtySinceMs = 0;
+    dropped = 0;
+}
+
+size_t FrameStore::begin()
+{
+    reset();
+    if (!storage)
+    {
+        return 0;
+    }
+
+    uint32_t ids[FRAME_STORE_MAX_SEGMENTS];
+    size_t count = storage->listSegments(ids, FRAME_STORE_MAX_SEGMENTS);
+    for (size_t i = 1; i < count; i++)
+    {
+        uint32_t id = ids[i];
+        size_t j = i;
+        for (; j > 0 && ids[j - 1] > id; j--)
+        {
+            ids[j] = ids[j - 1];
+        }
+        ids[j] = id;
+    }
+
+    uint32_t cursorSegment = 0;
+    uint32_t cursorOffset = 0;
+    bool hasCursor = storage->readCursor(cursorSegment, cursorOffset);
+    nextSegmentId = hasCursor ? cursorSegment + 1 : 0;
+    for (size_t i = 0; i < count; i++)
+    {
+        if (ids[i] >= nextSegmentId)
+        {
+            nextSegmentId = ids[i] + 1;
+        }
+        if (hasCursor && ids[i] < cursorSegment)
+        {
+            storage->remove(ids[i]); // Delivered, the reset came before it was deleted
+            continue;
+        }
+        scanSegment(ids[i], hasCursor && ids[i] == cursorSegment, cursorOffset);
+    }
+
+    loadRecord = headRecord;
+    loadOffset = headOffset;
+    retireDelivered();
+    return storedFrames;
+}
+
+void FrameStore::scanSegment(uint32_t id, bool isCursorSegment, uint32_t cursorOffset)
+{
+    uint16_t records = 0;
+    size_t offset = 0; // End of the last good record
+    uint16_t deliveredRecords = 0;
+    size_t deliveredBytes = 0;
+    bool clean = false;
+
+    // Records are parsed from scratch, refilled from offset + buffered
+    size_t buffered = 0;
+    for (;;)
+    {
+        int n = storage->read(id, offset + buffered, scratch + buffered, sizeof(scratch) - buffered);
+        if (n < 0)
+        {
+            break;
+        }
+        buffered += n;
+
+        size_t used = 0;
+        int size;
+        WireFrame frame;
+        while ((size = frame_record_decode(scratch + used, buffered - used, frame)) > 0 &&
+               offset + used + size <= FRAME_STORE_SEGMENT_BYTES)
+        {
+            used += size;
+            records++;
+            if (isCursorSegment && offset + used <= cursorOffset)
+            {
+                deliveredRecords = records;
+                deliveredBytes = offset + used;
+            }
+        }
+        offset += used;
+        buffered -= used;
+        memmove(scratch, scratch + used, buffered);
+
+        if (size != 0)
+        {
+            break; // Damaged record (or garbage past the segment size)
+        }
+        if (n == 0)
+        {
+            clean = buffered == 0; // Otherwise a torn record at the end
+            break;
+        }
+    }
+
+    if (records == 0)
+    {
+        storage->remove(id);
+        return;
+    }
+
+    if (segmentCount == 0)
+    {
+        headRecord = deliveredRecords;
+        headOffset = static_cast<uint16_t>(deliveredBytes);
+        storedFrames -= deliveredRecords;
+    }
+    segments[segmentCount++] = {id, records, static_cast<uint16_t>(offset)};
+    storedFrames += records;
+    tailOpen = clean; // The newest segment decides
+}
+
+void FrameStore::add(const WireFrame &frame, uint32_t nowMs)
+{
+    if (frame.len == 0 || frame.len > MAX_FRAME_SIZE)
+    {
+        return;
+    }
+
+    if (pendingCount == FRAME_STORE_BATCH_FRAMES)
+    {
+        sync();
+        if (pendingCount == FRAME_STORE_BATCH_FRAMES)
+        {
+            // Flash unavailable: the oldest frame in RAM makes room
+            pendingStart = (pendingStart + 1) % FRAME_STORE_BATCH_FRAMES;
+            pendingCount--;
+            dropped++;
+        }
+    }
+
+    pending[(pendingStart + pendingCount) % FRAME_STORE_BATCH_FRAMES] = frame;
+    pendingCount++;
+    markDirty(nowMs);
+}
+
+bool FrameStore::peek(size_t index, WireFrame &frame)
+{
+    if (index < storedFrames)
+    {
+        if (fillWindow(index))
+        {
+            frame = window[(windowStart + index) % FRAME_STORE_WINDOW_FRAMES];
+            return true;
+        }
+        if (index < storedFrames)
+        {
+            return false; // Beyond the read-ahead
+        }
+    }
+
+    index -= storedFrames;
+    if (index >= pendingCount)
+    {
+        return false;
+    }
+    frame = pending[(pendingStart + index) % FRAME_STORE_BATCH_FRAMES];
+    return true;
+}
+
+void FrameStore::drop(size_t n, uint32_t nowMs)
+{
+    for (; n > 0 && storedFrames > 0; n--)
+    {
+        if (!fillWindow(0))
+        {
+            break; // Everything left on flash turned out damaged
+        }
+        headOffset += window[windowStart].len + FRAME_RECORD_OVERHEAD;
+        headRecord++;
+        windowStart = (windowStart + 1) % FRAME_STORE_WINDOW_FRAMES;
+        windowCount--;
+        storedFrames--;
+
+        cursorDirty = true;
+        retireDelivered();
+        if (cursorDirty)
+        {
+            markDirty(nowMs);
+        }
+    }
+
+    for (; n > 0 && pendingCount > 0; n--)
+    {
+        pendingStart = (pendingStart + 1) % FRAME_STORE_BATCH_FRAMES;
+        pendingCount--;
+    }
+}
+
+uint32_t FrameStore::service(uint32_t nowMs)
+{
+    if (!dirty)
+    {
+        return UINT32_MAX;
+    }
+
+    uint32_t age = nowMs - dirtySinceMs;
+    if (age < FRAME_STORE_SYNC_DELAY_MS)
+    {
+        return FRAME_STORE_SYNC_DELAY_MS - age;
+    }
+    if (!sync())
+    {
+        dirtySinceMs = nowMs; // Retry with the next batch
+        return FRAME_STORE_SYNC_DELAY_MS;
+    }
+    return UINT32_MAX;
+}
+
+bool FrameStore::sync()
+{
+    bool ok = writePending();
+    if (ok && cursorDirty)
+    {
+        ok = storage->writeCursor(segments[0].id, headOffset);
+        cursorDirty = !ok;
+    }
+    if (ok)
+    {
+        dirty = false;
+    }
+    return ok;
+}
+
+uint32_t FrameStore::takeDropped()
+{
+    uint32_t count = dropped;
+    dropped = 0;
+    return count;
+}
+
+void FrameStore::markDirty(uint32_t nowMs)
+{
+    if (storage && !dirty)
+    {
+        dirty = true;
+        dirtySinceMs = nowMs;
+    }
+}
+
+bool FrameStore::fillWindow(size_t upto)
+{
+    while (windowCount <= upto && windowCount < FRAME_STORE_WINDOW_FRAMES && windowCount < storedFrames)
+    {
+        Segment &segment = segments[loadSegment];
+        if (loadRecord >= segment.records)
+        {
+            loadSegment++;
+            loadRecord = 0;
+            loadOffset = 0;
+            continue;
+        }
+
+        uint8_t record[FRAME_RECORD_MAX_SIZE];
+        int n = storage->read(segment.id, loadOffset, record, sizeof(record));
+        WireFrame &frame = window[(windowStart + windowCount) % FRAME_STORE_WINDOW_FRAMES];
+        int size = n > 0 ? frame_record_decode(record, n, frame) : -1;
+        if (size <= 0)
+        {
+            // Damaged since begin(): the rest of this segment is lost
+            size_t lost = segment.records - loadRecord;
+            segment.records = loadRecord;
+            segment.bytes = loadOffset;
+            storedFrames -= lost;
+            dropped += lost;
+            if (loadSegment == segmentCount - 1)
+            {
+                tailOpen = false;
+            }
+            retireDelivered();
+            continue;
+        }
+
+        windowCount++;
+        loadRecord++;
+        loadOffset += size;
+    }
+    return windowCount > upto;
+}
+
+bool FrameStore::writePending()
+{
+    if (pendingCount == 0)
+    {
+        return true;
+    }
+    if (!storage)
+    {
+        return false;
+    }
+
+    while (pendingCount > 0)
+    {
+        const WireFrame &oldest = pending[pendingStart];
+        if (!tailOpen || segments[segmentCount - 1].bytes + oldest.len + FRAME_RECORD_OVERHEAD > FRAME_STORE_SEGMENT_BYTES)
+        {
+            openSegment();
+        }
+
+        // As many records as fit the segment, in one append
+        Segment &tail = segments[segmentCount - 1];
+        size_t len = 0;
+        uint8_t frames = 0;
+        for (; frames < pendingCount; frames++)
+        {
+            const WireFrame &frame = pending[(pendingStart + frames) % FRAME_STORE_BATCH_FRAMES];
+            if (tail.bytes + len + frame.len + FRAME_RECORD_OVERHEAD > FRAME_STORE_SEGMENT_BYTES)
+            {
+                break;
+            }
+            len += frame_record_encode(frame, scratch + len);
+        }
+
+        if (!storage->append(tail.id, scratch, len))
+        {
+            // Some of it may have reached flash: never append behind it
+            tailOpen = false;
+            if (tail.records == 0)
+            {
+                storage->remove(tail.id);
+                segmentCount--;
+            }
+            return false;
+        }
+
+        tail.records += frames;
+        tail.bytes += len;
+        storedFrames += frames;
+        pendingStart = (pendingStart + frames) % FRAME_STORE_BATCH_FRAMES;
+        pendingCount -= frames;
+    }
+    return true;
+}
+
+void FrameStore::openSegment()
+{
+    if (segmentCount == FRAME_STORE_MAX_SEGMENTS)
+    {
+        // Full: the oldest undelivered frames make room
+        size_t loaded = (loadSegment == 0 ? loadRecord : segments[0].records) - headRecord;
+        windowStart = (windowStart + loaded) % FRAME_STORE_WINDOW_FRAMES;
+        windowCount -= loaded;
+        size_t lost = segments[0].records - headRecord;
+        storedFrames -= lost;
+        dropped += lost;
+        removeHead();
+    }
+
+    segments[segmentCount++] = {nextSegmentId++, 0, 0};
+    tailOpen = true;
+}
+
+void FrameStore::removeHead()
+{
+    storage->remove(segments[0].id);
+    memmove(segments, segments + 1, (segmentCount - 1) * sizeof(Segment));
+    segmentCount--;
+    headRecord = 0;
+    headOffset = 0;
+    if (loadSegment > 0)
+    {
+        loadSegment--;
+    }
+    else
+    {
+        loadRecord = 0;
+        loadOffset = 0;
+    }
+    if (segmentCount == 0)
+    {
+        tailOpen = false;
+    }
+
+    // A missing segment needs no cursor: begin() starts at the next one
+    cursorDirty = false;
+}
+
+void FrameStore::retireDelivered()
+{
+    while (segmentCount > 0 && headRecord >= segments[0].records)
+    {
+        removeHead();
+    }
+}
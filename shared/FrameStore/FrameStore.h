@@ -0,0 +1,174 @@
+#ifndef FRAME_STORE_H
+#define FRAME_STORE_H
+
+#include <stddef.h>
+#include <stdint.h>
+#include "Protocol.h"
+
+/// Bytes per flash segment, a record never spans two (4 KB: one flash erase block)
+#ifndef FRAME_STORE_SEGMENT_BYTES
+#define FRAME_STORE_SEGMENT_BYTES 4096
+#endif
+
+/// Segments kept on flash. 64 x 4 KB holds ~4900 full-size texts, over 10000 typical
+/// ones; when all are full the oldest segment is dropped.
+#ifndef FRAME_STORE_MAX_SEGMENTS
+#define FRAME_STORE_MAX_SEGMENTS 64
+#endif
+
+/// Frames collected in RAM and written to flash in one append
+const uint8_t FRAME_STORE_BATCH_FRAMES = 16;
+
+/// Longest a new frame (or a delivery) stays unrecorded on flash. Frames delivered
+/// within it are never written at all; on a reset at most this much is lost.
+const uint32_t FRAME_STORE_SYNC_DELAY_MS = 10000;
+
+/// Stored frames read ahead for peek(), enough for one full BLE notification
+const uint8_t FRAME_STORE_WINDOW_FRAMES = 24;
+
+/// Flash record: length byte, frame, CRC-8 over both
+const size_t FRAME_RECORD_OVERHEAD = 2;
+const size_t FRAME_RECORD_MAX_SIZE = MAX_FRAME_SIZE + FRAME_RECORD_OVERHEAD;
+
+static_assert(FRAME_STORE_MAX_SEGMENTS >= 2, "eviction needs a segment besides the one being written");
+static_assert(FRAME_STORE_SEGMENT_BYTES >= FRAME_STORE_BATCH_FRAMES * FRAME_RECORD_MAX_SIZE,
+              "a full batch must fit one segment");
+
+/// Backing store of a FrameStore: numbered append-only segments plus a delivery
+/// cursor. LittleFS files on the bridge, RAM in the tests.
+///
+/// Segment ids only grow. A call that returns true is durable; one that fails
+/// may have written part of the data (the store seals such a segment).
+class FrameStorage
+{
+public:
+    virtual ~FrameStorage() {}
+
+    /// Writes the ids of the existing segments (any order), returns how many (at most max)
+    virtual size_t listSegments(uint32_t *ids, size_t max) = 0;
+
+    /// Reads up to len bytes from offset. Returns the bytes read (short or 0 at the end), -1 on error
+    virtual int read(uint32_t segment, size_t offset, uint8_t *buf, size_t len) = 0;
+
+    /// Appends to a segment, creating it if needed
+    virtual bool append(uint32_t segment, const uint8_t *data, size_t len) = 0;
+
+    virtual bool remove(uint32_t segment) = 0;
+
+    /// Replaces the cursor: everything before offset in segment, and every older segment, is delivered
+    virtual bool writeCursor(uint32_t segment, uint32_t offset) = 0;
+
+    /// False if no cursor was written yet
+    virtual bool readCursor(uint32_t &segment, uint32_t &offset) = 0;
+};
+
+/// Persistent FIFO of wire frames waiting for the app (store-and-forward).
+///
+/// New frames collect in RAM and are appended to the newest flash segment in
+/// one batch, after FRAME_STORE_SYNC_DELAY_MS or once FRAME_STORE_BATCH_FRAMES
+/// are waiting. Deliveries are recorded the same way through the cursor, and a
+/// segment is deleted as soon as all of its frames are delivered. While the app
+/// is connected frames usually leave RAM before they were ever written.
+///
+/// Crash safety: every record carries a CRC. begin() scans the segments, keeps
+/// the records before the first damaged one, never appends behind damage, and
+/// resumes after the last recorded delivery (frames delivered after it are
+/// delivered again: at least once).
+///
+/// The RAM index is one small entry per segment. Not thread-safe: one task owns it.
+class FrameStore
+{
+public:
+    /// storage may be nullptr: the store then keeps the last FRAME_STORE_BATCH_FRAMES in RAM
+    explicit FrameStore(FrameStorage *storage);
+
+    /// Recovers the frames left on flash. Returns how many are waiting.
+    size_t begin();
+
+    /// Queues a frame behind everything stored
+    void add(const WireFrame &frame, uint32_t nowMs);
+
+    /// Copies the frame at index (0 = oldest) without removing it. False past
+    /// the end, or past the read-ahead of stored frames (peek in order from 0).
+    bool peek(size_t index, WireFrame &frame);
+
+    /// Removes the oldest n frames after they were delivered
+    void drop(size_t n, uint32_t nowMs);
+
+    size_t count() const { return storedFrames + pendingCount; }
+    bool isEmpty() const { return count() == 0; }
+
+    /// Frames currently on flash
+    size_t storedCount() const { return storedFrames; }
+
+    /// Writes the RAM batch and the cursor once they are due. Returns the ms
+    /// until the next write is due, UINT32_MAX if everything is on flash.
+    uint32_t service(uint32_t nowMs);
+
+    /// Writes the RAM batch and the cursor now. False on a storage error
+    /// (unwritten frames stay in RAM and are retried).
+    bool sync();
+
+    /// Frames lost to a full store or damaged flash since the last call
+    uint32_t takeDropped();
+
+private:
+    struct Segment
+    {
+        uint32_t id;
+        uint16_t records;
+        uint16_t bytes;
+    };
+
+    FrameStorage *storage;
+
+    // Segments on flash, oldest first; records of the first one before head* are delivered
+    Segment segments[FRAME_STORE_MAX_SEGMENTS];
+    size_t segmentCount;
+    bool tailOpen; // Newest segment ends cleanly: appends go there while it has room
+    uint32_t nextSegmentId;
+    uint16_t headRecord;
+    uint16_t headOffset;
+    size_t storedFrames;
+
+    // Read-ahead: the oldest stored frames, continued from load*
+    WireFrame window[FRAME_STORE_WINDOW_FRAMES];
+    uint8_t windowStart;
+    uint8_t windowCount;
+    size_t loadSegment;
+    uint16_t loadRecord;
+    uint16_t loadOffset;
+
+    // New frames not written yet, behind every stored one
+    WireFrame pending[FRAME_STORE_BATCH_FRAMES];
+    uint8_t pendingStart;
+    uint8_t pendingCount;
+
+    bool cursorDirty;
+    bool dirty;
+    uint32_t dirtySinceMs;
+    uint32_t dropped;
+
+    uint8_t scratch[FRAME_STORE_BATCH_FRAMES * FRAME_RECORD_MAX_SIZE];
+
+    void reset();
+    void markDirty(uint32_t nowMs);
+    bool fillWindow(size_t upto);
+    bool writePending();
+    void openSegment();
+    void removeHead();
+    void retireDelivered();
+    void scanSegment(uint32_t id, bool isCursorSegment, uint32_t cursorOffset);
+};
+
+/// CRC-8 (polynomial 0x07) of a flash record
+uint8_t frame_record_crc(const uint8_t *data, size_t len);
+
+/// Encodes a frame as a record into buf (FRAME_RECORD_MAX_SIZE bytes), returns its size
+size_t frame_record_encode(const WireFrame &frame, uint8_t *buf);
+
+/// Decodes the record at the start of buf. Returns its size, 0 if avail cuts
+/// it short (more data needed), -1 if it is damaged.
+int frame_record_decode(const uint8_t *buf, size_t avail, WireFrame &frame);
+
+#endif // FRAME_STORE_H
@@ -0,0 +1,259 @@
+#include "GpsDelta.h"
+#include <string.h>
+
+namespace
+{
+    /// Offset of the coordinates field in a Text frame
+    size_t gpsOffset(const WireFrame &frame)
+    {
+        return 4 + (frame.data[3] & TEXT_PACKED_LEN_MASK);
+    }
+
+    GpsEncoding gpsEncoding(const WireFrame &frame)
+    {
+        return static_cast<GpsEncoding>(frame.data[3] >> TEXT_GPS_SHIFT);
+    }
+
+    /// Offset from reference to value, modulo 2^32 so any pair of int32 positions round-trips
+    int32_t offsetFrom(int32_t reference, int32_t value)
+    {
+        return static_cast<int32_t>(static_cast<uint32_t>(value) - static_cast<uint32_t>(reference));
+    }
+
+    int32_t applyOffset(int32_t reference, int32_t offset)
+    {
+        return static_cast<int32_t>(static_cast<uint32_t>(reference) + static_cast<uint32_t>(offset));
+    }
+
+    /// Replaces the coordinates field of a Text frame (Delta: lat/lon are offsets)
+    /// Returns false if the result does not fit the frame
+    bool writeGps(WireFrame &frame, GpsEncoding encoding, int32_t lat, int32_t lon)
+    {
+        size_t offset = gpsOffset(frame);
+        size_t size = 0;
+        uint8_t field[2 * VARINT_MAX_SIZE];
+        if (encoding == GpsEncoding::Delta)
+        {
+            size_t latSize = write_varint(zigzag_encode(lat), field);
+            size = latSize + write_varint(zigzag_encode(lon), field + latSize);
+        }
+        else if (encoding != GpsEncoding::None)
+        {
+            memcpy(field, &lat, 4);     // Little-endian
+            memcpy(field + 4, &lon, 4); // Little-endian
+            size = GPS_ABSOLUTE_SIZE;
+        }
+
+        if (offset + size > sizeof(frame.data))
+        {
+            return false;
+        }
+        frame.data[3] = static_cast<uint8_t>((static_cast<uint8_t>(encoding) << TEXT_GPS_SHIFT) |
+                                             (frame.data[3] & TEXT_PACKED_LEN_MASK));
+        memcpy(frame.data + offset, field, size);
+        frame.len = static_cast<uint8_t>(offset + size);
+        return true;
+    }
+}
+
+void GpsDeltaEncoder::reset()
+{
+    referenceValid = false;
+    referenceLat = 0;
+    referenceLon = 0;
+    keyframePending = false;
+    keyframeSeq = 0;
+    keyframeLat = 0;
+    keyframeLon = 0;
+    deltasSinceKeyframe = 0;
+    deltaCount = 0;
+}
+
+void GpsDeltaEncoder::forget(uint8_t seq)
+{
+    if (keyframePending && seq == keyframeSeq)
+    {
+        // The peer may or may not have stored it
+        keyframePending = false;
+        referenceValid = false;
+    }
+    for (uint8_t i = 0; i < deltaCount; i++)
+    {
+        if (deltaSeqs[i] == seq)
+        {
+            deltaSeqs[i] = deltaSeqs[--deltaCount];
+            return;
+        }
+    }
+}
+
+void GpsDeltaEncoder::encode(WireFrame &frame)
+{
+    if (frame.len < 4 || frame.data[0] != static_cast<uint8_t>(MessageType::Text) ||
+        gpsEncoding(frame) != GpsEncoding::Absolute)
+    {
+        return;
+    }
+
+    uint8_t seq = frame.data[1];
+    forget(seq); // The app re-sent a seq still in flight, its old frame is replaced
+
+    int32_t lat;
+    int32_t lon;
+    memcpy(&lat, frame.data + gpsOffset(frame), 4);
+    memcpy(&lon, frame.data + gpsOffset(frame) + 4, 4);
+
+    if (referenceValid && !keyframePending && deltasSinceKeyframe < GPS_KEYFRAME_INTERVAL &&
+        deltaCount < ARQ_WINDOW_SIZE)
+    {
+        int32_t latOffset = offsetFrom(referenceLat, lat);
+        int32_t lonOffset = offsetFrom(referenceLon, lon);
+        if (varint_size(zigzag_encode(latOffset)) + varint_size(zigzag_encode(lonOffset)) < GPS_ABSOLUTE_SIZE)
+        {
+            writeGps(frame, GpsEncoding::Delta, latOffset, lonOffset);
+            deltaSeqs[deltaCount++] = seq;
+            deltasSinceKeyframe++;
+            return;
+        }
+    }
+
+    if (!keyframePending && deltaCount == 0)
+    {
+        writeGps(frame, GpsEncoding::Keyframe, lat, lon);
+        keyframePending = true;
+        keyframeSeq = seq;
+        keyframeLat = lat;
+        keyframeLon = lon;
+    }
+    // Otherwise Absolute: a keyframe must wait until nothing references the current one
+}
+
+void GpsDeltaEncoder::acknowledged(uint8_t seq)
+{
+    if (keyframePending && seq == keyframeSeq)
+    {
+        keyframePending = false;
+        referenceValid = true;
+        referenceLat = keyframeLat;
+        referenceLon = keyframeLon;
+        deltasSinceKeyframe = 0;
+        return;
+    }
+    forget(seq);
+}
+
+void GpsDeltaEncoder::dropped(uint8_t seq)
+{
+    forget(seq);
+}
+
+bool GpsDeltaDecoder::decode(WireFrame &frame)
+{
+    if (frame.len < 4 || frame.data[0] != static_cast<uint8_t>(MessageType::Text))
+    {
+        return true;
+    }
+
+    size_t offset = gpsOffset(frame);
+    switch (gpsEncoding(frame))
+    {
+    case GpsEncoding::None:
+    case GpsEncoding::Absolute:
+        return true;
+
+    case GpsEncoding::Keyframe:
+        memcpy(&referenceLat, frame.data + offset, 4);
+        memcpy(&referenceLon, frame.data + offset + 4, 4);
+        referenceValid = true;
+        return writeGps(frame, GpsEncoding::Absolute, referenceLat, referenceLon);
+
+    case GpsEncoding::Delta:
+    {
+        uint32_t latZigzag;
+        uint32_t lonZigzag;
+        int latSize = read_varint(frame.data + offset, frame.len - offset, latZigzag);
+        read_varint(frame.data + offset + latSize, frame.len - offset - latSize, lonZigzag);
+        if (!referenceValid)
+        {
+            writeGps(frame, GpsEncoding::None, 0, 0);
+            return false;
+        }
+        int32_t lat = applyOffset(referenceLat, zigzag_decode(latZigzag));
+        int32_t lon = applyOffset(referenceLon, zigzag_decode(lonZigzag));
+        if (!writeGps(frame, GpsEncoding::Absolute, lat, lon))
+        {
+            writeGps(frame, GpsEncoding::None, 0, 0); // Oversized packed text, no room for Absolute
+            return false;
+        }
+        return true;
+    }
+    }
+    return true;
+}
+
+GpsDeltaDecoderTable::Peer *GpsDeltaDecoderTable::find(uint16_t sender)
+{
+    for (Peer &p : peers)
+    {
+        if (p.used && p.sender == sender)
+        {
+            return &p;
+        }
+    }
+    return nullptr;
+}
+
+bool GpsDeltaDecoderTable::decode(uint16_t sender, WireFrame &frame, uint32_t nowMs)
+{
+    Peer *peer = find(sender);
+    if (peer == nullptr)
+    {
+        bool keyframe = frame.len >= 4 && frame.data[0] == static_cast<uint8_t>(MessageType::Text) &&
+                        gpsEncoding(frame) == GpsEncoding::Keyframe;
+        if (!keyframe)
+        {
+            GpsDeltaDecoder none; // No reference: Absolute passes, a Delta loses its position
+            return none.decode(frame);
+        }
+
+        // A free slot, else the least recently heard sender
+        peer = &peers[0];
+        for (Peer &p : peers)
+        {
+            if (!p.used)
+            {
+                peer = &p;
+                break;
+            }
+            if (nowMs - p.lastMs > nowMs - peer->lastMs)
+            {
+                peer = &p;
+            }
+        }
+        peer->used = true;
+        peer->sender = sender;
+        peer->decoder.reset();
+    }
+    peer->lastMs = nowMs;
+    return peer->decoder.decode(frame);
+}
+
+void GpsDeltaDecoderTable::reset()
+{
+    for (Peer &p : peers)
+    {
+        p.used = false;
+    }
+}
+
+bool GpsDeltaDecoderTable::hasReference(uint16_t sender) const
+{
+    for (const Peer &p : peers)
+    {
+        if (p.used && p.sender == sender)
+        {
+            return p.decoder.hasReference();
+        }
+    }
+    return false;
+}
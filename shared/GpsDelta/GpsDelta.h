@@ -0,0 +1,130 @@
+#ifndef GPS_DELTA_H
+#define GPS_DELTA_H
+
+#include <stddef.h>
+#include <stdint.h>
+#include "Protocol.h"
+#include "Arq.h"
+
+/// Deltas sent from one reference before the next position goes out as a keyframe,
+/// which also bounds how long a receiver that lost its reference (reboot) shows no position
+const uint8_t GPS_KEYFRAME_INTERVAL = 8;
+
+/// Senders whose references a GpsDeltaDecoderTable keeps; the least recently heard one is forgotten first
+const uint8_t GPS_DELTA_MAX_PEERS = 4;
+
+/// Sender half of the delta GPS coding on the bridge-to-bridge link.
+///
+/// The app sends Absolute coordinates. Before a text enters the ARQ the bridge
+/// rewrites them as zigzag varint offsets from the last position the peer has
+/// acknowledged, typically 2-4 bytes instead of 8. The text bytes are untouched.
+///
+/// The reference only ever moves through an acknowledged Keyframe:
+/// - A Keyframe is only sent while no delta is in flight, and no delta is sent
+///   while a Keyframe is, so no delta can be decoded against the wrong reference
+/// - Until the Keyframe is acknowledged positions go out Absolute
+/// - A Keyframe the ARQ gave up on leaves the peer's reference unknown, so the
+///   next position is a Keyframe again
+/// A position is sent Absolute (or as a Keyframe) whenever the delta is not shorter.
+///
+/// No clock or radio access: driven by the ARQ acknowledgments and give-ups.
+class GpsDeltaEncoder
+{
+public:
+    GpsDeltaEncoder() { reset(); }
+
+    /// Re-encodes the coordinates of a new Text frame for the link. Frames without
+    /// GPS, and anything but Absolute coordinates, are left as they are.
+    /// Call once per frame before it is tracked, retransmissions reuse the result.
+    void encode(WireFrame &frame);
+
+    /// The peer acknowledged the text with this seq
+    void acknowledged(uint8_t seq);
+
+    /// The ARQ gave up on the text with this seq
+    void dropped(uint8_t seq);
+
+    /// Forgets the reference, the next position is sent as a Keyframe
+    void reset();
+
+    /// True once the peer has acknowledged a Keyframe
+    bool hasReference() const { return referenceValid; }
+
+private:
+    bool referenceValid;
+    int32_t referenceLat;
+    int32_t referenceLon;
+    bool keyframePending;
+    uint8_t keyframeSeq;
+    int32_t keyframeLat;
+    int32_t keyframeLon;
+    uint8_t deltasSinceKeyframe;
+    uint8_t deltaSeqs[ARQ_WINDOW_SIZE]; // Deltas neither acknowledged nor given up on
+    uint8_t deltaCount;
+
+    void forget(uint8_t seq);
+};
+
+/// Receiver half: the position state kept for one sending bridge. Turns Keyframe
+/// and Delta coordinates back into Absolute ones, so the app and the display
+/// never see link-only encodings. A receiver that hears several bridges uses a
+/// GpsDeltaDecoderTable instead.
+class GpsDeltaDecoder
+{
+public:
+    GpsDeltaDecoder() { reset(); }
+
+    /// Rewrites the coordinates of a received Text frame as Absolute. A Keyframe
+    /// becomes the new reference. Returns false if a Delta arrived without a
+    /// reference (we rebooted since the Keyframe): its coordinates are removed.
+    /// frame must pass Message::isValidFrame().
+    bool decode(WireFrame &frame);
+
+    /// Forgets the reference
+    void reset() { referenceValid = false; }
+
+    /// True once a Keyframe has been received
+    bool hasReference() const { return referenceValid; }
+
+private:
+    bool referenceValid;
+    int32_t referenceLat;
+    int32_t referenceLon;
+};
+
+/// One GpsDeltaDecoder per sender (link peer or relay origin, as for DedupCache),
+/// so a Delta is only ever expanded against a Keyframe from the same sender.
+///
+/// A sender gets a slot with its first Keyframe; when all GPS_DELTA_MAX_PEERS
+/// are taken the least recently heard sender loses its reference, and its next
+/// Delta is dropped like one that arrived before any Keyframe. Fixed memory, no
+/// clock access: every call takes the current time. Not thread-safe.
+class GpsDeltaDecoderTable
+{
+public:
+    GpsDeltaDecoderTable() { reset(); }
+
+    /// GpsDeltaDecoder::decode() with the reference of sender
+    bool decode(uint16_t sender, WireFrame &frame, uint32_t nowMs);
+
+    /// Forgets every sender
+    void reset();
+
+    /// True once a Keyframe from sender has been received (and not forgotten since)
+    bool hasReference(uint16_t sender) const;
+
+private:
+    struct Peer
+    {
+        bool used;
+        uint16_t sender;
+        uint32_t lastMs;
+        GpsDeltaDecoder decoder;
+    };
+
+    Peer peers[GPS_DELTA_MAX_PEERS];
+
+    Peer *find(uint16_t sender);
+};
+
+#endif // GPS_DELTA_H
@@ -0,0 +1,133 @@
+#include "LinkStats.h"
+
+LinkStats linkStats;
+
+namespace
+{
+    const size_t STAGE_COUNT = static_cast<size_t>(LinkStage::Count);
+    const size_t COUNTER_COUNT = static_cast<size_t>(LinkCounter::Count);
+
+    uint8_t *put32(uint8_t *out, uint32_t value)
+    {
+        out[0] = static_cast<uint8_t>(value >> 24);
+        out[1] = static_cast<uint8_t>(value >> 16);
+        out[2] = static_cast<uint8_t>(value >> 8);
+        out[3] = static_cast<uint8_t>(value);
+        return out + 4;
+    }
+}
+
+uint8_t LinkStats::bucketFor(uint32_t us)
+{
+    uint32_t units = us / LINK_STATS_FIRST_BUCKET_US;
+    uint8_t index = 0;
+    while (units > 0 && index < LINK_STATS_BUCKETS - 1)
+    {
+        units >>= 1;
+        index++;
+    }
+    return index;
+}
+
+void LinkStats::record(LinkStage stage, uint32_t us)
+{
+    Histogram &h = stages[static_cast<size_t>(stage)];
+    h.buckets[bucketFor(us)].fetch_add(1, std::memory_order_relaxed);
+
+    uint32_t max = h.maxUs.load(std::memory_order_relaxed);
+    while (us > max && !h.maxUs.compare_exchange_weak(max, us, std::memory_order_relaxed))
+    {
+        // max was reloaded, try again while us is still larger
+    }
+}
+
+uint32_t LinkStats::samples(LinkStage stage) const
+{
+    uint32_t total = 0;
+    for (uint8_t i = 0; i < LINK_STATS_BUCKETS; i++)
+    {
+        total += bucket(stage, i);
+    }
+    return total;
+}
+
+uint32_t LinkStats::bucket(LinkStage stage, uint8_t index) const
+{
+    return stages[static_cast<size_t>(stage)].buckets[index].load(std::memory_order_relaxed);
+}
+
+uint32_t LinkStats::maxUs(LinkStage stage) const
+{
+    return stages[static_cast<size_t>(stage)].maxUs.load(std::memory_order_relaxed);
+}
+
+uint32_t LinkStats::percentileUs(LinkStage stage, uint8_t percent) const
+{
+    uint32_t total = samples(stage);
+    if (total == 0)
+    {
+        return 0;
+    }
+
+    uint64_t rank = (static_cast<uint64_t>(total) * percent + 99) / 100; // Samples at or below it
+    uint32_t seen = 0;
+    for (uint8_t i = 0; i < LINK_STATS_BUCKETS - 1; i++)
+    {
+        seen += bucket(stage, i);
+        if (seen >= rank)
+        {
+            return LINK_STATS_FIRST_BUCKET_US << i;
+        }
+    }
+    return maxUs(stage);
+}
+
+size_t LinkStats::serialize(uint8_t *out, size_t len, uint32_t uptimeS) const
+{
+    if (len < LINK_STATS_SIZE)
+    {
+        return 0;
+    }
+
+    uint8_t *p = out;
+    *p++ = LINK_STATS_VERSION;
+    *p++ = static_cast<uint8_t>(STAGE_COUNT);
+    *p++ = LINK_STATS_BUCKETS;
+    *p++ = static_cast<uint8_t>(COUNTER_COUNT);
+    p = put32(p, uptimeS);
+
+    for (size_t c = 0; c < COUNTER_COUNT; c++)
+    {
+        p = put32(p, counters[c].load(std::memory_order_relaxed));
+    }
+
+    for (size_t s = 0; s < STAGE_COUNT; s++)
+    {
+        LinkStage stage = static_cast<LinkStage>(s);
+        p = put32(p, maxUs(stage));
+        for (uint8_t i = 0; i < LINK_STATS_BUCKETS; i++)
+        {
+            uint32_t n = bucket(stage, i);
+            uint16_t saturated = n > 0xFFFF ? 0xFFFF : static_cast<uint16_t>(n);
+            *p++ = static_cast<uint8_t>(saturated >> 8);
+            *p++ = static_cast<uint8_t>(saturated);
+        }
+    }
+    return p - out;
+}
+
+void LinkStats::reset()
+{
+    for (Histogram &h : stages)
+    {
+        for (std::atomic<uint32_t> &b : h.buckets)
+        {
+            b.store(0, std::memory_order_relaxed);
+        }
+        h.maxUs.store(0, std::memory_order_relaxed);
+    }
+    for (std::atomic<uint32_t> &c : counters)
+    {
+        c.store(0, std::memory_order_relaxed);
+    }
+}
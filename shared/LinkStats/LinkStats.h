@@ -0,0 +1,131 @@
+#ifndef LINK_STATS_H
+#define LINK_STATS_H
+
+#include <stddef.h>
+#include <stdint.h>
+#include <atomic>
+
+/// Hot-path stages timed in microseconds, in the order a packet passes them
+enum class LinkStage : uint8_t
+{
+    RxWake,    // DIO0 interrupt -> radio task handling it
+    RxRead,    // Radio task: IRQ flags, FIFO and RSSI/SNR read, packet in the ring
+    RxQueued,  // Packet in the ring -> bridge task taking it
+    RxProcess, // Bridge task: deserialize and handle one packet
+    BleNotify, // Notification handed to NimBLE -> NimBLE reporting it sent
+    TxQueued,  // Frame queued for the radio -> on air
+    TxAir,     // On air -> TxDone interrupt
+    Count
+};
+
+/// Events counted since boot
+enum class LinkCounter : uint8_t
+{
+    RxRingFull,     // Received packet lost to a full RX ring
+    RxCrcError,     // Received packet with a bad or missing payload CRC
+    RxFiltered,     // Received packet rejected from its first bytes (not for us)
+    RxInvalid,      // Received frame or aggregate that does not deserialize
+    BleQueueFull,   // Frame from the app lost to a full BLE -> LoRa queue
+    AppQueueFull,   // Received frame lost to a full queue for the app
+    StoreDropped,   // Stored frame for the app evicted by newer ones
+    TxQueueFull,    // Packet the radio's TX queue had no room for
+    TxFailed,       // Transmission the radio did not complete
+    ArqRetransmit,  // Text sent again for a missing ACK
+    ArqGaveUp,      // Text dropped after its last attempt
+    DuplicateText,  // Retransmitted text received again (only its ACK is sent)
+    ChannelBusy,    // Listen-before-talk found the channel busy and backed off
+    SniffFalseWake, // RX sniff CAD hit without a packet header following
+    Count
+};
+
+/// Histogram buckets per stage: bucket 0 counts samples below LINK_STATS_FIRST_BUCKET_US,
+/// bucket i [FIRST << (i - 1), FIRST << i), the last one everything from about 4.2 s up
+const uint8_t LINK_STATS_BUCKETS = 20;
+const uint32_t LINK_STATS_FIRST_BUCKET_US = 16;
+
+/// Version byte leading a serialized snapshot, bumped on layout changes
+const uint8_t LINK_STATS_VERSION = 2;
+
+/// Serialized snapshot size, see LinkStats::serialize()
+const size_t LINK_STATS_SIZE = 8 + 4 * static_cast<size_t>(LinkCounter::Count) +
+                               static_cast<size_t>(LinkStage::Count) * (4 + 2 * LINK_STATS_BUCKETS);
+
+/// Latency histograms and drop counters of the bridge's hot paths.
+///
+/// Recording is a relaxed atomic increment (plus a compare-exchange while a
+/// new maximum is set), safe from any task and never blocking, so the radio
+/// task and the NimBLE host can record on every packet. Samples are only
+/// aggregated: per stage the count per log2 bucket and the largest value.
+class LinkStats
+{
+public:
+    LinkStats() { reset(); }
+
+    /// Adds a sample of us microseconds to a stage
+    void record(LinkStage stage, uint32_t us);
+
+    /// Adds n to a counter
+    void count(LinkCounter counter, uint32_t n = 1)
+    {
+        counters[static_cast<size_t>(counter)].fetch_add(n, std::memory_order_relaxed);
+    }
+
+    /// Overwrites a counter kept elsewhere (e.g. by the radio driver) before a snapshot
+    void set(LinkCounter counter, uint32_t value)
+    {
+        counters[static_cast<size_t>(counter)].store(value, std::memory_order_relaxed);
+    }
+
+    uint32_t counter(LinkCounter counter) const
+    {
+        return counters[static_cast<size_t>(counter)].load(std::memory_order_relaxed);
+    }
+
+    uint32_t samples(LinkStage stage) const;
+    uint32_t bucket(LinkStage stage, uint8_t index) const;
+    uint32_t maxUs(LinkStage stage) const;
+
+    /// Upper edge in us of the bucket holding the given percentile of a stage's
+    /// samples (the stage's maximum for the last bucket), 0 without samples
+    uint32_t percentileUs(LinkStage stage, uint8_t percent) const;
+
+    /// Writes a snapshot (big-endian, LINK_STATS_SIZE bytes):
+    /// [version][stages][buckets][counters][uptime s:4], every counter (4 bytes),
+    /// then per stage its maximum in us (4 bytes) and its bucket counts (2 bytes
+    /// each, saturating at 0xFFFF). Counters come first, so a snapshot cut to a
+    /// small notification still carries them. Returns the length, 0 if len is too small.
+    size_t serialize(uint8_t *out, size_t len, uint32_t uptimeS) const;
+
+    /// Clears every histogram and counter
+    void reset();
+
+    /// Bucket a sample of us microseconds falls into
+    static uint8_t bucketFor(uint32_t us);
+
+private:
+    struct Histogram
+    {
+        std::atomic<uint32_t> buckets[LINK_STATS_BUCKETS];
+        std::atomic<uint32_t> maxUs;
+    };
+
+    Histogram stages[static_cast<size_t>(LinkStage::Count)];
+    std::atomic<uint32_t> counters[static_cast<size_t>(LinkCounter::Count)];
+};
+
+/// The firmware's link statistics (one per image, like eventLog)
+extern LinkStats linkStats;
+
+#ifdef ARDUINO
+#include <Arduino.h>
+#define STATS_CLOCK_US() micros()
+#else
+#define STATS_CLOCK_US() 0
+#endif
+
+/// Records the time since startUs (a STATS_CLOCK_US() reading) for a stage
+#define STATS_SINCE(stage, startUs) linkStats.record(LinkStage::stage, STATS_CLOCK_US() - (startUs))
+
+#define STATS_COUNT(counter, ...) linkStats.count(LinkCounter::counter, ##__VA_ARGS__)
+
+#endif // LINK_STATS_H
@@ -0,0 +1,174 @@
+#ifndef LORA_AIRTIME_H
+#define LORA_AIRTIME_H
+
+#include <stddef.h>
+#include <stdint.h>
+#include "lora_config.h"
+
+/// Bandwidth the SX127x actually uses for a requested value, rounded up to the
+/// next supported step exactly like LoRaClass::setSignalBandwidth() does
+/// (LORA_BANDWIDTH 31E3 runs at 31.25 kHz)
+constexpr uint32_t lora_effective_bandwidth_hz(double requestedHz)
+{
+    return requestedHz <= 7.8E3     ? 7800
+           : requestedHz <= 10.4E3  ? 10400
+           : requestedHz <= 15.6E3  ? 15600
+           : requestedHz <= 20.8E3  ? 20800
+           : requestedHz <= 31.25E3 ? 31250
+           : requestedHz <= 41.7E3  ? 41700
+           : requestedHz <= 62.5E3  ? 62500
+           : requestedHz <= 125E3   ? 125000
+           : requestedHz <= 250E3   ? 250000
+                                    : 500000;
+}
+
+/// Symbol duration in microseconds: 2^SF / BW
+constexpr uint32_t lora_symbol_time_us(uint8_t spreadingFactor, uint32_t bandwidthHz)
+{
+    return static_cast<uint32_t>((static_cast<uint64_t>(1) << spreadingFactor) * 1000000ULL / bandwidthHz);
+}
+
+/// Low data rate optimization flag, computed with the same integer math as
+/// LoRaClass::setLdoFlag() (symbol duration in whole ms > 16)
+constexpr bool lora_low_data_rate_optimize(uint8_t spreadingFactor, uint32_t bandwidthHz)
+{
+    return 1000 / (bandwidthHz / (1UL << spreadingFactor)) > 16;
+}
+
+/// Number of payload symbols (Semtech SX1276 datasheet, section 4.1.1.7):
+/// 8 + max(ceil((8PL - 4SF + 28 + 16CRC - 20IH) / (4(SF - 2DE))) * CR, 0)
+/// codingRate is the denominator of 4/CR (5..8).
+constexpr uint32_t lora_payload_symbols(size_t payloadLen, uint8_t spreadingFactor, uint32_t bandwidthHz,
+                                        uint8_t codingRate, bool crc = true, bool implicitHeader = false)
+{
+    const int32_t numerator = 8 * static_cast<int32_t>(payloadLen) - 4 * spreadingFactor + 28 + (crc ? 16 : 0) -
+                              (implicitHeader ? 20 : 0);
+    const int32_t denominator = 4 * (spreadingFactor - (lora_low_data_rate_optimize(spreadingFactor, bandwidthHz) ? 2 : 0));
+    return 8 + (numerator > 0 ? static_cast<uint32_t>((numerator + denominator - 1) / denominator) * codingRate : 0);
+}
+
+/// Symbols a Channel Activity Detection is budgeted (the SX127x needs a bit over one)
+const uint8_t LORA_CAD_SYMBOLS = 2;
+
+/// Preamble symbols of every packet on the link at a rate: LORA_PREAMBLE_LENGTH,
+/// or with RX sniffing (LORA_RX_SNIFF_MS) one sniff period plus a CAD, plus the
+/// 6 symbols a receiver needs to lock on after a CAD at the worst moment
+constexpr uint16_t lora_link_preamble_symbols(uint8_t spreadingFactor, uint32_t bandwidthHz)
+{
+    const uint32_t symbolUs = lora_symbol_time_us(spreadingFactor, bandwidthHz);
+    const uint32_t sniff = (static_cast<uint32_t>(LORA_RX_SNIFF_MS) * 1000 + symbolUs - 1) / symbolUs + LORA_CAD_SYMBOLS + 6;
+    return LORA_RX_SNIFF_MS == 0 || sniff < LORA_PREAMBLE_LENGTH ? LORA_PREAMBLE_LENGTH
+           : sniff > 0xFFFF                                      ? 0xFFFF
+                                                                 : static_cast<uint16_t>(sniff);
+}
+
+/// Time on air of one packet in microseconds: (preamble + 4.25) symbols + payload symbols
+constexpr uint32_t lora_time_on_air_us(size_t payloadLen, uint8_t spreadingFactor, uint32_t bandwidthHz,
+                                       uint8_t codingRate, uint16_t preambleLen = 8, bool crc = true,
+                                       bool implicitHeader = false)
+{
+    return static_cast<uint32_t>(
+        static_cast<uint64_t>(lora_symbol_time_us(spreadingFactor, bandwidthHz)) *
+        (4ULL * preambleLen + 17 + 4ULL * lora_payload_symbols(payloadLen, spreadingFactor, bandwidthHz, codingRate, crc, implicitHeader)) /
+        4);
+}
+
+/// Time on air in milliseconds, rounded up
+constexpr uint32_t lora_time_on_air_ms(size_t payloadLen, uint8_t spreadingFactor, uint32_t bandwidthHz,
+                                       uint8_t codingRate, uint16_t preambleLen = 8, bool crc = true,
+                                       bool implicitHeader = false)
+{
+    return (lora_time_on_air_us(payloadLen, spreadingFactor, bandwidthHz, codingRate, preambleLen, crc, implicitHeader) +
+            999) /
+           1000;
+}
+
+/// Airtime a node may use per LORA_DUTY_CYCLE_WINDOW_MS
+constexpr uint32_t LORA_DUTY_CYCLE_BUDGET_MS =
+    static_cast<uint32_t>(static_cast<uint64_t>(LORA_DUTY_CYCLE_WINDOW_MS) * LORA_DUTY_CYCLE_PERMILLE / 1000);
+
+// --- Radio profiles, evaluated at compile time ---
+
+/// Radio settings as a type. Every derived value is a constant expression, so a
+/// firmware instantiating LoRaManager with a profile pays nothing at runtime and
+/// several profiles can be compared side by side in one build.
+/// BandwidthHz is the requested value passed to the radio; effectiveBandwidthHz
+/// is what the SX127x runs at. CodingRate is the denominator of 4/CR (5..8).
+template <uint32_t FrequencyHz, uint8_t SpreadingFactor, uint32_t BandwidthHz, uint8_t CodingRate, int8_t TxPowerDbm,
+          uint16_t PreambleLength, bool CrcEnabled>
+struct LoRaRadio
+{
+    static_assert(SpreadingFactor >= 6 && SpreadingFactor <= 12, "spreading factor must be 6-12");
+    static_assert(CodingRate >= 5 && CodingRate <= 8, "coding rate must be 4/5 to 4/8");
+    static_assert(TxPowerDbm >= 2 && TxPowerDbm <= 20, "PA_BOOST TX power must be 2-20 dBm");
+    static_assert(PreambleLength >= 6, "the SX127x needs at least 6 preamble symbols");
+
+    static constexpr uint32_t frequencyHz = FrequencyHz;
+    static constexpr uint8_t spreadingFactor = SpreadingFactor;
+    static constexpr uint32_t bandwidthHz = BandwidthHz;
+    static constexpr uint32_t effectiveBandwidthHz = lora_effective_bandwidth_hz(BandwidthHz);
+    static constexpr uint8_t codingRate = CodingRate;
+    static constexpr int8_t txPowerDbm = TxPowerDbm;
+    static constexpr uint16_t preambleLength = PreambleLength;
+    static constexpr bool crcEnabled = CrcEnabled;
+
+    static constexpr uint32_t symbolTimeUs = lora_symbol_time_us(SpreadingFactor, effectiveBandwidthHz);
+    static constexpr bool lowDataRateOptimize = lora_low_data_rate_optimize(SpreadingFactor, effectiveBandwidthHz);
+
+    /// Time on air of a packet of payloadLen bytes, in ms
+    static constexpr uint32_t timeOnAirMs(size_t payloadLen)
+    {
+        return lora_time_on_air_ms(payloadLen, SpreadingFactor, effectiveBandwidthHz, CodingRate, PreambleLength,
+                                   CrcEnabled);
+    }
+
+    /// Packets of payloadLen bytes that fit into an airtime budget (the duty-cycle window by default)
+    static constexpr uint32_t packetsPerWindow(size_t payloadLen, uint32_t budgetMs = LORA_DUTY_CYCLE_BUDGET_MS)
+    {
+        return budgetMs / timeOnAirMs(payloadLen);
+    }
+
+    /// Largest payload (0-255 bytes) whose time on air stays within airtimeMs, or -1 if not even an empty one does
+    static constexpr int16_t maxPayloadForAirtime(uint32_t airtimeMs)
+    {
+        int16_t len = 255;
+        while (len >= 0 && timeOnAirMs(static_cast<size_t>(len)) > airtimeMs)
+        {
+            len--;
+        }
+        return len;
+    }
+};
+
+/// Long range: the lora_config.h settings (SF11 / 31.25 kHz). Every bridge boots
+/// with it, and it is the slowest rate adaptive data rate switches back to.
+using LongRangeRadio = LoRaRadio<LORA_FREQUENCY, LORA_SPREADING_FACTOR, static_cast<uint32_t>(LORA_BANDWIDTH),
+                                 LORA_CODING_RATE, LORA_TX_POWER,
+                                 lora_link_preamble_symbols(LORA_SPREADING_FACTOR,
+                                                            lora_effective_bandwidth_hz(LORA_BANDWIDTH)),
+                                 LORA_CRC_ENABLED != 0>;
+
+/// Fast local: SF7 / 125 kHz with CRC, for nodes within a few hundred meters
+/// (a full text takes ~0.1 s on air instead of ~5 s)
+using FastLocalRadio = LoRaRadio<LORA_FREQUENCY, 7, 125000, 5, 14, 8, true>;
+
+/// Bench: SF7 / 125 kHz at minimum power, for boards next to each other on a desk
+using BenchRadio = LoRaRadio<LORA_FREQUENCY, 7, 125000, 5, 2, 8, true>;
+
+/// Time on air of a packet with the lora_config.h radio settings, in ms
+constexpr uint32_t lora_config_time_on_air_ms(size_t payloadLen)
+{
+    return LongRangeRadio::timeOnAirMs(payloadLen);
+}
+
+/// Packets of payloadLen bytes a node can send per duty-cycle window (capacity planning)
+constexpr uint32_t lora_config_packets_per_window(size_t payloadLen)
+{
+    return LongRangeRadio::packetsPerWindow(payloadLen);
+}
+
+static_assert(LORA_DUTY_CYCLE_PERMILLE > 0 && LORA_DUTY_CYCLE_PERMILLE <= 1000, "duty cycle must be 1-1000 permille");
+static_assert(lora_config_time_on_air_ms(255) < LORA_DUTY_CYCLE_BUDGET_MS,
+              "the largest LoRa packet must fit the duty-cycle budget");
+
+#endif // LORA_AIRTIME_H
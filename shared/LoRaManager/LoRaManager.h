@@ -3,13 +3,86 @@
 
 #include <SPI.h>
 #include <LoRa.h>
+#include <freertos/FreeRTOS.h>
+#include <freertos/task.h>
+#include <freertos/semphr.h>
+#include <freertos/message_buffer.h>
+#include <atomic>
 #include "lora_config.h"
+#include "LoRaAirtime.h"
+#include "LoRaPacketRing.h"
+#include "EventLog.h"
+#include "LinkStats.h"
 
+/**
+ * @brief TX queue capacity in bytes (override with -DLORA_TX_QUEUE_BYTES=...).
+ * Each queued frame costs its length plus 4 (queue time stamp) + sizeof(size_t) bytes.
+ */
+#ifndef LORA_TX_QUEUE_BYTES
+#define LORA_TX_QUEUE_BYTES 1024
+#endif
+
+/**
+ * @brief Slack on top of a frame's computed time on air before the radio task
+ * gives up waiting for TxDone and returns to RX.
+ */
+#ifndef LORA_TX_TIMEOUT_MARGIN_MS
+#define LORA_TX_TIMEOUT_MARGIN_MS 2000
+#endif
+
+/**
+ * @brief SPI and control pins of a board's LoRa module, as compile-time constants.
+ */
+template <int Sck, int Miso, int Mosi, int Ss, int Rst, int Dio0>
+struct LoRaPins
+{
+    static constexpr int sckPin = Sck;
+    static constexpr int misoPin = Miso;
+    static constexpr int mosiPin = Mosi;
+    static constexpr int ssPin = Ss;
+    static constexpr int rstPin = Rst;
+    static constexpr int dio0Pin = Dio0;
+};
+
+/**
+ * @brief Board pins plus radio settings (LoRaRadio in LoRaAirtime.h): everything LoRaManager is built from.
+ */
+template <typename Pins, typename Radio>
+struct LoRaProfile : Pins, Radio
+{
+};
+
+/**
+ * @brief SX127x driver owning RX and TX through a radio task.
+ * @tparam Profile A LoRaProfile: pins, frequency, SF, BW, CR, power and CRC are
+ * compile-time constants, derived airtime values are computed by the compiler.
+ */
+template <typename Profile>
 class LoRaManager
 {
+    static_assert(LORA_RX_SNIFF_MS == 0 ||
+                      Profile::preambleLength >= lora_link_preamble_symbols(Profile::spreadingFactor, Profile::effectiveBandwidthHz),
+                  "with RX sniffing the profile needs the link preamble (LongRangeRadio has it)");
+
 public:
-    LoRaManager(int sck, int miso, int mosi, int ss, int rst, int dio0, long frequency)
-        : sckPin(sck), misoPin(miso), mosiPin(mosi), ssPin(ss), rstPin(rst), dio0Pin(dio0), frequency(frequency) {}
+    /// Radio task runs above application tasks but below the NimBLE host/controller tasks
+    static const UBaseType_t RADIO_TASK_PRIORITY = configMAX_PRIORITIES - 5;
+    static const uint32_t RADIO_TASK_STACK_SIZE = 4096;
+
+    /// Bytes of a received packet an RX filter sees: the type byte and the rest of a relay header
+    static const size_t RX_HEADER_BYTES = 4;
+
+    /// Decides from the first headerLen bytes (at most RX_HEADER_BYTES) whether a received packet of packetLen bytes is read
+    typedef bool (*RxFilter)(const uint8_t *header, size_t headerLen, size_t packetLen);
+
+    LoRaManager()
+        : rxRing(nullptr), radioTaskHandle(nullptr), rxCallback(nullptr), rxFilter(nullptr), rxCrcErrors(0),
+          rxFiltered(0), dio0Us(0), dio0Stamped(false),
+          state(RadioState::Listening), stateTick(0), stateTimeoutTicks(0), sniffing(false), rxWindowExtended(false),
+          txQueue(nullptr), txMutex(nullptr), txStartCallback(nullptr), txDoneCallback(nullptr), txRecordLen(0),
+          lbtAttempts(0), txStartUs(0), txPending(0), lastTxSuccess(false),
+          spreadingFactor(Profile::spreadingFactor), bandwidth(Profile::bandwidthHz), pendingSpreadingFactor(0),
+          pendingBandwidth(0), dataRatePending(false) {}
 
     /**
      * @brief Initializes the LoRa module.
@@ -17,46 +90,229 @@ public:
      */
     bool setup()
     {
-        SPI.begin(sckPin, misoPin, mosiPin, ssPin);
-        LoRa.setPins(ssPin, rstPin, dio0Pin);
+        SPI.begin(Profile::sckPin, Profile::misoPin, Profile::mosiPin, Profile::ssPin);
+        LoRa.setPins(Profile::ssPin, Profile::rstPin, Profile::dio0Pin);
 
-        if (!LoRa.begin(frequency))
+        if (!LoRa.begin(Profile::frequencyHz))
         {
             Serial.println("LoRa initialization failed!");
             return false;
         }
 
-        // Configure LoRa parameters from lora_config.h
-        LoRa.setSignalBandwidth(LORA_BANDWIDTH);
-        LoRa.setCodingRate4(LORA_CODING_RATE);
-        LoRa.setSpreadingFactor(LORA_SPREADING_FACTOR);
-        LoRa.setTxPower(LORA_TX_POWER);
-        LoRa.disableCrc();
+        // Configure LoRa parameters from the profile
+        LoRa.setSignalBandwidth(Profile::bandwidthHz);
+        LoRa.setCodingRate4(Profile::codingRate);
+        LoRa.setSpreadingFactor(Profile::spreadingFactor);
+        LoRa.setTxPower(Profile::txPowerDbm);
+        LoRa.setPreambleLength(Profile::preambleLength);
+        if constexpr (Profile::crcEnabled)
+        {
+            LoRa.enableCrc();
+        }
+        else
+        {
+            LoRa.disableCrc();
+        }
 
         Serial.println("LoRa initialized successfully.");
         return true;
     }
 
     /**
-     * @brief Sends a packet with the given byte buffer.
+     * @brief Sends a packet with the given byte buffer and waits for completion.
+     *
+     * Once the radio task runs this goes through the asynchronous TX queue and
+     * blocks the caller until the frame is on air, so it never races the task
+     * for the SPI bus. Prefer queuePacket() anywhere latency matters.
      * @param buffer The byte buffer to send.
      * @param length The number of bytes to send from the buffer.
      * @return True if the packet was sent successfully, false otherwise.
      */
     bool sendPacket(const byte *buffer, size_t length)
     {
-        LoRa.beginPacket();
-        LoRa.write(buffer, length);         // Use LoRa.write for byte arrays
-        int success = LoRa.endPacket(true); // true for synchronous mode
+        bool success;
+        if (radioTaskHandle)
+        {
+            success = queuePacket(buffer, length) && flushTx(pdMS_TO_TICKS(txDrainTimeoutMs(length))) && lastTxSuccess;
+        }
+        else
+        {
+            LoRa.beginPacket();
+            LoRa.write(buffer, length);          // Use LoRa.write for byte arrays
+            success = LoRa.endPacket(false) > 0; // false = synchronous, blocks until TxDone
+        }
+
         if (success)
         {
-            Serial.println("Packet sent successfully!");
+            LOG_INFO(LoRaSendOk);
         }
         else
         {
-            Serial.println("Failed to send packet.");
+            LOG_WARN(LoRaSendFailed);
+        }
+        return success;
+    }
+
+    /**
+     * @brief Queues a frame for asynchronous transmission by the radio task.
+     *
+     * Returns immediately. The radio task starts the transmission as soon as
+     * the radio and the channel are free (LORA_LBT_ENABLED), waits for TxDone
+     * on DIO0, goes back to listening on its own and reports the result
+     * through the TX-done callback.
+     * Safe to call from any task; frames are sent in FIFO order.
+     * @param buffer Frame bytes (copied).
+     * @param length Frame length (1-255 bytes).
+     * @return True if the frame was queued, false if the queue is full or the radio task is not running.
+     */
+    bool queuePacket(const uint8_t *buffer, size_t length)
+    {
+        if (!txQueue || length == 0 || length > 255)
+        {
+            return false;
+        }
+
+        // Queued at [us:4] in front of the frame, for the TxQueued stage of linkStats
+        uint8_t record[TX_STAMP_SIZE + 255];
+        uint32_t queuedUs = STATS_CLOCK_US();
+        memcpy(record, &queuedUs, TX_STAMP_SIZE);
+        memcpy(record + TX_STAMP_SIZE, buffer, length);
+
+        xSemaphoreTake(txMutex, portMAX_DELAY); // Message buffers allow a single writer
+        bool queued = xMessageBufferSend(txQueue, record, TX_STAMP_SIZE + length, 0) == TX_STAMP_SIZE + length;
+        if (queued)
+        {
+            txPending++;
         }
-        return success > 0;
+        xSemaphoreGive(txMutex);
+
+        if (queued)
+        {
+            xTaskNotify(radioTaskHandle, NOTIFY_TX_REQUEST, eSetBits);
+        }
+        return queued;
+    }
+
+    /**
+     * @brief Waits until every queued frame has been transmitted.
+     * @param timeout Maximum ticks to wait.
+     * @return True if the TX queue drained in time.
+     */
+    bool flushTx(TickType_t timeout)
+    {
+        TickType_t start = xTaskGetTickCount();
+        while (txPending > 0)
+        {
+            if (xTaskGetTickCount() - start >= timeout)
+            {
+                return false;
+            }
+            vTaskDelay(pdMS_TO_TICKS(10));
+        }
+        return true;
+    }
+
+    /**
+     * @brief True while a frame is on air or waiting in the TX queue.
+     */
+    bool isTxBusy() const { return txPending > 0; }
+
+    /**
+     * @brief Longest a frame of len bytes may take from TX start to TxDone.
+     * Computed for the profile's rate, the slowest one setDataRate() is used with.
+     */
+    static constexpr uint32_t txTimeoutMs(size_t len)
+    {
+        return Profile::timeOnAirMs(len) + LORA_TX_TIMEOUT_MARGIN_MS;
+    }
+
+    /**
+     * @brief Longest a frame of len bytes may take from the head of the TX queue
+     * to TxDone: txTimeoutMs() plus every listen-before-talk check and backoff.
+     */
+    static constexpr uint32_t txDrainTimeoutMs(size_t len)
+    {
+        return txTimeoutMs(len) +
+               (LORA_LBT_ENABLED ? LORA_LBT_MAX_ATTEMPTS * (cadTimeoutMs(Profile::symbolTimeUs) +
+                                                            LBT_MAX_BACKOFF_SLOTS * Profile::timeOnAirMs(LBT_SLOT_BYTES))
+                                 : 0);
+    }
+
+    /**
+     * @brief Switches spreading factor and bandwidth at runtime (adaptive data rate).
+     *
+     * With the radio task running the change is applied by the task once the
+     * radio is idle and the TX queue is empty, so frames queued before this call
+     * still go out at the old rate. Before that it is applied right away.
+     * Coding rate and CRC stay as set by the profile; with RX sniffing the
+     * preamble is stretched to span a sniff period at the new rate.
+     * @param sf Spreading factor (6-12).
+     * @param bw Bandwidth in Hz, rounded up to the next supported value by the radio.
+     * @return False for an out-of-range spreading factor.
+     */
+    bool setDataRate(uint8_t sf, long bw)
+    {
+        if (sf < 6 || sf > 12)
+        {
+            return false;
+        }
+        if (!radioTaskHandle)
+        {
+            applyDataRate(sf, bw);
+            return true;
+        }
+
+        pendingSpreadingFactor = sf;
+        pendingBandwidth = bw;
+        dataRatePending = true; // Published last, the radio task reads the values after it
+        xTaskNotify(radioTaskHandle, NOTIFY_RECONFIGURE, eSetBits);
+        return true;
+    }
+
+    /**
+     * @brief Spreading factor the radio currently runs at.
+     */
+    uint8_t getSpreadingFactor() const { return spreadingFactor; }
+
+    /**
+     * @brief Bandwidth in Hz the radio currently runs at (as requested, before rounding).
+     */
+    long getBandwidth() const { return bandwidth; }
+
+    /**
+     * @brief Sets a callback invoked from the radio task right before a queued frame goes on air.
+     * Use it to raise power locks only for the actual transmission.
+     */
+    void setTxStartCallback(void (*callback)()) { txStartCallback = callback; }
+
+    /**
+     * @brief Sets a callback invoked from the radio task when a transmission completes.
+     * @param callback Receives true on TxDone, false if the radio refused the frame or timed out.
+     * The radio is already back in RX when it runs (keep it short, runs in the radio task).
+     */
+    void setTxDoneCallback(void (*callback)(bool success)) { txDoneCallback = callback; }
+
+    /**
+     * @brief Lets the radio sleep between receptions and sniff for a preamble
+     * with a CAD every LORA_RX_SNIFF_MS instead of staying in continuous RX.
+     *
+     * A CAD that finds a preamble opens an RX window for the packet; one
+     * without a valid header in time closes it again. DIO0 carries CadDone as
+     * well as RxDone, so the GPIO wake-up on DIO0 still wakes the CPU from
+     * light sleep, and the sniff timer is a plain task timeout the automatic
+     * light sleep wakes up for. Needs a caller that never halts the radio task
+     * for longer than a sniff period (no esp_light_sleep_start()).
+     * Call before startRadioTask().
+     * @return False if the link has no sniff preamble (LORA_RX_SNIFF_MS is 0) or the task already runs.
+     */
+    bool enableRxSniffing()
+    {
+        if (LORA_RX_SNIFF_MS == 0 || radioTaskHandle)
+        {
+            return false;
+        }
+        sniffing = true;
+        return true;
     }
 
     /**
@@ -70,107 +326,669 @@ public:
     }
 
     /**
-     * @brief Checks for and reads a packet into a byte buffer.
-     * @param buffer The buffer to store the received packet data.
-     * @param maxLen The maximum number of bytes to read into the buffer.
-     * @return The number of bytes received (packet size), or 0 if no packet was received or buffer is too small.
+     * @brief Starts the interrupt-driven radio task that owns RX and TX.
+     *
+     * The DIO0 ISR does no SPI work: it only wakes the radio task with a direct
+     * task notification. In RX the task reads the IRQ flags and the first bytes of
+     * the FIFO (see setRxFilter()), drains the rest, reads RSSI/SNR, timestamps the
+     * packet and appends it to the ring.
+     * Wake-up, FIFO read, TX queueing and airtime are timed into linkStats.
+     * Frames from queuePacket() are checked against a busy channel with a CAD
+     * first (LORA_LBT_ENABLED), then transmitted with DIO0 remapped to TxDone;
+     * on TxDone the task puts the radio back into RX. Outside of a transmission
+     * the radio is always listening, continuously or by sniffing (enableRxSniffing()).
+     *
+     * Call after setup() and startReceiveMode(). Replaces LoRa.onReceive().
+     * After this, only the radio task touches the SX127x - do not call
+     * startReceiveMode() while a transmission may be in flight.
+     * @param ring Variable-length packet ring that receives the packets (begin() already called).
+     * @param priority Radio task priority.
+     * @param core Core to pin the radio task to.
+     * @return True if the radio task was created.
+     */
+    bool startRadioTask(LoRaPacketRing *ring, UBaseType_t priority = RADIO_TASK_PRIORITY, BaseType_t core = tskNO_AFFINITY)
+    {
+        rxRing = ring;
+        instance = this;
+
+        txQueue = xMessageBufferCreate(LORA_TX_QUEUE_BYTES);
+        txMutex = xSemaphoreCreateMutex();
+        if (!txQueue || !txMutex)
+        {
+            Serial.println("Failed to create LoRa TX queue");
+            return false;
+        }
+
+        if (xTaskCreatePinnedToCore(radioTask, "lora_radio", RADIO_TASK_STACK_SIZE, this, priority, &radioTaskHandle, core) != pdPASS)
+        {
+            Serial.println("Failed to create LoRa radio task");
+            return false;
+        }
+
+        pinMode(Profile::dio0Pin, INPUT);
+        attachInterrupt(digitalPinToInterrupt(Profile::dio0Pin), onDio0Rise, RISING);
+        return true;
+    }
+
+    /**
+     * @brief Wakes the radio task to service pending IRQ flags.
+     *
+     * Use when a DIO0 edge may have been missed, e.g. after waking from light sleep
+     * with a packet already in the FIFO (DIO0 would stay high and never rise again).
      */
-    int receivePacket(byte *buffer, size_t maxLen)
+    void serviceIrq()
     {
-        int packetSize = LoRa.parsePacket();
-        if (packetSize == 0 || packetSize > maxLen)
+        if (radioTaskHandle)
         {
-            // No packet or buffer too small
-            // Clear any remaining data if packetSize > maxLen? LoRa lib might handle this.
-            // For now, just return 0. If packetSize > maxLen, we might lose data.
-            if (packetSize > maxLen)
+            xTaskNotify(radioTaskHandle, NOTIFY_DIO0, eSetBits);
+        }
+    }
+
+    /**
+     * @brief Sets a callback invoked from the radio task after a packet was queued.
+     * @param callback Function to call (keep it short, runs in the radio task).
+     */
+    void setRxCallback(void (*callback)()) { rxCallback = callback; }
+
+    /**
+     * @brief Sets a filter run by the radio task on the first bytes of every packet.
+     *
+     * A packet it rejects is never read any further: the rest of the FIFO, RSSI
+     * and SNR are skipped, nothing is pushed to the ring and the RX callback does
+     * not run. Keep it short and free of locks, it runs in the radio task.
+     * @param filter Returns true to receive the packet, nullptr receives everything.
+     */
+    void setRxFilter(RxFilter filter) { rxFilter = filter; }
+
+    /**
+     * @brief Number of received packets dropped because the RX ring was full.
+     */
+    uint32_t getRxDropped() const { return rxRing ? rxRing->getDropped() : 0; }
+
+    /**
+     * @brief Number of received packets dropped for a bad payload CRC, or for
+     * having none while the profile requires it (crcEnabled).
+     */
+    uint32_t getRxCrcErrors() const { return rxCrcErrors; }
+
+    /**
+     * @brief Number of received packets the RX filter rejected.
+     */
+    uint32_t getRxFiltered() const { return rxFiltered; }
+
+    /**
+     * @brief Prints the current LoRa configuration (no heap allocation).
+     * @param out Destination, e.g. Serial.
+     */
+    void printConfiguration(Print &out) const
+    {
+        out.println("LoRa Configuration:");
+        out.printf("  Frequency: %.2f MHz\n", Profile::frequencyHz / 1000000.0);
+        out.printf("  Bandwidth: %.2f kHz\n", bandwidth / 1000.0);
+        out.printf("  Spreading Factor: %u\n", spreadingFactor);
+        out.printf("  Coding Rate: 4/%u\n", Profile::codingRate);
+        out.printf("  TX Power: %d dBm\n", Profile::txPowerDbm);
+        out.printf("  Preamble: %u symbols, CRC %s\n", preambleFor(spreadingFactor, bandwidth),
+                   Profile::crcEnabled ? "on" : "off");
+        out.printf("  Listen before talk: %s, RX sniff period: %lu ms%s\n", LORA_LBT_ENABLED ? "on" : "off",
+                   static_cast<unsigned long>(LORA_RX_SNIFF_MS), LORA_RX_SNIFF_MS == 0 ? " (continuous RX)" : "");
+        out.printf("  Time on air: %lu ms per %d-byte packet\n",
+                   static_cast<unsigned long>(Profile::timeOnAirMs(LORA_AGGREGATE_MAX_BYTES)), LORA_AGGREGATE_MAX_BYTES);
+        out.printf("  Duty cycle: %.1f%% = %lu ms per %lu min\n", LORA_DUTY_CYCLE_PERMILLE / 10.0,
+                   static_cast<unsigned long>(LORA_DUTY_CYCLE_BUDGET_MS), LORA_DUTY_CYCLE_WINDOW_MS / 60000UL);
+    }
+
+private:
+    // SX127x registers and IRQ flags used by the radio task
+    static const uint8_t REG_FIFO = 0x00;
+    static const uint8_t REG_OP_MODE = 0x01;
+    static const uint8_t REG_FIFO_ADDR_PTR = 0x0D;
+    static const uint8_t REG_FIFO_RX_CURRENT_ADDR = 0x10;
+    static const uint8_t REG_IRQ_FLAGS = 0x12;
+    static const uint8_t REG_RX_NB_BYTES = 0x13;
+    static const uint8_t REG_MODEM_STAT = 0x18;
+    static const uint8_t REG_HOP_CHANNEL = 0x1C;
+    static const uint8_t REG_DIO_MAPPING_1 = 0x40;
+    static const uint8_t MODE_CAD = 0x87; // Long range mode + CAD
+    static const uint8_t IRQ_PAYLOAD_CRC_ERROR_MASK = 0x20;
+    static const uint8_t IRQ_RX_DONE_MASK = 0x40;
+    static const uint8_t IRQ_TX_DONE_MASK = 0x08;
+    static const uint8_t IRQ_CAD_DONE_MASK = 0x04;
+    static const uint8_t IRQ_CAD_DETECTED_MASK = 0x01;
+    static const uint8_t MODEM_STAT_BUSY = 0x0F;   // Signal detected, synchronized, RX ongoing or header valid
+    static const uint8_t MODEM_STAT_PACKET = 0x0C; // RX ongoing or header valid
+    static const uint8_t HOP_CHANNEL_CRC_ON_PAYLOAD = 0x40; // Header of the last packet announced a CRC
+    static const uint8_t DIO0_TX_DONE = 0x40;  // DIO_MAPPING_1 value routing TxDone to DIO0
+    static const uint8_t DIO0_CAD_DONE = 0x80; // DIO_MAPPING_1 value routing CadDone to DIO0
+
+    static const size_t TX_STAMP_SIZE = 4; // Queue time in front of every TX queue entry
+
+    // Listen-before-talk backoff: 1 to 2, 4, then at most 8 slots, a slot being
+    // the time on air of a bare ACK (the shortest packet that may be on air)
+    static const uint8_t LBT_MAX_BACKOFF_SLOTS = 8;
+    static const size_t LBT_SLOT_BYTES = 2;
+
+    // Radio task notification bits
+    static const uint32_t NOTIFY_DIO0 = 1 << 0;
+    static const uint32_t NOTIFY_TX_REQUEST = 1 << 1;
+    static const uint32_t NOTIFY_RECONFIGURE = 1 << 2;
+
+    /// What the radio task waits for (owned by the radio task)
+    enum class RadioState : uint8_t
+    {
+        Listening,    // Continuous RX, or with sniffing asleep until the next sniff
+        Sniffing,     // CAD for a preamble to receive
+        RxWindow,     // The sniff found a preamble: RX until RxDone or the window closes
+        ChannelCheck, // CAD before the held frame goes on air
+        Backoff,      // Channel busy: RX until the held frame may check again
+        Transmitting  // Held frame on air, waiting for TxDone
+    };
+
+    LoRaPacketRing *rxRing;
+    TaskHandle_t radioTaskHandle;
+    void (*rxCallback)();
+    RxFilter rxFilter;
+    std::atomic<uint32_t> rxCrcErrors;
+    std::atomic<uint32_t> rxFiltered;
+    volatile uint32_t dio0Us;   // STATS_CLOCK_US() of the last DIO0 edge, set by the ISR
+    volatile bool dio0Stamped; // dio0Us not yet taken by the radio task
+
+    // Radio state, with the ticks it may last (owned by the radio task)
+    RadioState state;
+    TickType_t stateTick;
+    TickType_t stateTimeoutTicks;
+    bool sniffing;
+    bool rxWindowExtended; // The RX window found a header and waits for the whole packet
+
+    // TX state (the held frame is owned by the radio task)
+    MessageBufferHandle_t txQueue;
+    SemaphoreHandle_t txMutex;
+    void (*txStartCallback)();
+    void (*txDoneCallback)(bool success);
+    uint8_t txRecord[TX_STAMP_SIZE + 255]; // Frame taken from the queue, until it is on air
+    size_t txRecordLen;
+    uint8_t lbtAttempts; // Channel checks of the held frame
+    uint32_t txStartUs;
+    std::atomic<uint32_t> txPending; // Queued + held frames
+    volatile bool lastTxSuccess;
+
+    // Data rate (written by the radio task once it runs, pending values by setDataRate())
+    volatile uint8_t spreadingFactor;
+    volatile long bandwidth;
+    uint8_t pendingSpreadingFactor;
+    long pendingBandwidth;
+    std::atomic<bool> dataRatePending;
+
+    // Single radio per firmware - the ISR needs a static entry point
+    static inline LoRaManager *instance = nullptr;
+
+    /**
+     * @brief Preamble symbols at a data rate: the profile's, or the link's sniff preamble.
+     */
+    static constexpr uint16_t preambleFor(uint8_t sf, long bw)
+    {
+        return LORA_RX_SNIFF_MS > 0 ? lora_link_preamble_symbols(sf, lora_effective_bandwidth_hz(bw))
+                                    : Profile::preambleLength;
+    }
+
+    /**
+     * @brief Longest a CAD may take before the radio task stops waiting for CadDone.
+     */
+    static constexpr uint32_t cadTimeoutMs(uint32_t symbolUs)
+    {
+        return 2 * LORA_CAD_SYMBOLS * symbolUs / 1000 + 10;
+    }
+
+    /**
+     * @brief DIO0 interrupt: defer all SPI work to the radio task.
+     */
+    static void IRAM_ATTR onDio0Rise()
+    {
+        BaseType_t higherPriorityTaskWoken = pdFALSE;
+        if (instance && instance->radioTaskHandle)
+        {
+            instance->dio0Us = STATS_CLOCK_US(); // micros() is IRAM safe
+            instance->dio0Stamped = true;
+            xTaskNotifyFromISR(instance->radioTaskHandle, NOTIFY_DIO0, eSetBits, &higherPriorityTaskWoken);
+        }
+        portYIELD_FROM_ISR(higherPriorityTaskWoken);
+    }
+
+    /**
+     * @brief Radio state machine: listening (RX or sniffing) <-> channel check <-> TX (waiting for TxDone).
+     */
+    static void radioTask(void *param)
+    {
+        LoRaManager *self = static_cast<LoRaManager *>(param);
+        self->listen();
+        for (;;)
+        {
+            uint32_t events = 0;
+            xTaskNotifyWait(0, UINT32_MAX, &events, self->waitTicks());
+
+            switch (self->state)
             {
-                Serial.printf("Received packet size (%d) exceeds buffer size (%d). Packet discarded.\n", packetSize, maxLen);
-                // Read and discard the packet data to clear the LoRa buffer
-                while (LoRa.available())
+            case RadioState::Transmitting:
+                // Also polled on timeout in case the TxDone edge was missed
+                self->handleTxDone();
+                break;
+            case RadioState::Sniffing:
+            case RadioState::ChannelCheck:
+                self->handleCadDone(); // Likewise for CadDone
+                break;
+            default:
+                if ((events & NOTIFY_DIO0) && self->handleRxDone() && self->state == RadioState::RxWindow)
+                {
+                    self->listen(); // The sniffed packet is in
+                }
+                if (self->waitTicks() == 0)
                 {
-                    LoRa.read();
+                    self->handleStateTimeout();
                 }
+                break;
+            }
+
+            while (self->state == RadioState::Listening && self->startNextTx())
+            {
+                // Frames the radio refused complete immediately - try the next one
+            }
+
+            // TX queue drained: a requested data rate change can be applied now
+            if (self->state == RadioState::Listening && self->dataRatePending)
+            {
+                self->dataRatePending = false;
+                self->applyDataRate(self->pendingSpreadingFactor, self->pendingBandwidth);
             }
-            return 0;
+        }
+    }
+
+    /**
+     * @brief Reprograms the modem in standby and goes back to listening.
+     */
+    void applyDataRate(uint8_t sf, long bw)
+    {
+        LoRa.idle();
+        LoRa.setSpreadingFactor(sf); // Also updates the low data rate optimization flag
+        LoRa.setSignalBandwidth(bw);
+        LoRa.setPreambleLength(preambleFor(sf, bw));
+        spreadingFactor = sf;
+        bandwidth = bw;
+        listen();
+        LOG_INFO(LoRaDataRate, sf, bw);
+    }
+
+    /**
+     * @brief Time on air of a packet of len bytes at the current data rate, in ms.
+     */
+    uint32_t timeOnAirMs(size_t len) const
+    {
+        return lora_time_on_air_ms(len, spreadingFactor, lora_effective_bandwidth_hz(bandwidth), Profile::codingRate,
+                                   preambleFor(spreadingFactor, bandwidth), Profile::crcEnabled);
+    }
+
+    void enterState(RadioState next, TickType_t timeoutTicks)
+    {
+        state = next;
+        stateTick = xTaskGetTickCount();
+        stateTimeoutTicks = timeoutTicks;
+    }
+
+    /**
+     * @brief Ticks until the current state times out (forever while in continuous RX).
+     */
+    TickType_t waitTicks() const
+    {
+        if (state == RadioState::Listening && !sniffing)
+        {
+            return portMAX_DELAY;
+        }
+        TickType_t elapsed = xTaskGetTickCount() - stateTick;
+        return elapsed >= stateTimeoutTicks ? 0 : stateTimeoutTicks - elapsed;
+    }
+
+    /**
+     * @brief Continuous RX, or with sniffing the radio asleep until the next sniff.
+     */
+    void listen()
+    {
+        if (sniffing)
+        {
+            LoRa.sleep();
+            enterState(RadioState::Listening, pdMS_TO_TICKS(LORA_RX_SNIFF_MS));
+        }
+        else
+        {
+            LoRa.receive();
+            enterState(RadioState::Listening, 0);
+        }
+    }
+
+    /**
+     * @brief Starts a CAD in standby with DIO0 routed to CadDone.
+     * IRQ flags other than the CAD ones are kept, so an RxDone that raced it is not lost.
+     */
+    void startCad(RadioState next)
+    {
+        LoRa.idle();
+        writeRegister(REG_IRQ_FLAGS, IRQ_CAD_DONE_MASK | IRQ_CAD_DETECTED_MASK);
+        writeRegister(REG_DIO_MAPPING_1, DIO0_CAD_DONE);
+        writeRegister(REG_OP_MODE, MODE_CAD);
+        enterState(next, pdMS_TO_TICKS(cadTimeoutMs(lora_symbol_time_us(spreadingFactor, lora_effective_bandwidth_hz(bandwidth)))) + 1);
+    }
+
+    /**
+     * @brief Acts on a finished CAD (or on one that timed out): an RX window or
+     * sleep after a sniff, the held frame or a backoff after a channel check.
+     */
+    void handleCadDone()
+    {
+        uint8_t irqFlags = readRegister(REG_IRQ_FLAGS);
+        bool done = (irqFlags & IRQ_CAD_DONE_MASK) != 0;
+        if (!done && waitTicks() > 0)
+        {
+            return; // Spurious wake-up, keep waiting
+        }
+
+        writeRegister(REG_IRQ_FLAGS, IRQ_CAD_DONE_MASK | IRQ_CAD_DETECTED_MASK);
+        dio0Stamped = false; // CadDone, not a packet
+        if (irqFlags & IRQ_RX_DONE_MASK)
+        {
+            handleRxDone(); // Completed while the CAD was started, still in the FIFO
         }
 
-        // Read packet data into the buffer
-        int bytesRead = 0;
-        while (LoRa.available() && bytesRead < packetSize) // Ensure we don't read more than packetSize
+        bool detected = (irqFlags & IRQ_CAD_DETECTED_MASK) != 0;
+        if (state == RadioState::Sniffing)
         {
-            buffer[bytesRead++] = (byte)LoRa.read();
+            if (detected)
+            {
+                // Long enough for the rest of the preamble and the header
+                LoRa.receive();
+                rxWindowExtended = false;
+                enterState(RadioState::RxWindow, pdMS_TO_TICKS(timeOnAirMs(0)) + 1);
+            }
+            else
+            {
+                listen();
+            }
+            return;
         }
 
-        // Check if we read the expected number of bytes
-        if (bytesRead != packetSize)
+        if (detected || !done) // A CAD that never finished tells nothing: treated as busy
         {
-            Serial.printf("Error reading packet: expected %d bytes, read %d bytes.\n", packetSize, bytesRead);
-            // Handle error, maybe return -1 or 0? For now, return bytesRead but log error.
+            backoff();
         }
+        else
+        {
+            transmitHeld();
+        }
+    }
+
+    /**
+     * @brief Listens for a random number of slots before the held frame checks the channel again.
+     */
+    void backoff()
+    {
+        linkStats.count(LinkCounter::ChannelBusy);
+        uint32_t window = 2u << (lbtAttempts < 3 ? lbtAttempts - 1 : 2); // 2, 4, then 8 slots
+        uint32_t backoffMs = (1 + esp_random() % window) * timeOnAirMs(LBT_SLOT_BYTES);
+        LOG_DEBUG(LoRaChannelBusy, lbtAttempts, backoffMs);
+
+        LoRa.receive(); // What is on air may be a packet for us
+        enterState(RadioState::Backoff, pdMS_TO_TICKS(backoffMs));
+    }
 
-        return bytesRead; // Return the actual number of bytes read
+    /**
+     * @brief Handles the end of a listening, RX window or backoff period.
+     */
+    void handleStateTimeout()
+    {
+        switch (state)
+        {
+        case RadioState::Listening:
+            startCad(RadioState::Sniffing);
+            break;
+        case RadioState::RxWindow:
+            if (!rxWindowExtended && (readRegister(REG_MODEM_STAT) & MODEM_STAT_PACKET) != 0)
+            {
+                // A header came in: wait for the longest packet it can announce
+                rxWindowExtended = true;
+                enterState(RadioState::RxWindow, pdMS_TO_TICKS(timeOnAirMs(255)) + 1);
+                break;
+            }
+            if (!rxWindowExtended)
+            {
+                linkStats.count(LinkCounter::SniffFalseWake);
+            }
+            listen();
+            break;
+        case RadioState::Backoff:
+            state = RadioState::Listening; // The radio stays in RX, startNextTx() checks the channel again
+            break;
+        default:
+            break;
+        }
     }
 
     /**
-     * @brief Gets the received signal strength indicator (RSSI) of the last packet.
-     * @return The RSSI value.
+     * @brief Takes the next frame from the TX queue, unless one is held, and
+     * checks the channel for it or puts it on air.
+     * @return True if there was a frame (check state for whether it is on its way).
      */
-    int getPacketRssi()
+    bool startNextTx()
     {
-        return LoRa.packetRssi();
+        if (txRecordLen == 0)
+        {
+            txRecordLen = xMessageBufferReceive(txQueue, txRecord, sizeof(txRecord), 0);
+            if (txRecordLen <= TX_STAMP_SIZE)
+            {
+                txRecordLen = 0;
+                return false;
+            }
+            lbtAttempts = 0;
+        }
+
+        if constexpr (LORA_LBT_ENABLED)
+        {
+            if (lbtAttempts < LORA_LBT_MAX_ATTEMPTS)
+            {
+                lbtAttempts++;
+                // In RX the modem already knows about a packet coming in, a CAD would abort it
+                if (!sniffing && (readRegister(REG_MODEM_STAT) & MODEM_STAT_BUSY) != 0)
+                {
+                    backoff();
+                }
+                else
+                {
+                    startCad(RadioState::ChannelCheck);
+                }
+                return true;
+            }
+            if (lbtAttempts > 0)
+            {
+                LOG_WARN(LoRaChannelBusyTx, lbtAttempts);
+            }
+        }
+        transmitHeld();
+        return true;
     }
 
     /**
-     * @brief Gets the signal-to-noise ratio (SNR) of the last packet.
-     * @return The SNR value.
+     * @brief Puts the held frame on air.
      */
-    float getPacketSnr()
+    void transmitHeld()
     {
-        return LoRa.packetSnr();
+        uint32_t queuedUs;
+        memcpy(&queuedUs, txRecord, TX_STAMP_SIZE);
+        const uint8_t *frame = txRecord + TX_STAMP_SIZE;
+        size_t len = txRecordLen - TX_STAMP_SIZE;
+        txRecordLen = 0; // Not refilled before the frame is written to the radio
+
+        if (txStartCallback)
+        {
+            txStartCallback();
+        }
+
+        if (!LoRa.beginPacket()) // Idles the radio, aborting any reception in progress
+        {
+            finishTx(false);
+            return;
+        }
+        LoRa.write(frame, len);
+        writeRegister(REG_DIO_MAPPING_1, DIO0_TX_DONE);
+        enterState(RadioState::Transmitting, pdMS_TO_TICKS(txTimeoutMs(len)));
+        LoRa.endPacket(true); // Async: returns once the radio is in TX mode
+        txStartUs = STATS_CLOCK_US();
+        linkStats.record(LinkStage::TxQueued, txStartUs - queuedUs);
     }
 
     /**
-     * @brief Gets the RSSI (Received Signal Strength Indicator) of the last received packet.
-     * @return RSSI value in dBm.
+     * @brief Completes the transmission on TxDone, or once its timeout (txTimeoutMs()) expired.
      */
-    int getRssi()
+    void handleTxDone()
     {
-        return LoRa.packetRssi();
+        uint8_t irqFlags = readRegister(REG_IRQ_FLAGS);
+        bool done = (irqFlags & IRQ_TX_DONE_MASK) != 0;
+        if (!done && waitTicks() > 0)
+        {
+            return; // Spurious wake-up, keep waiting
+        }
+
+        writeRegister(REG_IRQ_FLAGS, irqFlags); // Clear (write-1-to-clear)
+        if (done)
+        {
+            // The TxDone edge, or now if it was missed
+            uint32_t doneUs = dio0Stamped ? dio0Us : STATS_CLOCK_US();
+            dio0Stamped = false;
+            linkStats.record(LinkStage::TxAir, doneUs - txStartUs);
+        }
+        else
+        {
+            LOG_WARN(LoRaTxTimeout);
+        }
+        finishTx(done);
     }
 
     /**
-     * @brief Gets the SNR (Signal-to-Noise Ratio) of the last received packet.
-     * @return SNR value in dB.
+     * @brief Goes back to listening (DIO0 => RxDone) and reports the TX result.
      */
-    float getSnr()
+    void finishTx(bool success)
     {
-        return LoRa.packetSnr();
+        listen();
+        lastTxSuccess = success;
+        txPending--;
+
+        if (txDoneCallback)
+        {
+            txDoneCallback(success);
+        }
     }
 
     /**
-     * @brief Returns a string with the current LoRa configuration.
-     * @return Configuration string.
+     * @brief Reads and clears the IRQ flags, then drains a received packet.
+     * Runs in the radio task, never in interrupt context.
+     * Corrupt frames are dropped here, before the FIFO is read or anyone is woken,
+     * and so are frames the RX filter rejects from their first bytes.
+     * @return True if the radio reported RxDone, whatever became of the packet.
      */
-    String getConfigurationString() const
+    bool handleRxDone()
+    {
+        uint32_t startUs = STATS_CLOCK_US();
+        if (dio0Stamped) // Not when woken by serviceIrq()
+        {
+            dio0Stamped = false;
+            linkStats.record(LinkStage::RxWake, startUs - dio0Us);
+        }
+
+        uint8_t irqFlags = readRegister(REG_IRQ_FLAGS);
+        writeRegister(REG_IRQ_FLAGS, irqFlags); // Clear (write-1-to-clear)
+
+        if ((irqFlags & IRQ_RX_DONE_MASK) == 0)
+        {
+            return false;
+        }
+
+        // The radio only checks the CRC if the packet header announces one, so
+        // with CRC required a header without it (noise, or a peer with CRC off) is dropped too
+        bool crcMissing = Profile::crcEnabled && (readRegister(REG_HOP_CHANNEL) & HOP_CHANNEL_CRC_ON_PAYLOAD) == 0;
+        if ((irqFlags & IRQ_PAYLOAD_CRC_ERROR_MASK) != 0 || crcMissing)
+        {
+            rxCrcErrors++;
+            return true;
+        }
+
+        LoRaPacket packet;
+        packet.len = readRegister(REG_RX_NB_BYTES);
+        if (packet.len == 0)
+        {
+            return true;
+        }
+        writeRegister(REG_FIFO_ADDR_PTR, readRegister(REG_FIFO_RX_CURRENT_ADDR));
+
+        // Header first: a packet that is not for us costs a few bytes of SPI and wakes nobody
+        size_t headerLen = packet.len < static_cast<int>(RX_HEADER_BYTES) ? packet.len : RX_HEADER_BYTES;
+        readFifo(packet.buffer, headerLen);
+        if (rxFilter && !rxFilter(packet.buffer, headerLen, packet.len))
+        {
+            rxFiltered++;
+            return true;
+        }
+        if (packet.len > static_cast<int>(headerLen))
+        {
+            readFifo(packet.buffer + headerLen, packet.len - headerLen); // The FIFO pointer moved on
+        }
+        packet.rssi = LoRa.packetRssi();
+        packet.snr = LoRa.packetSnr();
+        packet.timestampUs = STATS_CLOCK_US();
+
+        if (!rxRing->push(packet))
+        {
+            return true; // Ring full - counted by the ring
+        }
+        linkStats.record(LinkStage::RxRead, packet.timestampUs - startUs);
+
+        if (rxCallback)
+        {
+            rxCallback();
+        }
+        return true;
+    }
+
+    uint8_t readRegister(uint8_t address)
     {
-        String config = "LoRa Configuration:\n";
-        config += "  Frequency: " + String(frequency / 1000000.0, 2) + " MHz\n";
-        config += "  Bandwidth: " + String(LORA_BANDWIDTH / 1000.0, 1) + " kHz\n";
-        config += "  Spreading Factor: " + String(LORA_SPREADING_FACTOR) + "\n";
-        config += "  Coding Rate: 4/" + String(LORA_CODING_RATE) + "\n";
-        config += "  TX Power: " + String(LORA_TX_POWER) + " dBm\n";
-        return config;
+        SPI.beginTransaction(SPISettings(LORA_DEFAULT_SPI_FREQUENCY, MSBFIRST, SPI_MODE0));
+        digitalWrite(Profile::ssPin, LOW);
+        SPI.transfer(address & 0x7F);
+        uint8_t value = SPI.transfer(0x00);
+        digitalWrite(Profile::ssPin, HIGH);
+        SPI.endTransaction();
+        return value;
     }
 
-private:
-    int sckPin;
-    int misoPin;
-    int mosiPin;
-    int ssPin;
-    int rstPin;
-    int dio0Pin;
-    long frequency;
+    void writeRegister(uint8_t address, uint8_t value)
+    {
+        SPI.beginTransaction(SPISettings(LORA_DEFAULT_SPI_FREQUENCY, MSBFIRST, SPI_MODE0));
+        digitalWrite(Profile::ssPin, LOW);
+        SPI.transfer(address | 0x80);
+        SPI.transfer(value);
+        digitalWrite(Profile::ssPin, HIGH);
+        SPI.endTransaction();
+    }
+
+    /**
+     * @brief Burst-reads len bytes from the FIFO in a single SPI transaction.
+     */
+    void readFifo(uint8_t *buffer, size_t len)
+    {
+        SPI.beginTransaction(SPISettings(LORA_DEFAULT_SPI_FREQUENCY, MSBFIRST, SPI_MODE0));
+        digitalWrite(Profile::ssPin, LOW);
+        SPI.transfer(REG_FIFO & 0x7F);
+        for (size_t i = 0; i < len; i++)
+        {
+            buffer[i] = SPI.transfer(0x00);
+        }
+        digitalWrite(Profile::ssPin, HIGH);
+        SPI.endTransaction();
+    }
 };
 
 #endif // LORA_MANAGER_H
\ No newline at end of file
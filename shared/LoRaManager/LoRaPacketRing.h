@@ -0,0 +1,146 @@
+#ifndef LORA_PACKET_RING_H
+#define LORA_PACKET_RING_H
+
+#include <Arduino.h>
+#include <freertos/FreeRTOS.h>
+#include <freertos/message_buffer.h>
+
+/**
+ * @brief RX ring capacity in bytes (override with -DLORA_RX_RING_BYTES=...).
+ * Each packet costs its payload plus RECORD_OVERHEAD bytes, so 2 KB holds ~32
+ * maximum-size protocol frames (50 bytes) - the old 15-slot queue used ~4 KB.
+ */
+#ifndef LORA_RX_RING_BYTES
+#define LORA_RX_RING_BYTES 2048
+#endif
+
+/// Received LoRa packet with link metadata, filled by the radio task
+struct LoRaPacket
+{
+    uint8_t buffer[256];
+    int len;
+    int rssi;
+    float snr;
+    uint32_t timestampUs; // STATS_CLOCK_US() when the FIFO was drained
+};
+
+/**
+ * @brief Variable-length ring of received LoRa packets
+ *
+ * Backed by a FreeRTOS message buffer. Records are packed as
+ * [timestampUs:4][rssi:2][snr*4:2][payload:len], so only the bytes actually
+ * received are stored. Readers and writers still exchange LoRaPacket structs.
+ *
+ * Single writer (radio task) and single reader, as required by message buffers.
+ */
+class LoRaPacketRing
+{
+public:
+    /// Per-record cost: packed metadata + message buffer length prefix
+    static const size_t RECORD_OVERHEAD = 8 + sizeof(size_t);
+
+    explicit LoRaPacketRing(size_t capacityBytes = LORA_RX_RING_BYTES)
+        : capacity(capacityBytes), handle(nullptr), dropped(0) {}
+
+    /**
+     * @brief Allocates the ring storage.
+     * @return True if the message buffer was created.
+     */
+    bool begin()
+    {
+        handle = xMessageBufferCreate(capacity);
+        return handle != nullptr;
+    }
+
+    /**
+     * @brief Appends a packet (writer side, never blocks).
+     * @return True if stored, false if there was not enough free space.
+     */
+    bool push(const LoRaPacket &packet)
+    {
+        if (packet.len <= 0 || packet.len > (int)sizeof(packet.buffer))
+        {
+            return false;
+        }
+
+        uint8_t record[HEADER_SIZE + sizeof(packet.buffer)];
+        RecordHeader header;
+        header.timestampUs = packet.timestampUs;
+        header.rssi = packet.rssi;
+        header.snrQuarterDb = (int16_t)(packet.snr * 4); // SX127x SNR resolution is 0.25 dB
+        memcpy(record, &header, HEADER_SIZE);
+        memcpy(record + HEADER_SIZE, packet.buffer, packet.len);
+
+        if (xMessageBufferSend(handle, record, HEADER_SIZE + packet.len, 0) == 0)
+        {
+            dropped++;
+            return false;
+        }
+        return true;
+    }
+
+    /**
+     * @brief Removes the oldest packet (reader side).
+     * @param packet Destination, unpacked into the usual LoRaPacket layout.
+     * @param wait Ticks to block while the ring is empty.
+     * @return True if a packet was retrieved.
+     */
+    bool pop(LoRaPacket &packet, TickType_t wait = 0)
+    {
+        uint8_t record[HEADER_SIZE + sizeof(packet.buffer)];
+        size_t size = xMessageBufferReceive(handle, record, sizeof(record), wait);
+        if (size < HEADER_SIZE)
+        {
+            return false;
+        }
+
+        RecordHeader header;
+        memcpy(&header, record, HEADER_SIZE);
+        packet.timestampUs = header.timestampUs;
+        packet.rssi = header.rssi;
+        packet.snr = header.snrQuarterDb / 4.0f;
+        packet.len = size - HEADER_SIZE;
+        memcpy(packet.buffer, record + HEADER_SIZE, packet.len);
+        return true;
+    }
+
+    /**
+     * @brief Check if the ring holds no packets.
+     */
+    bool isEmpty() const
+    {
+        return handle == nullptr || xMessageBufferIsEmpty(handle) == pdTRUE;
+    }
+
+    /**
+     * @brief Free space in bytes (a packet needs len + RECORD_OVERHEAD).
+     */
+    size_t freeBytes() const
+    {
+        return handle ? xMessageBufferSpacesAvailable(handle) : 0;
+    }
+
+    /**
+     * @brief Number of packets rejected because the ring was full.
+     */
+    uint32_t getDropped() const
+    {
+        return dropped;
+    }
+
+private:
+    struct __attribute__((packed)) RecordHeader
+    {
+        uint32_t timestampUs;
+        int16_t rssi;
+        int16_t snrQuarterDb;
+    };
+    static const size_t HEADER_SIZE = sizeof(RecordHeader);
+    static_assert(HEADER_SIZE == 8, "RecordHeader must stay packed");
+
+    size_t capacity;
+    MessageBufferHandle_t handle;
+    uint32_t dropped; // Written by the producer only
+};
+
+#endif // LORA_PACKET_RING_H
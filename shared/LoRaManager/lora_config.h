@@ -36,4 +36,121 @@
  */
 #define LORA_TX_POWER 20 // dBm
 
+/**
+ * @brief LoRa preamble length in symbols (LoRa library default).
+ */
+#define LORA_PREAMBLE_LENGTH 8
+
+/**
+ * @brief Payload CRC on (1) or off (0).
+ * Off saves 16 bits per packet; the protocol validates frame structure itself.
+ * On (-DLORA_CRC_ENABLED=1), the radio task drops frames with a bad CRC, and
+ * frames sent without one, before they reach the RX ring. Both ends of a link
+ * must use the same setting.
+ */
+#ifndef LORA_CRC_ENABLED
+#define LORA_CRC_ENABLED 0
+#endif
+
+/**
+ * @brief Listen-before-talk on (1) or off (0).
+ * On, the radio task runs a Channel Activity Detection before every frame
+ * and backs off for a random number of slots while it finds a preamble on
+ * air, so two nodes answering at once collide less often.
+ */
+#ifndef LORA_LBT_ENABLED
+#define LORA_LBT_ENABLED 1
+#endif
+
+/**
+ * @brief Channel checks per frame before it is sent on a busy channel anyway.
+ */
+#ifndef LORA_LBT_MAX_ATTEMPTS
+#define LORA_LBT_MAX_ATTEMPTS 5
+#endif
+
+/**
+ * @brief RX sniff period in ms, 0 = continuous RX.
+ * Non-zero, every frame is sent with a preamble long enough to span one
+ * period (see lora_link_preamble_symbols()), so a node that enables sniffing
+ * can sleep the radio and only wake it for a CAD once per period. Both ends
+ * of a link must use the same setting. Costs about one period of extra time
+ * on air per packet.
+ */
+#ifndef LORA_RX_SNIFF_MS
+#define LORA_RX_SNIFF_MS 0
+#endif
+
+/**
+ * @brief Duty-cycle limit in permille of LORA_DUTY_CYCLE_WINDOW_MS.
+ * 10 = 1% (EU/Switzerland, 36 s per hour). The bridge's TX scheduler never
+ * exceeds it; raise it (e.g. -DLORA_DUTY_CYCLE_PERMILLE=100 for 10%) only
+ * where the band plan allows.
+ */
+#ifndef LORA_DUTY_CYCLE_PERMILLE
+#define LORA_DUTY_CYCLE_PERMILLE 10
+#endif
+
+/**
+ * @brief Observation window for the duty-cycle limit (1 hour).
+ */
+#ifndef LORA_DUTY_CYCLE_WINDOW_MS
+#define LORA_DUTY_CYCLE_WINDOW_MS 3600000UL
+#endif
+
+/**
+ * @brief Size budget for aggregate frames (type 0x03), in payload bytes.
+ * Queued ACKs/texts are packed into one packet up to this size so the preamble
+ * and header are sent once. Larger values mean fewer but longer packets.
+ */
+#ifndef LORA_AGGREGATE_MAX_BYTES
+#define LORA_AGGREGATE_MAX_BYTES 64
+#endif
+
+/**
+ * @brief Airtime budget for packets carrying the fragments of a long message, in ms.
+ * Fragments fill a packet beyond LORA_AGGREGATE_MAX_BYTES, up to the 255-byte
+ * LoRa maximum, while it stays this short on air at the current data rate
+ * (17 s: a 200-character text with position in one packet at SF11). 0 packs
+ * them like texts.
+ */
+#ifndef LORA_FRAGMENT_MAX_AIRTIME_MS
+#define LORA_FRAGMENT_MAX_AIRTIME_MS 17000
+#endif
+
+/**
+ * @brief Multi-hop relay (managed flooding) on (1) or off (0).
+ * On, every packet goes out behind a 4-byte relay header (origin, TTL, packet
+ * id) and the bridge rebroadcasts the relayed packets it hears for the first
+ * time, see shared/Relay. All bridges of a deployment must use the same setting;
+ * the debugger understands both.
+ */
+#ifndef LORA_RELAY_ENABLED
+#define LORA_RELAY_ENABLED 0
+#endif
+
+/**
+ * @brief Rebroadcasts a packet may still take after it was first sent (relay mode).
+ */
+#ifndef LORA_RELAY_TTL
+#define LORA_RELAY_TTL 3
+#endif
+
+/**
+ * @brief Relay origin id of this node, 0 = the last byte of its MAC address
+ * (printed at boot). Must be unique within a deployment.
+ */
+#ifndef LORA_NODE_ID
+#define LORA_NODE_ID 0
+#endif
+
+/**
+ * @brief Origin id of the far-end bridge whose relayed packets this bridge
+ * delivers to its app and acknowledges. -1: relay only, nothing is delivered.
+ * Packets of every other origin are only rebroadcast.
+ */
+#ifndef LORA_RELAY_PEER
+#define LORA_RELAY_PEER -1
+#endif
+
 #endif // LORA_CONFIG_H
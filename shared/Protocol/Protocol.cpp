@@ -1,18 +1,221 @@
 #include "Protocol.h"
 
+namespace
+{
+    /// Marker for bytes that are not part of CHARSET (bit 6 set, never a valid 6-bit value)
+    const uint8_t INVALID_6BIT = 0xFF;
+
+    /// Reverse lookup table: byte value -> 6-bit code
+    struct SixBitTable
+    {
+        uint8_t values[256];
+    };
+
+    /// Builds the reverse table at compile time from CHARSET
+    /// Lowercase a-z map to the code of their uppercase letter (same result as toupper)
+    constexpr SixBitTable makeSixBitTable()
+    {
+        SixBitTable table{};
+        for (int i = 0; i < 256; i++)
+        {
+            table.values[i] = INVALID_6BIT;
+        }
+        for (int i = 0; i < 64; i++)
+        {
+            uint8_t ch = static_cast<uint8_t>(CHARSET[i]);
+            table.values[ch] = static_cast<uint8_t>(i);
+            if (ch >= 'A' && ch <= 'Z')
+            {
+                table.values[ch - 'A' + 'a'] = static_cast<uint8_t>(i);
+            }
+        }
+        return table;
+    }
+
+    constexpr SixBitTable SIXBIT_TABLE = makeSixBitTable();
+
+    static_assert(SIXBIT_TABLE.values[' '] == 0, "space must encode as 0");
+    static_assert(SIXBIT_TABLE.values['a'] == SIXBIT_TABLE.values['A'], "lowercase must fold to uppercase");
+    static_assert(SIXBIT_TABLE.values['_'] == 63, "CHARSET must have 64 entries");
+    static_assert(SIXBIT_TABLE.values['~'] == INVALID_6BIT, "characters outside CHARSET must be rejected");
+
+    inline uint8_t lookup6bit(char ch)
+    {
+        return SIXBIT_TABLE.values[static_cast<uint8_t>(ch)];
+    }
+
+    /// Static Huffman code: length in bits of the code for each 6-bit value.
+    /// Built from letter frequencies of English with space as the most common
+    /// character, digits at 7 bits and rare punctuation at 12. Must stay
+    /// identical to HUFFMAN_CODE_LENGTHS in Protocol.java.
+    constexpr uint8_t HUFFMAN_CODE_LENGTHS[64] = {
+        3, 4, 7, 6, 5, 3, 6, 6, 5, 4, 10, 8, 5, 6, 4, 4,        // ' ' A-O
+        6, 11, 5, 4, 4, 6, 7, 6, 10, 6, 12,                     // P-Z
+        7, 7, 7, 7, 7, 7, 7, 7, 7, 7,                           // 0-9
+        7, 8, 10, 9, 9, 10, 12, 11, 12, 12, 12, 12, 12, 12, 12, // . , ! ? - : ; ' " @ # $ % & *
+        12, 12, 12, 12, 12, 12, 12, 12, 9, 12, 12, 12};         // ( ) [ ] { } = + / < > _
+
+    const uint8_t HUFFMAN_MAX_BITS = 12;
+    const uint8_t HUFFMAN_FAST_BITS = 8;
+
+    /// Canonical code tables: codes are assigned in order of (length, 6-bit value),
+    /// so the lengths alone define the code
+    struct HuffmanTable
+    {
+        uint16_t codes[64];                       // Code per 6-bit value, right-aligned
+        uint16_t firstCode[HUFFMAN_MAX_BITS + 1]; // Code of the first symbol of each length
+        uint8_t count[HUFFMAN_MAX_BITS + 1];      // Symbols per length
+        uint8_t offset[HUFFMAN_MAX_BITS + 1];     // Index into symbols of the first symbol of each length
+        uint8_t symbols[64];                      // 6-bit values ordered by (length, value)
+        uint16_t fast[1 << HUFFMAN_FAST_BITS];    // Next 8 bits -> (length << 8) | value, 0 for longer codes
+    };
+
+    constexpr HuffmanTable makeHuffmanTable()
+    {
+        HuffmanTable table{};
+        uint16_t code = 0;
+        uint8_t index = 0;
+        for (uint8_t len = 1; len <= HUFFMAN_MAX_BITS; len++)
+        {
+            table.firstCode[len] = code;
+            table.offset[len] = index;
+            for (uint8_t value = 0; value < 64; value++)
+            {
+                if (HUFFMAN_CODE_LENGTHS[value] == len)
+                {
+                    table.codes[value] = code++;
+                    table.symbols[index++] = value;
+                    table.count[len]++;
+                }
+            }
+            code <<= 1;
+        }
+
+        for (uint8_t value = 0; value < 64; value++)
+        {
+            uint8_t len = HUFFMAN_CODE_LENGTHS[value];
+            if (len <= HUFFMAN_FAST_BITS)
+            {
+                uint16_t first = table.codes[value] << (HUFFMAN_FAST_BITS - len);
+                for (uint16_t k = 0; k < (1u << (HUFFMAN_FAST_BITS - len)); k++)
+                {
+                    table.fast[first + k] = static_cast<uint16_t>((len << 8) | value);
+                }
+            }
+        }
+        return table;
+    }
+
+    /// Kraft sum scaled by 2^HUFFMAN_MAX_BITS: exactly 2^HUFFMAN_MAX_BITS for a complete prefix code
+    constexpr uint32_t huffmanKraftSum()
+    {
+        uint32_t sum = 0;
+        for (uint8_t len : HUFFMAN_CODE_LENGTHS)
+        {
+            sum += 1u << (HUFFMAN_MAX_BITS - len);
+        }
+        return sum;
+    }
+
+    constexpr HuffmanTable HUFFMAN_TABLE = makeHuffmanTable();
+
+    static_assert(huffmanKraftSum() == (1u << HUFFMAN_MAX_BITS), "Huffman code must be complete and prefix-free");
+    static_assert(HUFFMAN_TABLE.codes[0] == 0, "space must get the first canonical code");
+
+    /// Decodes charCount Huffman coded characters, MSB first.
+    /// output may be null to only check that packed holds enough bits.
+    bool decodeHuffman(const uint8_t *packed, size_t packedLen, uint8_t charCount, char *output)
+    {
+        const size_t totalBits = packedLen * 8;
+        size_t bitPos = 0;
+
+        for (uint8_t i = 0; i < charCount; i++)
+        {
+            // Next 16 bits (at least one full code), zero padded past the end
+            size_t byte = bitPos >> 3;
+            uint32_t window = 0;
+            for (size_t k = 0; k < 3; k++)
+            {
+                window = (window << 8) | (byte + k < packedLen ? packed[byte + k] : 0);
+            }
+            uint32_t peek = (window >> (8 - (bitPos & 7))) & 0xFFFF;
+
+            // Codes up to 8 bits in one lookup, longer ones by canonical order
+            uint16_t entry = HUFFMAN_TABLE.fast[peek >> (16 - HUFFMAN_FAST_BITS)];
+            uint8_t len = entry >> 8;
+            uint8_t value = entry & 0x3F;
+            if (len == 0)
+            {
+                for (len = HUFFMAN_FAST_BITS + 1; len <= HUFFMAN_MAX_BITS; len++)
+                {
+                    uint16_t index = static_cast<uint16_t>((peek >> (16 - len)) - HUFFMAN_TABLE.firstCode[len]);
+                    if (index < HUFFMAN_TABLE.count[len])
+                    {
+                        value = HUFFMAN_TABLE.symbols[HUFFMAN_TABLE.offset[len] + index];
+                        break;
+                    }
+                }
+                if (len > HUFFMAN_MAX_BITS)
+                {
+                    return false; // Not reached for a complete code
+                }
+            }
+
+            bitPos += len;
+            if (bitPos > totalBits)
+            {
+                return false; // Insufficient packed data
+            }
+            if (output)
+            {
+                output[i] = CHARSET[value];
+            }
+        }
+        return true;
+    }
+
+    /// Size of the coordinates field of a Text frame starting at buf, -1 if it is truncated
+    int gpsFieldSize(GpsEncoding encoding, const uint8_t *buf, size_t len)
+    {
+        switch (encoding)
+        {
+        case GpsEncoding::None:
+            return 0;
+
+        case GpsEncoding::Absolute:
+        case GpsEncoding::Keyframe:
+            return len >= GPS_ABSOLUTE_SIZE ? static_cast<int>(GPS_ABSOLUTE_SIZE) : -1;
+
+        case GpsEncoding::Delta:
+        {
+            uint32_t value;
+            int latSize = read_varint(buf, len, value);
+            if (latSize < 0)
+            {
+                return -1;
+            }
+            int lonSize = read_varint(buf + latSize, len - latSize, value);
+            if (lonSize < 0 || static_cast<size_t>(latSize + lonSize) > GPS_ABSOLUTE_SIZE)
+            {
+                return -1; // Truncated, or longer than Absolute coordinates (MAX_FRAME_SIZE still holds)
+            }
+            return latSize + lonSize;
+        }
+        }
+        return -1;
+    }
+}
+
 /// Convert a character to its 6-bit encoded value
 /// Automatically converts lowercase to uppercase
 int char_to_6bit(char ch)
 {
-    char upper_ch = toupper(ch);
-    for (int i = 0; i < 64; i++)
+    uint8_t value = lookup6bit(ch);
+    if (value == INVALID_6BIT)
     {
-        if (CHARSET[i] == upper_ch)
-        {
-            return i;
-        }
+        return -1; // Character not in supported charset
     }
-    return -1; // Character not in supported charset
+    return value;
 }
 
 /// Convert a 6-bit value back to a character
@@ -25,10 +228,13 @@ char sixbit_to_char(uint8_t val)
     return '?'; // Invalid value
 }
 
-/// Pack text into 6-bit encoded bytes using manual bit manipulation
-/// Each character is encoded as 6 bits instead of 8 bits (UTF-8)
+/// Pack text into 6-bit encoded bytes
+/// Each character is encoded as 6 bits instead of 8 bits (UTF-8), MSB first
 /// Lowercase letters are automatically converted to uppercase
 /// 50 chars × 6 bits = 300 bits = 37.5 bytes → 38 bytes
+///
+/// Works on groups of 4 characters = 24 bits = 3 bytes. Invalid characters are
+/// collected in a single flag and checked once at the end, so the inner loop is branch-free.
 int pack_text(const char *text, uint8_t *output, size_t maxLen)
 {
     size_t charCount = strlen(text);
@@ -41,49 +247,55 @@ int pack_text(const char *text, uint8_t *output, size_t maxLen)
         return -1; // Buffer too small
     }
 
-    // Initialize output buffer to zero
-    memset(output, 0, byteCount);
+    uint8_t invalid = 0;
+    size_t i = 0;
+    uint8_t *out = output;
 
-    size_t bitOffset = 0;
+    // Full groups: 4 characters -> 3 bytes
+    for (; i + 4 <= charCount; i += 4, out += 3)
+    {
+        uint8_t a = lookup6bit(text[i]);
+        uint8_t b = lookup6bit(text[i + 1]);
+        uint8_t c = lookup6bit(text[i + 2]);
+        uint8_t d = lookup6bit(text[i + 3]);
+        invalid |= a | b | c | d;
+
+        uint32_t word = (static_cast<uint32_t>(a) << 18) | (static_cast<uint32_t>(b) << 12) |
+                        (static_cast<uint32_t>(c) << 6) | d;
+        out[0] = static_cast<uint8_t>(word >> 16);
+        out[1] = static_cast<uint8_t>(word >> 8);
+        out[2] = static_cast<uint8_t>(word);
+    }
 
-    for (size_t i = 0; i < charCount; i++)
+    // Tail: 1-3 remaining characters -> 1-3 bytes, unused low bits stay zero
+    size_t remaining = charCount - i;
+    if (remaining > 0)
     {
-        int value = char_to_6bit(text[i]);
-        if (value < 0)
+        uint32_t word = 0;
+        for (size_t k = 0; k < remaining; k++)
         {
-            return -1; // Invalid character
+            uint8_t value = lookup6bit(text[i + k]);
+            invalid |= value;
+            word |= static_cast<uint32_t>(value) << (18 - 6 * k);
         }
 
-        // Calculate which byte(s) this 6-bit value spans
-        size_t byteIdx = bitOffset / 8;
-        size_t bitInByte = bitOffset % 8;
-
-        if (bitInByte <= 2)
+        size_t tailBytes = byteCount - static_cast<size_t>(out - output);
+        for (size_t k = 0; k < tailBytes; k++)
         {
-            // The 6 bits fit within the current byte
-            output[byteIdx] |= (value << (2 - bitInByte));
-        }
-        else
-        {
-            // The 6 bits span two bytes
-            size_t bitsInFirst = 8 - bitInByte;
-            size_t bitsInSecond = 6 - bitsInFirst;
-
-            output[byteIdx] |= (value >> bitsInSecond);
-            if (byteIdx + 1 < byteCount)
-            {
-                output[byteIdx + 1] |= (value << (8 - bitsInSecond));
-            }
+            out[k] = static_cast<uint8_t>(word >> (16 - 8 * k));
         }
+    }
 
-        bitOffset += 6;
+    if (invalid & 0x40)
+    {
+        return -1; // Invalid character
     }
 
     return byteCount;
 }
 
-/// Unpack 6-bit encoded bytes back to text using manual bit manipulation
-/// Reads 6 bits at a time and converts to characters (uppercase)
+/// Unpack 6-bit encoded bytes back to text
+/// Reads 3 bytes at a time and emits 4 characters (uppercase)
 bool unpack_text(const uint8_t *packed, size_t packedLen, uint8_t charCount, char *output, size_t maxOutputLen)
 {
     if (charCount >= maxOutputLen)
@@ -91,54 +303,150 @@ bool unpack_text(const uint8_t *packed, size_t packedLen, uint8_t charCount, cha
         return false; // Output buffer too small
     }
 
-    size_t bitOffset = 0;
+    if (packedLen < (static_cast<size_t>(charCount) * 6 + 7) / 8)
+    {
+        return false; // Insufficient packed data
+    }
+
+    size_t i = 0;
+    const uint8_t *in = packed;
 
-    for (uint8_t i = 0; i < charCount; i++)
+    // Full groups: 3 bytes -> 4 characters
+    for (; i + 4 <= charCount; i += 4, in += 3)
     {
-        size_t byteIdx = bitOffset / 8;
-        size_t bitInByte = bitOffset % 8;
+        uint32_t word = (static_cast<uint32_t>(in[0]) << 16) | (static_cast<uint32_t>(in[1]) << 8) | in[2];
+        output[i] = CHARSET[(word >> 18) & 0x3F];
+        output[i + 1] = CHARSET[(word >> 12) & 0x3F];
+        output[i + 2] = CHARSET[(word >> 6) & 0x3F];
+        output[i + 3] = CHARSET[word & 0x3F];
+    }
 
-        if (byteIdx >= packedLen)
+    // Tail: 1-3 remaining characters spread over 1-3 bytes
+    size_t remaining = charCount - i;
+    if (remaining > 0)
+    {
+        uint32_t word = 0;
+        size_t tailBytes = (remaining * 6 + 7) / 8;
+        for (size_t k = 0; k < tailBytes; k++)
         {
-            return false; // Insufficient packed data
+            word |= static_cast<uint32_t>(in[k]) << (16 - 8 * k);
         }
-
-        uint8_t value;
-        if (bitInByte <= 2)
+        for (size_t k = 0; k < remaining; k++)
         {
-            // The 6 bits are within the current byte
-            value = (packed[byteIdx] >> (2 - bitInByte)) & 0x3F;
+            output[i + k] = CHARSET[(word >> (18 - 6 * k)) & 0x3F];
         }
-        else
-        {
-            // The 6 bits span two bytes
-            size_t bitsInFirst = 8 - bitInByte;
-            size_t bitsInSecond = 6 - bitsInFirst;
+    }
 
-            uint8_t firstPart = packed[byteIdx] & ((1 << bitsInFirst) - 1);
-            uint8_t secondPart = 0;
-            if (byteIdx + 1 < packedLen)
-            {
-                secondPart = packed[byteIdx + 1] >> (8 - bitsInSecond);
-            }
-            else
-            {
-                return false; // Insufficient packed data
-            }
+    output[charCount] = '\0'; // Null-terminate
+    return true;
+}
 
-            value = (firstPart << bitsInSecond) | secondPart;
-        }
+/// Number of bytes pack_text_compressed would write for text
+int compressed_text_size(const char *text)
+{
+    uint8_t invalid = 0;
+    size_t bits = 0;
+    for (const char *p = text; *p; p++)
+    {
+        uint8_t value = lookup6bit(*p);
+        invalid |= value;
+        bits += HUFFMAN_CODE_LENGTHS[value & 0x3F];
+    }
+    if (invalid & 0x40)
+    {
+        return -1; // Invalid character
+    }
+    return static_cast<int>((bits + 7) / 8);
+}
 
-        char ch = sixbit_to_char(value);
-        output[i] = ch;
+/// Pack text with the static Huffman code, MSB first, unused low bits of the last byte zero
+int pack_text_compressed(const char *text, uint8_t *output, size_t maxLen)
+{
+    int byteCount = compressed_text_size(text);
+    if (byteCount < 0 || static_cast<size_t>(byteCount) > maxLen)
+    {
+        return -1; // Invalid character or buffer too small
+    }
 
-        bitOffset += 6;
+    uint32_t bits = 0; // Pending bits in the low accBits
+    uint8_t accBits = 0;
+    uint8_t *out = output;
+    for (const char *p = text; *p; p++)
+    {
+        uint8_t value = lookup6bit(*p);
+        bits = (bits << HUFFMAN_CODE_LENGTHS[value]) | HUFFMAN_TABLE.codes[value];
+        accBits += HUFFMAN_CODE_LENGTHS[value];
+        while (accBits >= 8)
+        {
+            accBits -= 8;
+            *out++ = static_cast<uint8_t>(bits >> accBits);
+        }
     }
+    if (accBits > 0)
+    {
+        *out = static_cast<uint8_t>(bits << (8 - accBits));
+    }
+
+    return byteCount;
+}
 
+/// Unpack Huffman coded bytes back to text (uppercase)
+bool unpack_text_compressed(const uint8_t *packed, size_t packedLen, uint8_t charCount, char *output,
+                            size_t maxOutputLen)
+{
+    if (charCount >= maxOutputLen)
+    {
+        return false; // Output buffer too small
+    }
+    if (!decodeHuffman(packed, packedLen, charCount, output))
+    {
+        return false;
+    }
     output[charCount] = '\0'; // Null-terminate
     return true;
 }
 
+size_t varint_size(uint32_t value)
+{
+    size_t size = 1;
+    while (value >= 0x80)
+    {
+        value >>= 7;
+        size++;
+    }
+    return size;
+}
+
+size_t write_varint(uint32_t value, uint8_t *output)
+{
+    size_t i = 0;
+    while (value >= 0x80)
+    {
+        output[i++] = static_cast<uint8_t>(value) | 0x80;
+        value >>= 7;
+    }
+    output[i++] = static_cast<uint8_t>(value);
+    return i;
+}
+
+int read_varint(const uint8_t *input, size_t len, uint32_t &value)
+{
+    value = 0;
+    for (size_t i = 0; i < len && i < VARINT_MAX_SIZE; i++)
+    {
+        if (i == VARINT_MAX_SIZE - 1 && input[i] > 0x0F)
+        {
+            return -1; // More than 32 bits
+        }
+        value |= static_cast<uint32_t>(input[i] & 0x7F) << (7 * i);
+        if ((input[i] & 0x80) == 0)
+        {
+            return static_cast<int>(i + 1);
+        }
+    }
+    return -1; // Truncated
+}
+
 Message Message::createText(uint8_t seq, const char *text)
 {
     Message msg;
@@ -153,6 +461,7 @@ Message Message::createText(uint8_t seq, const char *text)
     memcpy(msg.textData.text, text, len);
     msg.textData.text[len] = '\0';
     msg.textData.hasGps = false;
+    msg.textData.gpsEncoding = GpsEncoding::None;
     msg.textData.lat = 0;
     msg.textData.lon = 0;
     return msg;
@@ -172,6 +481,7 @@ Message Message::createTextWithGps(uint8_t seq, const char *text, int32_t lat, i
     memcpy(msg.textData.text, text, len);
     msg.textData.text[len] = '\0';
     msg.textData.hasGps = true;
+    msg.textData.gpsEncoding = GpsEncoding::Absolute;
     msg.textData.lat = lat;
     msg.textData.lon = lon;
     return msg;
@@ -185,6 +495,48 @@ Message Message::createAck(uint8_t seq)
     return msg;
 }
 
+Message Message::createSelectiveAck(uint8_t cumulative, uint8_t bitmap)
+{
+    Message msg;
+    msg.type = MessageType::SelectiveAck;
+    msg.selectiveAckData.cumulative = cumulative;
+    msg.selectiveAckData.bitmap = bitmap;
+    return msg;
+}
+
+Message Message::createDataRate(DataRateOp op, uint8_t rate)
+{
+    Message msg;
+    msg.type = MessageType::DataRate;
+    msg.dataRateData.op = op;
+    msg.dataRateData.rate = rate;
+    return msg;
+}
+
+Message Message::createFragment(uint8_t seq, uint8_t index, uint8_t last, const uint8_t *data, size_t len)
+{
+    Message msg;
+    msg.type = MessageType::Fragment;
+    msg.fragmentData.seq = seq;
+    msg.fragmentData.index = index;
+    msg.fragmentData.last = last;
+    if (len > FRAGMENT_DATA_SIZE)
+    {
+        len = FRAGMENT_DATA_SIZE; // Truncate if too long
+    }
+    msg.fragmentData.len = len;
+    memcpy(msg.fragmentData.data, data, len);
+    return msg;
+}
+
+/// Checks the index, last index and data length of a fragment: every fragment
+/// but the last one is full, the last one holds at least one byte
+static bool isValidFragment(uint8_t index, uint8_t last, size_t dataLen)
+{
+    return last < FRAGMENT_MAX_COUNT && index <= last && dataLen > 0 && dataLen <= FRAGMENT_DATA_SIZE &&
+           (index == last || dataLen == FRAGMENT_DATA_SIZE);
+}
+
 /// Serializes the message into the provided buffer.
 /// Returns the number of bytes written on success, or -1 on failure.
 int Message::serialize(uint8_t *buf, size_t bufSize) const
@@ -199,20 +551,33 @@ int Message::serialize(uint8_t *buf, size_t bufSize) const
             return -1; // Text too long
         }
 
-        // Pack the text using 6-bit encoding
+        // Huffman coding when it is shorter, else 6-bit packing (digits and punctuation heavy text)
         uint8_t packedText[64];
-        int packedLen = pack_text(textData.text, packedText, sizeof(packedText));
+        int compressedLen = compressed_text_size(textData.text);
+        bool compressed = compressedLen >= 0 && static_cast<size_t>(compressedLen) < (textLen * 6 + 7) / 8;
+        int packedLen = compressed ? pack_text_compressed(textData.text, packedText, sizeof(packedText))
+                                   : pack_text(textData.text, packedText, sizeof(packedText));
         if (packedLen < 0)
         {
             return -1; // Packing failed
         }
 
-        size_t totalSize = 5 + packedLen; // type + seq + charCount + packedLen + hasGps + packed text
+        GpsEncoding gps = GpsEncoding::None;
+        size_t gpsSize = 0;
         if (textData.hasGps)
         {
-            totalSize += 8; // lat + lon
+            gps = textData.gpsEncoding == GpsEncoding::None ? GpsEncoding::Absolute : textData.gpsEncoding;
+            gpsSize = gps == GpsEncoding::Delta
+                          ? varint_size(zigzag_encode(textData.lat)) + varint_size(zigzag_encode(textData.lon))
+                          : GPS_ABSOLUTE_SIZE;
         }
 
+        if (gpsSize > GPS_ABSOLUTE_SIZE)
+        {
+            return -1; // Offsets too far apart for a Delta, send Absolute coordinates
+        }
+
+        size_t totalSize = 4 + packedLen + gpsSize; // type + seq + charCount + gps|packedLen + packed text + GPS
         if (bufSize < totalSize)
         {
             return -1; // Buffer too small
@@ -220,15 +585,20 @@ int Message::serialize(uint8_t *buf, size_t bufSize) const
 
         buf[0] = static_cast<uint8_t>(MessageType::Text);
         buf[1] = textData.seq;
-        buf[2] = textLen;   // Store original character count
-        buf[3] = packedLen; // Store packed byte count
+        buf[2] = textLen | (compressed ? TEXT_COMPRESSED_FLAG : 0); // Original character count + encoding
+        buf[3] = (static_cast<uint8_t>(gps) << TEXT_GPS_SHIFT) | packedLen; // GPS encoding + packed byte count
         memcpy(buf + 4, packedText, packedLen);
-        buf[4 + packedLen] = textData.hasGps ? 1 : 0;
 
-        if (textData.hasGps)
+        uint8_t *gpsField = buf + 4 + packedLen;
+        if (gps == GpsEncoding::Delta)
+        {
+            size_t latSize = write_varint(zigzag_encode(textData.lat), gpsField);
+            write_varint(zigzag_encode(textData.lon), gpsField + latSize);
+        }
+        else if (gps != GpsEncoding::None)
         {
-            memcpy(buf + 5 + packedLen, &textData.lat, 4); // Little-endian
-            memcpy(buf + 9 + packedLen, &textData.lon, 4); // Little-endian
+            memcpy(gpsField, &textData.lat, 4);     // Little-endian
+            memcpy(gpsField + 4, &textData.lon, 4); // Little-endian
         }
 
         return totalSize;
@@ -244,6 +614,54 @@ int Message::serialize(uint8_t *buf, size_t bufSize) const
         buf[1] = ackData.seq;
         return 2;
     }
+
+    case MessageType::SelectiveAck:
+    {
+        if (bufSize < 3)
+        {
+            return -1; // Buffer too small
+        }
+        buf[0] = static_cast<uint8_t>(MessageType::SelectiveAck);
+        buf[1] = selectiveAckData.cumulative;
+        buf[2] = selectiveAckData.bitmap;
+        return 3;
+    }
+
+    case MessageType::DataRate:
+    {
+        if (bufSize < 3)
+        {
+            return -1; // Buffer too small
+        }
+        buf[0] = static_cast<uint8_t>(MessageType::DataRate);
+        buf[1] = static_cast<uint8_t>(dataRateData.op);
+        buf[2] = dataRateData.rate;
+        return 3;
+    }
+
+    case MessageType::Fragment:
+    {
+        if (!isValidFragment(fragmentData.index, fragmentData.last, fragmentData.len))
+        {
+            return -1; // Index or data length out of range
+        }
+        size_t totalSize = FRAGMENT_HEADER_SIZE + fragmentData.len;
+        if (bufSize < totalSize)
+        {
+            return -1; // Buffer too small
+        }
+        buf[0] = static_cast<uint8_t>(MessageType::Fragment);
+        buf[1] = fragmentData.seq;
+        buf[2] = (fragmentData.index << FRAGMENT_INDEX_SHIFT) | fragmentData.last;
+        memcpy(buf + FRAGMENT_HEADER_SIZE, fragmentData.data, fragmentData.len);
+        return totalSize;
+    }
+
+    case MessageType::Aggregate:
+        return -1; // Containers are built with AggregateBuilder
+
+    case MessageType::Relay:
+        return -1; // Wraps whole packets, see relay_wrap()
     }
 
     return -1; // Unknown message type
@@ -262,42 +680,56 @@ bool Message::deserialize(const uint8_t *buf, size_t len)
     {
     case 0x01:
     { // Text message
-        if (len < 5)
+        if (len < 4)
         {
             return false; // Buffer too small for text message header
         }
 
         type = MessageType::Text;
         textData.seq = buf[1];
-        uint8_t charCount = buf[2];
-        uint8_t packedLen = buf[3];
+        bool compressed = (buf[2] & TEXT_COMPRESSED_FLAG) != 0;
+        uint8_t charCount = buf[2] & ~TEXT_COMPRESSED_FLAG;
+        GpsEncoding gps = static_cast<GpsEncoding>(buf[3] >> TEXT_GPS_SHIFT);
+        uint8_t packedLen = buf[3] & TEXT_PACKED_LEN_MASK;
 
-        if (len < 5 + packedLen)
+        if (len < 4u + packedLen)
         {
-            return false; // Buffer too small for packed text + hasGps flag
+            return false; // Buffer too small for packed text
         }
 
         const uint8_t *packedBytes = buf + 4;
-        if (!unpack_text(packedBytes, packedLen, charCount, textData.text, sizeof(textData.text)))
+        bool unpacked = compressed
+                            ? unpack_text_compressed(packedBytes, packedLen, charCount, textData.text, sizeof(textData.text))
+                            : unpack_text(packedBytes, packedLen, charCount, textData.text, sizeof(textData.text));
+        if (!unpacked)
         {
             return false;
         }
 
-        textData.hasGps = (buf[4 + packedLen] != 0);
+        const uint8_t *gpsField = buf + 4 + packedLen;
+        size_t gpsLen = len - 4 - packedLen;
+        if (gpsFieldSize(gps, gpsField, gpsLen) < 0)
+        {
+            return false; // Buffer too small for GPS data
+        }
 
-        if (textData.hasGps)
+        textData.hasGps = gps != GpsEncoding::None;
+        textData.gpsEncoding = gps;
+        textData.lat = 0;
+        textData.lon = 0;
+        if (gps == GpsEncoding::Delta)
         {
-            if (len < 5 + packedLen + 8)
-            {
-                return false; // Buffer too small for GPS data
-            }
-            memcpy(&textData.lat, buf + 5 + packedLen, 4); // Little-endian
-            memcpy(&textData.lon, buf + 9 + packedLen, 4); // Little-endian
+            uint32_t latZigzag;
+            uint32_t lonZigzag;
+            int latSize = read_varint(gpsField, gpsLen, latZigzag);
+            read_varint(gpsField + latSize, gpsLen - latSize, lonZigzag);
+            textData.lat = zigzag_decode(latZigzag);
+            textData.lon = zigzag_decode(lonZigzag);
         }
-        else
+        else if (gps != GpsEncoding::None)
         {
-            textData.lat = 0;
-            textData.lon = 0;
+            memcpy(&textData.lat, gpsField, 4);     // Little-endian
+            memcpy(&textData.lon, gpsField + 4, 4); // Little-endian
         }
 
         return true;
@@ -316,7 +748,215 @@ bool Message::deserialize(const uint8_t *buf, size_t len)
         return true;
     }
 
+    case 0x04:
+    { // Selective ACK message
+        if (len < 3)
+        {
+            return false; // Buffer too small for selective ack
+        }
+
+        type = MessageType::SelectiveAck;
+        selectiveAckData.cumulative = buf[1];
+        selectiveAckData.bitmap = buf[2];
+
+        return true;
+    }
+
+    case 0x05:
+    { // Data rate message
+        if (len < 3 || buf[1] > static_cast<uint8_t>(DataRateOp::Accept))
+        {
+            return false; // Buffer too small or unknown operation
+        }
+
+        type = MessageType::DataRate;
+        dataRateData.op = static_cast<DataRateOp>(buf[1]);
+        dataRateData.rate = buf[2];
+
+        return true;
+    }
+
+    case 0x07:
+    { // Fragment message: the data runs to the end of the frame
+        if (len < FRAGMENT_HEADER_SIZE ||
+            !isValidFragment(buf[2] >> FRAGMENT_INDEX_SHIFT, buf[2] & FRAGMENT_LAST_MASK, len - FRAGMENT_HEADER_SIZE))
+        {
+            return false; // Buffer too small, index out of range or wrong data length
+        }
+
+        type = MessageType::Fragment;
+        fragmentData.seq = buf[1];
+        fragmentData.index = buf[2] >> FRAGMENT_INDEX_SHIFT;
+        fragmentData.last = buf[2] & FRAGMENT_LAST_MASK;
+        fragmentData.len = len - FRAGMENT_HEADER_SIZE;
+        memcpy(fragmentData.data, buf + FRAGMENT_HEADER_SIZE, fragmentData.len);
+
+        return true;
+    }
+
+    default:
+        return false; // Unknown message type
+    }
+}
+
+/// Checks that buf holds a well-formed frame using only the header bytes.
+/// Accepts exactly the frames deserialize() accepts, without unpacking the text
+/// (Huffman coded text is walked, not copied, to check that its bits suffice).
+bool Message::isValidFrame(const uint8_t *buf, size_t len)
+{
+    if (len == 0)
+    {
+        return false; // Empty buffer
+    }
+
+    switch (buf[0])
+    {
+    case 0x01:
+    { // Text message
+        if (len < 4)
+        {
+            return false; // Buffer too small for text message header
+        }
+
+        bool compressed = (buf[2] & TEXT_COMPRESSED_FLAG) != 0;
+        uint8_t charCount = buf[2] & ~TEXT_COMPRESSED_FLAG;
+        GpsEncoding gps = static_cast<GpsEncoding>(buf[3] >> TEXT_GPS_SHIFT);
+        uint8_t packedLen = buf[3] & TEXT_PACKED_LEN_MASK;
+
+        if (charCount > MAX_TEXT_LENGTH || (!compressed && packedLen < (charCount * 6 + 7) / 8))
+        {
+            return false; // Text does not fit or packed data is short
+        }
+
+        if (len < 4u + packedLen)
+        {
+            return false; // Buffer too small for packed text
+        }
+
+        if (compressed && !decodeHuffman(buf + 4, packedLen, charCount, nullptr))
+        {
+            return false; // Huffman code runs past the packed data
+        }
+
+        if (gpsFieldSize(gps, buf + 4 + packedLen, len - 4 - packedLen) < 0)
+        {
+            return false; // Buffer too small for GPS data
+        }
+
+        return true;
+    }
+
+    case 0x02: // ACK message
+        return len >= 2;
+
+    case 0x04: // Selective ACK message
+        return len >= 3;
+
+    case 0x05: // Data rate message
+        return len >= 3 && buf[1] <= static_cast<uint8_t>(DataRateOp::Accept);
+
+    case 0x07: // Fragment message
+        return len >= FRAGMENT_HEADER_SIZE &&
+               isValidFragment(buf[2] >> FRAGMENT_INDEX_SHIFT, buf[2] & FRAGMENT_LAST_MASK, len - FRAGMENT_HEADER_SIZE);
+
     default:
         return false; // Unknown message type
     }
 }
+
+AggregateBuilder::AggregateBuilder(uint8_t *buf, size_t capacity)
+    : buf(buf), capacity(capacity < MAX_AGGREGATE_SIZE ? capacity : MAX_AGGREGATE_SIZE), used(0)
+{
+    clear();
+}
+
+void AggregateBuilder::clear()
+{
+    used = 0;
+    if (capacity >= AGGREGATE_HEADER_SIZE)
+    {
+        buf[0] = static_cast<uint8_t>(MessageType::Aggregate);
+        buf[1] = 0;
+        used = AGGREGATE_HEADER_SIZE;
+    }
+}
+
+bool AggregateBuilder::add(const uint8_t *frame, size_t len)
+{
+    if (used < AGGREGATE_HEADER_SIZE || len == 0 || len > MAX_FRAME_SIZE || buf[1] == 0xFF)
+    {
+        return false;
+    }
+    if (!fits(len) || !Message::isValidFrame(frame, len))
+    {
+        return false; // Over budget, or not a valid frame (aggregates never pass)
+    }
+
+    buf[used] = len;
+    memcpy(buf + used + 1, frame, len);
+    used += 1 + len;
+    buf[1]++;
+    return true;
+}
+
+size_t AggregateBuilder::finish(const uint8_t *&frame) const
+{
+    if (used < AGGREGATE_HEADER_SIZE || buf[1] == 0)
+    {
+        return 0;
+    }
+    if (buf[1] == 1)
+    {
+        frame = buf + AGGREGATE_HEADER_SIZE + 1; // Skip the container and the length byte
+        return buf[AGGREGATE_HEADER_SIZE];
+    }
+    frame = buf;
+    return used;
+}
+
+AggregateReader::AggregateReader(const uint8_t *buf, size_t len)
+    : buf(buf), len(len), offset(AGGREGATE_HEADER_SIZE), valid(isValidAggregate(buf, len))
+{
+}
+
+bool AggregateReader::next(const uint8_t *&frame, size_t &frameLen)
+{
+    if (!valid || offset >= len)
+    {
+        return false;
+    }
+    frameLen = buf[offset];
+    frame = buf + offset + 1;
+    offset += 1 + frameLen;
+    return true;
+}
+
+bool AggregateReader::isValidAggregate(const uint8_t *buf, size_t len)
+{
+    if (len < AGGREGATE_HEADER_SIZE || len > MAX_AGGREGATE_SIZE ||
+        buf[0] != static_cast<uint8_t>(MessageType::Aggregate) || buf[1] == 0)
+    {
+        return false; // Too short/long, wrong type or empty container
+    }
+
+    size_t offset = AGGREGATE_HEADER_SIZE;
+    for (uint8_t i = 0; i < buf[1]; i++)
+    {
+        if (offset >= len)
+        {
+            return false; // Fewer frames than count
+        }
+        size_t frameLen = buf[offset];
+        if (frameLen == 0 || frameLen > MAX_FRAME_SIZE || offset + 1 + frameLen > len)
+        {
+            return false; // Bad inner length
+        }
+        if (!Message::isValidFrame(buf + offset + 1, frameLen))
+        {
+            return false; // Malformed or nested inner frame
+        }
+        offset += 1 + frameLen;
+    }
+
+    return offset == len; // No trailing bytes
+}
@@ -1,23 +1,63 @@
 #ifndef PROTOCOL_H
 #define PROTOCOL_H
 
-#include <Arduino.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <string.h>
 
 /// Maximum text length in characters for optimal long-range LoRa transmission.
 /// With 6-bit packing: 50 chars = 38 bytes (was 50 bytes)
-/// With SF10, BW125, 433MHz: 50 bytes (12 header + 38 text) = ~600ms Time on Air
+/// With SF11, BW 31.25 kHz, 433MHz: 50 bytes (text + GPS) = 4932 ms Time on Air
 const uint8_t MAX_TEXT_LENGTH = 50;
 
+/// Maximum serialized size of any message: 50-char text with GPS
+/// 4 header + 38 packed text + 8 GPS = 50 bytes
+/// (Huffman coded text and delta coded GPS are only used when they are shorter)
+const size_t MAX_FRAME_SIZE = 50;
+
+/// Maximum size of an aggregate frame (SX127x FIFO / LoRa payload limit)
+const size_t MAX_AGGREGATE_SIZE = 255;
+
+/// Aggregate header: type + count
+const size_t AGGREGATE_HEADER_SIZE = 2;
+
+/// Fragment header: type + seq + index|last
+const size_t FRAGMENT_HEADER_SIZE = 3;
+
+/// Data bytes of every fragment but the last one, which carries 1 to this many
+const size_t FRAGMENT_DATA_SIZE = MAX_FRAME_SIZE - FRAGMENT_HEADER_SIZE;
+
+/// Most fragments per long message (one ARQ window, so one selective ACK reports them all)
+const uint8_t FRAGMENT_MAX_COUNT = 8;
+
+/// Byte 2 of a Fragment frame: fragment index in bits 7-4, index of the last fragment in bits 3-0
+const uint8_t FRAGMENT_INDEX_SHIFT = 4;
+const uint8_t FRAGMENT_LAST_MASK = 0x0F;
+
 /// Character set for 6-bit encoding (64 characters)
 /// Index maps to 6-bit value: 0-63
 /// UPPERCASE ONLY: Space + A-Z (26) + 0-9 (10) + punctuation (27)
-const char CHARSET[65] = " ABCDEFGHIJKLMNOPQRSTUVWXYZ0123456789.,!?-:;'\"@#$%&*()[]{}=+/<>_";
+constexpr char CHARSET[65] = " ABCDEFGHIJKLMNOPQRSTUVWXYZ0123456789.,!?-:;'\"@#$%&*()[]{}=+/<>_";
 
 /// Message types
 enum class MessageType : uint8_t
 {
     Text = 0x01,
-    Ack = 0x02
+    Ack = 0x02,
+    Aggregate = 0x03,    // Container of other frames, see AggregateBuilder
+    SelectiveAck = 0x04, // Cumulative + bitmap ACK for the link-layer ARQ, see Arq.h
+    DataRate = 0x05,     // Data rate switch request/accept between bridges, see Adr.h
+    Relay = 0x06,        // Routing header in front of a relayed packet, see Relay.h
+    Fragment = 0x07      // Part of a long message, see Fragment.h
+};
+
+/// How the coordinates of a Text frame are encoded (bits 7-6 of byte 3)
+enum class GpsEncoding : uint8_t
+{
+    None = 0,     // No coordinates
+    Absolute = 1, // lat + lon, 4 bytes each, little-endian
+    Keyframe = 2, // As Absolute, and the receiver keeps it as the sender's reference
+    Delta = 3     // Zigzag varint offsets from the sender's reference (at most 8 bytes), see GpsDelta.h
 };
 
 /// Text message with optional GPS coordinates
@@ -26,8 +66,9 @@ struct TextMessage
     uint8_t seq;
     char text[MAX_TEXT_LENGTH + 1]; // Fixed-size buffer for text (null-terminated)
     bool hasGps;                    // Whether GPS coordinates are included
-    int32_t lat;                    // latitude * 1_000_000 (only valid if hasGps=true)
-    int32_t lon;                    // longitude * 1_000_000 (only valid if hasGps=true)
+    GpsEncoding gpsEncoding;        // Absolute from the app; Keyframe/Delta only between bridges
+    int32_t lat;                    // latitude * 1_000_000 (only valid if hasGps=true; offset if Delta)
+    int32_t lon;                    // longitude * 1_000_000 (only valid if hasGps=true; offset if Delta)
 };
 
 /// Acknowledgment message
@@ -36,21 +77,72 @@ struct AckMessage
     uint8_t seq;
 };
 
+/// Selective acknowledgment: every seq up to and including cumulative
+/// (within the ARQ window) plus cumulative+1+i for each set bit i of bitmap
+struct SelectiveAckMessage
+{
+    uint8_t cumulative;
+    uint8_t bitmap;
+};
+
+/// One part of a long message: data holds the payload bytes from
+/// index * FRAGMENT_DATA_SIZE on. The fragments of a message have consecutive seqs, so the first
+/// one's seq (seq - index) identifies the message.
+struct FragmentMessage
+{
+    uint8_t seq;
+    uint8_t index;
+    uint8_t last; // Index of the message's last fragment
+    uint8_t len;  // Bytes in data
+    uint8_t data[FRAGMENT_DATA_SIZE];
+};
+
+/// Data rate negotiation step
+enum class DataRateOp : uint8_t
+{
+    Request = 0x00, // Sender can receive rate, asks the peer to switch
+    Accept = 0x01   // Sender switches to rate right after this frame
+};
+
+/// Data rate switch between bridges: rate indexes the ADR_RATES table (Adr.h)
+struct DataRateMessage
+{
+    DataRateOp op;
+    uint8_t rate;
+};
+
+/// Already-serialized message as it travels on the wire (LoRa payload / BLE value)
+/// Queues and buffers carry frames so forwarded messages are never decoded and re-encoded
+struct WireFrame
+{
+    uint8_t len;
+    uint8_t data[MAX_FRAME_SIZE];
+};
+
 /// Union of all message types
 class Message
 {
 public:
     MessageType type;
 
-    // Store all message data separately (only one will be used based on type)
-    TextMessage textData;
-    AckMessage ackData;
+    // Only one payload is valid at a time, selected by type
+    union
+    {
+        TextMessage textData;
+        AckMessage ackData;
+        SelectiveAckMessage selectiveAckData;
+        DataRateMessage dataRateData;
+        FragmentMessage fragmentData;
+    };
 
     Message() : type(MessageType::Text) {}
 
     static Message createText(uint8_t seq, const char *text);
     static Message createTextWithGps(uint8_t seq, const char *text, int32_t lat, int32_t lon);
     static Message createAck(uint8_t seq);
+    static Message createSelectiveAck(uint8_t cumulative, uint8_t bitmap);
+    static Message createDataRate(DataRateOp op, uint8_t rate);
+    static Message createFragment(uint8_t seq, uint8_t index, uint8_t last, const uint8_t *data, size_t len);
 
     /// Serializes the message into the provided buffer.
     /// Returns the number of bytes written on success, or -1 on failure.
@@ -59,6 +151,80 @@ public:
     /// Deserializes a message from the provided buffer.
     /// Returns true on success, false on failure.
     bool deserialize(const uint8_t *buf, size_t len);
+
+    /// Checks that buf holds a well-formed frame using only the header bytes.
+    /// Accepts exactly the frames deserialize() accepts, without unpacking the text
+    /// (Huffman coded text is walked, not copied, to check that its bits suffice).
+    static bool isValidFrame(const uint8_t *buf, size_t len);
+};
+
+/// Builds an aggregate frame: [0x03][count][len1][frame1]...[lenN][frameN]
+/// Each inner frame is a complete non-aggregate frame of at most MAX_FRAME_SIZE bytes.
+/// Aggregates do not nest. One LoRa packet then carries several messages, so the
+/// preamble and header airtime is paid once.
+class AggregateBuilder
+{
+public:
+    /// buf must stay valid while building. capacity is clamped to MAX_AGGREGATE_SIZE
+    /// and is the budget for the finished container.
+    AggregateBuilder(uint8_t *buf, size_t capacity);
+
+    /// Appends a frame. Returns false if it is not a valid non-aggregate frame
+    /// or if it would exceed the capacity (the builder is left unchanged).
+    bool add(const uint8_t *frame, size_t len);
+
+    /// True if a frame of len bytes would still fit
+    bool fits(size_t len) const { return size() + 1 + len <= capacity; }
+
+    /// Number of frames added so far
+    uint8_t count() const { return buf[1]; }
+
+    /// Container size in bytes (header included)
+    size_t size() const { return used; }
+
+    /// Drops all frames
+    void clear();
+
+    /// Returns the bytes to transmit via frame: the lone inner frame when only
+    /// one was added (no container overhead), otherwise the whole container.
+    /// Returns 0 when empty.
+    size_t finish(const uint8_t *&frame) const;
+
+    /// Bytes a frame of len bytes costs inside an aggregate
+    static size_t cost(size_t len) { return 1 + len; }
+
+private:
+    uint8_t *buf;
+    size_t capacity;
+    size_t used;
+};
+
+/// Walks the inner frames of an aggregate frame.
+/// The whole container is validated on construction, next() only yields frames
+/// from a valid container.
+class AggregateReader
+{
+public:
+    AggregateReader(const uint8_t *buf, size_t len);
+
+    /// True if the container and every inner frame are well-formed
+    bool isValid() const { return valid; }
+
+    /// Number of inner frames
+    uint8_t count() const { return valid ? buf[1] : 0; }
+
+    /// Returns the next inner frame, false when done
+    bool next(const uint8_t *&frame, size_t &frameLen);
+
+    /// Checks an aggregate frame: correct count, exact length, and every inner
+    /// frame passes Message::isValidFrame() and is not itself an aggregate.
+    static bool isValidAggregate(const uint8_t *buf, size_t len);
+
+private:
+    const uint8_t *buf;
+    size_t len;
+    size_t offset;
+    bool valid;
 };
 
 /// Convert a character to its 6-bit encoded value
@@ -76,4 +242,55 @@ int pack_text(const char *text, uint8_t *output, size_t maxLen);
 /// Returns true on success, false on error
 bool unpack_text(const uint8_t *packed, size_t packedLen, uint8_t charCount, char *output, size_t maxOutputLen);
 
+/// Set in the character count byte of a Text frame when the text is Huffman
+/// coded (pack_text_compressed) instead of 6-bit packed
+const uint8_t TEXT_COMPRESSED_FLAG = 0x80;
+
+/// Byte 3 of a Text frame: GpsEncoding in bits 7-6, packed text length in bits 5-0
+const uint8_t TEXT_GPS_SHIFT = 6;
+const uint8_t TEXT_PACKED_LEN_MASK = 0x3F;
+
+/// Size of Absolute and Keyframe coordinates
+const size_t GPS_ABSOLUTE_SIZE = 8;
+
+/// Longest varint of a 32-bit value
+const size_t VARINT_MAX_SIZE = 5;
+
+/// Maps signed offsets to small unsigned values: 0, -1, 1, -2, 2 ... -> 0, 1, 2, 3, 4 ...
+inline uint32_t zigzag_encode(int32_t value)
+{
+    return (static_cast<uint32_t>(value) << 1) ^ (value < 0 ? 0xFFFFFFFFu : 0u);
+}
+
+/// Inverse of zigzag_encode
+inline int32_t zigzag_decode(uint32_t value)
+{
+    return static_cast<int32_t>((value >> 1) ^ (0u - (value & 1)));
+}
+
+/// Bytes of the varint (7 bits per byte, low group first, bit 7 = more follow) for value
+size_t varint_size(uint32_t value);
+
+/// Writes value as a varint, returns the number of bytes written (1-5)
+size_t write_varint(uint32_t value, uint8_t *output);
+
+/// Reads a varint of at most VARINT_MAX_SIZE bytes
+/// Returns the number of bytes read, or -1 if truncated or out of range
+int read_varint(const uint8_t *input, size_t len, uint32_t &value);
+
+/// Number of bytes pack_text_compressed would write for text
+/// Returns -1 if text contains a character outside CHARSET
+int compressed_text_size(const char *text);
+
+/// Pack text with the static Huffman code over CHARSET (3-12 bits per character,
+/// MSB first). Tuned for uppercase English: a typical message needs ~4.6 bits per
+/// character instead of 6. Lowercase letters are converted to uppercase.
+/// Returns the number of bytes written, or -1 on error
+int pack_text_compressed(const char *text, uint8_t *output, size_t maxLen);
+
+/// Unpack Huffman coded bytes back to text (uppercase)
+/// Returns false if packed runs out before charCount characters
+bool unpack_text_compressed(const uint8_t *packed, size_t packedLen, uint8_t charCount, char *output,
+                            size_t maxOutputLen);
+
 #endif // PROTOCOL_H
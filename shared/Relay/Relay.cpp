@@ -0,0 +1,196 @@
+#include "Relay.h"
+
+static_assert(RELAY_HEADER_SIZE + MAX_FRAME_SIZE <= MAX_AGGREGATE_SIZE, "a relayed frame must fit one packet");
+
+size_t relay_wrap(const RelayHeader &header, const uint8_t *packet, size_t len, uint8_t *out)
+{
+    if (len == 0 || len > MAX_AGGREGATE_SIZE - RELAY_HEADER_SIZE)
+    {
+        return 0;
+    }
+    out[0] = static_cast<uint8_t>(MessageType::Relay);
+    out[1] = header.origin;
+    out[2] = header.ttl;
+    out[3] = header.packetId;
+    memmove(out + RELAY_HEADER_SIZE, packet, len);
+    return RELAY_HEADER_SIZE + len;
+}
+
+bool relay_unwrap(const uint8_t *buf, size_t len, RelayHeader &header, const uint8_t *&packet, size_t &packetLen)
+{
+    if (len <= RELAY_HEADER_SIZE || buf[0] != static_cast<uint8_t>(MessageType::Relay))
+    {
+        return false;
+    }
+
+    const uint8_t *inner = buf + RELAY_HEADER_SIZE;
+    size_t innerLen = len - RELAY_HEADER_SIZE;
+    bool valid = inner[0] == static_cast<uint8_t>(MessageType::Aggregate)
+                     ? AggregateReader::isValidAggregate(inner, innerLen)
+                     : Message::isValidFrame(inner, innerLen); // Relay headers do not nest
+    if (!valid)
+    {
+        return false; // Never rebroadcast a damaged packet
+    }
+
+    header.origin = buf[1];
+    header.ttl = buf[2];
+    header.packetId = buf[3];
+    packet = inner;
+    packetLen = innerLen;
+    return true;
+}
+
+uint32_t relay_backoff_ms(float snrDb, uint32_t airtimeMs, uint16_t jitter)
+{
+    float nearness = (snrDb - RELAY_SNR_FAR_DB) / (RELAY_SNR_NEAR_DB - RELAY_SNR_FAR_DB);
+    nearness = nearness < 0.0f ? 0.0f : (nearness > 1.0f ? 1.0f : nearness);
+    uint32_t backoff = static_cast<uint32_t>(nearness * RELAY_BACKOFF_SLOTS * airtimeMs);
+    return backoff + (airtimeMs > 0 ? jitter % airtimeMs : 0);
+}
+
+RelayRouter::RelayRouter(AirtimeFn airtime, uint8_t ttl)
+    : airtime(airtime), ttl(ttl), id(0), nextPacketId(0), relayedCount(0), suppressedCount(0), foldedCount(0),
+      droppedCount(0)
+{
+    for (Pending &p : pending)
+    {
+        p.used = false;
+    }
+}
+
+void RelayRouter::begin(uint8_t nodeId, uint8_t firstPacketId)
+{
+    id = nodeId;
+    nextPacketId = firstPacketId;
+}
+
+size_t RelayRouter::wrap(const uint8_t *packet, size_t len, uint8_t *out)
+{
+    RelayHeader header = {id, ttl, nextPacketId};
+    size_t wrapped = relay_wrap(header, packet, len, out);
+    if (wrapped > 0)
+    {
+        nextPacketId++;
+    }
+    return wrapped;
+}
+
+RelayRouter::Verdict RelayRouter::receive(const uint8_t *buf, size_t len, float snrDb, uint32_t nowMs,
+                                          RelayHeader &header, const uint8_t *&packet, size_t &packetLen)
+{
+    if (!relay_unwrap(buf, len, header, packet, packetLen))
+    {
+        return Verdict::Invalid;
+    }
+    if (header.origin == id)
+    {
+        return Verdict::Own;
+    }
+
+    if (seen.isDuplicate(header.origin, header.packetId, dedup_hash(packet, packetLen), nowMs))
+    {
+        // Another relay got there first: our copy would reach nobody new
+        for (Pending &p : pending)
+        {
+            if (p.used && p.origin == header.origin && p.packetId == header.packetId)
+            {
+                p.used = false;
+                suppressedCount++;
+                return Verdict::Suppressed;
+            }
+        }
+        return Verdict::Duplicate;
+    }
+
+    if (header.ttl > 0)
+    {
+        schedule(header, packet, packetLen, snrDb, nowMs);
+    }
+    return Verdict::Deliver;
+}
+
+void RelayRouter::schedule(const RelayHeader &header, const uint8_t *packet, size_t len, float snrDb, uint32_t nowMs)
+{
+    RelayHeader next = {header.origin, static_cast<uint8_t>(header.ttl - 1), header.packetId};
+    bool loneAck = packet[0] == static_cast<uint8_t>(MessageType::SelectiveAck);
+
+    Pending *slot = nullptr;
+    for (Pending &p : pending)
+    {
+        if (p.used && loneAck && p.loneAck && p.origin == header.origin)
+        {
+            // Reports everything the waiting one does: take its place and its turn
+            p.packetId = header.packetId;
+            p.len = relay_wrap(next, packet, len, p.data);
+            foldedCount++;
+            return;
+        }
+        if (!p.used && slot == nullptr)
+        {
+            slot = &p;
+        }
+    }
+    if (slot == nullptr)
+    {
+        droppedCount++;
+        return;
+    }
+
+    slot->len = relay_wrap(next, packet, len, slot->data);
+    slot->used = true;
+    slot->origin = header.origin;
+    slot->packetId = header.packetId;
+    slot->loneAck = loneAck;
+
+    // Same packet, other node: other jitter
+    uint8_t key[3] = {id, header.origin, header.packetId};
+    slot->dueMs = nowMs + relay_backoff_ms(snrDb, airtime(slot->len), dedup_hash(key, sizeof(key)));
+}
+
+bool RelayRouter::hasPending() const
+{
+    for (const Pending &p : pending)
+    {
+        if (p.used)
+        {
+            return true;
+        }
+    }
+    return false;
+}
+
+size_t RelayRouter::next(uint32_t nowMs, const uint8_t *&packet, uint32_t &waitMs)
+{
+    Pending *due = nullptr;
+    waitMs = UINT32_MAX;
+    for (Pending &p : pending)
+    {
+        if (!p.used)
+        {
+            continue;
+        }
+        int32_t untilDue = static_cast<int32_t>(p.dueMs - nowMs);
+        if (untilDue <= 0)
+        {
+            if (due == nullptr || static_cast<int32_t>(p.dueMs - due->dueMs) < 0)
+            {
+                due = &p;
+            }
+        }
+        else if (static_cast<uint32_t>(untilDue) < waitMs)
+        {
+            waitMs = untilDue;
+        }
+    }
+    if (due == nullptr)
+    {
+        return 0;
+    }
+
+    due->used = false;
+    memcpy(out, due->data, due->len);
+    packet = out;
+    relayedCount++;
+    return due->len;
+}
@@ -0,0 +1,127 @@
+#ifndef RELAY_H
+#define RELAY_H
+
+#include <stddef.h>
+#include <stdint.h>
+#include "Protocol.h"
+#include "Dedup.h"
+
+/// Relay header in front of a packet: [0x06][origin][ttl][packet id][packet...]
+const size_t RELAY_HEADER_SIZE = 4;
+
+/// Rebroadcasts waiting for their backoff at once; more are dropped
+const uint8_t RELAY_QUEUE_SIZE = 4;
+
+/// SNR range the backoff is spread over: a packet heard at or below RELAY_SNR_FAR_DB
+/// (a distant sender, we extend its reach the most) is rebroadcast after the jitter
+/// only, one at or above RELAY_SNR_NEAR_DB waits RELAY_BACKOFF_SLOTS airtimes longer
+const float RELAY_SNR_FAR_DB = -15.0f;
+const float RELAY_SNR_NEAR_DB = 5.0f;
+const uint8_t RELAY_BACKOFF_SLOTS = 4;
+
+/// Routing header of a relayed packet
+struct RelayHeader
+{
+    uint8_t origin;   // Node that first sent the packet
+    uint8_t ttl;      // Rebroadcasts left
+    uint8_t packetId; // Per origin, +1 for every packet it sends
+};
+
+/// Writes header and packet into out (MAX_AGGREGATE_SIZE bytes). Returns the
+/// relayed packet's length, 0 if it would not fit.
+size_t relay_wrap(const RelayHeader &header, const uint8_t *packet, size_t len, uint8_t *out);
+
+/// Splits a relayed packet into its header and the packet it carries. False if
+/// buf is not a relay header followed by a valid frame or aggregate.
+bool relay_unwrap(const uint8_t *buf, size_t len, RelayHeader &header, const uint8_t *&packet, size_t &packetLen);
+
+/// Rebroadcast delay for a packet heard at snrDb: RELAY_BACKOFF_SLOTS packet
+/// airtimes scaled by how close the sender is, plus up to one airtime of jitter
+uint32_t relay_backoff_ms(float snrDb, uint32_t airtimeMs, uint16_t jitter);
+
+/// Managed flooding: every node rebroadcasts the relayed packets it hears for
+/// the first time, once, with the TTL decremented.
+///
+/// Packets seen before (same origin and packet id, same contents) are dropped.
+/// The rebroadcast waits for an SNR-weighted backoff, so distant nodes relay
+/// first; a node that hears another relay's copy while it is still waiting
+/// cancels its own, so a dense cluster adds about one transmission per hop.
+/// A newer lone selective ACK from the same origin replaces a waiting one.
+///
+/// No clock or radio access: every call takes the current time in ms.
+class RelayRouter
+{
+public:
+    /// Airtime in ms of a packet of len bytes
+    typedef uint32_t (*AirtimeFn)(size_t len);
+
+    /// What receive() made of a relayed packet
+    enum class Verdict
+    {
+        Deliver,    // First copy: handle the packet (a rebroadcast may be scheduled)
+        Duplicate,  // Seen before, drop
+        Suppressed, // Seen before, and our own rebroadcast of it is cancelled
+        Own,        // One of our packets relayed back to us, drop
+        Invalid     // No valid relay header and packet
+    };
+
+    RelayRouter(AirtimeFn airtime, uint8_t ttl);
+
+    /// Sets our origin id, and the id of our first packet (random after a reboot,
+    /// so peers do not take new packets for ones they saw before it)
+    void begin(uint8_t nodeId, uint8_t firstPacketId);
+
+    uint8_t nodeId() const { return id; }
+
+    /// Puts the header of a new packet of ours in front of packet. Returns the
+    /// length written to out (MAX_AGGREGATE_SIZE bytes), 0 if it does not fit.
+    size_t wrap(const uint8_t *packet, size_t len, uint8_t *out);
+
+    /// Handles a received relayed packet. On Deliver, header, packet and
+    /// packetLen describe it (packet points into buf).
+    Verdict receive(const uint8_t *buf, size_t len, float snrDb, uint32_t nowMs, RelayHeader &header,
+                    const uint8_t *&packet, size_t &packetLen);
+
+    /// Takes the next rebroadcast that is due. Returns its length (packet points
+    /// into the router, valid until the next call), or 0 with waitMs set to the
+    /// time until the next one is due (UINT32_MAX if none is waiting).
+    size_t next(uint32_t nowMs, const uint8_t *&packet, uint32_t &waitMs);
+
+    /// True if a rebroadcast is waiting
+    bool hasPending() const;
+
+    uint32_t relayed() const { return relayedCount; }
+    uint32_t suppressed() const { return suppressedCount; }
+    uint32_t folded() const { return foldedCount; }
+
+    /// Rebroadcasts lost to a full queue
+    uint32_t dropped() const { return droppedCount; }
+
+private:
+    struct Pending
+    {
+        bool used;
+        uint8_t origin;
+        uint8_t packetId;
+        bool loneAck; // Carries only a selective ACK, a newer one from origin replaces it
+        uint32_t dueMs;
+        uint8_t len;
+        uint8_t data[MAX_AGGREGATE_SIZE];
+    };
+
+    AirtimeFn airtime;
+    uint8_t ttl;
+    uint8_t id;
+    uint8_t nextPacketId;
+    DedupCache seen;
+    Pending pending[RELAY_QUEUE_SIZE];
+    uint8_t out[MAX_AGGREGATE_SIZE];
+    uint32_t relayedCount;
+    uint32_t suppressedCount;
+    uint32_t foldedCount;
+    uint32_t droppedCount;
+
+    void schedule(const RelayHeader &header, const uint8_t *packet, size_t len, float snrDb, uint32_t nowMs);
+};
+
+#endif // RELAY_H
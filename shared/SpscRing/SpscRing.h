@@ -0,0 +1,152 @@
+#ifndef SPSC_RING_H
+#define SPSC_RING_H
+
+#include <stddef.h>
+#include <stdint.h>
+#include <atomic>
+
+/// Lock-free single-producer/single-consumer ring of N items (N a power of two).
+///
+/// One task pushes, one other task peeks, drops, pops and coalesces; neither
+/// ever blocks or takes a lock. Positions run freely and are masked, so all N
+/// slots are usable. Items are copied in and out: keep T small and trivially
+/// copyable (a WireFrame is 51 bytes).
+///
+/// The consumer owns every pending slot, so it may peek at any of them and
+/// compact them (coalesce()) while the producer keeps appending behind them.
+template <typename T, size_t N>
+class SpscRing
+{
+public:
+    static_assert(N >= 2 && (N & (N - 1)) == 0, "SpscRing capacity must be a power of two");
+
+    SpscRing() : head(0), tail(0) {}
+
+    /// Appends an item (producer). False if the ring is full.
+    bool push(const T &item)
+    {
+        size_t t = tail.load(std::memory_order_relaxed);
+        if (t - head.load(std::memory_order_acquire) == N)
+        {
+            return false;
+        }
+        slots[t & MASK] = item;
+        tail.store(t + 1, std::memory_order_release);
+        return true;
+    }
+
+    /// Copies the item at index (0 = oldest) without removing it (consumer)
+    bool peek(size_t index, T &item) const
+    {
+        size_t h = head.load(std::memory_order_relaxed);
+        if (index >= tail.load(std::memory_order_acquire) - h)
+        {
+            return false;
+        }
+        item = slots[(h + index) & MASK];
+        return true;
+    }
+
+    /// Removes the oldest n items (consumer)
+    void drop(size_t n)
+    {
+        size_t h = head.load(std::memory_order_relaxed);
+        size_t pending = tail.load(std::memory_order_acquire) - h;
+        head.store(h + (n < pending ? n : pending), std::memory_order_release);
+    }
+
+    /// Takes the oldest item (consumer). False if the ring is empty.
+    bool pop(T &item)
+    {
+        if (!peek(0, item))
+        {
+            return false;
+        }
+        drop(1);
+        return true;
+    }
+
+    /// Removes every pending item that a newer pending item replaces
+    /// (same(older, newer) is true), keeping the order of the rest (consumer).
+    /// Returns the number of items removed.
+    template <typename Same>
+    size_t coalesce(Same same)
+    {
+        size_t h = head.load(std::memory_order_relaxed);
+        size_t t = tail.load(std::memory_order_acquire);
+
+        // Walk from the newest item back; survivors are packed against t
+        size_t kept = t;
+        for (size_t i = t; i-- > h;)
+        {
+            bool replaced = false;
+            for (size_t j = kept; j < t && !replaced; j++)
+            {
+                replaced = same(slots[i & MASK], slots[j & MASK]);
+            }
+            if (!replaced && --kept != i)
+            {
+                slots[kept & MASK] = slots[i & MASK];
+            }
+        }
+        head.store(kept, std::memory_order_release);
+        return kept - h;
+    }
+
+    /// Items pending. Exact for the consumer, a lower bound of the free space for the producer.
+    size_t size() const { return tail.load(std::memory_order_acquire) - head.load(std::memory_order_acquire); }
+    bool empty() const { return size() == 0; }
+    static constexpr size_t capacity() { return N; }
+
+private:
+    static const size_t MASK = N - 1;
+
+    T slots[N];
+    std::atomic<size_t> head; // Next item to take, written by the consumer only
+    std::atomic<size_t> tail; // Next slot to fill, written by the producer only
+};
+
+/// LANES SpscRings between the same producer and consumer, lane 0 the most
+/// urgent: pop() serves a lane only once every lane before it is empty, so
+/// ACKs and control traffic overtake bulk text. A full lane never blocks the others.
+template <typename T, size_t N, size_t LANES>
+class SpscLanes
+{
+public:
+    static_assert(LANES >= 1, "SpscLanes needs a lane");
+
+    /// Appends an item to a lane (producer). False if that lane is full.
+    bool push(size_t lane, const T &item) { return lanes[lane].push(item); }
+
+    /// Takes the oldest item of the most urgent non-empty lane (consumer)
+    bool pop(T &item)
+    {
+        for (size_t i = 0; i < LANES; i++)
+        {
+            if (lanes[i].pop(item))
+            {
+                return true;
+            }
+        }
+        return false;
+    }
+
+    SpscRing<T, N> &lane(size_t lane) { return lanes[lane]; }
+
+    size_t size() const
+    {
+        size_t total = 0;
+        for (size_t i = 0; i < LANES; i++)
+        {
+            total += lanes[i].size();
+        }
+        return total;
+    }
+
+    bool empty() const { return size() == 0; }
+
+private:
+    SpscRing<T, N> lanes[LANES];
+};
+
+#endif // SPSC_RING_H
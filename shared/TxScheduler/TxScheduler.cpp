@@ -0,0 +1,256 @@
+#include "TxScheduler.h"
+#include <string.h>
+
+DutyCycleLimiter::DutyCycleLimiter(uint32_t windowMs, uint16_t limitPermille)
+    : bucketMs(windowMs / BUCKETS > 0 ? windowMs / BUCKETS : 1),
+      budget(static_cast<uint32_t>(static_cast<uint64_t>(windowMs) * limitPermille / 1000)),
+      head(0), currentIndex(0)
+{
+    memset(buckets, 0, sizeof(buckets));
+}
+
+void DutyCycleLimiter::advance(uint32_t nowMs)
+{
+    uint32_t index = nowMs / bucketMs;
+    if (index < currentIndex || index - currentIndex >= BUCKETS)
+    {
+        // millis() wrapped, or the whole window is in the past
+        memset(buckets, 0, sizeof(buckets));
+    }
+    else
+    {
+        for (uint32_t i = currentIndex; i < index; i++)
+        {
+            head = (head + 1) % BUCKETS;
+            buckets[head] = 0;
+        }
+    }
+    currentIndex = index;
+}
+
+uint32_t DutyCycleLimiter::usedMs(uint32_t nowMs)
+{
+    advance(nowMs);
+    uint32_t used = 0;
+    for (uint32_t bucket : buckets)
+    {
+        used += bucket;
+    }
+    return used;
+}
+
+uint32_t DutyCycleLimiter::waitMs(uint32_t nowMs, uint32_t airtimeMs)
+{
+    if (airtimeMs > budget)
+    {
+        return UINT32_MAX;
+    }
+
+    uint32_t used = usedMs(nowMs);
+    if (used + airtimeMs <= budget)
+    {
+        return 0;
+    }
+
+    // Oldest bucket first: the k-th oldest leaves the window when bucket currentIndex + 1 + k starts
+    for (uint8_t k = 0; k < BUCKETS; k++)
+    {
+        used -= buckets[(head + 1 + k) % BUCKETS];
+        if (used + airtimeMs <= budget)
+        {
+            uint64_t freeAt = static_cast<uint64_t>(currentIndex + 1 + k) * bucketMs;
+            uint64_t wait = freeAt - nowMs;
+            return wait < UINT32_MAX ? static_cast<uint32_t>(wait) : UINT32_MAX - 1;
+        }
+    }
+    return UINT32_MAX; // Not reached: an empty window always fits airtimeMs <= budget
+}
+
+void DutyCycleLimiter::record(uint32_t nowMs, uint32_t airtimeMs)
+{
+    advance(nowMs);
+    buckets[head] += airtimeMs;
+}
+
+// A lone frame is sent bare, so the builder always has room for one frame of any size
+static size_t schedulerPacketCapacity(size_t packetBudget)
+{
+    const size_t singleFrame = AGGREGATE_HEADER_SIZE + AggregateBuilder::cost(MAX_FRAME_SIZE);
+    return packetBudget > singleFrame ? packetBudget : singleFrame;
+}
+
+TxScheduler::TxScheduler(AirtimeFn airtime, uint32_t windowMs, uint16_t limitPermille, size_t packetBudget,
+                         size_t fragmentBudget, uint32_t fragmentAirtimeMs)
+    : airtime(airtime), limiter(windowMs, limitPermille), ackReserveMs(airtime(3)),
+      priorityHead(0), priorityCount(0), dataHead(0), dataCount(0), deferCount(0),
+      packetBudget(schedulerPacketCapacity(packetBudget)),
+      fragmentBudget(fragmentAirtimeMs > 0 && fragmentBudget > this->packetBudget ? fragmentBudget : this->packetBudget),
+      fragmentAirtimeMs(fragmentAirtimeMs), builder(packetBuf, this->fragmentBudget)
+{
+}
+
+bool TxScheduler::queuePriority(const uint8_t *frame, size_t len)
+{
+    if (len == 0 || len > MAX_FRAME_SIZE || !Message::isValidFrame(frame, len))
+    {
+        return false;
+    }
+
+    for (uint8_t i = 0; i < priorityCount; i++)
+    {
+        WireFrame &queued = priority[(priorityHead + i) % PRIORITY_QUEUE_SIZE];
+        bool sameFrame = queued.len == len && memcmp(queued.data, frame, len) == 0;
+        bool newerSack = frame[0] == static_cast<uint8_t>(MessageType::SelectiveAck) &&
+                         queued.data[0] == static_cast<uint8_t>(MessageType::SelectiveAck);
+        if (sameFrame || newerSack)
+        {
+            // A selective ACK reports the whole receiver state, the newest one replaces any still queued
+            queued.len = len;
+            memcpy(queued.data, frame, len);
+            return true;
+        }
+    }
+
+    if (priorityCount >= PRIORITY_QUEUE_SIZE)
+    {
+        return false;
+    }
+    WireFrame &slot = priority[(priorityHead + priorityCount) % PRIORITY_QUEUE_SIZE];
+    slot.len = len;
+    memcpy(slot.data, frame, len);
+    priorityCount++;
+    return true;
+}
+
+bool TxScheduler::queueData(const uint8_t *frame, size_t len)
+{
+    if (len == 0 || len > MAX_FRAME_SIZE || !Message::isValidFrame(frame, len))
+    {
+        return false;
+    }
+    if (airtime(len) + ackReserveMs > limiter.budgetMs())
+    {
+        return false; // Could never be sent under this duty cycle
+    }
+
+    for (uint8_t i = 0; i < dataCount; i++)
+    {
+        const WireFrame &queued = data[(dataHead + i) % DATA_QUEUE_SIZE];
+        if (queued.len == len && memcmp(queued.data, frame, len) == 0)
+        {
+            return true; // Retransmission of a frame that has not gone out yet
+        }
+    }
+
+    if (dataCount >= DATA_QUEUE_SIZE)
+    {
+        return false;
+    }
+    WireFrame &slot = data[(dataHead + dataCount) % DATA_QUEUE_SIZE];
+    slot.len = len;
+    memcpy(slot.data, frame, len);
+    dataCount++;
+    return true;
+}
+
+bool TxScheduler::fits(const WireFrame &frame) const
+{
+    size_t size = builder.size() + AggregateBuilder::cost(frame.len);
+    if (size <= packetBudget)
+    {
+        return true;
+    }
+    // Past the aggregate budget only fragments, while the packet stays within their airtime
+    return frame.data[0] == static_cast<uint8_t>(MessageType::Fragment) && size <= fragmentBudget &&
+           airtime(size) <= fragmentAirtimeMs;
+}
+
+size_t TxScheduler::pack(uint8_t maxData, const uint8_t *&packet, uint8_t &priorityUsed, uint8_t &dataUsed)
+{
+    builder.clear();
+    priorityUsed = 0;
+    dataUsed = 0;
+
+    while (priorityUsed < priorityCount)
+    {
+        const WireFrame &frame = priority[(priorityHead + priorityUsed) % PRIORITY_QUEUE_SIZE];
+        if (!fits(frame) || !builder.add(frame.data, frame.len))
+        {
+            break;
+        }
+        priorityUsed++;
+    }
+    while (dataUsed < dataCount && dataUsed < maxData)
+    {
+        const WireFrame &frame = data[(dataHead + dataUsed) % DATA_QUEUE_SIZE];
+        if (!fits(frame) || !builder.add(frame.data, frame.len))
+        {
+            break;
+        }
+        dataUsed++;
+    }
+
+    return builder.finish(packet);
+}
+
+void TxScheduler::pop(uint8_t priorityUsed, uint8_t dataUsed)
+{
+    priorityHead = (priorityHead + priorityUsed) % PRIORITY_QUEUE_SIZE;
+    priorityCount -= priorityUsed;
+    dataHead = (dataHead + dataUsed) % DATA_QUEUE_SIZE;
+    dataCount -= dataUsed;
+}
+
+size_t TxScheduler::next(uint32_t nowMs, const uint8_t *&packet, uint32_t &waitMs)
+{
+    waitMs = UINT32_MAX;
+    if (!hasPending())
+    {
+        return 0;
+    }
+
+    uint8_t priorityUsed;
+    uint8_t dataUsed;
+    size_t len = 0;
+    uint32_t dataWait = UINT32_MAX;
+
+    if (dataCount > 0)
+    {
+        // Data must leave one ACK's worth of budget unused so the peer still hears from us
+        len = pack(DATA_QUEUE_SIZE, packet, priorityUsed, dataUsed);
+        dataWait = limiter.waitMs(nowMs, airtime(len) + ackReserveMs);
+        if (dataWait == UINT32_MAX && dataUsed > 1)
+        {
+            // A full packet could never fit the budget, send the data one frame at a time
+            len = pack(1, packet, priorityUsed, dataUsed);
+            dataWait = limiter.waitMs(nowMs, airtime(len) + ackReserveMs);
+        }
+        if (dataWait == 0)
+        {
+            limiter.record(nowMs, airtime(len));
+            pop(priorityUsed, dataUsed);
+            return len;
+        }
+    }
+
+    if (priorityCount > 0)
+    {
+        // Budget too short for the data: the ACKs go out on their own
+        len = pack(0, packet, priorityUsed, dataUsed);
+        uint32_t ackWait = limiter.waitMs(nowMs, airtime(len));
+        if (ackWait == 0)
+        {
+            limiter.record(nowMs, airtime(len));
+            pop(priorityUsed, dataUsed);
+            return len;
+        }
+        waitMs = ackWait;
+    }
+    else
+    {
+        waitMs = dataWait;
+    }
+
+    deferCount++;
+    return 0;
+}
@@ -0,0 +1,125 @@
+#ifndef TX_SCHEDULER_H
+#define TX_SCHEDULER_H
+
+#include <stddef.h>
+#include <stdint.h>
+#include "Protocol.h"
+
+/// Tracks airtime over a sliding window split into fixed buckets, so memory
+/// stays constant however many packets are sent. A packet is charged to the
+/// bucket it started in and stays counted until that whole bucket leaves the
+/// window, which errs on the safe side by at most one bucket.
+///
+/// millis() wrapping (every ~49 days) clears the history once.
+class DutyCycleLimiter
+{
+public:
+    static const uint8_t BUCKETS = 60;
+
+    /// limitPermille of windowMs may be used for transmissions
+    DutyCycleLimiter(uint32_t windowMs, uint16_t limitPermille);
+
+    /// Airtime allowed per window
+    uint32_t budgetMs() const { return budget; }
+
+    /// Airtime charged in the current window
+    uint32_t usedMs(uint32_t nowMs);
+
+    /// Milliseconds until airtimeMs can be sent (0 = now), UINT32_MAX if it never fits
+    uint32_t waitMs(uint32_t nowMs, uint32_t airtimeMs);
+
+    /// Charges a transmission that starts now
+    void record(uint32_t nowMs, uint32_t airtimeMs);
+
+private:
+    uint32_t bucketMs;
+    uint32_t budget;
+    uint32_t buckets[BUCKETS];
+    uint8_t head;          // Bucket of the current interval
+    uint32_t currentIndex; // nowMs / bucketMs of the head bucket
+
+    void advance(uint32_t nowMs);
+};
+
+/// Decides what goes on air next under a duty-cycle limit.
+///
+/// Frames are queued as priority (ACKs) or data (texts, retransmissions) and
+/// packed into one aggregate per packet, priority frames first. Data may only
+/// use the budget while one ACK's airtime stays in reserve, and when the budget
+/// is short an ACK-only packet is sent ahead of the data - so acknowledgments
+/// keep flowing even when new text has to wait.
+///
+/// Fragments of a long message may fill a packet beyond the aggregate budget,
+/// up to fragmentBudget bytes as long as it stays within fragmentAirtimeMs on
+/// air, so one preamble carries the whole message.
+class TxScheduler
+{
+public:
+    /// Airtime in ms of a packet of len bytes
+    typedef uint32_t (*AirtimeFn)(size_t len);
+
+    static const uint8_t PRIORITY_QUEUE_SIZE = 8;
+    static const uint8_t DATA_QUEUE_SIZE = 16;
+
+    /// packetBudget is the aggregate size limit in bytes (LORA_AGGREGATE_MAX_BYTES). Fragments
+    /// may use up to fragmentBudget bytes and fragmentAirtimeMs (LORA_FRAGMENT_MAX_AIRTIME_MS),
+    /// 0 packs them like any other frame.
+    TxScheduler(AirtimeFn airtime, uint32_t windowMs, uint16_t limitPermille, size_t packetBudget,
+                size_t fragmentBudget = 0, uint32_t fragmentAirtimeMs = 0);
+
+    /// Queues an ACK. Returns false if the queue is full or the frame is invalid.
+    bool queuePriority(const uint8_t *frame, size_t len);
+
+    /// Queues a text or retransmission. A frame identical to one still queued is
+    /// accepted without being queued twice. Returns false if the queue is full or
+    /// the frame could never fit the duty-cycle budget.
+    bool queueData(const uint8_t *frame, size_t len);
+
+    /// True if any frame is waiting
+    bool hasPending() const { return priorityCount > 0 || dataCount > 0; }
+
+    /// True if texts or retransmissions are waiting (not just ACKs)
+    bool hasData() const { return dataCount > 0; }
+
+    /// True if queueData() has room for another frame
+    bool canQueueData() const { return dataCount < DATA_QUEUE_SIZE; }
+
+    /// Packs the next packet that may go on air now and charges its airtime.
+    /// Returns its length (packet points into the scheduler, valid until the next
+    /// call), or 0 with waitMs set to the time until the duty cycle allows the
+    /// next packet (UINT32_MAX if nothing is queued).
+    size_t next(uint32_t nowMs, const uint8_t *&packet, uint32_t &waitMs);
+
+    /// Duty-cycle bookkeeping, for logging and capacity reports
+    DutyCycleLimiter &dutyCycle() { return limiter; }
+
+    /// Times next() held frames back because of the duty cycle
+    uint32_t deferrals() const { return deferCount; }
+
+private:
+    AirtimeFn airtime;
+    DutyCycleLimiter limiter;
+    uint32_t ackReserveMs;
+
+    WireFrame priority[PRIORITY_QUEUE_SIZE];
+    WireFrame data[DATA_QUEUE_SIZE];
+    uint8_t priorityHead, priorityCount;
+    uint8_t dataHead, dataCount;
+    uint32_t deferCount;
+    size_t packetBudget;
+    size_t fragmentBudget;
+    uint32_t fragmentAirtimeMs;
+
+    uint8_t packetBuf[MAX_AGGREGATE_SIZE];
+    AggregateBuilder builder;
+
+    /// Packs the priority heads and up to maxData data frames. Returns the packet
+    /// length and how many frames of each queue it holds.
+    size_t pack(uint8_t maxData, const uint8_t *&packet, uint8_t &priorityUsed, uint8_t &dataUsed);
+
+    /// True if frame still fits the packet being packed
+    bool fits(const WireFrame &frame) const;
+    void pop(uint8_t priorityUsed, uint8_t dataUsed);
+};
+
+#endif // TX_SCHEDULER_H